@@ -43,6 +43,11 @@ GRN_API grn_rc grn_cache_set_max_n_entries(grn_ctx *ctx,
                                            unsigned int n);
 GRN_API unsigned int grn_cache_get_max_n_entries(grn_ctx *ctx,
                                                  grn_cache *cache);
+GRN_API grn_rc grn_cache_set_max_size(grn_ctx *ctx,
+                                      grn_cache *cache,
+                                      uint64_t max_size);
+GRN_API uint64_t grn_cache_get_max_size(grn_ctx *ctx,
+                                        grn_cache *cache);
 
 #ifdef __cplusplus
 }
@@ -37,6 +37,26 @@ GRN_API void *grn_column_cache_ref(grn_ctx *ctx,
 GRN_API grn_rc
 grn_column_copy(grn_ctx *ctx, grn_obj *from, grn_obj *to);
 
+/*
+  grn_column_get_values_batch() stores values of ids of column into
+  values at once. values is reinitialized.
+
+  values is a GRN_UVECTOR for a fixed size column. It has a value for
+  each ID in the same order as ids.
+
+  values is a GRN_VECTOR for a variable size scalar column. Each
+  element is a value for each ID in the same order as ids.
+
+  Values of nonexistent IDs are 0 or empty. Sorted ids are
+  processed faster.
+*/
+GRN_API grn_rc
+grn_column_get_values_batch(grn_ctx *ctx,
+                            grn_obj *column,
+                            const grn_id *ids,
+                            size_t n_ids,
+                            grn_obj *values);
+
 #ifdef __cplusplus
 }
 #endif
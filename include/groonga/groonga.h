@@ -362,6 +362,7 @@ typedef uint32_t grn_column_flags;
 #define GRN_OBJ_INDEX_SMALL            (0x01<<16)
 #define GRN_OBJ_INDEX_MEDIUM           (0x01<<17)
 #define GRN_OBJ_INDEX_LARGE            (0x01<<18)
+#define GRN_OBJ_WITH_DOCUMENT_LENGTH   (0x01<<19)
 
 /* obj types */
 
@@ -649,6 +650,9 @@ GRN_API grn_obj *grn_obj_column(grn_ctx *ctx, grn_obj *table,
 #define GRN_COLUMN_NAME_SUM_LEN       (sizeof(GRN_COLUMN_NAME_SUM) - 1)
 #define GRN_COLUMN_NAME_AVG           "_avg"
 #define GRN_COLUMN_NAME_AVG_LEN       (sizeof(GRN_COLUMN_NAME_AVG) - 1)
+#define GRN_COLUMN_NAME_APPROX_DISTINCT "_approx_distinct"
+#define GRN_COLUMN_NAME_APPROX_DISTINCT_LEN \
+  (sizeof(GRN_COLUMN_NAME_APPROX_DISTINCT) - 1)
 
 GRN_API grn_obj *grn_column_create(grn_ctx *ctx, grn_obj *table,
                                    const char *name, unsigned int name_size,
@@ -59,10 +59,68 @@ GRN_API unsigned int
 GRN_API int
   grn_scorer_matched_record_get_weight(grn_ctx *ctx,
                                        grn_scorer_matched_record *record);
+GRN_API unsigned int
+  grn_scorer_matched_record_get_section_id(grn_ctx *ctx,
+                                           grn_scorer_matched_record *record);
+/*
+  The following length functions require an index column created with
+  WITH_DOCUMENT_LENGTH flag. They return 0 for other index columns.
+
+  Section lengths are stored only for the first sections of an index
+  column with WITH_SECTION flag. Section length functions return 0 for
+  the other sections.
+ */
+GRN_API unsigned int
+  grn_scorer_matched_record_get_document_length(grn_ctx *ctx,
+                                                grn_scorer_matched_record *record);
+GRN_API double
+  grn_scorer_matched_record_get_average_document_length(grn_ctx *ctx,
+                                                        grn_scorer_matched_record *record);
+GRN_API unsigned int
+  grn_scorer_matched_record_get_section_length(grn_ctx *ctx,
+                                               grn_scorer_matched_record *record);
+GRN_API double
+  grn_scorer_matched_record_get_average_section_length(grn_ctx *ctx,
+                                                       grn_scorer_matched_record *record);
+/*
+  A score function is called for each matched section of a record. The
+  following functions return the sums of the values of the sections of
+  the same record that are already scored in the current search. They
+  can be used to score TF of all sections of a record.
+ */
+GRN_API unsigned int
+  grn_scorer_matched_record_get_n_previous_occurrences(grn_ctx *ctx,
+                                                       grn_scorer_matched_record *record);
+GRN_API unsigned int
+  grn_scorer_matched_record_get_previous_total_term_weights(grn_ctx *ctx,
+                                                            grn_scorer_matched_record *record);
+/*
+  A score function can set normalized TF of the current section such as
+  weighted and length normalized TF. It is summed up like the above
+  values. grn_scorer_matched_record_get_previous_normalized_tf() returns
+  the sum of the previous sections of the same record. It is 0 when no
+  normalized TF is set.
+ */
+GRN_API double
+  grn_scorer_matched_record_get_previous_normalized_tf(grn_ctx *ctx,
+                                                       grn_scorer_matched_record *record);
+GRN_API void
+  grn_scorer_matched_record_set_normalized_tf(grn_ctx *ctx,
+                                              grn_scorer_matched_record *record,
+                                              double normalized_tf);
+/*
+  grn_scorer_matched_record_get_arg() always returns the first
+  argument. Use grn_scorer_matched_record_get_nth_arg() to get the
+  `i'-th argument.
+ */
 GRN_API grn_obj *
   grn_scorer_matched_record_get_arg(grn_ctx *ctx,
                                     grn_scorer_matched_record *record,
                                     unsigned int i);
+GRN_API grn_obj *
+  grn_scorer_matched_record_get_nth_arg(grn_ctx *ctx,
+                                        grn_scorer_matched_record *record,
+                                        unsigned int i);
 GRN_API unsigned int
   grn_scorer_matched_record_get_n_args(grn_ctx *ctx,
                                        grn_scorer_matched_record *record);
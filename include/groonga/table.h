@@ -179,6 +179,8 @@ typedef uint32_t grn_table_group_flags;
 #define GRN_TABLE_GROUP_CALC_MIN       (0x01<<5)
 #define GRN_TABLE_GROUP_CALC_SUM       (0x01<<6)
 #define GRN_TABLE_GROUP_CALC_AVG       (0x01<<7)
+#define GRN_TABLE_GROUP_CALC_APPROX_DISTINCT (0x01<<8)
+#define GRN_TABLE_GROUP_APPROX_TOP_N   (0x01<<9)
 
 struct _grn_table_group_result {
   grn_obj *table;
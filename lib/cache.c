@@ -27,6 +27,32 @@
 
 #include <sys/stat.h>
 
+#ifdef GRN_WITH_ZLIB
+# include <zlib.h>
+#endif /* GRN_WITH_ZLIB */
+
+#ifdef GRN_WITH_LZ4
+# include <lz4.h>
+# if (LZ4_VERSION_MAJOR == 1 && LZ4_VERSION_MINOR < 6)
+#  define LZ4_compress_default(source, dest, source_size, max_dest_size) \
+  LZ4_compress((source), (dest), (source_size))
+# endif
+#endif /* GRN_WITH_LZ4 */
+
+#ifdef GRN_WITH_ZSTD
+# include <zstd.h>
+#endif /* GRN_WITH_ZSTD */
+
+typedef enum {
+  GRN_CACHE_COMPRESSION_NONE,
+  GRN_CACHE_COMPRESSION_ZLIB,
+  GRN_CACHE_COMPRESSION_LZ4,
+  GRN_CACHE_COMPRESSION_ZSTD
+} grn_cache_compression;
+
+/* Smaller values aren't compressed. */
+#define GRN_CACHE_COMPRESSION_THRESHOLD_SIZE 256
+
 typedef struct _grn_cache_entry_memory grn_cache_entry_memory;
 
 struct _grn_cache_entry_memory {
@@ -34,7 +60,24 @@ struct _grn_cache_entry_memory {
   grn_cache_entry_memory *prev;
   grn_obj *value;
   grn_timeval tv;
+  /* The last time when the entry is stored or fetched. It's used by
+     grn_cache_expire() to find the least recently used entry in all
+     shards. */
+  grn_timeval used_time;
   grn_id id;
+  /* IDs of tables that the value depends on. NULL means that the value
+     depends on the whole database. */
+  grn_id *dependencies;
+  uint32_t n_dependencies;
+  grn_cache_compression compression;
+  /* The size of the uncompressed value. */
+  uint32_t value_size;
+  /* Checksums of the uncompressed value to output a value compressed by
+     zlib as is. */
+  uint32_t crc32;
+  uint32_t adler32;
+  /* The number of bytes counted against max_size of the cache. */
+  uint64_t size;
 };
 
 typedef struct _grn_cache_entry_persistent_data {
@@ -58,16 +101,42 @@ typedef union _grn_cache_entry_persistent {
   grn_cache_entry_persistent_metadata metadata;
 } grn_cache_entry_persistent;
 
+/*
+  Memory cache is split into shards by key hash. Each shard has its own
+  lock and LRU list to reduce lock contention between threads. The max
+  number of entries and the max number of bytes are shared by all
+  shards. next and prev must be the first members because a shard is
+  used as the head of its LRU list.
+ */
+typedef struct _grn_cache_shard_memory {
+  grn_cache_entry_memory *next;
+  grn_cache_entry_memory *prev;
+  /* A grn_ctx can't be used by multiple threads at once. It's used only
+     while mutex is locked. */
+  grn_ctx ctx;
+  grn_hash *hash;
+  grn_mutex mutex;
+  uint32_t nfetches;
+  uint32_t nhits;
+} grn_cache_shard_memory;
+
+#define GRN_CACHE_DEFAULT_N_SHARDS 16
+#define GRN_CACHE_MAX_N_SHARDS 256
+
 struct _grn_cache {
   union {
     struct {
-      grn_cache_entry_memory *next;
-      grn_cache_entry_memory *prev;
-      grn_hash *hash;
-      grn_mutex mutex;
+      grn_cache_shard_memory *shards;
+      uint32_t n_shards;
       uint32_t max_nentries;
-      uint32_t nfetches;
-      uint32_t nhits;
+      /* 0 means that the number of bytes isn't limited. */
+      uint64_t max_size;
+      /* It protects max_nentries, max_size, nentries and size. It's
+         locked after a shard is locked. It's never locked while it
+         waits for a shard. */
+      grn_critical_section lock;
+      uint32_t nentries;
+      uint64_t size;
     } memory;
     struct {
       grn_hash *keys;
@@ -92,6 +161,10 @@ static grn_ctx grn_cache_ctx;
 static grn_cache *grn_cache_current = NULL;
 static grn_cache *grn_cache_default = NULL;
 static char grn_cache_default_base_path[PATH_MAX];
+static uint32_t grn_cache_n_shards = GRN_CACHE_DEFAULT_N_SHARDS;
+static uint64_t grn_cache_default_max_size = 0;
+static grn_cache_compression grn_cache_compression_type =
+  GRN_CACHE_COMPRESSION_NONE;
 
 void
 grn_set_default_cache_base_path(const char *base_path)
@@ -115,25 +188,491 @@ grn_get_default_cache_base_path(void)
   }
 }
 
+grn_inline static grn_cache_shard_memory *
+grn_cache_get_shard_memory(grn_cache *cache,
+                           const char *key,
+                           uint32_t key_len)
+{
+  /* FNV-1a */
+  uint32_t hash_value = 2166136261U;
+  uint32_t i;
+
+  if (cache->impl.memory.n_shards == 1) {
+    return cache->impl.memory.shards;
+  }
+
+  for (i = 0; i < key_len; i++) {
+    hash_value ^= (uint8_t)key[i];
+    hash_value *= 16777619U;
+  }
+  return cache->impl.memory.shards +
+    (hash_value % cache->impl.memory.n_shards);
+}
+
+static void
+grn_cache_dependencies_free(grn_ctx *ctx, grn_id *dependencies)
+{
+  if (dependencies) {
+    GRN_FREE(dependencies);
+  }
+}
+
+static void
+grn_cache_entry_memory_fin(grn_ctx *ctx, grn_cache_entry_memory *ce)
+{
+  grn_obj_close(ctx, ce->value);
+  grn_cache_dependencies_free(ctx, ce->dependencies);
+}
+
+static grn_id *
+grn_cache_dependencies_dup(grn_ctx *ctx,
+                           grn_obj *table_ids,
+                           uint32_t *n_dependencies)
+{
+  grn_id *dependencies;
+  size_t size = GRN_BULK_VSIZE(table_ids);
+
+  *n_dependencies = 0;
+  if (size == 0) {
+    return NULL;
+  }
+  dependencies = GRN_MALLOC(size);
+  if (!dependencies) {
+    return NULL;
+  }
+  grn_memcpy(dependencies, GRN_BULK_HEAD(table_ids), size);
+  *n_dependencies = size / sizeof(grn_id);
+  return dependencies;
+}
+
+/*
+  tv is the time when the entry is stored. dependencies is a copy of IDs
+  of tables that the entry depends on. NULL means that the entry depends
+  on the whole database. This must not be called while a shard is locked
+  because grn_ctx_at() may open a table.
+ */
+static grn_bool
+grn_cache_entry_memory_is_valid(grn_ctx *ctx,
+                                grn_timeval *tv,
+                                grn_obj *dependencies)
+{
+  grn_obj *db = ctx->impl->db;
+  size_t i;
+  size_t n_dependencies;
+
+  if (!dependencies) {
+    return tv->tv_sec > grn_db_get_last_modified(ctx, db);
+  }
+
+  if (tv->tv_sec <= grn_db_get_last_touched(ctx, db)) {
+    return GRN_FALSE;
+  }
+  n_dependencies = GRN_BULK_VSIZE(dependencies) / sizeof(grn_id);
+  for (i = 0; i < n_dependencies; i++) {
+    grn_obj *table = grn_ctx_at(ctx, GRN_RECORD_VALUE_AT(dependencies, i));
+    if (!table) {
+      return GRN_FALSE;
+    }
+    if (tv->tv_sec <= grn_obj_get_last_modified(ctx, table)) {
+      return GRN_FALSE;
+    }
+  }
+  return GRN_TRUE;
+}
+
+#ifdef GRN_WITH_ZLIB
+/*
+  A value is compressed to a raw deflate stream that is flushed by
+  Z_SYNC_FLUSH instead of being finished. It doesn't have the last block
+  and ends at a byte boundary. So it can be embedded into a gzip or zlib
+  stream as is. See grn_cache_encode_output().
+ */
+static grn_bool
+grn_cache_compress_zlib(grn_ctx *ctx,
+                        const char *value,
+                        uint32_t value_size,
+                        grn_obj *compressed)
+{
+  z_stream zstream;
+  uLong max_compressed_size;
+  int zrc;
+
+  zstream.next_in = (Bytef *)value;
+  zstream.avail_in = value_size;
+  zstream.zalloc = Z_NULL;
+  zstream.zfree = Z_NULL;
+  zstream.opaque = Z_NULL;
+  zrc = deflateInit2(&zstream, Z_DEFAULT_COMPRESSION, Z_DEFLATED,
+                     -15 /* windowBits: raw deflate */,
+                     8 /* memLevel */,
+                     Z_DEFAULT_STRATEGY);
+  if (zrc != Z_OK) {
+    GRN_LOG(ctx, GRN_LOG_WARNING,
+            "[cache][zlib] failed to compress: initialize: %d", zrc);
+    return GRN_FALSE;
+  }
+  /* Z_SYNC_FLUSH appends an empty stored block. */
+  max_compressed_size = deflateBound(&zstream, value_size) + 5;
+  if (grn_bulk_space(ctx, compressed, max_compressed_size) != GRN_SUCCESS) {
+    deflateEnd(&zstream);
+    return GRN_FALSE;
+  }
+  zstream.next_out = (Bytef *)GRN_BULK_HEAD(compressed);
+  zstream.avail_out = max_compressed_size;
+  zrc = deflate(&zstream, Z_SYNC_FLUSH);
+  if (zrc != Z_OK || zstream.avail_in > 0 || zstream.avail_out == 0) {
+    deflateEnd(&zstream);
+    GRN_LOG(ctx, GRN_LOG_WARNING,
+            "[cache][zlib] failed to compress: flush: %d", zrc);
+    return GRN_FALSE;
+  }
+  grn_bulk_truncate(ctx, compressed, zstream.total_out);
+  deflateEnd(&zstream);
+  return GRN_TRUE;
+}
+
+static grn_bool
+grn_cache_decompress_zlib(grn_ctx *ctx,
+                          const char *compressed,
+                          uint32_t compressed_size,
+                          char *value,
+                          uint32_t value_size)
+{
+  z_stream zstream;
+  int zrc;
+
+  zstream.next_in = (Bytef *)compressed;
+  zstream.avail_in = compressed_size;
+  zstream.zalloc = Z_NULL;
+  zstream.zfree = Z_NULL;
+  zstream.opaque = Z_NULL;
+  zrc = inflateInit2(&zstream, -15 /* windowBits: raw deflate */);
+  if (zrc != Z_OK) {
+    GRN_LOG(ctx, GRN_LOG_WARNING,
+            "[cache][zlib] failed to decompress: initialize: %d", zrc);
+    return GRN_FALSE;
+  }
+  zstream.next_out = (Bytef *)value;
+  zstream.avail_out = value_size;
+  zrc = inflate(&zstream, Z_SYNC_FLUSH);
+  inflateEnd(&zstream);
+  if (!(zrc == Z_OK || zrc == Z_BUF_ERROR) ||
+      zstream.total_out != value_size) {
+    GRN_LOG(ctx, GRN_LOG_WARNING,
+            "[cache][zlib] failed to decompress: %d", zrc);
+    return GRN_FALSE;
+  }
+  return GRN_TRUE;
+}
+#endif /* GRN_WITH_ZLIB */
+
+#ifdef GRN_WITH_LZ4
+static grn_bool
+grn_cache_compress_lz4(grn_ctx *ctx,
+                       const char *value,
+                       uint32_t value_size,
+                       grn_obj *compressed)
+{
+  int max_compressed_size = LZ4_compressBound(value_size);
+  int compressed_size;
+
+  if (grn_bulk_space(ctx, compressed, max_compressed_size) != GRN_SUCCESS) {
+    return GRN_FALSE;
+  }
+  compressed_size = LZ4_compress_default(value,
+                                         GRN_BULK_HEAD(compressed),
+                                         value_size,
+                                         max_compressed_size);
+  if (compressed_size <= 0) {
+    GRN_LOG(ctx, GRN_LOG_WARNING, "[cache][lz4] failed to compress");
+    return GRN_FALSE;
+  }
+  grn_bulk_truncate(ctx, compressed, compressed_size);
+  return GRN_TRUE;
+}
+
+static grn_bool
+grn_cache_decompress_lz4(grn_ctx *ctx,
+                         const char *compressed,
+                         uint32_t compressed_size,
+                         char *value,
+                         uint32_t value_size)
+{
+  if (LZ4_decompress_safe(compressed,
+                          value,
+                          compressed_size,
+                          value_size) != (int)value_size) {
+    GRN_LOG(ctx, GRN_LOG_WARNING, "[cache][lz4] failed to decompress");
+    return GRN_FALSE;
+  }
+  return GRN_TRUE;
+}
+#endif /* GRN_WITH_LZ4 */
+
+#ifdef GRN_WITH_ZSTD
+static grn_bool
+grn_cache_compress_zstd(grn_ctx *ctx,
+                        const char *value,
+                        uint32_t value_size,
+                        grn_obj *compressed)
+{
+  int zstd_compression_level = 3;
+  size_t max_compressed_size = ZSTD_compressBound(value_size);
+  size_t compressed_size;
+
+  if (grn_bulk_space(ctx, compressed, max_compressed_size) != GRN_SUCCESS) {
+    return GRN_FALSE;
+  }
+  compressed_size = ZSTD_compress(GRN_BULK_HEAD(compressed),
+                                  max_compressed_size,
+                                  value,
+                                  value_size,
+                                  zstd_compression_level);
+  if (ZSTD_isError(compressed_size)) {
+    GRN_LOG(ctx, GRN_LOG_WARNING,
+            "[cache][zstd] failed to compress: %s",
+            ZSTD_getErrorName(compressed_size));
+    return GRN_FALSE;
+  }
+  grn_bulk_truncate(ctx, compressed, compressed_size);
+  return GRN_TRUE;
+}
+
+static grn_bool
+grn_cache_decompress_zstd(grn_ctx *ctx,
+                          const char *compressed,
+                          uint32_t compressed_size,
+                          char *value,
+                          uint32_t value_size)
+{
+  size_t written_size;
+
+  written_size = ZSTD_decompress(value, value_size,
+                                 compressed, compressed_size);
+  if (ZSTD_isError(written_size) || written_size != value_size) {
+    GRN_LOG(ctx, GRN_LOG_WARNING,
+            "[cache][zstd] failed to decompress: %s",
+            ZSTD_isError(written_size) ?
+            ZSTD_getErrorName(written_size) :
+            "size mismatch");
+    return GRN_FALSE;
+  }
+  return GRN_TRUE;
+}
+#endif /* GRN_WITH_ZSTD */
+
+/*
+  Compresses value into compressed when it's large enough and
+  compression reduces its size. Returns GRN_CACHE_COMPRESSION_NONE when
+  value isn't compressed.
+ */
+static grn_cache_compression
+grn_cache_value_compress(grn_ctx *ctx,
+                         grn_obj *value,
+                         grn_obj *compressed,
+                         uint32_t *crc32_value,
+                         uint32_t *adler32_value)
+{
+  grn_cache_compression compression = grn_cache_compression_type;
+  const char *raw_value = GRN_TEXT_VALUE(value);
+  uint32_t raw_value_size = GRN_TEXT_LEN(value);
+  grn_bool succeeded = GRN_FALSE;
+
+  *crc32_value = 0;
+  *adler32_value = 0;
+
+  if (compression == GRN_CACHE_COMPRESSION_NONE ||
+      raw_value_size < GRN_CACHE_COMPRESSION_THRESHOLD_SIZE) {
+    return GRN_CACHE_COMPRESSION_NONE;
+  }
+
+  switch (compression) {
+  case GRN_CACHE_COMPRESSION_ZLIB :
+#ifdef GRN_WITH_ZLIB
+    succeeded = grn_cache_compress_zlib(ctx,
+                                        raw_value,
+                                        raw_value_size,
+                                        compressed);
+    if (succeeded) {
+      *crc32_value = crc32(crc32(0L, Z_NULL, 0),
+                           (const Bytef *)raw_value,
+                           raw_value_size);
+      *adler32_value = adler32(adler32(0L, Z_NULL, 0),
+                               (const Bytef *)raw_value,
+                               raw_value_size);
+    }
+#endif /* GRN_WITH_ZLIB */
+    break;
+  case GRN_CACHE_COMPRESSION_LZ4 :
+#ifdef GRN_WITH_LZ4
+    succeeded = grn_cache_compress_lz4(ctx,
+                                       raw_value,
+                                       raw_value_size,
+                                       compressed);
+#endif /* GRN_WITH_LZ4 */
+    break;
+  case GRN_CACHE_COMPRESSION_ZSTD :
+#ifdef GRN_WITH_ZSTD
+    succeeded = grn_cache_compress_zstd(ctx,
+                                        raw_value,
+                                        raw_value_size,
+                                        compressed);
+#endif /* GRN_WITH_ZSTD */
+    break;
+  default :
+    break;
+  }
+  if (!succeeded || GRN_TEXT_LEN(compressed) >= raw_value_size) {
+    GRN_BULK_REWIND(compressed);
+    return GRN_CACHE_COMPRESSION_NONE;
+  }
+  return compression;
+}
+
+static grn_bool
+grn_cache_value_decompress(grn_ctx *ctx,
+                           grn_cache_compression compression,
+                           grn_obj *compressed,
+                           uint32_t value_size,
+                           grn_obj *output)
+{
+  grn_bool succeeded = GRN_FALSE;
+  size_t offset = GRN_BULK_VSIZE(output);
+  char *value;
+
+  if (grn_bulk_space(ctx, output, value_size) != GRN_SUCCESS) {
+    return GRN_FALSE;
+  }
+  value = GRN_BULK_HEAD(output) + offset;
+  switch (compression) {
+  case GRN_CACHE_COMPRESSION_ZLIB :
+#ifdef GRN_WITH_ZLIB
+    succeeded = grn_cache_decompress_zlib(ctx,
+                                          GRN_TEXT_VALUE(compressed),
+                                          GRN_TEXT_LEN(compressed),
+                                          value,
+                                          value_size);
+#endif /* GRN_WITH_ZLIB */
+    break;
+  case GRN_CACHE_COMPRESSION_LZ4 :
+#ifdef GRN_WITH_LZ4
+    succeeded = grn_cache_decompress_lz4(ctx,
+                                         GRN_TEXT_VALUE(compressed),
+                                         GRN_TEXT_LEN(compressed),
+                                         value,
+                                         value_size);
+#endif /* GRN_WITH_LZ4 */
+    break;
+  case GRN_CACHE_COMPRESSION_ZSTD :
+#ifdef GRN_WITH_ZSTD
+    succeeded = grn_cache_decompress_zstd(ctx,
+                                          GRN_TEXT_VALUE(compressed),
+                                          GRN_TEXT_LEN(compressed),
+                                          value,
+                                          value_size);
+#endif /* GRN_WITH_ZSTD */
+    break;
+  default :
+    break;
+  }
+  if (!succeeded) {
+    grn_bulk_truncate(ctx, output, offset);
+  }
+  return succeeded;
+}
+
+/*
+  Returns GRN_CACHE_CONTENT_ENCODING_* to output a value compressed by
+  zlib as is. 0 means that the value must be decompressed. The value is
+  output as is only when it's the whole body of the output and the
+  output envelope doesn't transform it.
+ */
+static int
+grn_cache_select_output_content_encoding(grn_ctx *ctx, grn_obj *output)
+{
+  int accept_content_encodings =
+    ctx->impl->cache_output.accept_content_encodings;
+
+  if (accept_content_encodings == 0) {
+    return 0;
+  }
+  if (output != ctx->impl->output.buf || GRN_TEXT_LEN(output) > 0) {
+    return 0;
+  }
+  switch (ctx->impl->output.type) {
+  case GRN_CONTENT_JSON :
+  case GRN_CONTENT_TSV :
+  case GRN_CONTENT_MSGPACK :
+    break;
+  default :
+    return 0;
+  }
+  if (accept_content_encodings & GRN_CACHE_CONTENT_ENCODING_GZIP) {
+    return GRN_CACHE_CONTENT_ENCODING_GZIP;
+  }
+  if (accept_content_encodings & GRN_CACHE_CONTENT_ENCODING_DEFLATE) {
+    return GRN_CACHE_CONTENT_ENCODING_DEFLATE;
+  }
+  return 0;
+}
+
+static void
+grn_cache_close_shard_memory(grn_cache_shard_memory *shard)
+{
+  grn_ctx *ctx = &(shard->ctx);
+  grn_cache_entry_memory *vp;
+
+  GRN_HASH_EACH(ctx, shard->hash, id, NULL, NULL, &vp, {
+    grn_cache_entry_memory_fin(ctx, vp);
+  });
+  grn_hash_close(ctx, shard->hash);
+  MUTEX_FIN(shard->mutex);
+  grn_ctx_fin(ctx);
+}
+
 static void
 grn_cache_open_memory(grn_ctx *ctx, grn_cache *cache)
 {
-  cache->impl.memory.next = (grn_cache_entry_memory *)cache;
-  cache->impl.memory.prev = (grn_cache_entry_memory *)cache;
-  cache->impl.memory.hash = grn_hash_create(cache->ctx,
-                                            NULL,
-                                            GRN_CACHE_MAX_KEY_SIZE,
-                                            sizeof(grn_cache_entry_memory),
-                                            GRN_OBJ_KEY_VAR_SIZE);
-  if (!cache->impl.memory.hash) {
-    ERR(GRN_NO_MEMORY_AVAILABLE, "[cache] failed to create hash table");
+  uint32_t i;
+
+  cache->impl.memory.n_shards = grn_cache_n_shards;
+  cache->impl.memory.max_nentries = GRN_CACHE_DEFAULT_MAX_N_ENTRIES;
+  cache->impl.memory.max_size = grn_cache_default_max_size;
+  cache->impl.memory.nentries = 0;
+  cache->impl.memory.size = 0;
+  cache->impl.memory.shards =
+    GRN_CALLOC(sizeof(grn_cache_shard_memory) * cache->impl.memory.n_shards);
+  if (!cache->impl.memory.shards) {
+    ERR(GRN_NO_MEMORY_AVAILABLE, "[cache] failed to allocate shards");
     return;
   }
-  MUTEX_INIT(cache->impl.memory.mutex);
 
-  cache->impl.memory.max_nentries = GRN_CACHE_DEFAULT_MAX_N_ENTRIES;
-  cache->impl.memory.nfetches = 0;
-  cache->impl.memory.nhits = 0;
+  for (i = 0; i < cache->impl.memory.n_shards; i++) {
+    grn_cache_shard_memory *shard = cache->impl.memory.shards + i;
+    shard->next = (grn_cache_entry_memory *)shard;
+    shard->prev = (grn_cache_entry_memory *)shard;
+    grn_ctx_init(&(shard->ctx), 0);
+    shard->hash = grn_hash_create(&(shard->ctx),
+                                  NULL,
+                                  GRN_CACHE_MAX_KEY_SIZE,
+                                  sizeof(grn_cache_entry_memory),
+                                  GRN_OBJ_KEY_VAR_SIZE);
+    if (!shard->hash) {
+      uint32_t j;
+      grn_ctx_fin(&(shard->ctx));
+      for (j = 0; j < i; j++) {
+        grn_cache_close_shard_memory(cache->impl.memory.shards + j);
+      }
+      GRN_FREE(cache->impl.memory.shards);
+      cache->impl.memory.shards = NULL;
+      ERR(GRN_NO_MEMORY_AVAILABLE, "[cache] failed to create hash table");
+      return;
+    }
+    MUTEX_INIT(shard->mutex);
+    shard->nfetches = 0;
+    shard->nhits = 0;
+  }
+  CRITICAL_SECTION_INIT(cache->impl.memory.lock);
 }
 
 static void
@@ -366,13 +905,13 @@ grn_persistent_cache_open(grn_ctx *ctx, const char *base_path)
 static void
 grn_cache_close_memory(grn_ctx *ctx, grn_cache *cache)
 {
-  grn_cache_entry_memory *vp;
+  uint32_t i;
 
-  GRN_HASH_EACH(ctx, cache->impl.memory.hash, id, NULL, NULL, &vp, {
-    grn_obj_close(ctx, vp->value);
-  });
-  grn_hash_close(ctx, cache->impl.memory.hash);
-  MUTEX_FIN(cache->impl.memory.mutex);
+  for (i = 0; i < cache->impl.memory.n_shards; i++) {
+    grn_cache_close_shard_memory(cache->impl.memory.shards + i);
+  }
+  GRN_FREE(cache->impl.memory.shards);
+  CRITICAL_SECTION_FIN(cache->impl.memory.lock);
 }
 
 static void
@@ -420,6 +959,64 @@ grn_cache_init(void)
 {
   grn_ctx *ctx = &grn_cache_ctx;
 
+  {
+    char grn_cache_n_shards_env[GRN_ENV_BUFFER_SIZE];
+    grn_getenv("GRN_CACHE_N_SHARDS",
+               grn_cache_n_shards_env,
+               GRN_ENV_BUFFER_SIZE);
+    if (grn_cache_n_shards_env[0]) {
+      int n_shards = atoi(grn_cache_n_shards_env);
+      if (n_shards < 1) {
+        n_shards = 1;
+      } else if (n_shards > GRN_CACHE_MAX_N_SHARDS) {
+        n_shards = GRN_CACHE_MAX_N_SHARDS;
+      }
+      grn_cache_n_shards = n_shards;
+    }
+  }
+
+  {
+    char grn_cache_max_size_env[GRN_ENV_BUFFER_SIZE];
+    grn_getenv("GRN_CACHE_MAX_SIZE",
+               grn_cache_max_size_env,
+               GRN_ENV_BUFFER_SIZE);
+    if (grn_cache_max_size_env[0]) {
+      grn_cache_default_max_size =
+        grn_atoull(grn_cache_max_size_env,
+                   grn_cache_max_size_env + strlen(grn_cache_max_size_env),
+                   NULL);
+    }
+  }
+
+  {
+    char grn_cache_compression_env[GRN_ENV_BUFFER_SIZE];
+    grn_getenv("GRN_CACHE_COMPRESSION",
+               grn_cache_compression_env,
+               GRN_ENV_BUFFER_SIZE);
+    if (strcmp(grn_cache_compression_env, "zlib") == 0) {
+#ifdef GRN_WITH_ZLIB
+      grn_cache_compression_type = GRN_CACHE_COMPRESSION_ZLIB;
+#else /* GRN_WITH_ZLIB */
+      GRN_LOG(&grn_gctx, GRN_LOG_WARNING,
+              "[cache] zlib isn't supported: GRN_CACHE_COMPRESSION=zlib");
+#endif /* GRN_WITH_ZLIB */
+    } else if (strcmp(grn_cache_compression_env, "lz4") == 0) {
+#ifdef GRN_WITH_LZ4
+      grn_cache_compression_type = GRN_CACHE_COMPRESSION_LZ4;
+#else /* GRN_WITH_LZ4 */
+      GRN_LOG(&grn_gctx, GRN_LOG_WARNING,
+              "[cache] LZ4 isn't supported: GRN_CACHE_COMPRESSION=lz4");
+#endif /* GRN_WITH_LZ4 */
+    } else if (strcmp(grn_cache_compression_env, "zstd") == 0) {
+#ifdef GRN_WITH_ZSTD
+      grn_cache_compression_type = GRN_CACHE_COMPRESSION_ZSTD;
+#else /* GRN_WITH_ZSTD */
+      GRN_LOG(&grn_gctx, GRN_LOG_WARNING,
+              "[cache] Zstandard isn't supported: GRN_CACHE_COMPRESSION=zstd");
+#endif /* GRN_WITH_ZSTD */
+    }
+  }
+
   grn_ctx_init(ctx, 0);
 
   grn_cache_default = grn_cache_open(ctx);
@@ -454,12 +1051,18 @@ grn_cache_default_reopen(void)
 }
 
 static void
-grn_cache_expire_entry_memory(grn_cache *cache, grn_cache_entry_memory *ce)
+grn_cache_expire_entry_memory(grn_cache *cache,
+                              grn_cache_shard_memory *shard,
+                              grn_cache_entry_memory *ce)
 {
   ce->prev->next = ce->next;
   ce->next->prev = ce->prev;
-  grn_obj_close(cache->ctx, ce->value);
-  grn_hash_delete_by_id(cache->ctx, cache->impl.memory.hash, ce->id, NULL);
+  CRITICAL_SECTION_ENTER(cache->impl.memory.lock);
+  cache->impl.memory.nentries--;
+  cache->impl.memory.size -= ce->size;
+  CRITICAL_SECTION_LEAVE(cache->impl.memory.lock);
+  grn_cache_entry_memory_fin(&(shard->ctx), ce);
+  grn_hash_delete_by_id(&(shard->ctx), shard->hash, ce->id, NULL);
 }
 
 static void
@@ -521,12 +1124,121 @@ grn_cache_expire_entry_persistent(grn_cache *cache,
 }
 
 static void
-grn_cache_expire_memory_without_lock(grn_cache *cache, int32_t size)
+grn_cache_expire_shard_memory_without_lock(grn_cache *cache,
+                                           grn_cache_shard_memory *shard)
+{
+  grn_cache_entry_memory *ce0 = (grn_cache_entry_memory *)shard;
+  while (ce0 != ce0->prev) {
+    grn_cache_expire_entry_memory(cache, shard, ce0->prev);
+  }
+}
+
+/*
+  Expires the least recently used entry in all shards. Shards are
+  locked one by one. So it never waits for a shard while it locks
+  another shard. Returns GRN_FALSE when there is no entry. It's used
+  only by grn_cache_expire(). It scans all shards. So updates use
+  grn_cache_expire_over_limit_memory() instead.
+ */
+static grn_bool
+grn_cache_expire_least_recently_used_memory(grn_cache *cache)
+{
+  grn_cache_shard_memory *target_shard = NULL;
+  grn_timeval target_used_time;
+  grn_bool expired = GRN_FALSE;
+  uint32_t i;
+
+  for (i = 0; i < cache->impl.memory.n_shards; i++) {
+    grn_cache_shard_memory *shard = cache->impl.memory.shards + i;
+    grn_cache_entry_memory *ce0 = (grn_cache_entry_memory *)shard;
+    MUTEX_LOCK(shard->mutex);
+    if (ce0 != ce0->prev) {
+      grn_timeval *used_time = &(ce0->prev->used_time);
+      if (!target_shard ||
+          used_time->tv_sec < target_used_time.tv_sec ||
+          (used_time->tv_sec == target_used_time.tv_sec &&
+           used_time->tv_nsec < target_used_time.tv_nsec)) {
+        target_shard = shard;
+        target_used_time = *used_time;
+      }
+    }
+    MUTEX_UNLOCK(shard->mutex);
+  }
+
+  if (target_shard) {
+    grn_cache_entry_memory *ce0 = (grn_cache_entry_memory *)target_shard;
+    MUTEX_LOCK(target_shard->mutex);
+    if (ce0 != ce0->prev) {
+      grn_cache_expire_entry_memory(cache, target_shard, ce0->prev);
+      expired = GRN_TRUE;
+    }
+    MUTEX_UNLOCK(target_shard->mutex);
+  }
+
+  return expired;
+}
+
+static grn_bool
+grn_cache_is_over_limit_memory(grn_cache *cache)
+{
+  grn_bool is_over_limit;
+  CRITICAL_SECTION_ENTER(cache->impl.memory.lock);
+  is_over_limit =
+    (cache->impl.memory.nentries > cache->impl.memory.max_nentries) ||
+    (cache->impl.memory.max_size > 0 &&
+     cache->impl.memory.size > cache->impl.memory.max_size);
+  CRITICAL_SECTION_LEAVE(cache->impl.memory.lock);
+  return is_over_limit;
+}
+
+/*
+  Expires the least recently used entries in the shard while the whole
+  cache is over the limits. keep isn't expired. NULL means that any
+  entry may be expired. The shard must be locked. Returns GRN_TRUE when
+  the whole cache is still over the limits.
+ */
+static grn_bool
+grn_cache_expire_over_limit_shard_memory_without_lock(
+  grn_cache *cache,
+  grn_cache_shard_memory *shard,
+  grn_cache_entry_memory *keep)
+{
+  grn_cache_entry_memory *ce0 = (grn_cache_entry_memory *)shard;
+  while (grn_cache_is_over_limit_memory(cache)) {
+    if (ce0 == ce0->prev || ce0->prev == keep) {
+      return GRN_TRUE;
+    }
+    grn_cache_expire_entry_memory(cache, shard, ce0->prev);
+  }
+  return GRN_FALSE;
+}
+
+/*
+  Expires entries while the whole cache is over the limits. Shards are
+  locked one by one from the start-th shard. So it never waits for a
+  shard while it locks another shard. Each shard expires its least
+  recently used entries first. So the expire algorithm is LRU in each
+  shard, not in the whole cache.
+ */
+static void
+grn_cache_expire_over_limit_memory(grn_cache *cache, uint32_t start)
 {
-  grn_cache_entry_memory *ce0 =
-    (grn_cache_entry_memory *)(&(cache->impl.memory));
-  while (ce0 != ce0->prev && size--) {
-    grn_cache_expire_entry_memory(cache, ce0->prev);
+  uint32_t n_shards = cache->impl.memory.n_shards;
+  uint32_t i;
+
+  for (i = 0; i < n_shards; i++) {
+    grn_cache_shard_memory *shard =
+      cache->impl.memory.shards + ((start + i) % n_shards);
+    grn_bool is_over_limit;
+    MUTEX_LOCK(shard->mutex);
+    is_over_limit =
+      grn_cache_expire_over_limit_shard_memory_without_lock(cache,
+                                                            shard,
+                                                            NULL);
+    MUTEX_UNLOCK(shard->mutex);
+    if (!is_over_limit) {
+      break;
+    }
   }
 }
 
@@ -560,15 +1272,10 @@ grn_cache_set_max_n_entries_memory(grn_ctx *ctx,
                                    grn_cache *cache,
                                    unsigned int n)
 {
-  uint32_t current_max_n_entries;
-
-  MUTEX_LOCK(cache->impl.memory.mutex);
-  current_max_n_entries = cache->impl.memory.max_nentries;
+  CRITICAL_SECTION_ENTER(cache->impl.memory.lock);
   cache->impl.memory.max_nentries = n;
-  if (n < current_max_n_entries) {
-    grn_cache_expire_memory_without_lock(cache, current_max_n_entries - n);
-  }
-  MUTEX_UNLOCK(cache->impl.memory.mutex);
+  CRITICAL_SECTION_LEAVE(cache->impl.memory.lock);
+  grn_cache_expire_over_limit_memory(cache, 0);
 
   return GRN_SUCCESS;
 }
@@ -662,16 +1369,69 @@ grn_cache_get_max_n_entries(grn_ctx *ctx, grn_cache *cache)
   }
 }
 
+static grn_rc
+grn_cache_set_max_size_memory(grn_ctx *ctx,
+                              grn_cache *cache,
+                              uint64_t max_size)
+{
+  CRITICAL_SECTION_ENTER(cache->impl.memory.lock);
+  cache->impl.memory.max_size = max_size;
+  CRITICAL_SECTION_LEAVE(cache->impl.memory.lock);
+  grn_cache_expire_over_limit_memory(cache, 0);
+
+  return GRN_SUCCESS;
+}
+
+grn_rc
+grn_cache_set_max_size(grn_ctx *ctx, grn_cache *cache, uint64_t max_size)
+{
+  if (!cache) {
+    return GRN_INVALID_ARGUMENT;
+  }
+
+  if (cache->is_memory) {
+    return grn_cache_set_max_size_memory(cache->ctx, cache, max_size);
+  } else {
+    /* Persistent cache is limited only by the number of entries. */
+    return GRN_FUNCTION_NOT_IMPLEMENTED;
+  }
+}
+
+uint64_t
+grn_cache_get_max_size(grn_ctx *ctx, grn_cache *cache)
+{
+  if (!cache) {
+    return 0;
+  }
+
+  if (cache->is_memory) {
+    return cache->impl.memory.max_size;
+  } else {
+    return 0;
+  }
+}
+
 static void
 grn_cache_get_statistics_memory(grn_ctx *ctx, grn_cache *cache,
                                 grn_cache_statistics *statistics)
 {
-  MUTEX_LOCK(cache->impl.memory.mutex);
-  statistics->nentries = GRN_HASH_SIZE(cache->impl.memory.hash);
+  uint32_t i;
+
+  CRITICAL_SECTION_ENTER(cache->impl.memory.lock);
   statistics->max_nentries = cache->impl.memory.max_nentries;
-  statistics->nfetches = cache->impl.memory.nfetches;
-  statistics->nhits = cache->impl.memory.nhits;
-  MUTEX_UNLOCK(cache->impl.memory.mutex);
+  statistics->max_size = cache->impl.memory.max_size;
+  statistics->nentries = cache->impl.memory.nentries;
+  statistics->size = cache->impl.memory.size;
+  CRITICAL_SECTION_LEAVE(cache->impl.memory.lock);
+  statistics->nfetches = 0;
+  statistics->nhits = 0;
+  for (i = 0; i < cache->impl.memory.n_shards; i++) {
+    grn_cache_shard_memory *shard = cache->impl.memory.shards + i;
+    MUTEX_LOCK(shard->mutex);
+    statistics->nfetches += shard->nfetches;
+    statistics->nhits += shard->nhits;
+    MUTEX_UNLOCK(shard->mutex);
+  }
 }
 
 static void
@@ -697,6 +1457,8 @@ grn_cache_get_statistics_persistent(grn_ctx *ctx, grn_cache *cache,
   statistics->max_nentries = metadata_entry->metadata.max_nentries;
   statistics->nfetches = metadata_entry->metadata.nfetches;
   statistics->nhits = metadata_entry->metadata.nhits;
+  statistics->size = 0;
+  statistics->max_size = 0;
 
   grn_io_unlock(keys->io);
 }
@@ -719,35 +1481,106 @@ grn_cache_fetch_memory(grn_ctx *ctx, grn_cache *cache,
 {
   /* TODO: How about GRN_NOT_FOUND? */
   grn_rc rc = GRN_INVALID_ARGUMENT;
+  grn_cache_shard_memory *shard;
   grn_cache_entry_memory *ce;
-
-  MUTEX_LOCK(cache->impl.memory.mutex);
-  cache->impl.memory.nfetches++;
-  if (grn_hash_get(cache->ctx, cache->impl.memory.hash, key, key_len,
-                   (void **)&ce)) {
-    if (ce->tv.tv_sec <= grn_db_get_last_modified(ctx, ctx->impl->db)) {
-      grn_cache_expire_entry_memory(cache, ce);
-      goto exit;
-    }
+  grn_cache_compression compression = GRN_CACHE_COMPRESSION_NONE;
+  uint32_t value_size = 0;
+  grn_obj compressed;
+  unsigned int output_size = GRN_BULK_VSIZE(output);
+  int content_encoding = 0;
+  grn_timeval tv;
+  grn_bool depends_on_db = GRN_FALSE;
+  grn_obj dependencies;
+
+  GRN_TEXT_INIT(&compressed, 0);
+  GRN_RECORD_INIT(&dependencies, GRN_OBJ_VECTOR, GRN_ID_NIL);
+  shard = grn_cache_get_shard_memory(cache, key, key_len);
+  MUTEX_LOCK(shard->mutex);
+  shard->nfetches++;
+  if (grn_hash_get(&(shard->ctx), shard->hash, key, key_len, (void **)&ce)) {
     rc = GRN_SUCCESS;
-    GRN_TEXT_PUT(ctx,
-                 output,
-                 GRN_TEXT_VALUE(ce->value),
-                 GRN_TEXT_LEN(ce->value));
+    /* The entry is validated after unlock. See
+       grn_cache_entry_memory_is_valid(). */
+    tv = ce->tv;
+    if (ce->dependencies) {
+      grn_bulk_write(ctx,
+                     &dependencies,
+                     (const char *)(ce->dependencies),
+                     sizeof(grn_id) * ce->n_dependencies);
+    } else {
+      depends_on_db = GRN_TRUE;
+    }
+    if (ce->compression == GRN_CACHE_COMPRESSION_ZLIB) {
+      content_encoding = grn_cache_select_output_content_encoding(ctx, output);
+    }
+    if (ce->compression == GRN_CACHE_COMPRESSION_NONE ||
+        content_encoding != 0) {
+      GRN_TEXT_PUT(ctx,
+                   output,
+                   GRN_TEXT_VALUE(ce->value),
+                   GRN_TEXT_LEN(ce->value));
+      if (content_encoding != 0) {
+        ctx->impl->cache_output.content_encoding = content_encoding;
+        ctx->impl->cache_output.size = ce->value_size;
+        ctx->impl->cache_output.crc32 = ce->crc32;
+        ctx->impl->cache_output.adler32 = ce->adler32;
+      }
+    } else {
+      /* Decompresses after unlock to not block other threads. */
+      compression = ce->compression;
+      value_size = ce->value_size;
+      GRN_TEXT_SET(ctx,
+                   &compressed,
+                   GRN_TEXT_VALUE(ce->value),
+                   GRN_TEXT_LEN(ce->value));
+    }
     ce->prev->next = ce->next;
     ce->next->prev = ce->prev;
     {
-      grn_cache_entry_memory *ce0 =
-        (grn_cache_entry_memory *)(&(cache->impl.memory));
+      grn_cache_entry_memory *ce0 = (grn_cache_entry_memory *)shard;
       ce->next = ce0->next;
       ce->prev = ce0;
       ce0->next->prev = ce;
       ce0->next = ce;
     }
-    cache->impl.memory.nhits++;
+    grn_timeval_now(ctx, &(ce->used_time));
+    shard->nhits++;
   }
-exit :
-  MUTEX_UNLOCK(cache->impl.memory.mutex);
+  MUTEX_UNLOCK(shard->mutex);
+
+  if (rc == GRN_SUCCESS &&
+      !grn_cache_entry_memory_is_valid(ctx,
+                                       &tv,
+                                       depends_on_db ? NULL : &dependencies)) {
+    rc = GRN_INVALID_ARGUMENT;
+    compression = GRN_CACHE_COMPRESSION_NONE;
+    grn_bulk_truncate(ctx, output, output_size);
+    if (content_encoding != 0) {
+      ctx->impl->cache_output.content_encoding = 0;
+    }
+    MUTEX_LOCK(shard->mutex);
+    shard->nhits--;
+    /* The entry may be updated by another thread while it's unlocked. */
+    if (grn_hash_get(&(shard->ctx), shard->hash, key, key_len,
+                     (void **)&ce) &&
+        ce->tv.tv_sec == tv.tv_sec &&
+        ce->tv.tv_nsec == tv.tv_nsec) {
+      grn_cache_expire_entry_memory(cache, shard, ce);
+    }
+    MUTEX_UNLOCK(shard->mutex);
+  }
+  GRN_OBJ_FIN(ctx, &dependencies);
+
+  if (compression != GRN_CACHE_COMPRESSION_NONE) {
+    if (!grn_cache_value_decompress(ctx,
+                                    compression,
+                                    &compressed,
+                                    value_size,
+                                    output)) {
+      rc = GRN_INVALID_ARGUMENT;
+    }
+  }
+  GRN_OBJ_FIN(ctx, &compressed);
   return rc;
 }
 
@@ -844,51 +1677,136 @@ grn_cache_update_memory(grn_ctx *ctx, grn_cache *cache,
 {
   grn_id id;
   int added = 0;
+  grn_cache_shard_memory *shard;
+  grn_ctx *shard_ctx;
   grn_cache_entry_memory *ce;
-  grn_rc rc = GRN_SUCCESS;
   grn_obj *old = NULL;
+  grn_id *old_dependencies = NULL;
   grn_obj *obj = NULL;
+  grn_id *dependencies = NULL;
+  uint32_t n_dependencies = 0;
+  grn_obj compressed;
+  grn_obj *stored_value;
+  grn_cache_compression compression;
+  uint32_t crc32_value;
+  uint32_t adler32_value;
+  uint64_t size;
+  uint64_t max_size;
+  grn_bool is_over_limit = GRN_FALSE;
 
   if (cache->impl.memory.max_nentries == 0) {
     return;
   }
 
-  MUTEX_LOCK(cache->impl.memory.mutex);
-  obj = grn_obj_open(cache->ctx, GRN_BULK, 0, GRN_DB_TEXT);
+  shard = grn_cache_get_shard_memory(cache, key, key_len);
+  shard_ctx = &(shard->ctx);
+
+  if (ctx->impl->cache_dependencies) {
+    grn_db_expand_cache_dependencies(ctx, ctx->impl->cache_dependencies);
+    n_dependencies =
+      GRN_BULK_VSIZE(ctx->impl->cache_dependencies) / sizeof(grn_id);
+  }
+
+  /* Compresses before lock to not block other threads. */
+  GRN_TEXT_INIT(&compressed, 0);
+  compression = grn_cache_value_compress(ctx,
+                                         value,
+                                         &compressed,
+                                         &crc32_value,
+                                         &adler32_value);
+  if (compression == GRN_CACHE_COMPRESSION_NONE) {
+    stored_value = value;
+  } else {
+    stored_value = &compressed;
+  }
+  size =
+    sizeof(grn_cache_entry_memory) +
+    key_len +
+    GRN_TEXT_LEN(stored_value) +
+    sizeof(grn_id) * n_dependencies;
+
+  CRITICAL_SECTION_ENTER(cache->impl.memory.lock);
+  max_size = cache->impl.memory.max_size;
+  CRITICAL_SECTION_LEAVE(cache->impl.memory.lock);
+
+  MUTEX_LOCK(shard->mutex);
+  if (max_size > 0 && size > max_size) {
+    /* Too large to cache. The previous value is also outdated. */
+    if (grn_hash_get(shard_ctx, shard->hash, key, key_len, (void **)&ce)) {
+      grn_cache_expire_entry_memory(cache, shard, ce);
+    }
+    goto exit;
+  }
+  obj = grn_obj_open(shard_ctx, GRN_BULK, 0, GRN_DB_TEXT);
   if (!obj) {
     goto exit;
   }
-  GRN_TEXT_PUT(cache->ctx, obj, GRN_TEXT_VALUE(value), GRN_TEXT_LEN(value));
-  id = grn_hash_add(cache->ctx, cache->impl.memory.hash, key, key_len,
+  grn_bulk_resize(shard_ctx, obj, GRN_TEXT_LEN(stored_value));
+  GRN_TEXT_PUT(shard_ctx,
+               obj,
+               GRN_TEXT_VALUE(stored_value),
+               GRN_TEXT_LEN(stored_value));
+  if (ctx->impl->cache_dependencies) {
+    dependencies = grn_cache_dependencies_dup(shard_ctx,
+                                              ctx->impl->cache_dependencies,
+                                              &n_dependencies);
+  }
+  id = grn_hash_add(shard_ctx, shard->hash, key, key_len,
                     (void **)&ce, &added);
   if (id) {
+    CRITICAL_SECTION_ENTER(cache->impl.memory.lock);
+    if (added) {
+      cache->impl.memory.nentries++;
+    } else {
+      cache->impl.memory.size -= ce->size;
+    }
+    cache->impl.memory.size += size;
+    CRITICAL_SECTION_LEAVE(cache->impl.memory.lock);
     if (!added) {
       old = ce->value;
+      old_dependencies = ce->dependencies;
       ce->prev->next = ce->next;
       ce->next->prev = ce->prev;
     }
     ce->id = id;
     ce->value = obj;
+    obj = NULL;
     ce->tv = ctx->impl->tv;
+    grn_timeval_now(ctx, &(ce->used_time));
+    ce->dependencies = dependencies;
+    ce->n_dependencies = n_dependencies;
+    dependencies = NULL;
+    ce->compression = compression;
+    ce->value_size = GRN_TEXT_LEN(value);
+    ce->crc32 = crc32_value;
+    ce->adler32 = adler32_value;
+    ce->size = size;
     {
-      grn_cache_entry_memory *ce0 =
-        (grn_cache_entry_memory *)(&(cache->impl.memory));
+      grn_cache_entry_memory *ce0 = (grn_cache_entry_memory *)shard;
       ce->next = ce0->next;
       ce->prev = ce0;
       ce0->next->prev = ce;
       ce0->next = ce;
     }
-    if (GRN_HASH_SIZE(cache->impl.memory.hash) >
-        cache->impl.memory.max_nentries) {
-      grn_cache_expire_entry_memory(cache, cache->impl.memory.prev);
-    }
-  } else {
-    rc = GRN_NO_MEMORY_AVAILABLE;
+    /* This shard is already locked. So its entries are expired
+       first. The new entry isn't expired here. */
+    is_over_limit =
+      grn_cache_expire_over_limit_shard_memory_without_lock(cache,
+                                                            shard,
+                                                            ce);
   }
 exit :
-  if (rc) { grn_obj_close(cache->ctx, obj); }
-  if (old) { grn_obj_close(cache->ctx, old); }
-  MUTEX_UNLOCK(cache->impl.memory.mutex);
+  if (obj) { grn_obj_close(shard_ctx, obj); }
+  if (old) { grn_obj_close(shard_ctx, old); }
+  grn_cache_dependencies_free(shard_ctx, old_dependencies);
+  grn_cache_dependencies_free(shard_ctx, dependencies);
+  MUTEX_UNLOCK(shard->mutex);
+  GRN_OBJ_FIN(ctx, &compressed);
+
+  if (is_over_limit) {
+    uint32_t shard_index = (uint32_t)(shard - cache->impl.memory.shards);
+    grn_cache_expire_over_limit_memory(cache, shard_index + 1);
+  }
 }
 
 static void
@@ -986,12 +1904,174 @@ grn_cache_update(grn_ctx *ctx, grn_cache *cache,
   }
 }
 
+void
+grn_cache_set_accept_content_encodings(grn_ctx *ctx, int content_encodings)
+{
+  ctx->impl->cache_output.accept_content_encodings = content_encodings;
+  ctx->impl->cache_output.content_encoding = 0;
+}
+
+const char *
+grn_cache_get_output_content_encoding(grn_ctx *ctx)
+{
+  switch (ctx->impl->cache_output.content_encoding) {
+  case GRN_CACHE_CONTENT_ENCODING_GZIP :
+    return "gzip";
+  case GRN_CACHE_CONTENT_ENCODING_DEFLATE :
+    return "deflate";
+  default :
+    return NULL;
+  }
+}
+
+#ifdef GRN_WITH_ZLIB
+static void
+grn_cache_put_stored_blocks(grn_ctx *ctx,
+                            grn_obj *output,
+                            const char *data,
+                            size_t data_size,
+                            grn_bool is_final)
+{
+  if (data_size == 0 && !is_final) {
+    return;
+  }
+  do {
+    uint16_t block_size = data_size > 0xffff ? 0xffff : data_size;
+    uint16_t block_size_complement = ~block_size;
+    grn_bool is_final_block = is_final && block_size == data_size;
+    /* BFINAL and BTYPE=00 (stored). The rest of the byte is padding. */
+    GRN_TEXT_PUTC(ctx, output, is_final_block ? 0x01 : 0x00);
+    GRN_TEXT_PUTC(ctx, output, block_size & 0xff);
+    GRN_TEXT_PUTC(ctx, output, block_size >> 8);
+    GRN_TEXT_PUTC(ctx, output, block_size_complement & 0xff);
+    GRN_TEXT_PUTC(ctx, output, block_size_complement >> 8);
+    GRN_TEXT_PUT(ctx, output, data, block_size);
+    data += block_size;
+    data_size -= block_size;
+  } while (data_size > 0);
+}
+#endif /* GRN_WITH_ZLIB */
+
+/*
+  Builds a gzip or zlib stream of head, the compressed cached value in
+  body and foot. head and foot are put as stored blocks. So the cached
+  value isn't decompressed nor compressed again. Checksums are combined
+  from ones computed when the value was cached.
+ */
+grn_rc
+grn_cache_encode_output(grn_ctx *ctx,
+                        grn_obj *head,
+                        grn_obj *body,
+                        grn_obj *foot,
+                        grn_obj *output)
+{
+#ifdef GRN_WITH_ZLIB
+  int content_encoding = ctx->impl->cache_output.content_encoding;
+  uint32_t head_size = GRN_TEXT_LEN(head);
+  uint32_t foot_size = GRN_TEXT_LEN(foot);
+  uint32_t size;
+
+  ctx->impl->cache_output.content_encoding = 0;
+  size = head_size + ctx->impl->cache_output.size + foot_size;
+
+  switch (content_encoding) {
+  case GRN_CACHE_CONTENT_ENCODING_GZIP :
+    {
+      const char header[] = {
+        0x1f, (char)0x8b, /* ID1, ID2 */
+        0x08, /* CM: deflate */
+        0x00, /* FLG */
+        0x00, 0x00, 0x00, 0x00, /* MTIME */
+        0x00, /* XFL */
+        (char)0xff /* OS: unknown */
+      };
+      uLong crc;
+      GRN_TEXT_PUT(ctx, output, header, sizeof(header));
+      grn_cache_put_stored_blocks(ctx, output,
+                                  GRN_TEXT_VALUE(head), head_size,
+                                  GRN_FALSE);
+      GRN_TEXT_PUT(ctx, output, GRN_TEXT_VALUE(body), GRN_TEXT_LEN(body));
+      grn_cache_put_stored_blocks(ctx, output,
+                                  GRN_TEXT_VALUE(foot), foot_size,
+                                  GRN_TRUE);
+      crc = crc32(crc32(0L, Z_NULL, 0),
+                  (const Bytef *)GRN_TEXT_VALUE(head), head_size);
+      crc = crc32_combine(crc,
+                          ctx->impl->cache_output.crc32,
+                          ctx->impl->cache_output.size);
+      crc = crc32_combine(crc,
+                          crc32(crc32(0L, Z_NULL, 0),
+                                (const Bytef *)GRN_TEXT_VALUE(foot),
+                                foot_size),
+                          foot_size);
+      GRN_TEXT_PUTC(ctx, output, crc & 0xff);
+      GRN_TEXT_PUTC(ctx, output, (crc >> 8) & 0xff);
+      GRN_TEXT_PUTC(ctx, output, (crc >> 16) & 0xff);
+      GRN_TEXT_PUTC(ctx, output, (crc >> 24) & 0xff);
+      GRN_TEXT_PUTC(ctx, output, size & 0xff);
+      GRN_TEXT_PUTC(ctx, output, (size >> 8) & 0xff);
+      GRN_TEXT_PUTC(ctx, output, (size >> 16) & 0xff);
+      GRN_TEXT_PUTC(ctx, output, (size >> 24) & 0xff);
+    }
+    break;
+  case GRN_CACHE_CONTENT_ENCODING_DEFLATE :
+    {
+      /* CMF: deflate with 32K window, FLG: fastest level without
+         dictionary. */
+      const char header[] = {0x78, 0x01};
+      uLong adler;
+      GRN_TEXT_PUT(ctx, output, header, sizeof(header));
+      grn_cache_put_stored_blocks(ctx, output,
+                                  GRN_TEXT_VALUE(head), head_size,
+                                  GRN_FALSE);
+      GRN_TEXT_PUT(ctx, output, GRN_TEXT_VALUE(body), GRN_TEXT_LEN(body));
+      grn_cache_put_stored_blocks(ctx, output,
+                                  GRN_TEXT_VALUE(foot), foot_size,
+                                  GRN_TRUE);
+      adler = adler32(adler32(0L, Z_NULL, 0),
+                      (const Bytef *)GRN_TEXT_VALUE(head), head_size);
+      adler = adler32_combine(adler,
+                              ctx->impl->cache_output.adler32,
+                              ctx->impl->cache_output.size);
+      adler = adler32_combine(adler,
+                              adler32(adler32(0L, Z_NULL, 0),
+                                      (const Bytef *)GRN_TEXT_VALUE(foot),
+                                      foot_size),
+                              foot_size);
+      GRN_TEXT_PUTC(ctx, output, (adler >> 24) & 0xff);
+      GRN_TEXT_PUTC(ctx, output, (adler >> 16) & 0xff);
+      GRN_TEXT_PUTC(ctx, output, (adler >> 8) & 0xff);
+      GRN_TEXT_PUTC(ctx, output, adler & 0xff);
+    }
+    break;
+  default :
+    return GRN_INVALID_ARGUMENT;
+  }
+  return GRN_SUCCESS;
+#else /* GRN_WITH_ZLIB */
+  ctx->impl->cache_output.content_encoding = 0;
+  return GRN_FUNCTION_NOT_IMPLEMENTED;
+#endif /* GRN_WITH_ZLIB */
+}
+
 static void
 grn_cache_expire_memory(grn_cache *cache, int32_t size)
 {
-  MUTEX_LOCK(cache->impl.memory.mutex);
-  grn_cache_expire_memory_without_lock(cache, size);
-  MUTEX_UNLOCK(cache->impl.memory.mutex);
+  if (size < 0) {
+    uint32_t i;
+    for (i = 0; i < cache->impl.memory.n_shards; i++) {
+      grn_cache_shard_memory *shard = cache->impl.memory.shards + i;
+      MUTEX_LOCK(shard->mutex);
+      grn_cache_expire_shard_memory_without_lock(cache, shard);
+      MUTEX_UNLOCK(shard->mutex);
+    }
+  } else {
+    while (size-- > 0) {
+      if (!grn_cache_expire_least_recently_used_memory(cache)) {
+        break;
+      }
+    }
+  }
 }
 
 static void
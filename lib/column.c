@@ -19,6 +19,7 @@
 
 #include "grn.h"
 #include "grn_column.h"
+#include "grn_db.h"
 #include "grn_ii.h"
 
 grn_column_flags
@@ -118,6 +119,118 @@ grn_column_cache_ref(grn_ctx *ctx,
   GRN_API_RETURN(value);
 }
 
+grn_rc
+grn_column_get_values_batch(grn_ctx *ctx,
+                            grn_obj *column,
+                            const grn_id *ids,
+                            size_t n_ids,
+                            grn_obj *values)
+{
+  grn_id range;
+
+  GRN_API_ENTER;
+
+  if (!column) {
+    ERR(GRN_INVALID_ARGUMENT,
+        "[column][get-values-batch] column must not be NULL");
+    GRN_API_RETURN(ctx->rc);
+  }
+
+  range = DB_OBJ(column)->range;
+  switch (column->header.type) {
+  case GRN_COLUMN_FIX_SIZE :
+    {
+      grn_ra *ra = (grn_ra *)column;
+      size_t values_size = ra->header->element_size * n_ids;
+      grn_obj_reinit(ctx, values, range, GRN_OBJ_VECTOR);
+      if (ctx->rc != GRN_SUCCESS) {
+        break;
+      }
+      if (grn_bulk_space(ctx, values, values_size) != GRN_SUCCESS) {
+        break;
+      }
+      grn_ra_get_values(ctx, ra, ids, n_ids,
+                        GRN_BULK_CURR(values) - values_size);
+    }
+    break;
+  case GRN_COLUMN_VAR_SIZE :
+    if ((column->header.flags & GRN_OBJ_COLUMN_TYPE_MASK) ==
+        GRN_OBJ_COLUMN_SCALAR) {
+      grn_ja *ja = (grn_ja *)column;
+      grn_ja_reader reader;
+      grn_obj *body;
+      grn_rc rc;
+      size_t i;
+
+      grn_obj_reinit(ctx, values, range, GRN_OBJ_VECTOR);
+      if (ctx->rc != GRN_SUCCESS) {
+        break;
+      }
+      body = grn_vector_body(ctx, values);
+      if (!body) {
+        break;
+      }
+      /* Values in a ring buffer need to be rearranged. */
+      if (grn_ja_get_flags(ctx, ja) & GRN_OBJ_RING_BUFFER) {
+        for (i = 0; i < n_ids; i++) {
+          grn_ja_get_value(ctx, ja, ids[i], body);
+          grn_vector_delimit(ctx, values, 0, range);
+        }
+        break;
+      }
+      rc = grn_ja_reader_init(ctx, &reader, ja);
+      if (rc != GRN_SUCCESS) {
+        ERR(rc,
+            "[column][get-values-batch] failed to initialize a reader");
+        break;
+      }
+      for (i = 0; i < n_ids; i++) {
+        grn_id id = ids[i];
+        /* Nonexistent values can't be sought. They are empty. */
+        if (id != GRN_ID_NIL && id <= GRN_ID_MAX &&
+            grn_ja_reader_seek(ctx, &reader, id) == GRN_SUCCESS &&
+            reader.value_size > 0) {
+          rc = grn_bulk_reserve(ctx, body, reader.value_size);
+          if (rc == GRN_SUCCESS) {
+            rc = grn_ja_reader_read(ctx, &reader, GRN_BULK_CURR(body));
+          }
+          if (rc != GRN_SUCCESS) {
+            char name[GRN_TABLE_MAX_KEY_SIZE];
+            int name_size;
+            name_size = grn_obj_name(ctx, column, name, sizeof(name));
+            ERR(rc,
+                "[column][get-values-batch] failed to read a value: "
+                "<%.*s>: <%u>",
+                name_size, name,
+                id);
+            break;
+          }
+          GRN_BULK_INCR_LEN(body, reader.value_size);
+        }
+        grn_vector_delimit(ctx, values, 0, range);
+      }
+      grn_ja_reader_fin(ctx, &reader);
+      break;
+    }
+    /* fallthru */
+  default :
+    {
+      char name[GRN_TABLE_MAX_KEY_SIZE];
+      int name_size;
+
+      name_size = grn_obj_name(ctx, column, name, sizeof(name));
+      ERR(GRN_OPERATION_NOT_SUPPORTED,
+          "[column][get-values-batch] "
+          "must be a fixed size column or a variable size scalar column: "
+          "<%.*s>",
+          name_size, name);
+    }
+    break;
+  }
+
+  GRN_API_RETURN(ctx->rc);
+}
+
 static void
 grn_column_copy_same_table(grn_ctx *ctx,
                            grn_obj *table,
@@ -477,6 +477,56 @@ grn_com_event_del(grn_ctx *ctx, grn_com_event *ev, grn_sock fd)
   }
 }
 
+/*
+ * Changes events to be polled for com without looking up ev->hash. A
+ * thread that doesn't run the event loop can use this to stop polling
+ * com while it processes a request from com and to restart polling
+ * after it finishes. 0 events removes com from the underlying poller
+ * so that hang-ups aren't reported while it isn't polled.
+ */
+grn_rc
+grn_com_event_set_events(grn_ctx *ctx, grn_com *com, int events)
+{
+  int current_events = com->events;
+
+  if (current_events == events) {
+    return GRN_SUCCESS;
+  }
+  com->events = events;
+#ifdef USE_EPOLL
+  {
+    struct epoll_event e;
+    int op;
+    if (current_events == 0) {
+      op = EPOLL_CTL_ADD;
+    } else if (events == 0) {
+      op = EPOLL_CTL_DEL;
+    } else {
+      op = EPOLL_CTL_MOD;
+    }
+    memset(&e, 0, sizeof(struct epoll_event));
+    e.data.fd = com->fd;
+    e.events = (uint32_t) events;
+    if (epoll_ctl(com->ev->epfd, op, com->fd, &e) == -1) {
+      SERR("epoll_ctl");
+      return ctx->rc;
+    }
+  }
+#endif /* USE_EPOLL*/
+#ifdef USE_KQUEUE
+  {
+    struct kevent e;
+    EV_SET(&e, com->fd, GRN_COM_POLLIN, events ? EV_ENABLE : EV_DISABLE,
+           0, 0, NULL);
+    if (kevent(com->ev->kqfd, &e, 1, NULL, 0, NULL) == -1) {
+      SERR("kevent");
+      return ctx->rc;
+    }
+  }
+#endif /* USE_KQUEUE */
+  return GRN_SUCCESS;
+}
+
 grn_rc
 grn_com_event_start_accept(grn_ctx *ctx, grn_com_event *ev)
 {
@@ -536,6 +586,12 @@ grn_com_receiver(grn_ctx *ctx, grn_com *com)
     ncs->has_sid = 0;
     ncs->closed = 0;
     ncs->opaque = NULL;
+    ncs->n_requests = 0;
+    {
+      grn_timeval tv;
+      grn_timeval_now(ctx, &tv);
+      ncs->last_active_time_msec = GRN_TIMEVAL_TO_MSEC(&tv);
+    }
     GRN_COM_QUEUE_INIT(&ncs->new_);
     // GRN_LOG(ctx, GRN_LOG_NOTICE, "accepted (%d)", fd);
     return;
@@ -634,8 +690,7 @@ grn_com_event_poll(grn_ctx *ctx, grn_com_event *ev, int timeout)
   ctx->rc = GRN_SUCCESS;
   GRN_HASH_EACH(ctx, ev->hash, eh, &pfd, &dummy, &com, {
     ep->fd = *pfd;
-    //    ep->events =(short) com->events;
-    ep->events = POLLIN;
+    ep->events = (com->events & GRN_COM_POLLIN) ? POLLIN : 0;
     ep->revents = 0;
     ep++;
     nfd++;
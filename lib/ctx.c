@@ -25,6 +25,7 @@
 #include "grn_encoding.h"
 #include "grn_ii.h"
 #include "grn_pat.h"
+#include "grn_store.h"
 #include "grn_index_column.h"
 #include "grn_proc.h"
 #include "grn_plugin.h"
@@ -37,6 +38,7 @@
 #include "grn_logger.h"
 #include "grn_cache.h"
 #include "grn_expr.h"
+#include "grn_expr_cache.h"
 #include <stdio.h>
 #include <stdarg.h>
 #include <time.h>
@@ -105,9 +107,11 @@ grn_init_from_env(void)
   grn_mrb_init_from_env();
   grn_ctx_impl_mrb_init_from_env();
   grn_io_init_from_env();
+  grn_store_init_from_env();
   grn_ii_init_from_env();
   grn_db_init_from_env();
   grn_expr_init_from_env();
+  grn_expr_cache_init_from_env();
   grn_index_column_init_from_env();
   grn_proc_init_from_env();
   grn_plugin_init_from_env();
@@ -193,6 +197,10 @@ grn_ctx_loader_clear(grn_ctx *ctx)
   grn_obj *ve = (grn_obj *)(GRN_BULK_CURR(&loader->values));
   grn_obj **p = (grn_obj **)GRN_BULK_HEAD(&loader->columns);
   uint32_t i = GRN_BULK_VSIZE(&loader->columns) / sizeof(grn_obj *);
+  if (ctx->impl->ii_batch) {
+    grn_ii_batch_close(ctx, ctx->impl->ii_batch);
+    ctx->impl->ii_batch = NULL;
+  }
   if (ctx->impl->db) { while (i--) { grn_obj_unlink(ctx, *p++); } }
   if (loader->ifexists) { grn_obj_unlink(ctx, loader->ifexists); }
   if (loader->each) { grn_obj_unlink(ctx, loader->each); }
@@ -294,6 +302,18 @@ grn_ctx_impl_init(grn_ctx *ctx)
   }
   ctx->impl->force_match_escalation = GRN_FALSE;
 
+  ctx->impl->table_select_n_workers = 0;
+
+  ctx->impl->ii_builder_n_workers = 0;
+  ctx->impl->ii_batch = NULL;
+
+  ctx->impl->cache_dependencies = NULL;
+  ctx->impl->cache_output.accept_content_encodings = 0;
+  ctx->impl->cache_output.content_encoding = 0;
+  ctx->impl->cache_output.size = 0;
+  ctx->impl->cache_output.crc32 = 0;
+  ctx->impl->cache_output.adler32 = 0;
+
   ctx->impl->finalizer = NULL;
 
   ctx->impl->com = NULL;
@@ -705,6 +725,8 @@ grn_init(void)
             "failed to initialize request timer (%d)", rc);
     goto fail_request_timer;
   }
+  grn_ii_bitmap_cache_init();
+  grn_ii_posting_cache_init();
   GRN_LOG(ctx, GRN_LOG_NOTICE, "grn_init: <%s>", grn_get_version());
   check_overcommit_memory(ctx);
   return rc;
@@ -804,6 +826,8 @@ grn_fin(void)
 {
   grn_ctx *ctx, *ctx_;
   if (grn_gctx.stat == GRN_CTX_FIN) { return GRN_INVALID_ARGUMENT; }
+  grn_ii_posting_cache_fin();
+  grn_ii_bitmap_cache_fin();
   for (ctx = grn_gctx.next; ctx != &grn_gctx; ctx = ctx_) {
     ctx_ = ctx->next;
     if (ctx->stat != GRN_CTX_FIN) { grn_ctx_fin(ctx); }
@@ -105,6 +105,11 @@ grn_obj_get_range_info(grn_ctx *ctx, grn_obj *obj,
                        grn_id *range_id, grn_obj_flags *range_flags);
 
 static char grn_db_key[GRN_ENV_BUFFER_SIZE];
+static grn_bool grn_table_sort_normalize_enable = GRN_TRUE;
+static uint32_t grn_table_sort_text_prefix_size = 16;
+static uint32_t grn_table_group_min_n_records_per_worker = 10000;
+
+#define GRN_TABLE_SORT_TEXT_PREFIX_SIZE_MAX 254
 
 void
 grn_db_init_from_env(void)
@@ -112,6 +117,45 @@ grn_db_init_from_env(void)
   grn_getenv("GRN_DB_KEY",
              grn_db_key,
              GRN_ENV_BUFFER_SIZE);
+
+  {
+    char grn_table_sort_normalize_enable_env[GRN_ENV_BUFFER_SIZE];
+    grn_getenv("GRN_TABLE_SORT_NORMALIZE_ENABLE",
+               grn_table_sort_normalize_enable_env,
+               GRN_ENV_BUFFER_SIZE);
+    if (strcmp(grn_table_sort_normalize_enable_env, "no") == 0) {
+      grn_table_sort_normalize_enable = GRN_FALSE;
+    } else {
+      grn_table_sort_normalize_enable = GRN_TRUE;
+    }
+  }
+
+  {
+    char grn_table_sort_text_prefix_size_env[GRN_ENV_BUFFER_SIZE];
+    grn_getenv("GRN_TABLE_SORT_TEXT_PREFIX_SIZE",
+               grn_table_sort_text_prefix_size_env,
+               GRN_ENV_BUFFER_SIZE);
+    if (grn_table_sort_text_prefix_size_env[0]) {
+      int size = atoi(grn_table_sort_text_prefix_size_env);
+      if (size < 1) {
+        size = 1;
+      } else if (size > GRN_TABLE_SORT_TEXT_PREFIX_SIZE_MAX) {
+        size = GRN_TABLE_SORT_TEXT_PREFIX_SIZE_MAX;
+      }
+      grn_table_sort_text_prefix_size = size;
+    }
+  }
+
+  {
+    char grn_table_group_min_n_records_per_worker_env[GRN_ENV_BUFFER_SIZE];
+    grn_getenv("GRN_TABLE_GROUP_MIN_N_RECORDS_PER_WORKER",
+               grn_table_group_min_n_records_per_worker_env,
+               GRN_ENV_BUFFER_SIZE);
+    if (grn_table_group_min_n_records_per_worker_env[0]) {
+      grn_table_group_min_n_records_per_worker =
+        atoi(grn_table_group_min_n_records_per_worker_env);
+    }
+  }
 }
 
 grn_inline static void
@@ -192,6 +236,22 @@ grn_db_config_open(grn_ctx *ctx, grn_db *s, const char *path)
   }
 }
 
+static void
+grn_db_init_schema_generation(grn_ctx *ctx, grn_db *s)
+{
+  switch (s->keys->header.type) {
+  case GRN_TABLE_PAT_KEY :
+    s->schema_generation = &(((grn_pat *)(s->keys))->header->schema_generation);
+    break;
+  case GRN_TABLE_DAT_KEY :
+    s->schema_generation = &(((grn_dat *)(s->keys))->header->schema_generation);
+    break;
+  default :
+    s->schema_generation = NULL;
+    break;
+  }
+}
+
 static grn_rc
 grn_db_config_remove(grn_ctx *ctx, const char *path)
 {
@@ -229,6 +289,8 @@ grn_db_create(grn_ctx *ctx, const char *path, grn_db_create_optarg *optarg)
   s->config = NULL;
   s->cache = NULL;
   s->options = NULL;
+  s->schema_generation = NULL;
+  s->expr_cache = NULL;
 
   {
     grn_bool use_default_db_key = GRN_TRUE;
@@ -257,6 +319,7 @@ grn_db_create(grn_ctx *ctx, const char *path, grn_db_create_optarg *optarg)
   if (!s->keys) {
     goto exit;
   }
+  grn_db_init_schema_generation(ctx, s);
 
   GRN_DB_OBJ_SET_TYPE(s, GRN_DB);
   s->obj.db = (grn_obj *)s;
@@ -358,6 +421,8 @@ grn_db_open(grn_ctx *ctx, const char *path)
   s->config = NULL;
   s->cache = NULL;
   s->options = NULL;
+  s->schema_generation = NULL;
+  s->expr_cache = NULL;
 
   {
     uint32_t type = grn_io_detect_type(ctx, path);
@@ -382,6 +447,7 @@ grn_db_open(grn_ctx *ctx, const char *path)
   if (!s->keys) {
     goto exit;
   }
+  grn_db_init_schema_generation(ctx, s);
 
   {
     char specs_path[PATH_MAX];
@@ -479,6 +545,11 @@ grn_db_close(grn_ctx *ctx, grn_obj *db)
   if (!s) { return GRN_INVALID_ARGUMENT; }
   GRN_API_ENTER;
 
+  if (s->expr_cache) {
+    grn_expr_cache_close(ctx, s->expr_cache);
+    s->expr_cache = NULL;
+  }
+
   ctx_used_db = ctx->impl && ctx->impl->db == db;
   if (ctx_used_db) {
     grn_ctx_loader_clear(ctx);
@@ -550,6 +621,42 @@ grn_db_close(grn_ctx *ctx, grn_obj *db)
   GRN_API_RETURN(GRN_SUCCESS);
 }
 
+grn_expr_cache *
+grn_db_get_expr_cache(grn_ctx *ctx, grn_obj *db)
+{
+  grn_db *s = (grn_db *)db;
+  if (!s->expr_cache) {
+    CRITICAL_SECTION_ENTER(s->lock);
+    if (!s->expr_cache) {
+      s->expr_cache = grn_expr_cache_open(ctx);
+    }
+    CRITICAL_SECTION_LEAVE(s->lock);
+  }
+  return s->expr_cache;
+}
+
+uint32_t
+grn_db_get_schema_generation(grn_ctx *ctx, grn_obj *db)
+{
+  grn_db *s = (grn_db *)db;
+  if (!s || !s->schema_generation) {
+    return 0;
+  }
+  return *(s->schema_generation);
+}
+
+static grn_inline void
+grn_db_increment_schema_generation(grn_obj *db)
+{
+  grn_db *s = (grn_db *)db;
+  uint32_t previous_generation;
+  if (!s->schema_generation) {
+    return;
+  }
+  GRN_ATOMIC_ADD_EX(s->schema_generation, 1, previous_generation);
+  (void)previous_generation;
+}
+
 grn_rc
 grn_db_set_cache(grn_ctx *ctx, grn_obj *db, grn_cache *cache)
 {
@@ -749,6 +856,22 @@ grn_db_get_last_modified(grn_ctx *ctx, grn_obj *db)
   return grn_obj_get_last_modified(ctx, db);
 }
 
+/*
+  Returns the last time when the database itself is touched. Touching a
+  table or a column updates the last modified time of the database but
+  doesn't update this. The last modified time in the header of the specs
+  is used to store this because it's shared with other processes.
+ */
+uint32_t
+grn_db_get_last_touched(grn_ctx *ctx, grn_obj *db)
+{
+  if (!db) {
+    return 0;
+  }
+
+  return ((grn_db *)db)->specs->io->header->last_modified;
+}
+
 grn_bool
 grn_db_is_dirty(grn_ctx *ctx, grn_obj *db)
 {
@@ -879,6 +1002,24 @@ grn_obj_is_corrupt(grn_ctx *ctx, grn_obj *obj)
 
 #define IS_TEMP(obj) (DB_OBJ(obj)->id & GRN_OBJ_TMP_OBJECT)
 
+static void
+grn_table_ids_add(grn_ctx *ctx, grn_obj *table_ids, grn_id id)
+{
+  size_t i;
+  size_t n_ids;
+
+  if (id == GRN_ID_NIL || (id & GRN_OBJ_TMP_OBJECT) || grn_id_is_builtin(ctx, id)) {
+    return;
+  }
+  n_ids = GRN_BULK_VSIZE(table_ids) / sizeof(grn_id);
+  for (i = 0; i < n_ids; i++) {
+    if (GRN_RECORD_VALUE_AT(table_ids, i) == id) {
+      return;
+    }
+  }
+  GRN_RECORD_PUT(ctx, table_ids, id);
+}
+
 static grn_inline void
 grn_obj_touch_db(grn_ctx *ctx, grn_obj *obj, grn_timeval *tv)
 {
@@ -898,23 +1039,139 @@ grn_obj_touch(grn_ctx *ctx, grn_obj *obj, grn_timeval *tv)
     switch (obj->header.type) {
     case GRN_DB :
       grn_obj_touch_db(ctx, obj, tv);
+      ((grn_db *)obj)->specs->io->header->last_modified = tv->tv_sec;
       break;
     case GRN_TABLE_HASH_KEY :
     case GRN_TABLE_PAT_KEY :
     case GRN_TABLE_DAT_KEY :
     case GRN_TABLE_NO_KEY :
+      if (!IS_TEMP(obj)) {
+        grn_obj_get_io(ctx, obj)->header->last_modified = tv->tv_sec;
+        grn_obj_touch_db(ctx, DB_OBJ(obj)->db, tv);
+      }
+      break;
     case GRN_COLUMN_VAR_SIZE :
     case GRN_COLUMN_FIX_SIZE :
     case GRN_COLUMN_INDEX :
       if (!IS_TEMP(obj)) {
+        grn_obj *table;
         grn_obj_get_io(ctx, obj)->header->last_modified = tv->tv_sec;
-        grn_obj_touch(ctx, DB_OBJ(obj)->db, tv);
+        /* Cached results depend on tables not columns. */
+        table = grn_ctx_at(ctx, obj->header.domain);
+        if (table) {
+          grn_obj_get_io(ctx, table)->header->last_modified = tv->tv_sec;
+        }
+        grn_obj_touch_db(ctx, DB_OBJ(obj)->db, tv);
       }
       break;
     }
   }
 }
 
+static void
+grn_table_ids_add_related(grn_ctx *ctx,
+                          grn_obj *table_ids,
+                          grn_obj *table,
+                          grn_bool with_index_sources)
+{
+  grn_hash *columns;
+
+  grn_table_ids_add(ctx, table_ids, table->header.domain);
+
+  columns = grn_hash_create(ctx, NULL, sizeof(grn_id), 0,
+                            GRN_OBJ_TABLE_HASH_KEY | GRN_HASH_TINY);
+  if (!columns) {
+    return;
+  }
+  grn_table_columns(ctx, table, "", 0, (grn_obj *)columns);
+  GRN_HASH_EACH_BEGIN(ctx, columns, cursor, id) {
+    grn_id *column_id;
+    grn_obj *column;
+
+    grn_hash_cursor_get_key(ctx, cursor, (void **)&column_id);
+    column = grn_ctx_at(ctx, *column_id);
+    if (!column) {
+      continue;
+    }
+    if (grn_obj_is_index_column(ctx, column)) {
+      grn_id *source_ids;
+      size_t i, n_source_ids;
+
+      if (!with_index_sources) {
+        continue;
+      }
+      source_ids = DB_OBJ(column)->source;
+      n_source_ids = DB_OBJ(column)->source_size / sizeof(grn_id);
+      for (i = 0; i < n_source_ids; i++) {
+        grn_obj *source = grn_ctx_at(ctx, source_ids[i]);
+        if (!source) {
+          continue;
+        }
+        if (grn_obj_is_table(ctx, source)) {
+          grn_table_ids_add(ctx, table_ids, source_ids[i]);
+        } else {
+          grn_table_ids_add(ctx, table_ids, source->header.domain);
+        }
+      }
+    } else {
+      grn_table_ids_add(ctx, table_ids, DB_OBJ(column)->range);
+    }
+  } GRN_HASH_EACH_END(ctx, cursor);
+  grn_hash_close(ctx, columns);
+}
+
+/*
+  Touches the table and the tables referred by its key and columns
+  recursively. Loading values to the table may add new records to the
+  referred tables.
+ */
+void
+grn_table_touch_with_references(grn_ctx *ctx, grn_obj *table)
+{
+  grn_timeval tv;
+  grn_obj table_ids;
+  size_t i;
+
+  if (!table || IS_TEMP(table)) {
+    return;
+  }
+
+  grn_timeval_now(ctx, &tv);
+  GRN_RECORD_INIT(&table_ids, GRN_OBJ_VECTOR, GRN_ID_NIL);
+  GRN_RECORD_PUT(ctx, &table_ids, DB_OBJ(table)->id);
+  for (i = 0; i < GRN_BULK_VSIZE(&table_ids) / sizeof(grn_id); i++) {
+    grn_obj *current = grn_ctx_at(ctx, GRN_RECORD_VALUE_AT(&table_ids, i));
+    if (!grn_obj_is_table(ctx, current)) {
+      continue;
+    }
+    grn_obj_touch(ctx, current, &tv);
+    grn_table_ids_add_related(ctx, &table_ids, current, GRN_FALSE);
+  }
+  GRN_OBJ_FIN(ctx, &table_ids);
+}
+
+/*
+  Adds the tables that may change data of the tables in table_ids to
+  table_ids recursively. Changes of the referred tables and the source
+  tables of index columns may change the tables.
+ */
+void
+grn_db_expand_cache_dependencies(grn_ctx *ctx, grn_obj *table_ids)
+{
+  grn_obj *cache_dependencies = ctx->impl->cache_dependencies;
+  size_t i;
+
+  ctx->impl->cache_dependencies = NULL;
+  for (i = 0; i < GRN_BULK_VSIZE(table_ids) / sizeof(grn_id); i++) {
+    grn_obj *table = grn_ctx_at(ctx, GRN_RECORD_VALUE_AT(table_ids, i));
+    if (!grn_obj_is_table(ctx, table)) {
+      continue;
+    }
+    grn_table_ids_add_related(ctx, table_ids, table, GRN_TRUE);
+  }
+  ctx->impl->cache_dependencies = cache_dependencies;
+}
+
 grn_rc
 grn_db_check_name(grn_ctx *ctx, const char *name, unsigned int name_size)
 {
@@ -4154,7 +4411,8 @@ grn_table_group_add_subrec(grn_ctx *ctx,
   if (!(flags & (GRN_TABLE_GROUP_CALC_MAX |
                  GRN_TABLE_GROUP_CALC_MIN |
                  GRN_TABLE_GROUP_CALC_SUM |
-                 GRN_TABLE_GROUP_CALC_AVG))) {
+                 GRN_TABLE_GROUP_CALC_AVG |
+                 GRN_TABLE_GROUP_CALC_APPROX_DISTINCT))) {
     return;
   }
 
@@ -4165,7 +4423,8 @@ grn_table_group_add_subrec(grn_ctx *ctx,
 
 static grn_bool
 accelerated_table_group(grn_ctx *ctx, grn_obj *table, grn_obj *key,
-                        grn_table_group_result *result)
+                        grn_table_group_result *result,
+                        int offset, int limit)
 {
   grn_obj *res = result->table;
   grn_obj *calc_target = result->calc_target;
@@ -4177,7 +4436,8 @@ accelerated_table_group(grn_ctx *ctx, grn_obj *table, grn_obj *key,
       grn_obj *range = grn_ctx_at(ctx, grn_obj_get_range(ctx, key));
       int idp = GRN_OBJ_TABLEP(range);
       grn_table_cursor *tc;
-      if ((tc = grn_table_cursor_open(ctx, table, NULL, 0, NULL, 0, 0, -1, 0))) {
+      if ((tc = grn_table_cursor_open(ctx, table, NULL, 0, NULL, 0,
+                                      offset, limit, 0))) {
         grn_bool processed = GRN_TRUE;
         grn_obj value_buffer;
         GRN_VOID_INIT(&value_buffer);
@@ -4265,7 +4525,8 @@ accelerated_table_group(grn_ctx *ctx, grn_obj *table, grn_obj *key,
 
 static void
 grn_table_group_single_key_records(grn_ctx *ctx, grn_obj *table,
-                                   grn_obj *key, grn_table_group_result *result)
+                                   grn_obj *key, grn_table_group_result *result,
+                                   int offset, int limit)
 {
   grn_obj bulk;
   grn_obj value_buffer;
@@ -4275,7 +4536,8 @@ grn_table_group_single_key_records(grn_ctx *ctx, grn_obj *table,
 
   GRN_TEXT_INIT(&bulk, 0);
   GRN_VOID_INIT(&value_buffer);
-  if ((tc = grn_table_cursor_open(ctx, table, NULL, 0, NULL, 0, 0, -1, 0))) {
+  if ((tc = grn_table_cursor_open(ctx, table, NULL, 0, NULL, 0,
+                                  offset, limit, 0))) {
     grn_id id;
     grn_obj *range = grn_ctx_at(ctx, grn_obj_get_range(ctx, key));
     int idp = GRN_OBJ_TABLEP(range);
@@ -4509,6 +4771,40 @@ grn_table_group_with_range_gap(grn_ctx *ctx, grn_obj *table,
   return 0;
 }
 
+static grn_inline void
+grn_table_group_multi_keys_pack_key(grn_ctx *ctx,
+                                    int n_keys,
+                                    grn_table_group_result *rp,
+                                    grn_obj *vector,
+                                    grn_obj *bulk)
+{
+  int i;
+  int end;
+
+  if (rp->key_end > n_keys) {
+    end = n_keys;
+  } else {
+    end = rp->key_end + 1;
+  }
+  GRN_BULK_REWIND(bulk);
+  grn_text_benc(ctx, bulk, end - rp->key_begin);
+  for (i = rp->key_begin; i < end; i++) {
+    grn_section section = vector->u.v.sections[i];
+    grn_text_benc(ctx, bulk, section.length);
+  }
+  {
+    grn_obj *body = vector->u.v.body;
+    if (body) {
+      GRN_TEXT_PUT(ctx, bulk, GRN_BULK_HEAD(body), GRN_BULK_VSIZE(body));
+    }
+  }
+  for (i = rp->key_begin; i < end; i++) {
+    grn_section section = vector->u.v.sections[i];
+    grn_text_benc(ctx, bulk, section.weight);
+    grn_text_benc(ctx, bulk, section.domain);
+  }
+}
+
 static grn_inline void
 grn_table_group_multi_keys_add_record(grn_ctx *ctx,
                                       grn_table_sort_key *keys,
@@ -4525,31 +4821,8 @@ grn_table_group_multi_keys_add_record(grn_ctx *ctx,
 
   for (r = 0, rp = results; r < n_results; r++, rp++) {
     void *value;
-    int i;
-    int end;
 
-    if (rp->key_end > n_keys) {
-      end = n_keys;
-    } else {
-      end = rp->key_end + 1;
-    }
-    GRN_BULK_REWIND(bulk);
-    grn_text_benc(ctx, bulk, end - rp->key_begin);
-    for (i = rp->key_begin; i < end; i++) {
-      grn_section section = vector->u.v.sections[i];
-      grn_text_benc(ctx, bulk, section.length);
-    }
-    {
-      grn_obj *body = vector->u.v.body;
-      if (body) {
-        GRN_TEXT_PUT(ctx, bulk, GRN_BULK_HEAD(body), GRN_BULK_VSIZE(body));
-      }
-    }
-    for (i = rp->key_begin; i < end; i++) {
-      grn_section section = vector->u.v.sections[i];
-      grn_text_benc(ctx, bulk, section.weight);
-      grn_text_benc(ctx, bulk, section.domain);
-    }
+    grn_table_group_multi_keys_pack_key(ctx, n_keys, rp, vector, bulk);
 
     // todo : cut off GRN_ID_NIL
     if (grn_table_add_v_inline(ctx, rp->table,
@@ -4570,14 +4843,16 @@ grn_table_group_multi_keys_scalar_records(grn_ctx *ctx,
                                           grn_table_sort_key *keys,
                                           int n_keys,
                                           grn_table_group_result *results,
-                                          int n_results)
+                                          int n_results,
+                                          int offset,
+                                          int limit)
 {
   grn_id id;
   grn_table_cursor *tc;
   grn_obj bulk;
   grn_obj vector;
 
-  tc = grn_table_cursor_open(ctx, table, NULL, 0, NULL, 0, 0, -1, 0);
+  tc = grn_table_cursor_open(ctx, table, NULL, 0, NULL, 0, offset, limit, 0);
   if (!tc) {
     return;
   }
@@ -4712,7 +4987,9 @@ grn_table_group_multi_keys_vector_records(grn_ctx *ctx,
                                           grn_table_sort_key *keys,
                                           int n_keys,
                                           grn_table_group_result *results,
-                                          int n_results)
+                                          int n_results,
+                                          int offset,
+                                          int limit)
 {
   grn_id id;
   grn_table_cursor *tc;
@@ -4721,7 +4998,7 @@ grn_table_group_multi_keys_vector_records(grn_ctx *ctx,
   grn_obj *key_buffers;
   int k;
 
-  tc = grn_table_cursor_open(ctx, table, NULL, 0, NULL, 0, 0, -1, 0);
+  tc = grn_table_cursor_open(ctx, table, NULL, 0, NULL, 0, offset, limit, 0);
   if (!tc) {
     return;
   }
@@ -4766,6 +5043,798 @@ grn_table_group_multi_keys_vector_records(grn_ctx *ctx,
   grn_table_cursor_close(ctx, tc);
 }
 
+/* Approximate top-N grouping by Space-Saving. The result table keeps at
+ * most result->limit groups. When a new group is found and the result
+ * table is full, the group that has the fewest records is replaced with
+ * the new group. The new group inherits the number of records of the
+ * replaced group. So _nsubrecs of each group is never less than the
+ * real number of records and frequent groups are kept.
+ *
+ * Groups are tracked by a min-heap on _nsubrecs. The heap isn't
+ * updated for each record. Stale entries are refreshed when the
+ * minimum is needed. */
+typedef struct {
+  int n_subrecs;
+  grn_id id;
+} grn_table_group_approx_top_n_entry;
+
+typedef struct {
+  grn_hash *table;
+  uint32_t max_n_groups;
+  uint32_t n_entries;
+  grn_table_group_approx_top_n_entry *entries;
+  int n_inherited_subrecs;
+} grn_table_group_approx_top_n;
+
+static void
+grn_table_group_approx_top_n_sift_up(grn_table_group_approx_top_n *data,
+                                     uint32_t i)
+{
+  grn_table_group_approx_top_n_entry entry = data->entries[i];
+  while (i > 0) {
+    uint32_t parent = (i - 1) / 2;
+    if (data->entries[parent].n_subrecs <= entry.n_subrecs) {
+      break;
+    }
+    data->entries[i] = data->entries[parent];
+    i = parent;
+  }
+  data->entries[i] = entry;
+}
+
+static void
+grn_table_group_approx_top_n_sift_down(grn_table_group_approx_top_n *data,
+                                       uint32_t i)
+{
+  grn_table_group_approx_top_n_entry entry = data->entries[i];
+  for (;;) {
+    uint32_t child = i * 2 + 1;
+    if (child >= data->n_entries) {
+      break;
+    }
+    if (child + 1 < data->n_entries &&
+        data->entries[child + 1].n_subrecs < data->entries[child].n_subrecs) {
+      child++;
+    }
+    if (entry.n_subrecs <= data->entries[child].n_subrecs) {
+      break;
+    }
+    data->entries[i] = data->entries[child];
+    i = child;
+  }
+  data->entries[i] = entry;
+}
+
+static grn_rc
+grn_table_group_approx_top_n_init(grn_ctx *ctx,
+                                  grn_table_group_approx_top_n *data,
+                                  grn_table_group_result *result)
+{
+  grn_obj *table = result->table;
+  uint32_t n_records;
+
+  data->table = (grn_hash *)table;
+  data->n_entries = 0;
+  data->entries = NULL;
+  data->n_inherited_subrecs = 0;
+
+  if (result->limit <= 0) {
+    ERR(GRN_INVALID_ARGUMENT,
+        "[table][group][approx-top-n] the max number of groups must be "
+        "positive: <%d>",
+        result->limit);
+    return ctx->rc;
+  }
+  if (table->header.type != GRN_TABLE_HASH_KEY ||
+      !(table->header.flags & GRN_OBJ_WITH_SUBREC)) {
+    ERR(GRN_INVALID_ARGUMENT,
+        "[table][group][approx-top-n] "
+        "result table must be a hash table with sub records");
+    return ctx->rc;
+  }
+  if (DB_OBJ(table)->max_n_subrecs > 1) {
+    ERR(GRN_INVALID_ARGUMENT,
+        "[table][group][approx-top-n] "
+        "the max number of sub records must be 0 or 1: <%u>",
+        DB_OBJ(table)->max_n_subrecs);
+    return ctx->rc;
+  }
+
+  data->max_n_groups = result->limit;
+  n_records = grn_hash_size(ctx, data->table);
+  if (n_records > data->max_n_groups) {
+    data->max_n_groups = n_records;
+  }
+  data->entries =
+    GRN_MALLOC(sizeof(grn_table_group_approx_top_n_entry) * data->max_n_groups);
+  if (!data->entries) {
+    ERR(GRN_NO_MEMORY_AVAILABLE,
+        "[table][group][approx-top-n] failed to allocate heap: <%u>",
+        data->max_n_groups);
+    return ctx->rc;
+  }
+
+  /* For grouping into a table that already has groups. */
+  GRN_HASH_EACH_BEGIN(ctx, data->table, cursor, id) {
+    grn_rset_recinfo *ri;
+    grn_table_group_approx_top_n_entry *entry;
+    grn_hash_cursor_get_value(ctx, cursor, (void **)&ri);
+    entry = &(data->entries[data->n_entries]);
+    entry->n_subrecs = GRN_RSET_N_SUBRECS(ri);
+    entry->id = id;
+    grn_table_group_approx_top_n_sift_up(data, data->n_entries++);
+  } GRN_HASH_EACH_END(ctx, cursor);
+
+  return ctx->rc;
+}
+
+static void
+grn_table_group_approx_top_n_fin(grn_ctx *ctx,
+                                 grn_table_group_approx_top_n *data)
+{
+  if (data->entries) {
+    GRN_FREE(data->entries);
+  }
+}
+
+/* Returns the record ID of the group for the key. The caller must call
+ * grn_table_group_approx_top_n_added() after adding a sub record to the
+ * group. */
+static grn_id
+grn_table_group_approx_top_n_add(grn_ctx *ctx,
+                                 grn_table_group_approx_top_n *data,
+                                 const void *key,
+                                 unsigned int key_size,
+                                 void **value)
+{
+  grn_id id;
+  grn_bool replaced = GRN_FALSE;
+
+  data->n_inherited_subrecs = 0;
+  if (!key || key_size == 0) {
+    return GRN_ID_NIL;
+  }
+
+  id = grn_hash_get(ctx, data->table, key, key_size, value);
+  if (id != GRN_ID_NIL) {
+    return id;
+  }
+
+  if (data->n_entries == data->max_n_groups) {
+    grn_table_group_approx_top_n_entry *min_entry = &(data->entries[0]);
+    for (;;) {
+      grn_rset_recinfo *ri;
+      uint32_t value_size;
+      int n_subrecs;
+      ri = (grn_rset_recinfo *)grn_hash_get_value_(ctx,
+                                                   data->table,
+                                                   min_entry->id,
+                                                   &value_size);
+      n_subrecs = GRN_RSET_N_SUBRECS(ri);
+      if (n_subrecs == min_entry->n_subrecs) {
+        break;
+      }
+      min_entry->n_subrecs = n_subrecs;
+      grn_table_group_approx_top_n_sift_down(data, 0);
+    }
+    data->n_inherited_subrecs = min_entry->n_subrecs;
+    grn_hash_delete_by_id(ctx, data->table, min_entry->id, NULL);
+    replaced = GRN_TRUE;
+  }
+
+  id = grn_hash_add(ctx, data->table, key, key_size, value, NULL);
+  if (id == GRN_ID_NIL) {
+    return GRN_ID_NIL;
+  }
+  if (replaced) {
+    data->entries[0].n_subrecs = data->n_inherited_subrecs + 1;
+    data->entries[0].id = id;
+    grn_table_group_approx_top_n_sift_down(data, 0);
+  } else {
+    grn_table_group_approx_top_n_entry *entry;
+    entry = &(data->entries[data->n_entries]);
+    entry->n_subrecs = 1;
+    entry->id = id;
+    grn_table_group_approx_top_n_sift_up(data, data->n_entries++);
+  }
+  return id;
+}
+
+static grn_inline void
+grn_table_group_approx_top_n_added(grn_ctx *ctx,
+                                   grn_table_group_approx_top_n *data,
+                                   grn_rset_recinfo *ri)
+{
+  ri->n_subrecs += data->n_inherited_subrecs;
+}
+
+static void
+grn_table_group_approx_top_n_add_record(grn_ctx *ctx,
+                                        grn_table_group_approx_top_n *data,
+                                        grn_table_group_result *result,
+                                        const void *key,
+                                        unsigned int key_size,
+                                        grn_id id,
+                                        grn_rset_recinfo *ri,
+                                        grn_obj *value_buffer)
+{
+  void *value;
+
+  if (!grn_table_group_approx_top_n_add(ctx, data, key, key_size, &value)) {
+    return;
+  }
+  grn_table_group_add_subrec(ctx, result->table, value,
+                             ri ? ri->score : 0,
+                             (grn_rset_posinfo *)&id, 0,
+                             result->calc_target,
+                             value_buffer);
+  grn_table_group_approx_top_n_added(ctx, data, value);
+}
+
+static void
+grn_table_group_approx_top_n_records(grn_ctx *ctx, grn_obj *table,
+                                     grn_table_sort_key *keys, int n_keys,
+                                     grn_table_group_result *results,
+                                     int n_results)
+{
+  grn_table_group_approx_top_n data;
+  grn_table_cursor *tc;
+  grn_obj bulk;
+  grn_obj vector;
+  grn_obj value_buffer;
+  grn_id id;
+  int k;
+  grn_bool is_reference = GRN_FALSE;
+
+  if (n_results != 1) {
+    ERR(GRN_INVALID_ARGUMENT,
+        "[table][group][approx-top-n] only one result is supported: <%d>",
+        n_results);
+    return;
+  }
+  for (k = 0; k < n_keys; k++) {
+    grn_id range_id;
+    grn_obj_flags range_flags = 0;
+    grn_obj_get_range_info(ctx, keys[k].key, &range_id, &range_flags);
+    if (n_keys > 1 && range_flags == GRN_OBJ_VECTOR) {
+      ERR(GRN_INVALID_ARGUMENT,
+          "[table][group][approx-top-n] "
+          "vector isn't supported for multiple keys");
+      return;
+    }
+    if (n_keys == 1) {
+      grn_obj *range = grn_ctx_at(ctx, range_id);
+      is_reference = GRN_OBJ_TABLEP(range);
+    }
+  }
+
+  if (grn_table_group_approx_top_n_init(ctx, &data, results) != GRN_SUCCESS) {
+    grn_table_group_approx_top_n_fin(ctx, &data);
+    return;
+  }
+
+  tc = grn_table_cursor_open(ctx, table, NULL, 0, NULL, 0, 0, -1, 0);
+  if (!tc) {
+    grn_table_group_approx_top_n_fin(ctx, &data);
+    return;
+  }
+
+  GRN_TEXT_INIT(&bulk, 0);
+  GRN_OBJ_INIT(&vector, GRN_VECTOR, 0, GRN_DB_VOID);
+  GRN_VOID_INIT(&value_buffer);
+  while ((id = grn_table_cursor_next_inline(ctx, tc))) {
+    grn_rset_recinfo *ri = NULL;
+
+    if (DB_OBJ(table)->header.flags & GRN_OBJ_WITH_SUBREC) {
+      grn_table_cursor_get_value_inline(ctx, tc, (void **)&ri);
+    }
+
+    if (n_keys > 1) {
+      GRN_BULK_REWIND(&vector);
+      for (k = 0; k < n_keys; k++) {
+        GRN_BULK_REWIND(&bulk);
+        grn_obj_get_value(ctx, keys[k].key, id, &bulk);
+        grn_vector_add_element(ctx, &vector,
+                               GRN_BULK_HEAD(&bulk), GRN_BULK_VSIZE(&bulk),
+                               0,
+                               bulk.header.domain);
+      }
+      grn_table_group_multi_keys_pack_key(ctx, n_keys, results,
+                                          &vector, &bulk);
+      grn_table_group_approx_top_n_add_record(ctx, &data, results,
+                                              GRN_BULK_HEAD(&bulk),
+                                              GRN_BULK_VSIZE(&bulk),
+                                              id, ri, &value_buffer);
+      continue;
+    }
+
+    GRN_BULK_REWIND(&bulk);
+    grn_obj_get_value(ctx, keys->key, id, &bulk);
+    switch (bulk.header.type) {
+    case GRN_UVECTOR :
+      {
+        unsigned int element_size;
+        uint8_t *elements;
+        int i, n_elements;
+
+        element_size = grn_uvector_element_size(ctx, &bulk);
+        elements = GRN_BULK_HEAD(&bulk);
+        n_elements = GRN_BULK_VSIZE(&bulk) / element_size;
+        for (i = 0; i < n_elements; i++) {
+          uint8_t *element = elements + (element_size * i);
+          if (is_reference && *((grn_id *)element) == GRN_ID_NIL) {
+            continue;
+          }
+          grn_table_group_approx_top_n_add_record(ctx, &data, results,
+                                                  element, element_size,
+                                                  id, ri, &value_buffer);
+        }
+      }
+      break;
+    case GRN_VECTOR :
+      {
+        unsigned int i, n_elements;
+        n_elements = grn_vector_size(ctx, &bulk);
+        for (i = 0; i < n_elements; i++) {
+          const char *content;
+          unsigned int content_length;
+          content_length = grn_vector_get_element(ctx, &bulk, i,
+                                                  &content, NULL, NULL);
+          grn_table_group_approx_top_n_add_record(ctx, &data, results,
+                                                  content, content_length,
+                                                  id, ri, &value_buffer);
+        }
+      }
+      break;
+    case GRN_BULK :
+      if (is_reference && *((grn_id *)GRN_BULK_HEAD(&bulk)) == GRN_ID_NIL) {
+        break;
+      }
+      grn_table_group_approx_top_n_add_record(ctx, &data, results,
+                                              GRN_BULK_HEAD(&bulk),
+                                              GRN_BULK_VSIZE(&bulk),
+                                              id, ri, &value_buffer);
+      break;
+    default :
+      ERR(GRN_INVALID_ARGUMENT, "invalid column");
+      break;
+    }
+    if (ctx->rc != GRN_SUCCESS) {
+      break;
+    }
+  }
+  GRN_OBJ_FIN(ctx, &value_buffer);
+  GRN_OBJ_FIN(ctx, &vector);
+  GRN_OBJ_FIN(ctx, &bulk);
+  grn_table_cursor_close(ctx, tc);
+  grn_table_group_approx_top_n_fin(ctx, &data);
+}
+
+static grn_rc
+grn_table_group_create_result_tables(grn_ctx *ctx, grn_obj *table,
+                                     grn_table_sort_key *keys, int n_keys,
+                                     grn_table_group_result *results,
+                                     int n_results)
+{
+  grn_bool group_by_all_records = (n_keys == 0 && n_results == 1);
+  int r;
+  grn_table_group_result *rp;
+
+  for (r = 0, rp = results; r < n_results; r++, rp++) {
+    grn_table_flags flags;
+    grn_obj *key_type = NULL;
+    uint32_t additional_value_size;
+
+    if (rp->table) {
+      continue;
+    }
+
+    flags = GRN_OBJ_TABLE_HASH_KEY|
+      GRN_OBJ_WITH_SUBREC|
+      GRN_OBJ_UNIT_USERDEF_DOCUMENT;
+    if (group_by_all_records) {
+      key_type = grn_ctx_at(ctx, GRN_DB_SHORT_TEXT);
+    } else if (n_keys == 1) {
+      key_type = grn_ctx_at(ctx, grn_obj_get_range(ctx, keys[0].key));
+    } else {
+      flags |= GRN_OBJ_KEY_VAR_SIZE;
+    }
+    additional_value_size = grn_rset_recinfo_calc_values_size(ctx,
+                                                              rp->flags);
+    rp->table = grn_table_create_with_max_n_subrecs(ctx, NULL, 0, NULL,
+                                                    flags,
+                                                    key_type, table,
+                                                    rp->max_n_subrecs,
+                                                    additional_value_size);
+    if (!rp->table) {
+      if (ctx->rc == GRN_SUCCESS) {
+        ERR(GRN_NO_MEMORY_AVAILABLE,
+            "[table][group] failed to create a result table");
+      }
+      return ctx->rc;
+    }
+    DB_OBJ(rp->table)->flags.group = rp->flags;
+  }
+
+  return GRN_SUCCESS;
+}
+
+static void
+grn_table_group_records(grn_ctx *ctx, grn_obj *table,
+                        grn_table_sort_key *keys, int n_keys,
+                        grn_table_group_result *results, int n_results,
+                        int offset, int limit)
+{
+  if (n_keys == 1 && n_results == 1) {
+    if (!accelerated_table_group(ctx, table, keys->key, results,
+                                 offset, limit)) {
+      grn_table_group_single_key_records(ctx, table, keys->key, results,
+                                         offset, limit);
+    }
+  } else {
+    int k;
+    grn_table_sort_key *kp;
+    grn_bool have_vector = GRN_FALSE;
+    for (k = 0, kp = keys; k < n_keys; k++, kp++) {
+      grn_id range_id;
+      grn_obj_flags range_flags = 0;
+      grn_obj_get_range_info(ctx, kp->key, &range_id, &range_flags);
+      if (range_flags == GRN_OBJ_VECTOR) {
+        have_vector = GRN_TRUE;
+        break;
+      }
+    }
+    if (have_vector) {
+      grn_table_group_multi_keys_vector_records(ctx, table,
+                                                keys, n_keys,
+                                                results, n_results,
+                                                offset, limit);
+    } else {
+      grn_table_group_multi_keys_scalar_records(ctx, table,
+                                                keys, n_keys,
+                                                results, n_results,
+                                                offset, limit);
+    }
+  }
+}
+
+typedef struct {
+  grn_ctx ctx;
+  grn_obj *table;
+  grn_table_sort_key *keys;
+  int n_keys;
+  grn_table_group_result *results;
+  int n_results;
+  int offset;
+  int limit;
+  grn_thread thread;
+  grn_bool thread_created;
+  grn_rc rc;
+} grn_table_group_worker;
+
+static grn_thread_func_result CALLBACK
+grn_table_group_worker_run(void *data)
+{
+  grn_table_group_worker *worker = data;
+  grn_ctx *ctx = &(worker->ctx);
+
+  if (grn_table_group_create_result_tables(ctx, worker->table,
+                                           worker->keys, worker->n_keys,
+                                           worker->results,
+                                           worker->n_results) ==
+      GRN_SUCCESS) {
+    grn_table_group_records(ctx, worker->table,
+                            worker->keys, worker->n_keys,
+                            worker->results, worker->n_results,
+                            worker->offset, worker->limit);
+  }
+  worker->rc = ctx->rc;
+  return GRN_THREAD_FUNC_RETURN_VALUE;
+}
+
+/* Worker local result tables must have the same value layout as the
+ * final result table because they are merged by copying values. */
+static grn_bool
+grn_table_group_parallel_is_mergeable(grn_ctx *ctx,
+                                      grn_obj *table,
+                                      grn_obj *local_table)
+{
+  if (table->header.type != GRN_TABLE_HASH_KEY) {
+    return GRN_FALSE;
+  }
+  if (!(table->header.flags & GRN_OBJ_WITH_SUBREC)) {
+    return GRN_FALSE;
+  }
+  if (((grn_hash *)table)->value_size != ((grn_hash *)local_table)->value_size) {
+    return GRN_FALSE;
+  }
+  if (DB_OBJ(table)->subrec_size != DB_OBJ(local_table)->subrec_size) {
+    return GRN_FALSE;
+  }
+  if (DB_OBJ(table)->max_n_subrecs != DB_OBJ(local_table)->max_n_subrecs) {
+    return GRN_FALSE;
+  }
+  if (DB_OBJ(table)->flags.group != DB_OBJ(local_table)->flags.group) {
+    return GRN_FALSE;
+  }
+  return GRN_TRUE;
+}
+
+/* Merges a grouped record in a worker local result table into the
+ * final result table. It's the same as adding the local record's
+ * source records to the final record one by one by
+ * grn_table_add_subrec(): sub records are kept by score in the same
+ * heap up to max_n_subrecs. Records are grouped with dir 0, so sub
+ * records that have the same score are kept in insertion order. */
+static void
+grn_table_group_merge_record(grn_ctx *ctx,
+                             grn_obj *table,
+                             grn_rset_recinfo *ri,
+                             grn_obj *local_table,
+                             grn_rset_recinfo *local_ri,
+                             grn_bool added)
+{
+  const int dir = 0;
+  int max_n_subrecs = DB_OBJ(table)->max_n_subrecs;
+  int n_subrecs;
+  int n_local_subrecs;
+
+  if (added) {
+    grn_memcpy(ri, local_ri, ((grn_hash *)table)->value_size);
+    return;
+  }
+
+  n_subrecs = GRN_RSET_N_SUBRECS(ri);
+  n_local_subrecs = GRN_RSET_N_SUBRECS(local_ri);
+  ri->score += local_ri->score;
+  if (max_n_subrecs > 0) {
+    int subrec_size = DB_OBJ(table)->subrec_size;
+    int i;
+    for (i = 0; i < n_local_subrecs && i < max_n_subrecs; i++) {
+      double *local_subrec =
+        GRN_RSET_SUBRECS_NTH((byte *)(local_ri->subrecs), subrec_size, i);
+      double score = *local_subrec;
+      byte *body = ((byte *)local_subrec) + GRN_RSET_SCORE_SIZE;
+      n_subrecs++;
+      if (max_n_subrecs < n_subrecs) {
+        if (GRN_RSET_SUBRECS_CMP(score, *((double *)(ri->subrecs)), dir) > 0) {
+          subrecs_replace_min((byte *)(ri->subrecs), subrec_size,
+                              max_n_subrecs, score, body, dir);
+        }
+      } else {
+        subrecs_push((byte *)(ri->subrecs), subrec_size,
+                     n_subrecs, score, body, dir);
+      }
+    }
+  }
+  ri->n_subrecs += n_local_subrecs;
+  grn_rset_recinfo_merge_calc_values(ctx, ri, table, local_ri, local_table);
+}
+
+static void
+grn_table_group_merge(grn_ctx *ctx, grn_obj *table, grn_obj *local_table)
+{
+  GRN_HASH_EACH_BEGIN(ctx, (grn_hash *)local_table, cursor, local_id) {
+    void *key;
+    unsigned int key_size;
+    void *local_value;
+    void *value;
+    int added = 0;
+
+    grn_hash_cursor_get_key_value(ctx, cursor, &key, &key_size, &local_value);
+    if (grn_table_add_v_inline(ctx, table, key, key_size, &value, &added)) {
+      grn_table_group_merge_record(ctx,
+                                   table,
+                                   value,
+                                   local_table,
+                                   local_value,
+                                   added);
+    }
+    if (ctx->rc != GRN_SUCCESS) {
+      break;
+    }
+  } GRN_HASH_EACH_END(ctx, cursor);
+}
+
+grn_rc
+grn_table_group_merge_results(grn_ctx *ctx, grn_obj *table,
+                              grn_table_sort_key *keys, int n_keys,
+                              grn_table_group_result *results,
+                              grn_table_group_result *local_results,
+                              int n_results)
+{
+  int r;
+
+  GRN_API_ENTER;
+  if (grn_table_group_create_result_tables(ctx, table,
+                                           keys, n_keys,
+                                           results, n_results) !=
+      GRN_SUCCESS) {
+    GRN_API_RETURN(ctx->rc);
+  }
+  for (r = 0; r < n_results; r++) {
+    if (!local_results[r].table) {
+      continue;
+    }
+    if (!grn_table_group_parallel_is_mergeable(ctx,
+                                               results[r].table,
+                                               local_results[r].table)) {
+      ERR(GRN_INVALID_ARGUMENT,
+          "[table][group][merge] result tables have different layouts");
+      break;
+    }
+    grn_table_group_merge(ctx, results[r].table, local_results[r].table);
+    if (ctx->rc != GRN_SUCCESS) {
+      break;
+    }
+    GRN_TABLE_GROUPED_ON(results[r].table);
+  }
+  GRN_API_RETURN(ctx->rc);
+}
+
+/* Splits the records into contiguous cursor order ranges and groups
+ * each range into worker local result tables by a worker thread.
+ * Local result tables are merged into the final result tables in
+ * range order. So grouped records are added in the same order as the
+ * one by one thread and have the same IDs.
+ *
+ * A temporary table must be updated only by the context that creates
+ * it. So local result tables are created by worker contexts and they
+ * are closed by them after they are merged by ctx.
+ *
+ * This returns GRN_FALSE when the number of records is too small or
+ * result tables can't be merged. The caller groups records by
+ * itself. */
+static grn_bool
+grn_table_group_parallel(grn_ctx *ctx, grn_obj *table,
+                         grn_table_sort_key *keys, int n_keys,
+                         grn_table_group_result *results, int n_results)
+{
+  uint32_t n_workers = grn_table_select_get_n_workers(ctx);
+  uint32_t n_initialized_workers = 0;
+  uint32_t n_records;
+  uint32_t n_records_per_worker;
+  uint32_t i;
+  int r;
+  grn_table_group_worker *workers;
+  grn_table_group_result *local_results;
+  grn_bool mergeable = GRN_TRUE;
+
+  if (n_workers < 2) {
+    return GRN_FALSE;
+  }
+  n_records = grn_table_size(ctx, table);
+  if (grn_table_group_min_n_records_per_worker > 0 &&
+      n_workers > n_records / grn_table_group_min_n_records_per_worker) {
+    n_workers = n_records / grn_table_group_min_n_records_per_worker;
+  }
+  if (n_workers < 2) {
+    return GRN_FALSE;
+  }
+  /* Every worker must have at least one record. */
+  n_records_per_worker = (n_records + n_workers - 1) / n_workers;
+  n_workers = (n_records + n_records_per_worker - 1) / n_records_per_worker;
+  if (n_workers < 2) {
+    return GRN_FALSE;
+  }
+
+  workers = GRN_CALLOC(sizeof(grn_table_group_worker) * n_workers);
+  if (!workers) {
+    ERRCLR(ctx);
+    return GRN_FALSE;
+  }
+  local_results = GRN_CALLOC(sizeof(grn_table_group_result) *
+                             n_results * n_workers);
+  if (!local_results) {
+    ERRCLR(ctx);
+    GRN_FREE(workers);
+    return GRN_FALSE;
+  }
+
+  /* Worker local result tables are created in the same way as the
+   * tables created here. */
+  for (r = 0; r < n_results && mergeable; r++) {
+    grn_table_group_result probe = results[r];
+    probe.table = NULL;
+    if (grn_table_group_create_result_tables(ctx, table,
+                                             keys, n_keys,
+                                             &probe, 1) != GRN_SUCCESS) {
+      ERRCLR(ctx);
+      mergeable = GRN_FALSE;
+      break;
+    }
+    mergeable = grn_table_group_parallel_is_mergeable(ctx,
+                                                      results[r].table,
+                                                      probe.table);
+    grn_obj_close(ctx, probe.table);
+  }
+  if (!mergeable) {
+    goto exit;
+  }
+  for (i = 0; i < n_results * n_workers; i++) {
+    local_results[i] = results[i % n_results];
+    local_results[i].table = NULL;
+  }
+
+  GRN_LOG(ctx, GRN_LOG_INFO,
+          "[table][group] n_workers=<%u> n_records=<%u>",
+          n_workers, n_records);
+
+  for (; n_initialized_workers < n_workers; n_initialized_workers++) {
+    grn_table_group_worker *worker = &(workers[n_initialized_workers]);
+    grn_ctx_init(&(worker->ctx), 0);
+    grn_ctx_use(&(worker->ctx), grn_ctx_db(ctx));
+    worker->ctx.impl->table_select_n_workers = 1;
+    worker->table = table;
+    worker->keys = keys;
+    worker->n_keys = n_keys;
+    worker->results = local_results + (n_results * n_initialized_workers);
+    worker->n_results = n_results;
+    worker->offset = n_records_per_worker * n_initialized_workers;
+    worker->limit = n_records_per_worker;
+  }
+
+  for (i = 0; i < n_workers; i++) {
+    grn_table_group_worker *worker = &(workers[i]);
+    if (THREAD_CREATE(worker->thread,
+                      grn_table_group_worker_run,
+                      worker) == 0) {
+      worker->thread_created = GRN_TRUE;
+    } else {
+      GRN_LOG(ctx, GRN_LOG_WARNING,
+              "[table][group][worker] "
+              "failed to create a thread: <%u>: "
+              "run in the current thread",
+              i);
+      grn_table_group_worker_run(worker);
+    }
+  }
+  for (i = 0; i < n_workers; i++) {
+    grn_table_group_worker *worker = &(workers[i]);
+    if (worker->thread_created) {
+      THREAD_JOIN(worker->thread);
+    }
+  }
+  for (i = 0; i < n_workers; i++) {
+    grn_table_group_worker *worker = &(workers[i]);
+    if (worker->rc != GRN_SUCCESS) {
+      ERR(worker->rc,
+          "[table][group][worker] %s",
+          worker->ctx.errbuf);
+      break;
+    }
+  }
+
+  for (i = 0; i < n_workers && ctx->rc == GRN_SUCCESS; i++) {
+    grn_table_group_result *worker_results = local_results + (n_results * i);
+    for (r = 0; r < n_results; r++) {
+      if (!worker_results[r].table) {
+        continue;
+      }
+      grn_table_group_merge(ctx, results[r].table, worker_results[r].table);
+      if (ctx->rc != GRN_SUCCESS) {
+        break;
+      }
+    }
+  }
+
+  for (i = 0; i < n_initialized_workers; i++) {
+    grn_table_group_result *worker_results = local_results + (n_results * i);
+    for (r = 0; r < n_results; r++) {
+      if (worker_results[r].table) {
+        grn_obj_close(&(workers[i].ctx), worker_results[r].table);
+      }
+    }
+    grn_ctx_fin(&(workers[i].ctx));
+  }
+
+exit :
+  GRN_FREE(local_results);
+  GRN_FREE(workers);
+
+  return mergeable;
+}
+
 grn_rc
 grn_table_group(grn_ctx *ctx, grn_obj *table,
                 grn_table_sort_key *keys, int n_keys,
@@ -4790,61 +5859,25 @@ grn_table_group(grn_ctx *ctx, grn_obj *table,
         goto exit;
       }
     }
-    for (r = 0, rp = results; r < n_results; r++, rp++) {
-      if (!rp->table) {
-        grn_table_flags flags;
-        grn_obj *key_type = NULL;
-        uint32_t additional_value_size;
-
-        flags = GRN_OBJ_TABLE_HASH_KEY|
-          GRN_OBJ_WITH_SUBREC|
-          GRN_OBJ_UNIT_USERDEF_DOCUMENT;
-        if (group_by_all_records) {
-          key_type = grn_ctx_at(ctx, GRN_DB_SHORT_TEXT);
-        } else if (n_keys == 1) {
-          key_type = grn_ctx_at(ctx, grn_obj_get_range(ctx, keys[0].key));
-        } else {
-          flags |= GRN_OBJ_KEY_VAR_SIZE;
-        }
-        additional_value_size = grn_rset_recinfo_calc_values_size(ctx,
-                                                                  rp->flags);
-        rp->table = grn_table_create_with_max_n_subrecs(ctx, NULL, 0, NULL,
-                                                        flags,
-                                                        key_type, table,
-                                                        rp->max_n_subrecs,
-                                                        additional_value_size);
-        if (!rp->table) {
-          goto exit;
-        }
-        DB_OBJ(rp->table)->flags.group = rp->flags;
-      }
+    if (grn_table_group_create_result_tables(ctx, table,
+                                             keys, n_keys,
+                                             results, n_results) !=
+        GRN_SUCCESS) {
+      goto exit;
     }
     if (group_by_all_records) {
       grn_table_group_all_records(ctx, table, results);
-    } else if (n_keys == 1 && n_results == 1) {
-      if (!accelerated_table_group(ctx, table, keys->key, results)) {
-        grn_table_group_single_key_records(ctx, table, keys->key, results);
-      }
-    } else {
-      grn_bool have_vector = GRN_FALSE;
-      for (k = 0, kp = keys; k < n_keys; k++, kp++) {
-        grn_id range_id;
-        grn_obj_flags range_flags = 0;
-        grn_obj_get_range_info(ctx, kp->key, &range_id, &range_flags);
-        if (range_flags == GRN_OBJ_VECTOR) {
-          have_vector = GRN_TRUE;
-          break;
-        }
-      }
-      if (have_vector) {
-        grn_table_group_multi_keys_vector_records(ctx, table,
-                                                  keys, n_keys,
-                                                  results, n_results);
-      } else {
-        grn_table_group_multi_keys_scalar_records(ctx, table,
-                                                  keys, n_keys,
-                                                  results, n_results);
-      }
+    } else if (results->flags & GRN_TABLE_GROUP_APPROX_TOP_N) {
+      grn_table_group_approx_top_n_records(ctx, table,
+                                           keys, n_keys,
+                                           results, n_results);
+    } else if (!grn_table_group_parallel(ctx, table,
+                                         keys, n_keys,
+                                         results, n_results)) {
+      grn_table_group_records(ctx, table,
+                              keys, n_keys,
+                              results, n_results,
+                              0, -1);
     }
     for (r = 0, rp = results; r < n_results; r++, rp++) {
       GRN_TABLE_GROUPED_ON(rp->table);
@@ -5485,6 +6518,7 @@ default_column_set_value(grn_ctx *ctx, grn_proc_ctx *pctx, grn_obj *in, grn_obj
           return GRN_NO_MEMORY_AVAILABLE;
         }
         grn_memcpy(v, in->u.p.ptr, value_size);
+        grn_ra_zone_map_update(ctx, (grn_ra *)pctx->obj, arg->id, v);
         grn_ra_unref(ctx, (grn_ra *)pctx->obj, arg->id);
       }
       break;
@@ -5617,7 +6651,7 @@ grn_vector_size(grn_ctx *ctx, grn_obj *vector)
   GRN_API_RETURN(size);
 }
 
-static grn_obj *
+grn_obj *
 grn_vector_body(grn_ctx *ctx, grn_obj *v)
 {
   if (!v) {
@@ -5970,6 +7004,30 @@ accessor_new(grn_ctx *ctx)
   return res;
 }
 
+grn_obj *
+grn_accessor_copy(grn_ctx *ctx, grn_obj *accessor)
+{
+  grn_accessor *a;
+  grn_accessor *copied = NULL;
+  grn_accessor **rp = &copied;
+  for (a = (grn_accessor *)accessor; a; a = a->next) {
+    if (!(*rp = accessor_new(ctx))) {
+      if (copied) {
+        grn_obj_close(ctx, (grn_obj *)copied);
+      }
+      return NULL;
+    }
+    (*rp)->header.flags = a->header.flags;
+    (*rp)->header.domain = a->header.domain;
+    (*rp)->range = a->range;
+    (*rp)->action = a->action;
+    (*rp)->offset = a->offset;
+    (*rp)->obj = a->obj;
+    rp = &((*rp)->next);
+  }
+  return (grn_obj *)copied;
+}
+
 grn_inline static grn_bool
 grn_obj_get_accessor_rset_value(grn_ctx *ctx, grn_obj *obj,
                                 grn_accessor **res, uint8_t action)
@@ -6012,6 +7070,9 @@ grn_obj_get_accessor_rset_value(grn_ctx *ctx, grn_obj *obj,
     case GRN_ACCESSOR_GET_AVG :
       CHECK_GROUP_CALC_FLAG(GRN_TABLE_GROUP_CALC_AVG);
       break;
+    case GRN_ACCESSOR_GET_APPROX_DISTINCT :
+      CHECK_GROUP_CALC_FLAG(GRN_TABLE_GROUP_CALC_APPROX_DISTINCT);
+      break;
     case GRN_ACCESSOR_GET_NSUBRECS :
       if (GRN_TABLE_IS_GROUPED(obj)) {
         (*rp)->action = action;
@@ -6075,6 +7136,7 @@ grn_obj_get_accessor(grn_ctx *ctx, grn_obj *obj, const char *name, unsigned int
     case GRN_ACCESSOR_GET_MIN :
     case GRN_ACCESSOR_GET_SUM :
     case GRN_ACCESSOR_GET_AVG :
+    case GRN_ACCESSOR_GET_APPROX_DISTINCT :
       obj = grn_ctx_at(ctx, DB_OBJ(res->obj)->range);
       break;
     case GRN_ACCESSOR_GET_COLUMN_VALUE :
@@ -6295,13 +7357,21 @@ grn_obj_get_accessor(grn_ctx *ctx, grn_obj *obj, const char *name, unsigned int
           goto exit;
         }
         break;
-      case 'a' : /* avg */
+      case 'a' : /* avg, approx_distinct */
         if (len == GRN_COLUMN_NAME_AVG_LEN &&
             memcmp(name,
                    GRN_COLUMN_NAME_AVG,
                    GRN_COLUMN_NAME_AVG_LEN) == 0) {
           if (!grn_obj_get_accessor_rset_value(ctx, obj, &res,
-                                               GRN_ACCESSOR_GET_AVG)) {
+                                               GRN_ACCESSOR_GET_AVG)) {
+            goto exit;
+          }
+        } else if (len == GRN_COLUMN_NAME_APPROX_DISTINCT_LEN &&
+                   memcmp(name,
+                          GRN_COLUMN_NAME_APPROX_DISTINCT,
+                          GRN_COLUMN_NAME_APPROX_DISTINCT_LEN) == 0) {
+          if (!grn_obj_get_accessor_rset_value(ctx, obj, &res,
+                                               GRN_ACCESSOR_GET_APPROX_DISTINCT)) {
             goto exit;
           }
         } else {
@@ -6456,6 +7526,7 @@ grn_obj_get_range_info(grn_ctx *ctx, grn_obj *obj,
       case GRN_ACCESSOR_GET_MAX :
       case GRN_ACCESSOR_GET_MIN :
       case GRN_ACCESSOR_GET_SUM :
+      case GRN_ACCESSOR_GET_APPROX_DISTINCT :
         *range_id = GRN_DB_INT64;
         break;
       case GRN_ACCESSOR_GET_AVG :
@@ -6502,6 +7573,7 @@ grn_obj_is_persistent(grn_ctx *ctx, grn_obj *obj)
       case GRN_ACCESSOR_GET_MIN :
       case GRN_ACCESSOR_GET_SUM :
       case GRN_ACCESSOR_GET_AVG :
+      case GRN_ACCESSOR_GET_APPROX_DISTINCT :
         res = 0;
         break;
       case GRN_ACCESSOR_GET_ID :
@@ -7148,6 +8220,15 @@ grn_accessor_get_value_(grn_ctx *ctx, grn_accessor *a, grn_id id, uint32_t *size
         *size = GRN_RSET_AVG_SIZE;
       }
       break;
+    case GRN_ACCESSOR_GET_APPROX_DISTINCT :
+      if ((value = grn_obj_get_value_(ctx, a->obj, id, size))) {
+        value =
+          (const char *)grn_rset_recinfo_get_approx_distinct_(ctx,
+                                                              (grn_rset_recinfo *)value,
+                                                              a->obj);
+        *size = sizeof(int64_t);
+      }
+      break;
     case GRN_ACCESSOR_GET_COLUMN_VALUE :
       /* todo : support vector */
       value = grn_obj_get_value_(ctx, a->obj, id, size);
@@ -7283,6 +8364,17 @@ grn_accessor_get_value(grn_ctx *ctx, grn_accessor *a, grn_id id, grn_obj *value)
       }
       value->header.domain = GRN_DB_FLOAT;
       break;
+    case GRN_ACCESSOR_GET_APPROX_DISTINCT :
+      if (id) {
+        grn_rset_recinfo *ri = (grn_rset_recinfo *)grn_obj_get_value_(ctx, a->obj, id, &vs);
+        int64_t approx_distinct;
+        approx_distinct = grn_rset_recinfo_get_approx_distinct(ctx, ri, a->obj);
+        GRN_INT64_PUT(ctx, value, approx_distinct);
+      } else {
+        GRN_INT64_PUT(ctx, value, 0);
+      }
+      value->header.domain = GRN_DB_INT64;
+      break;
     case GRN_ACCESSOR_GET_COLUMN_VALUE :
       grn_obj_get_value(ctx, a->obj, id, value);
       if (value->header.type == GRN_UVECTOR && a->next) {
@@ -8186,6 +9278,9 @@ grn_obj_set_value_column_fix_size(grn_ctx *ctx, grn_obj *obj, grn_id id,
       rc = GRN_OPERATION_NOT_SUPPORTED;
       break;
     }
+    if (rc == GRN_SUCCESS) {
+      grn_ra_zone_map_update(ctx, (grn_ra *)obj, id, p);
+    }
     grn_ra_unref(ctx, (grn_ra *)obj, id);
   }
   GRN_OBJ_FIN(ctx, &buf);
@@ -11079,6 +12174,9 @@ grn_obj_rename(grn_ctx *ctx, grn_obj *obj, const char *name, unsigned int name_s
     grn_db *s = (grn_db *)ctx->impl->db;
     grn_obj *keys = (grn_obj *)s->keys;
     rc = grn_table_update_by_id(ctx, keys, DB_OBJ(obj)->id, name, name_size);
+    if (rc == GRN_SUCCESS) {
+      grn_db_increment_schema_generation(ctx->impl->db);
+    }
   }
   GRN_API_RETURN(rc);
 }
@@ -11204,6 +12302,8 @@ grn_obj_register(grn_ctx *ctx, grn_obj *db, const char *name, unsigned int name_
           "[object][register] already used name was assigned: <%.*s>",
           name_size, name);
       id = GRN_ID_NIL;
+    } else {
+      grn_db_increment_schema_generation(db);
     }
   } else if (ctx->impl && ctx->impl->values) {
     id = grn_array_add(ctx, ctx->impl->values, NULL) | GRN_OBJ_TMP_OBJECT;
@@ -11235,6 +12335,9 @@ grn_obj_delete_by_id(grn_ctx *ctx, grn_obj *db, grn_id id, grn_bool removep)
     } else {
       db_value *vp;
       grn_db *s = (grn_db *)db;
+      /* This is also called by grn_obj_close(). Cached expressions
+         refer the object by raw pointer. */
+      grn_db_increment_schema_generation(db);
       if ((vp = grn_tiny_array_at(&s->values, id))) {
         GRN_ASSERT(!vp->lock);
         vp->lock = 0;
@@ -11459,6 +12562,31 @@ grn_db_spec_unpack(grn_ctx *ctx,
   return GRN_TRUE;
 }
 
+/* Records the table read by the current cacheable command. */
+static grn_inline void
+grn_ctx_at_add_cache_dependency(grn_ctx *ctx, grn_obj *obj, grn_id id)
+{
+  grn_id table_id;
+
+  switch (obj->header.type) {
+  case GRN_TABLE_HASH_KEY :
+  case GRN_TABLE_PAT_KEY :
+  case GRN_TABLE_DAT_KEY :
+  case GRN_TABLE_NO_KEY :
+    table_id = id;
+    break;
+  case GRN_COLUMN_FIX_SIZE :
+  case GRN_COLUMN_VAR_SIZE :
+  case GRN_COLUMN_INDEX :
+    table_id = obj->header.domain;
+    break;
+  default :
+    return;
+  }
+
+  grn_table_ids_add(ctx, ctx->impl->cache_dependencies, table_id);
+}
+
 grn_obj *
 grn_ctx_at(grn_ctx *ctx, grn_id id)
 {
@@ -11692,6 +12820,9 @@ grn_ctx_at(grn_ctx *ctx, grn_id id)
       if (res && res->header.type == GRN_PROC) {
         grn_plugin_ensure_registered(ctx, res);
       }
+      if (res && ctx->impl->cache_dependencies) {
+        grn_ctx_at_add_cache_dependency(ctx, res, id);
+      }
     }
   }
 exit :
@@ -12296,6 +13427,10 @@ grn_column_name(grn_ctx *ctx, grn_obj *obj, char *namebuf, int buf_size)
         ADD_DELMITER();
         GRN_TEXT_PUTS(ctx, &name, GRN_COLUMN_NAME_AVG);
         break;
+      case GRN_ACCESSOR_GET_APPROX_DISTINCT :
+        ADD_DELMITER();
+        GRN_TEXT_PUTS(ctx, &name, GRN_COLUMN_NAME_APPROX_DISTINCT);
+        break;
       case GRN_ACCESSOR_GET_COLUMN_VALUE :
         ADD_DELMITER();
         {
@@ -12398,6 +13533,11 @@ grn_column_name_(grn_ctx *ctx, grn_obj *obj, grn_obj *buf)
                      GRN_COLUMN_NAME_AVG,
                      GRN_COLUMN_NAME_AVG_LEN);
         break;
+      case GRN_ACCESSOR_GET_APPROX_DISTINCT :
+        GRN_TEXT_PUT(ctx, buf,
+                     GRN_COLUMN_NAME_APPROX_DISTINCT,
+                     GRN_COLUMN_NAME_APPROX_DISTINCT_LEN);
+        break;
       case GRN_ACCESSOR_GET_COLUMN_VALUE :
         grn_column_name_(ctx, a->obj, buf);
         if (a->next) { GRN_TEXT_PUTC(ctx, buf, '.'); }
@@ -13770,6 +14910,611 @@ grn_table_sort_value(grn_ctx *ctx, grn_obj *table,
   }
 }
 
+/* A record for normalized sort. The fixed size normalized key follows
+ * this header. */
+typedef struct {
+  grn_id id;
+} sort_normalized_entry;
+
+#define SORT_NORMALIZED_ENTRY_KEY(entry)\
+  (((uint8_t *)(entry)) + sizeof(sort_normalized_entry))
+#define SORT_NORMALIZED_ENTRY_AT(data, entries, i)\
+  ((sort_normalized_entry *)((entries) + (size_t)((data)->entry_size) * (i)))
+
+typedef struct {
+  grn_table_sort_key *keys;
+  int n_keys;
+  grn_bool use_reference;
+  uint32_t text_prefix_size;
+  uint32_t *key_offsets;
+  uint32_t key_size;
+  uint32_t entry_size;
+  grn_ra_cache *ra_caches;
+  grn_bool have_truncated_key;
+  grn_obj a_buffer;
+  grn_obj b_buffer;
+  grn_obj batch_ids;
+  grn_obj batch_values;
+} sort_normalized_data;
+
+#define SORT_NORMALIZED_BATCH_SIZE 1024
+
+static uint32_t
+sort_normalized_key_size(sort_normalized_data *data, grn_table_sort_key *key)
+{
+  switch (key->offset) {
+  case KEY_BULK :
+    /* prefix + length byte */
+    return data->text_prefix_size + 1;
+  case KEY_INT8 :
+  case KEY_UINT8 :
+    return 1 + 1;
+  case KEY_INT16 :
+  case KEY_UINT16 :
+    return 1 + 2;
+  case KEY_ID :
+  case KEY_INT32 :
+  case KEY_UINT32 :
+  case KEY_FLOAT32 :
+    return 1 + 4;
+  default :
+    return 1 + 8;
+  }
+}
+
+static const unsigned char *
+sort_normalized_get_value(grn_ctx *ctx,
+                          sort_normalized_data *data,
+                          int i,
+                          grn_id id,
+                          grn_obj *buffer,
+                          grn_id *id_value,
+                          uint32_t *size)
+{
+  grn_table_sort_key *key = data->keys + i;
+  if (data->use_reference) {
+    const char *value;
+    if (key->key->header.type == GRN_COLUMN_FIX_SIZE) {
+      grn_ra *ra = (grn_ra *)(key->key);
+      value = grn_ra_ref_cache(ctx, ra, id, data->ra_caches + i);
+      *size = value ? ra->header->element_size : 0;
+      return (const unsigned char *)value;
+    }
+    value = grn_obj_get_value_(ctx, key->key, id, size);
+    if (key->offset == KEY_ID && *size == GRN_OBJ_GET_VALUE_IMD) {
+      *id_value = (grn_id)(uintptr_t)value;
+      *size = sizeof(grn_id);
+      return (const unsigned char *)id_value;
+    }
+    if (!value) {
+      *size = 0;
+    }
+    return (const unsigned char *)value;
+  } else {
+    GRN_BULK_REWIND(buffer);
+    grn_obj_get_value(ctx, key->key, id, buffer);
+    *size = GRN_BULK_VSIZE(buffer);
+    return (const unsigned char *)GRN_BULK_HEAD(buffer);
+  }
+}
+
+grn_inline static void
+sort_normalized_put_uint(uint8_t *output, uint64_t value, size_t size)
+{
+  size_t i;
+  for (i = size; i > 0; i--) {
+    output[i - 1] = value & 0xff;
+    value >>= 8;
+  }
+}
+
+/* Encodes a key value to a fixed size byte sequence. memcmp() orders
+ * encoded values as compare_reference()/compare_value() order raw
+ * values. Texts are encoded as a prefix and its length. It returns
+ * GRN_TRUE when the text is longer than the prefix. */
+static grn_bool
+sort_normalized_encode(grn_ctx *ctx,
+                       sort_normalized_data *data,
+                       grn_table_sort_key *key,
+                       const unsigned char *value,
+                       uint32_t value_size,
+                       uint8_t *output,
+                       uint32_t output_size)
+{
+  grn_bool truncated = GRN_FALSE;
+
+  if (key->offset == KEY_BULK) {
+    uint32_t prefix_size = data->text_prefix_size;
+    if (value_size > prefix_size) {
+      grn_memcpy(output, value, prefix_size);
+      output[prefix_size] = prefix_size + 1;
+      truncated = GRN_TRUE;
+    } else {
+      if (value_size > 0) {
+        grn_memcpy(output, value, value_size);
+      }
+      memset(output + value_size, 0, prefix_size - value_size);
+      output[prefix_size] = value_size;
+    }
+  } else if (value_size == 0) {
+    memset(output, 0, output_size);
+  } else {
+    uint8_t raw[8];
+    uint32_t raw_size = output_size - 1;
+    memset(raw, 0, sizeof(raw));
+    grn_memcpy(raw, value, value_size < raw_size ? value_size : raw_size);
+    output[0] = 1;
+    switch (key->offset) {
+    case KEY_INT8 :
+      sort_normalized_put_uint(output + 1, *((uint8_t *)raw) ^ 0x80, 1);
+      break;
+    case KEY_UINT8 :
+      sort_normalized_put_uint(output + 1, *((uint8_t *)raw), 1);
+      break;
+    case KEY_INT16 :
+      sort_normalized_put_uint(output + 1, *((uint16_t *)raw) ^ 0x8000, 2);
+      break;
+    case KEY_UINT16 :
+      sort_normalized_put_uint(output + 1, *((uint16_t *)raw), 2);
+      break;
+    case KEY_INT32 :
+      sort_normalized_put_uint(output + 1,
+                               *((uint32_t *)raw) ^ 0x80000000,
+                               4);
+      break;
+    case KEY_ID :
+    case KEY_UINT32 :
+      sort_normalized_put_uint(output + 1, *((uint32_t *)raw), 4);
+      break;
+    case KEY_INT64 :
+      sort_normalized_put_uint(output + 1,
+                               *((uint64_t *)raw) ^ (((uint64_t)1) << 63),
+                               8);
+      break;
+    case KEY_UINT64 :
+      sort_normalized_put_uint(output + 1, *((uint64_t *)raw), 8);
+      break;
+    case KEY_FLOAT32 :
+      {
+        float float_value = *((float *)raw);
+        uint32_t bits;
+        /* -0.0 == 0.0 */
+        if (float_value == 0.0) {
+          float_value = 0.0;
+        }
+        grn_memcpy(&bits, &float_value, sizeof(bits));
+        if (bits & 0x80000000) {
+          bits = ~bits;
+        } else {
+          bits |= 0x80000000;
+        }
+        sort_normalized_put_uint(output + 1, bits, 4);
+      }
+      break;
+    case KEY_FLOAT64 :
+      {
+        double float_value = *((double *)raw);
+        uint64_t bits;
+        /* -0.0 == 0.0 */
+        if (float_value == 0.0) {
+          float_value = 0.0;
+        }
+        grn_memcpy(&bits, &float_value, sizeof(bits));
+        if (bits & (((uint64_t)1) << 63)) {
+          bits = ~bits;
+        } else {
+          bits |= (((uint64_t)1) << 63);
+        }
+        sort_normalized_put_uint(output + 1, bits, 8);
+      }
+      break;
+    }
+  }
+
+  if (key->flags & GRN_TABLE_SORT_DESC) {
+    uint32_t i;
+    for (i = 0; i < output_size; i++) {
+      output[i] = ~output[i];
+    }
+  }
+
+  return truncated;
+}
+
+static void
+sort_normalized_encode_keys(grn_ctx *ctx,
+                            sort_normalized_data *data,
+                            sort_normalized_entry *entry,
+                            int start,
+                            int end)
+{
+  uint8_t *entry_key = SORT_NORMALIZED_ENTRY_KEY(entry);
+  int i;
+  for (i = start; i < end; i++) {
+    const unsigned char *value;
+    uint32_t value_size;
+    grn_id id_value;
+    value = sort_normalized_get_value(ctx, data, i, entry->id,
+                                      &(data->a_buffer),
+                                      &id_value, &value_size);
+    if (sort_normalized_encode(ctx, data, data->keys + i,
+                               value, value_size,
+                               entry_key + data->key_offsets[i],
+                               data->key_offsets[i + 1] -
+                               data->key_offsets[i])) {
+      data->have_truncated_key = GRN_TRUE;
+    }
+  }
+}
+
+/* Encodes the ith key of n entries. Values of a fixed size column
+ * are read by grn_column_get_values_batch() for each batch of entries
+ * instead of referring a value for each entry. */
+static void
+sort_normalized_encode_key_batch(grn_ctx *ctx,
+                                 sort_normalized_data *data,
+                                 uint8_t *entries,
+                                 int n,
+                                 int i)
+{
+  grn_table_sort_key *key = data->keys + i;
+  uint32_t element_size;
+  int offset;
+
+  if (!(data->use_reference &&
+        key->key->header.type == GRN_COLUMN_FIX_SIZE)) {
+    int j;
+    for (j = 0; j < n; j++) {
+      sort_normalized_entry *entry = SORT_NORMALIZED_ENTRY_AT(data, entries, j);
+      sort_normalized_encode_keys(ctx, data, entry, i, i + 1);
+    }
+    return;
+  }
+
+  element_size = ((grn_ra *)(key->key))->header->element_size;
+  for (offset = 0; offset < n; offset += SORT_NORMALIZED_BATCH_SIZE) {
+    int n_batch_entries = n - offset;
+    const unsigned char *values;
+    int j;
+
+    if (n_batch_entries > SORT_NORMALIZED_BATCH_SIZE) {
+      n_batch_entries = SORT_NORMALIZED_BATCH_SIZE;
+    }
+    GRN_BULK_REWIND(&(data->batch_ids));
+    for (j = 0; j < n_batch_entries; j++) {
+      sort_normalized_entry *entry =
+        SORT_NORMALIZED_ENTRY_AT(data, entries, offset + j);
+      GRN_RECORD_PUT(ctx, &(data->batch_ids), entry->id);
+    }
+    grn_column_get_values_batch(ctx,
+                                key->key,
+                                (grn_id *)GRN_BULK_HEAD(&(data->batch_ids)),
+                                n_batch_entries,
+                                &(data->batch_values));
+    if (ctx->rc != GRN_SUCCESS) {
+      break;
+    }
+    values = (const unsigned char *)GRN_BULK_HEAD(&(data->batch_values));
+    for (j = 0; j < n_batch_entries; j++) {
+      sort_normalized_entry *entry =
+        SORT_NORMALIZED_ENTRY_AT(data, entries, offset + j);
+      uint8_t *entry_key = SORT_NORMALIZED_ENTRY_KEY(entry);
+      if (sort_normalized_encode(ctx, data, key,
+                                 values + (size_t)element_size * j,
+                                 element_size,
+                                 entry_key + data->key_offsets[i],
+                                 data->key_offsets[i + 1] -
+                                 data->key_offsets[i])) {
+        data->have_truncated_key = GRN_TRUE;
+      }
+    }
+  }
+}
+
+grn_inline static grn_bool
+sort_normalized_is_truncated(sort_normalized_data *data,
+                             int i,
+                             const uint8_t *entry_key)
+{
+  uint8_t length = entry_key[data->key_offsets[i] + data->text_prefix_size];
+  if (data->keys[i].flags & GRN_TABLE_SORT_DESC) {
+    length = ~length;
+  }
+  return length == data->text_prefix_size + 1;
+}
+
+static int
+sort_normalized_compare_text(grn_ctx *ctx,
+                             sort_normalized_data *data,
+                             int i,
+                             sort_normalized_entry *a,
+                             sort_normalized_entry *b)
+{
+  grn_table_sort_key *key = data->keys + i;
+  const unsigned char *ap, *bp;
+  uint32_t as, bs;
+  grn_id a_id_value, b_id_value;
+  int result = 0;
+
+  ap = sort_normalized_get_value(ctx, data, i, a->id, &(data->a_buffer),
+                                 &a_id_value, &as);
+  bp = sort_normalized_get_value(ctx, data, i, b->id, &(data->b_buffer),
+                                 &b_id_value, &bs);
+  for (;; ap++, bp++, as--, bs--) {
+    if (!as) { result = bs ? -1 : 0; break; }
+    if (!bs) { result = 1; break; }
+    if (*ap < *bp) { result = -1; break; }
+    if (*ap > *bp) { result = 1; break; }
+  }
+  if (key->flags & GRN_TABLE_SORT_DESC) {
+    result = -result;
+  }
+  return result;
+}
+
+/* It returns 0 for records that have the same keys like
+ * compare_reference() and compare_value(). */
+static int
+sort_normalized_compare(grn_ctx *ctx,
+                        sort_normalized_data *data,
+                        sort_normalized_entry *a,
+                        sort_normalized_entry *b)
+{
+  const uint8_t *a_key = SORT_NORMALIZED_ENTRY_KEY(a);
+  const uint8_t *b_key = SORT_NORMALIZED_ENTRY_KEY(b);
+  int result;
+
+  if (data->have_truncated_key) {
+    int i;
+    for (i = 0; i < data->n_keys; i++) {
+      uint32_t offset = data->key_offsets[i];
+      result = memcmp(a_key + offset,
+                      b_key + offset,
+                      data->key_offsets[i + 1] - offset);
+      if (result != 0) {
+        return result;
+      }
+      if (data->keys[i].offset == KEY_BULK &&
+          sort_normalized_is_truncated(data, i, a_key)) {
+        result = sort_normalized_compare_text(ctx, data, i, a, b);
+        if (result != 0) {
+          return result;
+        }
+      }
+    }
+  } else {
+    result = memcmp(a_key, b_key, data->key_size);
+    if (result != 0) {
+      return result;
+    }
+  }
+
+  return 0;
+}
+
+/* The following functions sort entries in the same way as
+ * sort_reference() and sort_value(). So records that have the same
+ * keys are returned in the same order as the previous
+ * implementation. */
+grn_inline static void
+sort_normalized_swap(sort_normalized_entry **a, sort_normalized_entry **b)
+{
+  sort_normalized_entry *c_ = *a;
+  *a = *b;
+  *b = c_;
+}
+
+grn_inline static sort_normalized_entry **
+sort_normalized_part(grn_ctx *ctx,
+                     sort_normalized_data *data,
+                     sort_normalized_entry **b,
+                     sort_normalized_entry **e)
+{
+  sort_normalized_entry **c;
+  intptr_t d = e - b;
+  if (sort_normalized_compare(ctx, data, *b, *e) > 0) {
+    sort_normalized_swap(b, e);
+  }
+  if (d < 2) { return NULL; }
+  c = b + (d >> 1);
+  if (sort_normalized_compare(ctx, data, *b, *c) > 0) {
+    sort_normalized_swap(b, c);
+  } else {
+    if (sort_normalized_compare(ctx, data, *c, *e) > 0) {
+      sort_normalized_swap(c, e);
+    }
+  }
+  if (d < 3) { return NULL; }
+  b++;
+  sort_normalized_swap(b, c);
+  c = b;
+  for (;;) {
+    do {
+      b++;
+    } while (sort_normalized_compare(ctx, data, *c, *b) > 0);
+    do {
+      e--;
+    } while (sort_normalized_compare(ctx, data, *e, *c) > 0);
+    if (b >= e) { break; }
+    sort_normalized_swap(b, e);
+  }
+  sort_normalized_swap(c, e);
+  return e;
+}
+
+static void
+sort_normalized_sort(grn_ctx *ctx,
+                     sort_normalized_data *data,
+                     sort_normalized_entry **head,
+                     sort_normalized_entry **tail,
+                     int from, int to)
+{
+  sort_normalized_entry **c;
+  if (head < tail && (c = sort_normalized_part(ctx, data, head, tail))) {
+    intptr_t m = c - head + 1;
+    if (from < m - 1) {
+      sort_normalized_sort(ctx, data, head, c - 1, from, to);
+    }
+    if (m < to) {
+      sort_normalized_sort(ctx, data, c + 1, tail, from - m, to - m);
+    }
+  }
+}
+
+/* Puts entries that are smaller than the first entry from head and the
+ * others from tail. It returns the position of the first entry. */
+static sort_normalized_entry **
+sort_normalized_pack(grn_ctx *ctx,
+                     sort_normalized_data *data,
+                     uint8_t *entries,
+                     int n,
+                     sort_normalized_entry **head,
+                     sort_normalized_entry **tail)
+{
+  sort_normalized_entry *c = SORT_NORMALIZED_ENTRY_AT(data, entries, 0);
+  int i;
+  for (i = 1; i < n; i++) {
+    sort_normalized_entry *e = SORT_NORMALIZED_ENTRY_AT(data, entries, i);
+    if (sort_normalized_compare(ctx, data, c, e) > 0) {
+      *head++ = e;
+    } else {
+      *tail-- = e;
+    }
+  }
+  *head = c;
+  return n > 2 ? head : NULL;
+}
+
+static int
+grn_table_sort_normalized(grn_ctx *ctx, grn_obj *table,
+                          int offset, int limit,
+                          grn_obj *result,
+                          grn_table_sort_key *keys, int n_keys,
+                          grn_bool use_reference)
+{
+  int e, n;
+  int i;
+  int n_results = 0;
+  int n_entries = 0;
+  sort_normalized_data data;
+  uint8_t *entries = NULL;
+  sort_normalized_entry **pointers = NULL;
+
+  e = offset + limit;
+  n = grn_table_size(ctx, table);
+  if (e > n) {
+    e = n;
+  }
+  if (offset >= e) {
+    return 0;
+  }
+
+  data.keys = keys;
+  data.n_keys = n_keys;
+  data.use_reference = use_reference;
+  data.text_prefix_size = grn_table_sort_text_prefix_size;
+  data.have_truncated_key = GRN_FALSE;
+  GRN_TEXT_INIT(&(data.a_buffer), 0);
+  GRN_TEXT_INIT(&(data.b_buffer), 0);
+  GRN_RECORD_INIT(&(data.batch_ids), GRN_OBJ_VECTOR, GRN_ID_NIL);
+  GRN_VOID_INIT(&(data.batch_values));
+  data.key_offsets = NULL;
+  data.ra_caches = GRN_MALLOCN(grn_ra_cache, n_keys);
+  if (!data.ra_caches) {
+    goto exit;
+  }
+  for (i = 0; i < n_keys; i++) {
+    GRN_RA_CACHE_INIT((grn_ra *)(keys[i].key), data.ra_caches + i);
+  }
+  data.key_offsets = GRN_MALLOCN(uint32_t, n_keys + 1);
+  if (!data.key_offsets) {
+    goto exit;
+  }
+  data.key_size = 0;
+  for (i = 0; i < n_keys; i++) {
+    data.key_offsets[i] = data.key_size;
+    data.key_size += sort_normalized_key_size(&data, keys + i);
+  }
+  data.key_offsets[n_keys] = data.key_size;
+  data.entry_size = sizeof(sort_normalized_entry) + data.key_size;
+  data.entry_size =
+    (data.entry_size + sizeof(uint32_t) - 1) / sizeof(uint32_t) *
+    sizeof(uint32_t);
+  entries = GRN_MALLOC((size_t)(data.entry_size) * n);
+  pointers = GRN_MALLOCN(sort_normalized_entry *, n);
+  if (!entries || !pointers) {
+    goto exit;
+  }
+  {
+    grn_table_cursor *tc;
+    grn_id id;
+    tc = grn_table_cursor_open(ctx, table, NULL, 0, NULL, 0, 0, -1, 0);
+    if (!tc) {
+      goto exit;
+    }
+    while (n_entries < n && (id = grn_table_cursor_next_inline(ctx, tc))) {
+      SORT_NORMALIZED_ENTRY_AT(&data, entries, n_entries)->id = id;
+      n_entries++;
+    }
+    grn_table_cursor_close(ctx, tc);
+  }
+  if (n_entries == 0) {
+    goto exit;
+  }
+  for (i = 0; i < n_keys; i++) {
+    sort_normalized_encode_key_batch(ctx, &data, entries, n_entries, i);
+    if (ctx->rc != GRN_SUCCESS) {
+      goto exit;
+    }
+  }
+
+  {
+    sort_normalized_entry **ep;
+    ep = sort_normalized_pack(ctx, &data, entries, n_entries,
+                              pointers, pointers + n_entries - 1);
+    if (ep) {
+      intptr_t m = ep - pointers + 1;
+      if (offset < m - 1) {
+        sort_normalized_sort(ctx, &data, pointers, ep - 1, offset, e);
+      }
+      if (m < e) {
+        sort_normalized_sort(ctx, &data, ep + 1, pointers + n_entries - 1,
+                             offset - m, e - m);
+      }
+    }
+  }
+  for (i = offset; i < e && i < n_entries; i++) {
+    grn_id *v;
+    if (!grn_array_add(ctx, (grn_array *)result, (void **)&v)) { break; }
+    *v = pointers[i]->id;
+    n_results++;
+  }
+
+exit :
+  if (pointers) {
+    GRN_FREE(pointers);
+  }
+  if (entries) {
+    GRN_FREE(entries);
+  }
+  if (data.ra_caches) {
+    for (i = 0; i < n_keys; i++) {
+      if (keys[i].key->header.type == GRN_COLUMN_FIX_SIZE) {
+        GRN_RA_CACHE_FIN((grn_ra *)(keys[i].key), data.ra_caches + i);
+      }
+    }
+    GRN_FREE(data.ra_caches);
+  }
+  if (data.key_offsets) {
+    GRN_FREE(data.key_offsets);
+  }
+  GRN_OBJ_FIN(ctx, &(data.a_buffer));
+  GRN_OBJ_FIN(ctx, &(data.b_buffer));
+  GRN_OBJ_FIN(ctx, &(data.batch_ids));
+  GRN_OBJ_FIN(ctx, &(data.batch_values));
+  return n_results;
+}
+
 static grn_bool
 is_compressed_column(grn_ctx *ctx, grn_obj *obj)
 {
@@ -14041,11 +15786,19 @@ grn_table_sort(grn_ctx *ctx, grn_obj *table, int offset, int limit,
         }
       }
     }
-    if (have_compressed_column ||
-        have_sub_record_accessor ||
-        have_encoded_pat_key_accessor ||
-        have_index_value_get ||
-        have_score) {
+    if (grn_table_sort_normalize_enable) {
+      grn_bool use_reference = !(have_compressed_column ||
+                                 have_sub_record_accessor ||
+                                 have_encoded_pat_key_accessor ||
+                                 have_index_value_get ||
+                                 have_score);
+      i = grn_table_sort_normalized(ctx, table, offset, limit, result,
+                                    keys, n_keys, use_reference);
+    } else if (have_compressed_column ||
+               have_sub_record_accessor ||
+               have_encoded_pat_key_accessor ||
+               have_index_value_get ||
+               have_score) {
       i = grn_table_sort_value(ctx, table, offset, limit, result,
                                keys, n_keys);
     } else {
@@ -15584,6 +17337,10 @@ grn_db_unmap(grn_ctx *ctx, grn_obj *db)
     }
   });
 
+  /* Cached expressions refer the closed objects. */
+  grn_db_increment_schema_generation(db);
+  grn_expr_cache_clear(ctx, s->expr_cache);
+
   GRN_API_RETURN(ctx->rc);
 }
 
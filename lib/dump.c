@@ -93,6 +93,9 @@ grn_dump_column_create_flags(grn_ctx *ctx,
     if (flags & GRN_OBJ_INDEX_LARGE) {
       GRN_TEXT_PUTS(ctx, buffer, "|INDEX_LARGE");
     }
+    if (flags & GRN_OBJ_WITH_DOCUMENT_LENGTH) {
+      GRN_TEXT_PUTS(ctx, buffer, "|WITH_DOCUMENT_LENGTH");
+    }
     break;
   }
   switch (flags & GRN_OBJ_COMPRESS_MASK) {
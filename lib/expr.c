@@ -27,6 +27,7 @@
 #include "grn_ii.h"
 #include "grn_geo.h"
 #include "grn_expr.h"
+#include "grn_expr_cache.h"
 #include "grn_expr_code.h"
 #include "grn_expr_executor.h"
 #include "grn_scanner.h"
@@ -41,6 +42,9 @@ static int grn_table_select_max_n_enough_filtered_records = 1000;
 static grn_bool grn_table_select_and_min_skip_enable = GRN_TRUE;
 static grn_bool grn_scan_info_regexp_dot_asterisk_enable = GRN_TRUE;
 static grn_bool grn_query_log_show_condition = GRN_TRUE;
+static int grn_table_select_sequential_batch_size = 1024;
+static uint32_t grn_table_select_n_workers = 1;
+static uint32_t grn_table_select_first_n_min_window_size = 64;
 
 void
 grn_expr_init_from_env(void)
@@ -102,6 +106,51 @@ grn_expr_init_from_env(void)
       grn_query_log_show_condition = GRN_TRUE;
     }
   }
+
+  {
+    char grn_table_select_sequential_batch_size_env[GRN_ENV_BUFFER_SIZE];
+    grn_getenv("GRN_TABLE_SELECT_SEQUENTIAL_BATCH_SIZE",
+               grn_table_select_sequential_batch_size_env,
+               GRN_ENV_BUFFER_SIZE);
+    if (grn_table_select_sequential_batch_size_env[0]) {
+      grn_table_select_sequential_batch_size =
+        atoi(grn_table_select_sequential_batch_size_env);
+    }
+  }
+
+  {
+    char grn_table_select_n_workers_env[GRN_ENV_BUFFER_SIZE];
+    grn_getenv("GRN_TABLE_SELECT_N_WORKERS",
+               grn_table_select_n_workers_env,
+               GRN_ENV_BUFFER_SIZE);
+    if (grn_table_select_n_workers_env[0]) {
+      grn_table_select_n_workers =
+        grn_atoui(grn_table_select_n_workers_env,
+                  grn_table_select_n_workers_env +
+                  strlen(grn_table_select_n_workers_env),
+                  NULL);
+      if (grn_table_select_n_workers == 0) {
+        grn_table_select_n_workers = 1;
+      }
+    }
+  }
+
+  {
+    char grn_table_select_first_n_min_window_size_env[GRN_ENV_BUFFER_SIZE];
+    grn_getenv("GRN_TABLE_SELECT_FIRST_N_MIN_WINDOW_SIZE",
+               grn_table_select_first_n_min_window_size_env,
+               GRN_ENV_BUFFER_SIZE);
+    if (grn_table_select_first_n_min_window_size_env[0]) {
+      grn_table_select_first_n_min_window_size =
+        grn_atoui(grn_table_select_first_n_min_window_size_env,
+                  grn_table_select_first_n_min_window_size_env +
+                  strlen(grn_table_select_first_n_min_window_size_env),
+                  NULL);
+      if (grn_table_select_first_n_min_window_size == 0) {
+        grn_table_select_first_n_min_window_size = 1;
+      }
+    }
+  }
 }
 
 grn_obj *
@@ -556,13 +605,6 @@ grn_expr_take_obj(grn_ctx *ctx, grn_obj *expr, grn_obj *obj)
   GRN_PTR_PUT(ctx, &(e->objs), obj);
 }
 
-/* data flow info */
-typedef struct {
-  grn_expr_code *code;
-  grn_id domain;
-  unsigned char type;
-} grn_expr_dfi;
-
 static grn_expr_dfi *
 grn_expr_dfi_pop(grn_expr *expr)
 {
@@ -897,7 +939,7 @@ grn_expr_get_var_by_offset(grn_ctx *ctx, grn_obj *expr, unsigned int offset)
   grn_expr_dfi_put(ctx, e, type, domain, code);                 \
 } while (0)
 
-static void
+void
 grn_expr_append_obj_resolve_const(grn_ctx *ctx,
                                   grn_obj *obj,
                                   grn_id to_domain)
@@ -912,6 +954,46 @@ grn_expr_append_obj_resolve_const(grn_ctx *ctx,
   GRN_OBJ_FIN(ctx, &dest);
 }
 
+grn_rc
+grn_expr_reserve_codes(grn_ctx *ctx, grn_obj *expr, uint32_t n_codes)
+{
+  grn_expr *e = (grn_expr *)expr;
+  grn_expr_dfi *dfis;
+  size_t i, n_dfis;
+  uint32_t new_codes_size;
+  grn_expr_code *new_codes;
+
+  if (e->codes_curr + n_codes <= e->codes_size) {
+    return GRN_SUCCESS;
+  }
+
+  new_codes_size = e->codes_size * 2;
+  while (new_codes_size < e->codes_curr + n_codes) {
+    new_codes_size *= 2;
+  }
+  new_codes = (grn_expr_code *)GRN_MALLOC(sizeof(grn_expr_code) *
+                                          new_codes_size);
+  if (!new_codes) {
+    ERR(GRN_NO_MEMORY_AVAILABLE, "stack is full");
+    return ctx->rc;
+  }
+  grn_memcpy(new_codes, e->codes, sizeof(grn_expr_code) * e->codes_size);
+  if (e->code0 >= e->codes && e->code0 < e->codes + e->codes_size) {
+    e->code0 = new_codes + (e->code0 - e->codes);
+  }
+  dfis = (grn_expr_dfi *)GRN_BULK_HEAD(&e->dfi);
+  n_dfis = GRN_BULK_VSIZE(&e->dfi) / sizeof(grn_expr_dfi);
+  for (i = 0; i < n_dfis; i++) {
+    if (dfis[i].code >= e->codes && dfis[i].code < e->codes + e->codes_size) {
+      dfis[i].code = new_codes + (dfis[i].code - e->codes);
+    }
+  }
+  GRN_FREE(e->codes);
+  e->codes = new_codes;
+  e->codes_size = new_codes_size;
+  return GRN_SUCCESS;
+}
+
 grn_obj *
 grn_expr_append_obj(grn_ctx *ctx, grn_obj *expr, grn_obj *obj, grn_operator op, int nargs)
 {
@@ -922,28 +1004,8 @@ grn_expr_append_obj(grn_ctx *ctx, grn_obj *expr, grn_obj *obj, grn_operator op,
   grn_obj *res = NULL;
   grn_expr *e = (grn_expr *)expr;
   GRN_API_ENTER;
-  if (e->codes_curr >= e->codes_size) {
-    grn_expr_dfi *dfis = (grn_expr_dfi *)GRN_BULK_HEAD(&e->dfi);
-    size_t i, n_dfis = GRN_BULK_VSIZE(&e->dfi) / sizeof(grn_expr_dfi);
-    uint32_t new_codes_size = e->codes_size * 2;
-    size_t n_bytes = sizeof(grn_expr_code) * new_codes_size;
-    grn_expr_code *new_codes = (grn_expr_code *)GRN_MALLOC(n_bytes);
-    if (!new_codes) {
-      ERR(GRN_NO_MEMORY_AVAILABLE, "stack is full");
-      goto exit;
-    }
-    grn_memcpy(new_codes, e->codes, sizeof(grn_expr_code) * e->codes_size);
-    if (e->code0 >= e->codes && e->code0 < e->codes + e->codes_size) {
-      e->code0 = new_codes + (e->code0 - e->codes);
-    }
-    for (i = 0; i < n_dfis; i++) {
-      if (dfis[i].code >= e->codes && dfis[i].code < e->codes + e->codes_size) {
-        dfis[i].code = new_codes + (dfis[i].code - e->codes);
-      }
-    }
-    GRN_FREE(e->codes);
-    e->codes = new_codes;
-    e->codes_size = new_codes_size;
+  if (grn_expr_reserve_codes(ctx, expr, 1) != GRN_SUCCESS) {
+    goto exit;
   }
   {
     switch (op) {
@@ -3517,114 +3579,796 @@ typedef struct {
   grn_bool is_first_unskipped_scan_info;
 } grn_table_select_data;
 
+/* grn_expr_executor evaluates comparisons with an integer constant that
+ * is out of range of the integer column type without the column
+ * values. */
+static grn_bool
+grn_table_select_sequential_zone_filter_is_in_range(grn_ctx *ctx,
+                                                    grn_obj *value,
+                                                    grn_id range)
+{
+  grn_id domain = value->header.domain;
+  grn_bool is_negative = GRN_FALSE;
+  uint64_t absolute_value = 0;
+  uint64_t max = 0;
+
+  if (!(GRN_DB_INT8 <= domain && domain <= GRN_DB_UINT64)) {
+    return GRN_TRUE;
+  }
+  if (!(GRN_DB_INT8 <= range && range <= GRN_DB_UINT64)) {
+    return GRN_TRUE;
+  }
+
+#define CASE_INT(N)                                                     \
+  GRN_DB_INT ## N :                                                     \
+    {                                                                   \
+      int64_t int_value = GRN_INT ## N ## _VALUE(value);                \
+      is_negative = (int_value < 0);                                    \
+      absolute_value = is_negative ?                                    \
+        (uint64_t)(-(int_value + 1)) + 1 :                              \
+        (uint64_t)int_value;                                            \
+    }                                                                   \
+    break
+#define CASE_UINT(N)                                                    \
+  GRN_DB_UINT ## N :                                                    \
+    absolute_value = GRN_UINT ## N ## _VALUE(value);                    \
+    break
+
+  switch (domain) {
+  case CASE_INT(8);
+  case CASE_UINT(8);
+  case CASE_INT(16);
+  case CASE_UINT(16);
+  case CASE_INT(32);
+  case CASE_UINT(32);
+  case CASE_INT(64);
+  case CASE_UINT(64);
+  default :
+    return GRN_FALSE;
+  }
+
+#undef CASE_INT
+#undef CASE_UINT
+
+#define CASE_INT(N)                                                     \
+  GRN_DB_INT ## N :                                                     \
+    if (is_negative) {                                                  \
+      max = (uint64_t)INT ## N ## _MAX + 1;                             \
+    } else {                                                            \
+      max = INT ## N ## _MAX;                                           \
+    }                                                                   \
+    break
+#define CASE_UINT(N)                                                    \
+  GRN_DB_UINT ## N :                                                    \
+    if (is_negative) {                                                  \
+      return GRN_FALSE;                                                 \
+    }                                                                   \
+    max = UINT ## N ## _MAX;                                            \
+    break
+
+  switch (range) {
+  case CASE_INT(8);
+  case CASE_UINT(8);
+  case CASE_INT(16);
+  case CASE_UINT(16);
+  case CASE_INT(32);
+  case CASE_UINT(32);
+  case CASE_INT(64);
+  case CASE_UINT(64);
+  default :
+    return GRN_FALSE;
+  }
+
+#undef CASE_INT
+#undef CASE_UINT
+
+  return absolute_value <= max;
+}
+
+/* Initializes zone_filter when expr is "column OP constant" such as
+ * "price > 100" for a numeric fixed size column of table. Records in
+ * zones that can't have a matched value aren't evaluated. */
+static grn_bool
+grn_table_select_sequential_zone_filter_init(grn_ctx *ctx,
+                                             grn_obj *table,
+                                             grn_obj *expr,
+                                             grn_ra_zone_filter *zone_filter)
+{
+  grn_expr *e = (grn_expr *)expr;
+  grn_obj *column;
+  grn_obj *value;
+  grn_operator op;
+  grn_obj *min = NULL;
+  grn_bool min_include = GRN_FALSE;
+  grn_obj *max = NULL;
+  grn_bool max_include = GRN_FALSE;
+  grn_bool reversed = GRN_FALSE;
+  grn_obj casted_value;
+  grn_bool initialized;
+
+  if (e->codes_curr != 3 || e->codes[2].nargs != 2) {
+    return GRN_FALSE;
+  }
+  op = e->codes[2].op;
+  if (e->codes[0].op == GRN_OP_GET_VALUE && e->codes[1].op == GRN_OP_PUSH) {
+    column = e->codes[0].value;
+    value = e->codes[1].value;
+  } else if (e->codes[0].op == GRN_OP_PUSH &&
+             e->codes[1].op == GRN_OP_GET_VALUE) {
+    value = e->codes[0].value;
+    column = e->codes[1].value;
+    reversed = GRN_TRUE;
+    switch (op) {
+    case GRN_OP_LESS :
+      op = GRN_OP_GREATER;
+      break;
+    case GRN_OP_GREATER :
+      op = GRN_OP_LESS;
+      break;
+    case GRN_OP_LESS_EQUAL :
+      op = GRN_OP_GREATER_EQUAL;
+      break;
+    case GRN_OP_GREATER_EQUAL :
+      op = GRN_OP_LESS_EQUAL;
+      break;
+    default :
+      break;
+    }
+  } else {
+    return GRN_FALSE;
+  }
+  if (!column || column->header.type != GRN_COLUMN_FIX_SIZE) {
+    return GRN_FALSE;
+  }
+  if (column->header.domain != DB_OBJ(table)->id) {
+    return GRN_FALSE;
+  }
+  if (!value || value->header.type != GRN_BULK) {
+    return GRN_FALSE;
+  }
+
+  /* "column OP constant" is evaluated with the constant casted to the
+   * column type by grn_expr_executor. Other forms are used only when no
+   * cast is needed. */
+  GRN_VOID_INIT(&casted_value);
+  if (value->header.domain != DB_OBJ(column)->range) {
+    if (reversed) {
+      return GRN_FALSE;
+    }
+    if (!grn_table_select_sequential_zone_filter_is_in_range(
+          ctx, value, DB_OBJ(column)->range)) {
+      return GRN_FALSE;
+    }
+    grn_obj_reinit_for(ctx, &casted_value, column);
+    if (grn_obj_cast(ctx, value, &casted_value, GRN_FALSE) != GRN_SUCCESS) {
+      GRN_OBJ_FIN(ctx, &casted_value);
+      return GRN_FALSE;
+    }
+    value = &casted_value;
+  }
+
+  switch (op) {
+  case GRN_OP_EQUAL :
+    /* Float values are compared with DBL_EPSILON. */
+    if (DB_OBJ(column)->range == GRN_DB_FLOAT) {
+      GRN_OBJ_FIN(ctx, &casted_value);
+      return GRN_FALSE;
+    }
+    min = value;
+    min_include = GRN_TRUE;
+    max = value;
+    max_include = GRN_TRUE;
+    break;
+  case GRN_OP_LESS :
+    max = value;
+    break;
+  case GRN_OP_LESS_EQUAL :
+    max = value;
+    max_include = GRN_TRUE;
+    break;
+  case GRN_OP_GREATER :
+    min = value;
+    break;
+  case GRN_OP_GREATER_EQUAL :
+    min = value;
+    min_include = GRN_TRUE;
+    break;
+  default :
+    GRN_OBJ_FIN(ctx, &casted_value);
+    return GRN_FALSE;
+  }
+
+  initialized = grn_ra_zone_filter_init(ctx,
+                                        zone_filter,
+                                        (grn_ra *)column,
+                                        table,
+                                        min,
+                                        min_include,
+                                        max,
+                                        max_include);
+  GRN_OBJ_FIN(ctx, &casted_value);
+  return initialized;
+}
+
+static grn_inline grn_bool
+grn_table_select_sequential_is_skipped(grn_ra_zone_filter *zone_filter,
+                                       grn_id id)
+{
+  return zone_filter && !grn_ra_zone_filter_may_match(zone_filter, id);
+}
+
 static void
-grn_table_select_sequential(grn_ctx *ctx, grn_obj *table, grn_obj *expr,
-                            grn_obj *v, grn_obj *res, grn_operator op)
+grn_table_select_sequential_batch_apply(grn_ctx *ctx,
+                                        grn_obj *res,
+                                        grn_operator op,
+                                        grn_id *record_ids,
+                                        grn_id *entry_ids,
+                                        grn_bool *results,
+                                        size_t n_ids)
 {
-  grn_obj *result;
-  grn_obj score_buffer;
-  int32_t score;
-  grn_id id, *idp;
-  grn_table_cursor *tc;
-  grn_hash_cursor *hc;
   grn_hash *s = (grn_hash *)res;
-  grn_expr_executor executor;
+  size_t i;
 
-  grn_expr_executor_init(ctx, &executor, expr);
-  if (ctx->rc != GRN_SUCCESS) {
+  for (i = 0; i < n_ids; i++) {
+    grn_rset_recinfo *ri;
+    uint32_t value_size;
+
+    switch (op) {
+    case GRN_OP_OR :
+      if (results[i]) {
+        if (grn_hash_add(ctx, s, &(record_ids[i]), s->key_size,
+                         (void **)&ri, NULL)) {
+          grn_table_add_subrec(res, ri, 1,
+                               (grn_rset_posinfo *)&(record_ids[i]), 1);
+        }
+      }
+      break;
+    case GRN_OP_AND :
+      if (results[i]) {
+        ri = (grn_rset_recinfo *)grn_hash_get_value_(ctx, s, entry_ids[i],
+                                                     &value_size);
+        grn_table_add_subrec(res, ri, 1,
+                             (grn_rset_posinfo *)&(record_ids[i]), 1);
+      } else {
+        grn_hash_delete_by_id(ctx, s, entry_ids[i], NULL);
+      }
+      break;
+    case GRN_OP_AND_NOT :
+      if (results[i]) {
+        grn_hash_delete_by_id(ctx, s, entry_ids[i], NULL);
+      }
+      break;
+    case GRN_OP_ADJUST :
+      if (results[i]) {
+        ri = (grn_rset_recinfo *)grn_hash_get_value_(ctx, s, entry_ids[i],
+                                                     &value_size);
+        grn_table_add_subrec(res, ri, 1,
+                             (grn_rset_posinfo *)&(record_ids[i]), 1);
+      }
+      break;
+    default :
+      break;
+    }
+  }
+}
+
+static void
+grn_table_select_sequential_batch_flush(grn_ctx *ctx,
+                                        grn_expr_executor *executor,
+                                        grn_obj *res,
+                                        grn_operator op,
+                                        grn_id *record_ids,
+                                        grn_id *entry_ids,
+                                        grn_bool *results,
+                                        size_t n_ids)
+{
+  if (n_ids == 0) {
     return;
   }
-  GRN_INT32_INIT(&score_buffer, 0);
+
+  grn_expr_executor_exec_batch(ctx, executor, record_ids, n_ids, results);
+  if (ctx->rc) {
+    return;
+  }
+
+  grn_table_select_sequential_batch_apply(ctx, res, op,
+                                          record_ids, entry_ids,
+                                          results, n_ids);
+}
+
+/* Evaluates the expression for grn_table_select_sequential_batch_size
+ * records at once. It's used only when the expression is a condition
+ * that has a batch implementation. Matched records get score 1 like
+ * grn_table_select_sequential(). */
+static void
+grn_table_select_sequential_batch(grn_ctx *ctx, grn_obj *table,
+                                  grn_expr_executor *executor,
+                                  grn_obj *res, grn_operator op,
+                                  grn_ra_zone_filter *zone_filter)
+{
+  grn_hash *s = (grn_hash *)res;
+  size_t batch_size = grn_table_select_sequential_batch_size;
+  grn_id *record_ids;
+  grn_id *entry_ids;
+  grn_bool *results;
+  size_t n_ids = 0;
+
+  record_ids = GRN_MALLOC(sizeof(grn_id) * batch_size * 2 +
+                          sizeof(grn_bool) * batch_size);
+  if (!record_ids) {
+    return;
+  }
+  entry_ids = record_ids + batch_size;
+  results = (grn_bool *)(entry_ids + batch_size);
+
   switch (op) {
   case GRN_OP_OR :
-    if ((tc = grn_table_cursor_open(ctx, table, NULL, 0, NULL, 0, 0, -1, 0))) {
+    {
+      grn_table_cursor *tc;
+      grn_id id;
+      tc = grn_table_cursor_open(ctx, table, NULL, 0, NULL, 0, 0, -1, 0);
+      if (!tc) {
+        break;
+      }
       while ((id = grn_table_cursor_next(ctx, tc))) {
-        result = grn_expr_executor_exec(ctx, &executor, id);
-        if (ctx->rc) {
-          break;
+        if (grn_table_select_sequential_is_skipped(zone_filter, id)) {
+          continue;
         }
-        score = exec_result_to_score(ctx, result, &score_buffer);
-        if (score > 0) {
-          grn_rset_recinfo *ri;
-          if (grn_hash_add(ctx, s, &id, s->key_size, (void **)&ri, NULL)) {
-            grn_table_add_subrec(res, ri, score, (grn_rset_posinfo *)&id, 1);
+        record_ids[n_ids++] = id;
+        if (n_ids == batch_size) {
+          grn_table_select_sequential_batch_flush(ctx, executor, res, op,
+                                                  record_ids, entry_ids,
+                                                  results, n_ids);
+          n_ids = 0;
+          if (ctx->rc) {
+            break;
           }
         }
       }
+      if (ctx->rc == GRN_SUCCESS) {
+        grn_table_select_sequential_batch_flush(ctx, executor, res, op,
+                                                record_ids, entry_ids,
+                                                results, n_ids);
+      }
       grn_table_cursor_close(ctx, tc);
     }
     break;
   case GRN_OP_AND :
-    if ((hc = grn_hash_cursor_open(ctx, s, NULL, 0, NULL, 0, 0, -1, 0))) {
-      while (grn_hash_cursor_next(ctx, hc)) {
-        grn_hash_cursor_get_key(ctx, hc, (void **) &idp);
-        result = grn_expr_executor_exec(ctx, &executor, *idp);
-        if (ctx->rc) {
-          break;
-        }
-        score = exec_result_to_score(ctx, result, &score_buffer);
-        if (score > 0) {
-          grn_rset_recinfo *ri;
-          grn_hash_cursor_get_value(ctx, hc, (void **) &ri);
-          grn_table_add_subrec(res, ri, score, (grn_rset_posinfo *)idp, 1);
-        } else {
-          grn_hash_cursor_delete(ctx, hc, NULL);
-        }
-      }
-      grn_hash_cursor_close(ctx, hc);
-    }
-    break;
   case GRN_OP_AND_NOT :
-    if ((hc = grn_hash_cursor_open(ctx, s, NULL, 0, NULL, 0, 0, -1, 0))) {
-      while (grn_hash_cursor_next(ctx, hc)) {
-        grn_hash_cursor_get_key(ctx, hc, (void **) &idp);
-        result = grn_expr_executor_exec(ctx, &executor, *idp);
-        if (ctx->rc) {
-          break;
-        }
-        score = exec_result_to_score(ctx, result, &score_buffer);
-        if (score > 0) {
-          grn_hash_cursor_delete(ctx, hc, NULL);
-        }
-      }
-      grn_hash_cursor_close(ctx, hc);
-    }
-    break;
   case GRN_OP_ADJUST :
-    if ((hc = grn_hash_cursor_open(ctx, s, NULL, 0, NULL, 0, 0, -1, 0))) {
-      while (grn_hash_cursor_next(ctx, hc)) {
-        grn_hash_cursor_get_key(ctx, hc, (void **) &idp);
-        result = grn_expr_executor_exec(ctx, &executor, *idp);
-        if (ctx->rc) {
-          break;
+    {
+      grn_hash_cursor *hc;
+      grn_id entry_id;
+      hc = grn_hash_cursor_open(ctx, s, NULL, 0, NULL, 0, 0, -1, 0);
+      if (!hc) {
+        break;
+      }
+      while ((entry_id = grn_hash_cursor_next(ctx, hc))) {
+        grn_id *idp;
+        grn_hash_cursor_get_key(ctx, hc, (void **)&idp);
+        if (grn_table_select_sequential_is_skipped(zone_filter, *idp)) {
+          if (op == GRN_OP_AND) {
+            /* Records are deleted in the cursor order like
+             * grn_table_select_sequential(). */
+            grn_table_select_sequential_batch_flush(ctx, executor, res, op,
+                                                    record_ids, entry_ids,
+                                                    results, n_ids);
+            n_ids = 0;
+            if (ctx->rc) {
+              break;
+            }
+            grn_hash_cursor_delete(ctx, hc, NULL);
+          }
+          continue;
         }
-        score = exec_result_to_score(ctx, result, &score_buffer);
-        if (score > 0) {
-          grn_rset_recinfo *ri;
-          grn_hash_cursor_get_value(ctx, hc, (void **) &ri);
-          grn_table_add_subrec(res, ri, score, (grn_rset_posinfo *)idp, 1);
+        record_ids[n_ids] = *idp;
+        entry_ids[n_ids] = entry_id;
+        n_ids++;
+        if (n_ids == batch_size) {
+          grn_table_select_sequential_batch_flush(ctx, executor, res, op,
+                                                  record_ids, entry_ids,
+                                                  results, n_ids);
+          n_ids = 0;
+          if (ctx->rc) {
+            break;
+          }
         }
       }
+      if (ctx->rc == GRN_SUCCESS) {
+        grn_table_select_sequential_batch_flush(ctx, executor, res, op,
+                                                record_ids, entry_ids,
+                                                results, n_ids);
+      }
       grn_hash_cursor_close(ctx, hc);
     }
     break;
   default :
     break;
   }
-  GRN_OBJ_FIN(ctx, &score_buffer);
-  grn_expr_executor_fin(ctx, &executor);
+
+  GRN_FREE(record_ids);
 }
 
-static grn_inline void
-grn_table_select_index_report(grn_ctx *ctx, const char *tag, grn_obj *index)
+typedef struct {
+  grn_ctx ctx;
+  grn_expr_executor executor;
+  grn_bool executor_initialized;
+  grn_id *record_ids;
+  grn_bool *results;
+  size_t n_ids;
+  size_t batch_size;
+  grn_thread thread;
+  grn_bool thread_created;
+  grn_rc rc;
+} grn_table_select_sequential_worker;
+
+static grn_thread_func_result CALLBACK
+grn_table_select_sequential_worker_run(void *data)
 {
-  grn_report_index(ctx, "[table][select]", tag, index);
-}
+  grn_table_select_sequential_worker *worker = data;
+  grn_ctx *ctx = &(worker->ctx);
+  size_t offset;
 
-static grn_inline void
-grn_table_select_index_not_used_report(grn_ctx *ctx,
-                                       const char *tag,
-                                       grn_obj *index,
+  for (offset = 0; offset < worker->n_ids; offset += worker->batch_size) {
+    size_t n_ids = worker->n_ids - offset;
+    if (n_ids > worker->batch_size) {
+      n_ids = worker->batch_size;
+    }
+    grn_expr_executor_exec_batch(ctx,
+                                 &(worker->executor),
+                                 worker->record_ids + offset,
+                                 n_ids,
+                                 worker->results + offset);
+    if (ctx->rc != GRN_SUCCESS) {
+      break;
+    }
+  }
+  worker->rc = ctx->rc;
+  return GRN_THREAD_FUNC_RETURN_VALUE;
+}
+
+uint32_t
+grn_table_select_get_n_workers(grn_ctx *ctx)
+{
+  if (ctx->impl && ctx->impl->table_select_n_workers > 0) {
+    return ctx->impl->table_select_n_workers;
+  } else {
+    return grn_table_select_n_workers;
+  }
+}
+
+/* Collects target record IDs, splits them into contiguous ranges and
+ * evaluates each range by a worker thread. Each worker has its own
+ * grn_ctx and executor and writes only to its range of the result
+ * array. Results are applied to res in the original cursor order, so
+ * the result set is the same as the one by one thread.
+ *
+ * This returns GRN_FALSE when the expression or the number of records
+ * isn't suitable for workers. The caller processes it by itself. */
+static grn_bool
+grn_table_select_sequential_parallel(grn_ctx *ctx, grn_obj *table,
+                                     grn_obj *expr, grn_obj *res,
+                                     grn_operator op,
+                                     grn_ra_zone_filter *zone_filter)
+{
+  grn_hash *s = (grn_hash *)res;
+  size_t batch_size = grn_table_select_sequential_batch_size;
+  uint32_t n_workers = grn_table_select_get_n_workers(ctx);
+  uint32_t n_initialized_workers = 0;
+  uint32_t i;
+  size_t n_max_ids;
+  size_t n_ids = 0;
+  size_t n_ids_per_worker;
+  grn_id *record_ids;
+  grn_id *entry_ids;
+  grn_bool *results;
+  grn_table_select_sequential_worker *workers;
+
+  switch (op) {
+  case GRN_OP_OR :
+    n_max_ids = grn_table_size(ctx, table);
+    break;
+  case GRN_OP_AND :
+  case GRN_OP_AND_NOT :
+  case GRN_OP_ADJUST :
+    n_max_ids = grn_table_size(ctx, res);
+    break;
+  default :
+    return GRN_FALSE;
+  }
+  /* Each worker should have at least one batch. */
+  if (n_workers > n_max_ids / batch_size) {
+    n_workers = n_max_ids / batch_size;
+  }
+  if (n_workers < 2) {
+    return GRN_FALSE;
+  }
+
+  record_ids = GRN_MALLOC(sizeof(grn_id) * n_max_ids * 2 +
+                          sizeof(grn_bool) * n_max_ids);
+  if (!record_ids) {
+    ERRCLR(ctx);
+    return GRN_FALSE;
+  }
+  entry_ids = record_ids + n_max_ids;
+  results = (grn_bool *)(entry_ids + n_max_ids);
+
+  if (op == GRN_OP_OR) {
+    grn_table_cursor *tc;
+    grn_id id;
+    tc = grn_table_cursor_open(ctx, table, NULL, 0, NULL, 0, 0, -1, 0);
+    if (tc) {
+      while (n_ids < n_max_ids && (id = grn_table_cursor_next(ctx, tc))) {
+        if (grn_table_select_sequential_is_skipped(zone_filter, id)) {
+          continue;
+        }
+        record_ids[n_ids++] = id;
+      }
+      grn_table_cursor_close(ctx, tc);
+    }
+  } else {
+    grn_hash_cursor *hc;
+    grn_id entry_id;
+    hc = grn_hash_cursor_open(ctx, s, NULL, 0, NULL, 0, 0, -1, 0);
+    if (hc) {
+      while (n_ids < n_max_ids && (entry_id = grn_hash_cursor_next(ctx, hc))) {
+        grn_id *idp;
+        grn_hash_cursor_get_key(ctx, hc, (void **)&idp);
+        if (grn_table_select_sequential_is_skipped(zone_filter, *idp)) {
+          if (op == GRN_OP_AND) {
+            grn_hash_cursor_delete(ctx, hc, NULL);
+          }
+          continue;
+        }
+        record_ids[n_ids] = *idp;
+        entry_ids[n_ids] = entry_id;
+        n_ids++;
+      }
+      grn_hash_cursor_close(ctx, hc);
+    }
+  }
+  if (ctx->rc != GRN_SUCCESS) {
+    GRN_FREE(record_ids);
+    return GRN_TRUE;
+  }
+
+  workers = GRN_CALLOC(sizeof(grn_table_select_sequential_worker) * n_workers);
+  if (!workers) {
+    ERRCLR(ctx);
+    GRN_FREE(record_ids);
+    return GRN_FALSE;
+  }
+  GRN_LOG(ctx, GRN_LOG_INFO,
+          "[table][select][sequential] "
+          "n_workers=<%u> n_records=<%" GRN_FMT_SIZE ">",
+          n_workers, n_ids);
+
+  n_ids_per_worker = (n_ids + n_workers - 1) / n_workers;
+  for (; n_initialized_workers < n_workers; n_initialized_workers++) {
+    grn_table_select_sequential_worker *worker =
+      &(workers[n_initialized_workers]);
+    size_t offset = n_ids_per_worker * n_initialized_workers;
+    grn_ctx_init(&(worker->ctx), 0);
+    grn_ctx_use(&(worker->ctx), grn_ctx_db(ctx));
+    worker->record_ids = record_ids + offset;
+    worker->results = results + offset;
+    if (offset < n_ids) {
+      worker->n_ids = n_ids - offset;
+      if (worker->n_ids > n_ids_per_worker) {
+        worker->n_ids = n_ids_per_worker;
+      }
+    }
+    worker->batch_size = batch_size;
+    grn_expr_executor_init(&(worker->ctx), &(worker->executor), expr);
+    if (worker->ctx.rc != GRN_SUCCESS) {
+      ERR(worker->ctx.rc,
+          "[table][select][sequential][worker] %s",
+          worker->ctx.errbuf);
+      n_initialized_workers++;
+      break;
+    }
+    worker->executor_initialized = GRN_TRUE;
+  }
+
+  if (ctx->rc == GRN_SUCCESS) {
+    for (i = 0; i < n_workers; i++) {
+      grn_table_select_sequential_worker *worker = &(workers[i]);
+      if (THREAD_CREATE(worker->thread,
+                        grn_table_select_sequential_worker_run,
+                        worker) == 0) {
+        worker->thread_created = GRN_TRUE;
+      } else {
+        GRN_LOG(ctx, GRN_LOG_WARNING,
+                "[table][select][sequential][worker] "
+                "failed to create a thread: <%u>: "
+                "run in the current thread",
+                i);
+        grn_table_select_sequential_worker_run(worker);
+      }
+    }
+    for (i = 0; i < n_workers; i++) {
+      grn_table_select_sequential_worker *worker = &(workers[i]);
+      if (worker->thread_created) {
+        THREAD_JOIN(worker->thread);
+      }
+    }
+    for (i = 0; i < n_workers; i++) {
+      grn_table_select_sequential_worker *worker = &(workers[i]);
+      if (worker->rc != GRN_SUCCESS) {
+        ERR(worker->rc,
+            "[table][select][sequential][worker] %s",
+            worker->ctx.errbuf);
+        break;
+      }
+    }
+  }
+
+  if (ctx->rc == GRN_SUCCESS) {
+    grn_table_select_sequential_batch_apply(ctx, res, op,
+                                            record_ids, entry_ids,
+                                            results, n_ids);
+  }
+
+  for (i = 0; i < n_initialized_workers; i++) {
+    grn_table_select_sequential_worker *worker = &(workers[i]);
+    if (worker->executor_initialized) {
+      grn_expr_executor_fin(&(worker->ctx), &(worker->executor));
+    }
+    grn_ctx_fin(&(worker->ctx));
+  }
+  GRN_FREE(workers);
+  GRN_FREE(record_ids);
+
+  return GRN_TRUE;
+}
+
+static void
+grn_table_select_sequential(grn_ctx *ctx, grn_obj *table, grn_obj *expr,
+                            grn_obj *v, grn_obj *res, grn_operator op)
+{
+  grn_obj *result;
+  grn_obj score_buffer;
+  int32_t score;
+  grn_id id, *idp;
+  grn_table_cursor *tc;
+  grn_hash_cursor *hc;
+  grn_hash *s = (grn_hash *)res;
+  grn_expr_executor executor;
+  grn_ra_zone_filter zone_filter_data;
+  grn_ra_zone_filter *zone_filter = NULL;
+
+  grn_expr_executor_init(ctx, &executor, expr);
+  if (ctx->rc != GRN_SUCCESS) {
+    return;
+  }
+  if (grn_table_select_sequential_zone_filter_init(ctx,
+                                                   table,
+                                                   expr,
+                                                   &zone_filter_data)) {
+    zone_filter = &zone_filter_data;
+  }
+  if (grn_table_select_sequential_batch_size > 1 &&
+      grn_expr_executor_can_exec_batch(ctx, &executor)) {
+    /* Executors that support batch mode don't share state with the
+     * expression. So they can be used in worker threads. */
+    if (!grn_table_select_sequential_parallel(ctx, table, expr, res, op,
+                                              zone_filter)) {
+      grn_table_select_sequential_batch(ctx, table, &executor, res, op,
+                                        zone_filter);
+    }
+    if (zone_filter) {
+      grn_ra_zone_filter_fin(ctx, zone_filter);
+    }
+    grn_expr_executor_fin(ctx, &executor);
+    return;
+  }
+  GRN_INT32_INIT(&score_buffer, 0);
+  switch (op) {
+  case GRN_OP_OR :
+    if ((tc = grn_table_cursor_open(ctx, table, NULL, 0, NULL, 0, 0, -1, 0))) {
+      while ((id = grn_table_cursor_next(ctx, tc))) {
+        if (grn_table_select_sequential_is_skipped(zone_filter, id)) {
+          continue;
+        }
+        result = grn_expr_executor_exec(ctx, &executor, id);
+        if (ctx->rc) {
+          break;
+        }
+        score = exec_result_to_score(ctx, result, &score_buffer);
+        if (score > 0) {
+          grn_rset_recinfo *ri;
+          if (grn_hash_add(ctx, s, &id, s->key_size, (void **)&ri, NULL)) {
+            grn_table_add_subrec(res, ri, score, (grn_rset_posinfo *)&id, 1);
+          }
+        }
+      }
+      grn_table_cursor_close(ctx, tc);
+    }
+    break;
+  case GRN_OP_AND :
+    if ((hc = grn_hash_cursor_open(ctx, s, NULL, 0, NULL, 0, 0, -1, 0))) {
+      while (grn_hash_cursor_next(ctx, hc)) {
+        grn_hash_cursor_get_key(ctx, hc, (void **) &idp);
+        if (grn_table_select_sequential_is_skipped(zone_filter, *idp)) {
+          grn_hash_cursor_delete(ctx, hc, NULL);
+          continue;
+        }
+        result = grn_expr_executor_exec(ctx, &executor, *idp);
+        if (ctx->rc) {
+          break;
+        }
+        score = exec_result_to_score(ctx, result, &score_buffer);
+        if (score > 0) {
+          grn_rset_recinfo *ri;
+          grn_hash_cursor_get_value(ctx, hc, (void **) &ri);
+          grn_table_add_subrec(res, ri, score, (grn_rset_posinfo *)idp, 1);
+        } else {
+          grn_hash_cursor_delete(ctx, hc, NULL);
+        }
+      }
+      grn_hash_cursor_close(ctx, hc);
+    }
+    break;
+  case GRN_OP_AND_NOT :
+    if ((hc = grn_hash_cursor_open(ctx, s, NULL, 0, NULL, 0, 0, -1, 0))) {
+      while (grn_hash_cursor_next(ctx, hc)) {
+        grn_hash_cursor_get_key(ctx, hc, (void **) &idp);
+        if (grn_table_select_sequential_is_skipped(zone_filter, *idp)) {
+          continue;
+        }
+        result = grn_expr_executor_exec(ctx, &executor, *idp);
+        if (ctx->rc) {
+          break;
+        }
+        score = exec_result_to_score(ctx, result, &score_buffer);
+        if (score > 0) {
+          grn_hash_cursor_delete(ctx, hc, NULL);
+        }
+      }
+      grn_hash_cursor_close(ctx, hc);
+    }
+    break;
+  case GRN_OP_ADJUST :
+    if ((hc = grn_hash_cursor_open(ctx, s, NULL, 0, NULL, 0, 0, -1, 0))) {
+      while (grn_hash_cursor_next(ctx, hc)) {
+        grn_hash_cursor_get_key(ctx, hc, (void **) &idp);
+        if (grn_table_select_sequential_is_skipped(zone_filter, *idp)) {
+          continue;
+        }
+        result = grn_expr_executor_exec(ctx, &executor, *idp);
+        if (ctx->rc) {
+          break;
+        }
+        score = exec_result_to_score(ctx, result, &score_buffer);
+        if (score > 0) {
+          grn_rset_recinfo *ri;
+          grn_hash_cursor_get_value(ctx, hc, (void **) &ri);
+          grn_table_add_subrec(res, ri, score, (grn_rset_posinfo *)idp, 1);
+        }
+      }
+      grn_hash_cursor_close(ctx, hc);
+    }
+    break;
+  default :
+    break;
+  }
+  GRN_OBJ_FIN(ctx, &score_buffer);
+  if (zone_filter) {
+    grn_ra_zone_filter_fin(ctx, zone_filter);
+  }
+  grn_expr_executor_fin(ctx, &executor);
+}
+
+static grn_inline void
+grn_table_select_index_report(grn_ctx *ctx, const char *tag, grn_obj *index)
+{
+  grn_report_index(ctx, "[table][select]", tag, index);
+}
+
+static grn_inline void
+grn_table_select_index_not_used_report(grn_ctx *ctx,
+                                       const char *tag,
+                                       grn_obj *index,
                                        const char *reason)
 {
   grn_report_index_not_used(ctx, "[table][select]", tag, index, reason);
@@ -4045,6 +4789,71 @@ grn_table_select_index_suffix(grn_ctx *ctx,
   return grn_table_select_index_prefix(ctx, table, index, data);
 }
 
+/* Scorers of the j-th and the (j + 1)-th indexes can be processed by
+ * one search when they are the same scorer with the same constant
+ * arguments. */
+static grn_bool
+grn_table_select_index_match_scorer_is_same(grn_ctx *ctx,
+                                            scan_info *si,
+                                            int j)
+{
+  grn_obj *scorer;
+  grn_expr *args_expr;
+  grn_expr *next_args_expr;
+  uint32_t offset;
+  uint32_t next_offset;
+
+  scorer = GRN_PTR_VALUE_AT(&(si->scorers), j);
+  if (scorer != GRN_PTR_VALUE_AT(&(si->scorers), j + 1)) {
+    return GRN_FALSE;
+  }
+  if (!scorer) {
+    return GRN_TRUE;
+  }
+
+  offset = GRN_UINT32_VALUE_AT(&(si->scorer_args_expr_offsets), j);
+  next_offset = GRN_UINT32_VALUE_AT(&(si->scorer_args_expr_offsets), j + 1);
+  if (offset == 0 || next_offset == 0) {
+    return offset == next_offset;
+  }
+
+  args_expr = (grn_expr *)GRN_PTR_VALUE_AT(&(si->scorer_args_exprs), j);
+  next_args_expr =
+    (grn_expr *)GRN_PTR_VALUE_AT(&(si->scorer_args_exprs), j + 1);
+  if (args_expr != next_args_expr) {
+    return GRN_FALSE;
+  }
+
+  for (; offset < args_expr->codes_curr && next_offset < args_expr->codes_curr;
+       offset++, next_offset++) {
+    grn_expr_code *code = args_expr->codes + offset;
+    grn_expr_code *next_code = args_expr->codes + next_offset;
+    grn_obj *value = code->value;
+    grn_obj *next_value = next_code->value;
+
+    if (code->op != next_code->op) {
+      return GRN_FALSE;
+    }
+    if (code->op == GRN_OP_CALL) {
+      return code->nargs == next_code->nargs;
+    }
+    if (code->op != GRN_OP_PUSH || !value || !next_value) {
+      return GRN_FALSE;
+    }
+    if (value->header.type != GRN_BULK ||
+        next_value->header.type != GRN_BULK ||
+        value->header.domain != next_value->header.domain ||
+        GRN_BULK_VSIZE(value) != GRN_BULK_VSIZE(next_value) ||
+        memcmp(GRN_BULK_HEAD(value),
+               GRN_BULK_HEAD(next_value),
+               GRN_BULK_VSIZE(value)) != 0) {
+      return GRN_FALSE;
+    }
+  }
+
+  return GRN_FALSE;
+}
+
 static grn_inline grn_bool
 grn_table_select_index_match(grn_ctx *ctx,
                              grn_obj *table,
@@ -4116,10 +4925,11 @@ grn_table_select_index_match(grn_ctx *ctx,
     optarg.scorer_args_expr_offset =
       GRN_UINT32_VALUE_AT(&(si->scorer_args_expr_offsets), j);
     if (j < n_indexes - 1) {
+      /* Sections of the same record are scored in one search. So a
+         scorer can sum up TF of all the sections. */
       if (sid > 0 &&
           ip[0] == ip[1] &&
-          !optarg.scorer &&
-          !GRN_PTR_VALUE_AT(&(si->scorers), j + 1)) {
+          grn_table_select_index_match_scorer_is_same(ctx, si, j)) {
         continue;
       }
     }
@@ -5071,6 +5881,754 @@ grn_table_select(grn_ctx *ctx, grn_obj *table, grn_obj *expr,
   GRN_API_RETURN(res);
 }
 
+#define GRN_TABLE_SELECT_FIRST_N_MAX_WINDOW_SIZE 65536
+
+static grn_bool
+grn_table_select_first_n_is_supported(grn_ctx *ctx,
+                                      grn_scanner *scanner,
+                                      grn_bool *use_index)
+{
+  int i;
+
+  *use_index = GRN_FALSE;
+  for (i = 0; i < scanner->n_sis; i++) {
+    scan_info *si = scanner->sis[i];
+    grn_bool searchable = GRN_FALSE;
+
+    if (si->flags & (SCAN_PUSH|SCAN_POP)) {
+      return GRN_FALSE;
+    }
+    if (GRN_BULK_VSIZE(&(si->index)) > 0) {
+      searchable = GRN_TRUE;
+    }
+    if (si->op == GRN_OP_CALL && grn_obj_is_selector_proc(ctx, si->args[0])) {
+      searchable = GRN_TRUE;
+    }
+    if (i == 0) {
+      *use_index = searchable;
+      continue;
+    }
+    if (searchable) {
+      return GRN_FALSE;
+    }
+    switch (si->logical_op) {
+    case GRN_OP_AND :
+    case GRN_OP_AND_NOT :
+    case GRN_OP_ADJUST :
+      break;
+    default :
+      return GRN_FALSE;
+    }
+  }
+
+  return GRN_TRUE;
+}
+
+/*
+ * Selects records by the first condition in the same way as
+ * grn_table_select(). It returns NULL without error when the condition
+ * is skipped because grn_table_select() ignores it in the case.
+ */
+static grn_obj *
+grn_table_select_first_n_select_index(grn_ctx *ctx,
+                                      grn_obj *table,
+                                      grn_obj *expr,
+                                      grn_scanner *scanner)
+{
+  grn_obj *source;
+  grn_expr *e = (grn_expr *)(scanner->expr);
+  scan_info *si = scanner->sis[0];
+  grn_table_select_data data;
+
+  source = grn_table_create(ctx, NULL, 0, NULL,
+                            GRN_OBJ_TABLE_HASH_KEY|GRN_OBJ_WITH_SUBREC,
+                            table, NULL);
+  if (!source) {
+    return NULL;
+  }
+
+  data.variable = grn_expr_get_var_by_offset(ctx, scanner->expr, 0);
+  data.scanner = scanner;
+  data.nth_scan_info = 0;
+  data.scan_info = si;
+  data.res = source;
+  data.min_id = GRN_ID_NIL;
+  data.is_skipped = GRN_FALSE;
+  data.is_first_unskipped_scan_info = GRN_TRUE;
+  if (!grn_table_select_index(ctx, table, &data) &&
+      ctx->rc == GRN_SUCCESS) {
+    grn_expr_code *codes = e->codes;
+    uint32_t codes_curr = e->codes_curr;
+    e->codes = codes + si->start;
+    e->codes_curr = si->end - si->start + 1;
+    grn_table_select_sequential(ctx, table, (grn_obj *)e, data.variable,
+                                source, si->logical_op);
+    e->codes = codes;
+    e->codes_curr = codes_curr;
+  }
+  if (ctx->rc != GRN_SUCCESS || data.is_skipped) {
+    grn_obj_close(ctx, source);
+    return NULL;
+  }
+
+  {
+    grn_obj condition_inspect_buffer;
+    GRN_TEXT_INIT(&condition_inspect_buffer, 0);
+    GRN_QUERY_LOG(ctx, GRN_QUERY_LOG_SIZE,
+                  ":", "%sfilter(%d)%s",
+                  grn_expr_get_query_log_tag_prefix(ctx, expr),
+                  grn_table_size(ctx, source),
+                  grn_table_select_inspect_condition(ctx,
+                                                     &condition_inspect_buffer,
+                                                     si,
+                                                     e));
+    GRN_OBJ_FIN(ctx, &condition_inspect_buffer);
+  }
+
+  return source;
+}
+
+/*
+ * Selects records in the table cursor order until n records are
+ * matched. Records are read in windows and each window is evaluated by
+ * the same sequential search as grn_table_select(). So matched records
+ * and their scores are the same as the first n records of
+ * grn_table_select(). n_hits is the number of matched records. It's a
+ * lower bound unless all records are read. If estimate is true, n_hits
+ * is extrapolated from the ratio of matched records instead.
+ *
+ * If the first condition uses an index or a selector, records are
+ * selected by it as grn_table_select() does and the other conditions are
+ * evaluated in windows in the order of the selected records. The other
+ * conditions must not use an index or a selector.
+ *
+ * It returns NULL without error when the expression can't be evaluated
+ * by the above. The caller should use grn_table_select() in the case.
+ */
+grn_obj *
+grn_table_select_first_n(grn_ctx *ctx,
+                         grn_obj *table,
+                         grn_obj *expr,
+                         uint32_t n,
+                         grn_bool estimate,
+                         uint32_t *n_hits)
+{
+  grn_obj *res = NULL;
+  grn_obj *source = NULL;
+  grn_obj *window = NULL;
+  grn_scanner *scanner;
+  grn_expr *e = NULL;
+  grn_expr_code *codes = NULL;
+  uint32_t codes_curr = 0;
+  grn_obj *v;
+  grn_table_cursor *cursor = NULL;
+  uint32_t value_size;
+  uint32_t window_size;
+  uint32_t n_scanned = 0;
+  grn_bool use_index = GRN_FALSE;
+  grn_bool completed = GRN_FALSE;
+
+  GRN_API_ENTER;
+
+  if (n == 0) {
+    GRN_API_RETURN(NULL);
+  }
+
+  scanner = grn_scanner_open(ctx, expr, GRN_OP_OR, GRN_FALSE);
+  if (scanner) {
+    if (!grn_table_select_first_n_is_supported(ctx, scanner, &use_index)) {
+      goto exit;
+    }
+    e = (grn_expr *)(scanner->expr);
+    codes = e->codes;
+    codes_curr = e->codes_curr;
+    v = grn_expr_get_var_by_offset(ctx, scanner->expr, 0);
+  } else {
+    if (ctx->rc != GRN_SUCCESS) {
+      goto exit;
+    }
+    v = grn_expr_get_var_by_offset(ctx, expr, 0);
+  }
+  if (!v) {
+    goto exit;
+  }
+
+  if (use_index) {
+    source = grn_table_select_first_n_select_index(ctx, table, expr, scanner);
+    if (!source) {
+      goto exit;
+    }
+    if (scanner->n_sis == 1) {
+      res = source;
+      source = NULL;
+      completed = GRN_TRUE;
+      *n_hits = grn_table_size(ctx, res);
+      goto exit;
+    }
+  }
+
+  res = grn_table_create(ctx, NULL, 0, NULL,
+                         GRN_OBJ_TABLE_HASH_KEY|GRN_OBJ_WITH_SUBREC,
+                         table, NULL);
+  if (!res) {
+    goto exit;
+  }
+  value_size = ((grn_hash *)res)->value_size;
+  if (source) {
+    cursor = grn_table_cursor_open(ctx, source, NULL, 0, NULL, 0, 0, -1, 0);
+  } else {
+    cursor = grn_table_cursor_open(ctx, table, NULL, 0, NULL, 0, 0, -1, 0);
+  }
+  if (!cursor) {
+    grn_obj_close(ctx, res);
+    res = NULL;
+    goto exit;
+  }
+
+  window_size = n;
+  if (window_size < grn_table_select_first_n_min_window_size) {
+    window_size = grn_table_select_first_n_min_window_size;
+  }
+  while (grn_table_size(ctx, res) < n) {
+    grn_id id;
+    uint32_t n_window_records = 0;
+
+    window = grn_table_create(ctx, NULL, 0, NULL,
+                              GRN_OBJ_TABLE_HASH_KEY|GRN_OBJ_WITH_SUBREC,
+                              table, NULL);
+    if (!window) {
+      grn_obj_close(ctx, res);
+      res = NULL;
+      goto exit;
+    }
+    while (n_window_records < window_size &&
+           (id = grn_table_cursor_next(ctx, cursor)) != GRN_ID_NIL) {
+      grn_rset_recinfo *ri;
+      if (source) {
+        void *key;
+        void *value;
+        grn_table_cursor_get_key(ctx, cursor, &key);
+        grn_table_cursor_get_value(ctx, cursor, &value);
+        if (grn_hash_add(ctx, (grn_hash *)window, key, sizeof(grn_id),
+                         (void **)&ri, NULL)) {
+          grn_memcpy(ri, value, value_size);
+        }
+      } else {
+        if (grn_hash_add(ctx, (grn_hash *)window, &id, sizeof(grn_id),
+                         (void **)&ri, NULL)) {
+          ri->score = 0;
+          ri->n_subrecs = 0;
+        }
+      }
+      n_window_records++;
+    }
+    n_scanned += n_window_records;
+    if (n_window_records < window_size) {
+      completed = GRN_TRUE;
+    }
+    if (n_window_records == 0) {
+      grn_obj_close(ctx, window);
+      window = NULL;
+      break;
+    }
+
+    /* The window already has the candidate records. So the first
+     * condition is applied by AND instead of OR. If the first
+     * condition is evaluated by an index, the window has the matched
+     * records of it. */
+    if (scanner) {
+      int i;
+      for (i = source ? 1 : 0; i < scanner->n_sis; i++) {
+        scan_info *si = scanner->sis[i];
+        grn_operator op = (i == 0) ? GRN_OP_AND : si->logical_op;
+        e->codes = codes + si->start;
+        e->codes_curr = si->end - si->start + 1;
+        grn_table_select_sequential(ctx, table, (grn_obj *)e, v, window, op);
+        e->codes = codes;
+        e->codes_curr = codes_curr;
+        if (ctx->rc != GRN_SUCCESS) {
+          break;
+        }
+      }
+    } else {
+      grn_table_select_sequential(ctx, table, expr, v, window, GRN_OP_AND);
+    }
+    if (ctx->rc != GRN_SUCCESS) {
+      break;
+    }
+
+    GRN_HASH_EACH_BEGIN(ctx, (grn_hash *)window, window_cursor, window_id) {
+      void *key;
+      void *value;
+      void *res_value;
+      grn_hash_cursor_get_key_value(ctx, window_cursor, &key, NULL, &value);
+      if (grn_hash_add(ctx, (grn_hash *)res, key, sizeof(grn_id),
+                       &res_value, NULL)) {
+        grn_memcpy(res_value, value, value_size);
+      }
+    } GRN_HASH_EACH_END(ctx, window_cursor);
+    grn_obj_close(ctx, window);
+    window = NULL;
+
+    if (completed) {
+      break;
+    }
+    if (window_size <= GRN_TABLE_SELECT_FIRST_N_MAX_WINDOW_SIZE / 2) {
+      window_size *= 2;
+    }
+  }
+
+  if (ctx->rc != GRN_SUCCESS) {
+    grn_obj_close(ctx, res);
+    res = NULL;
+    goto exit;
+  }
+
+  if (!completed && grn_table_cursor_next(ctx, cursor) == GRN_ID_NIL) {
+    completed = GRN_TRUE;
+  }
+  *n_hits = grn_table_size(ctx, res);
+  if (!completed && estimate && n_scanned > 0) {
+    uint64_t n_records;
+    if (source) {
+      n_records = grn_table_size(ctx, source);
+    } else {
+      n_records = grn_table_size(ctx, table);
+    }
+    *n_hits = (uint32_t)(((uint64_t)(*n_hits) * n_records) / n_scanned);
+  }
+
+exit :
+  if (res) {
+    GRN_QUERY_LOG(ctx, GRN_QUERY_LOG_SIZE,
+                  ":", "%sfilter(%u): first-n(%u)%s",
+                  grn_expr_get_query_log_tag_prefix(ctx, expr),
+                  *n_hits,
+                  n,
+                  completed ? "" : (estimate ? "[estimated]" : "[lower-bound]"));
+  }
+  if (cursor) {
+    grn_table_cursor_close(ctx, cursor);
+  }
+  if (window) {
+    grn_obj_close(ctx, window);
+  }
+  if (source) {
+    grn_obj_close(ctx, source);
+  }
+  if (scanner) {
+    grn_scanner_close(ctx, scanner);
+  }
+
+  GRN_API_RETURN(res);
+}
+
+/* Variables of a temporary expression are stored in the grn_ctx that
+ * creates the expression. This creates an expression in dest_ctx that
+ * has the same codes as expr but refers its own variables. expr must
+ * not refer other expressions because their variables can't be
+ * replaced. */
+static grn_obj *
+grn_expr_copy_to_ctx(grn_ctx *ctx, grn_obj *expr, grn_ctx *dest_ctx)
+{
+  grn_expr *e = (grn_expr *)expr;
+  grn_obj *copied_expr;
+  grn_expr *copied_e;
+  grn_hash *vars;
+  uint32_t n_vars;
+
+  vars = grn_expr_get_vars(ctx, expr, &n_vars);
+  if (!vars) {
+    return NULL;
+  }
+
+  copied_expr = grn_expr_create(dest_ctx, NULL, 0);
+  if (!copied_expr) {
+    return NULL;
+  }
+  copied_e = (grn_expr *)copied_expr;
+  if (copied_e->codes_size < e->codes_curr) {
+    grn_expr_code *codes;
+    codes = (grn_expr_code *)GRN_MALLOC(sizeof(grn_expr_code) *
+                                        e->codes_size);
+    if (!codes) {
+      grn_obj_close(dest_ctx, copied_expr);
+      return NULL;
+    }
+    GRN_FREE(copied_e->codes);
+    copied_e->codes = codes;
+    copied_e->codes_size = e->codes_size;
+  }
+  grn_memcpy(copied_e->codes, e->codes, sizeof(grn_expr_code) * e->codes_curr);
+  copied_e->codes_curr = e->codes_curr;
+  copied_e->cacheable = e->cacheable;
+  copied_e->taintable = e->taintable;
+  GRN_TEXT_SET(dest_ctx,
+               &(copied_e->query_log_tag_prefix),
+               GRN_TEXT_VALUE(&(e->query_log_tag_prefix)),
+               GRN_TEXT_LEN(&(e->query_log_tag_prefix)));
+
+  GRN_HASH_EACH_BEGIN(ctx, vars, cursor, id) {
+    void *name;
+    int name_size;
+    void *value;
+    grn_obj *var;
+    grn_obj *copied_var;
+    uint32_t i;
+
+    name_size = grn_hash_cursor_get_key(ctx, cursor, &name);
+    grn_hash_cursor_get_value(ctx, cursor, &value);
+    var = value;
+    copied_var = grn_expr_add_var(dest_ctx, copied_expr, name, name_size);
+    if (!copied_var) {
+      break;
+    }
+    GRN_OBJ_INIT(copied_var, var->header.type, 0, var->header.domain);
+    for (i = 0; i < copied_e->codes_curr; i++) {
+      if (copied_e->codes[i].value == var) {
+        copied_e->codes[i].value = copied_var;
+      }
+    }
+  } GRN_HASH_EACH_END(ctx, cursor);
+
+  if (dest_ctx->rc != GRN_SUCCESS) {
+    ERR(dest_ctx->rc,
+        "[expr][copy] failed to copy an expression: %s",
+        dest_ctx->errbuf);
+    grn_obj_close(dest_ctx, copied_expr);
+    return NULL;
+  }
+
+  return copied_expr;
+}
+
+static grn_bool
+grn_expr_is_copyable_to_ctx(grn_ctx *ctx, grn_obj *expr)
+{
+  grn_expr *e = (grn_expr *)expr;
+  uint32_t i;
+
+  if (expr->header.type != GRN_EXPR) {
+    return GRN_FALSE;
+  }
+  for (i = 0; i < e->codes_curr; i++) {
+    grn_obj *value = e->codes[i].value;
+    if (value && value->header.type == GRN_EXPR) {
+      return GRN_FALSE;
+    }
+  }
+  return GRN_TRUE;
+}
+
+typedef struct {
+  grn_table_select_target *targets;
+  size_t n_targets;
+  int64_t limit;
+  grn_critical_section lock;
+  size_t n_finished_prefix_targets;
+  int64_t n_prefix_records;
+  grn_bool *dispatched;
+  grn_bool *finished;
+  grn_bool stopped;
+  grn_obj **results;
+} grn_table_select_targets_data;
+
+typedef struct {
+  grn_ctx ctx;
+  grn_table_select_targets_data *data;
+  size_t offset;
+  size_t step;
+  grn_obj **exprs;
+  grn_thread thread;
+  grn_bool thread_created;
+  grn_rc rc;
+} grn_table_select_targets_worker;
+
+/* Selects the offset-th, (offset + step)-th, ... targets until
+ * enough records are collected. The number of collected records is
+ * counted only for the finished prefix of targets. It's for keeping
+ * the records in the original order.
+ *
+ * If data->results isn't NULL, ctx is the context of a worker. A
+ * temporary table must be updated only by the context that creates
+ * it, so each target is selected into a new result created by ctx
+ * and stored into data->results. It's merged into target->result by
+ * the main context. */
+static void
+grn_table_select_targets_run(grn_ctx *ctx,
+                             grn_table_select_targets_data *data,
+                             size_t offset,
+                             size_t step,
+                             grn_obj **exprs)
+{
+  size_t i;
+
+  for (i = offset; i < data->n_targets; i += step) {
+    grn_table_select_target *target = &(data->targets[i]);
+    grn_obj *expr;
+    grn_obj *result;
+
+    CRITICAL_SECTION_ENTER(data->lock);
+    if (data->stopped) {
+      CRITICAL_SECTION_LEAVE(data->lock);
+      break;
+    }
+    data->dispatched[i] = GRN_TRUE;
+    CRITICAL_SECTION_LEAVE(data->lock);
+
+    if (exprs) {
+      expr = exprs[i];
+    } else {
+      expr = target->expr;
+    }
+    if (data->results) {
+      result = grn_table_create(ctx, NULL, 0, NULL,
+                                GRN_OBJ_TABLE_HASH_KEY|
+                                GRN_OBJ_WITH_SUBREC,
+                                target->table, NULL);
+      data->results[i] = result;
+    } else {
+      result = target->result;
+    }
+    if (result) {
+      grn_table_select(ctx, target->table, expr, result, GRN_OP_OR);
+    }
+    if (ctx->rc != GRN_SUCCESS) {
+      CRITICAL_SECTION_ENTER(data->lock);
+      data->stopped = GRN_TRUE;
+      CRITICAL_SECTION_LEAVE(data->lock);
+      break;
+    }
+
+    CRITICAL_SECTION_ENTER(data->lock);
+    data->finished[i] = GRN_TRUE;
+    while (data->n_finished_prefix_targets < data->n_targets &&
+           data->finished[data->n_finished_prefix_targets]) {
+      grn_obj *prefix_result;
+      if (data->results) {
+        prefix_result = data->results[data->n_finished_prefix_targets];
+      } else {
+        prefix_result = data->targets[data->n_finished_prefix_targets].result;
+      }
+      data->n_prefix_records += grn_table_size(ctx, prefix_result);
+      data->n_finished_prefix_targets++;
+    }
+    if (data->limit >= 0 && data->n_prefix_records >= data->limit) {
+      data->stopped = GRN_TRUE;
+    }
+    CRITICAL_SECTION_LEAVE(data->lock);
+  }
+}
+
+static grn_thread_func_result CALLBACK
+grn_table_select_targets_worker_run(void *data)
+{
+  grn_table_select_targets_worker *worker = data;
+  grn_ctx *ctx = &(worker->ctx);
+
+  grn_table_select_targets_run(ctx,
+                               worker->data,
+                               worker->offset,
+                               worker->step,
+                               worker->exprs);
+  worker->rc = ctx->rc;
+  return GRN_THREAD_FUNC_RETURN_VALUE;
+}
+
+grn_rc
+grn_table_select_targets(grn_ctx *ctx,
+                         grn_table_select_target *targets,
+                         size_t n_targets,
+                         int64_t limit)
+{
+  grn_table_select_targets_data data;
+  grn_table_select_targets_worker *workers = NULL;
+  grn_obj **exprs = NULL;
+  uint32_t n_workers;
+  uint32_t n_initialized_workers = 0;
+  uint32_t i;
+  size_t j;
+
+  GRN_API_ENTER;
+
+  for (j = 0; j < n_targets; j++) {
+    grn_table_select_target *target = &(targets[j]);
+    target->result = grn_table_create(ctx, NULL, 0, NULL,
+                                      GRN_OBJ_TABLE_HASH_KEY|
+                                      GRN_OBJ_WITH_SUBREC,
+                                      target->table, NULL);
+    if (!target->result) {
+      goto exit;
+    }
+  }
+
+  data.targets = targets;
+  data.n_targets = n_targets;
+  data.limit = limit;
+  data.n_finished_prefix_targets = 0;
+  data.n_prefix_records = 0;
+  data.stopped = GRN_FALSE;
+  data.results = NULL;
+  data.dispatched = GRN_CALLOC(sizeof(grn_bool) * (n_targets + 1) * 2);
+  if (!data.dispatched) {
+    goto exit;
+  }
+  data.finished = data.dispatched + n_targets + 1;
+  CRITICAL_SECTION_INIT(data.lock);
+
+  n_workers = grn_table_select_get_n_workers(ctx);
+  if (n_workers > n_targets) {
+    n_workers = n_targets;
+  }
+  for (j = 0; n_workers > 1 && j < n_targets; j++) {
+    if (!grn_expr_is_copyable_to_ctx(ctx, targets[j].expr)) {
+      GRN_LOG(ctx, GRN_LOG_DEBUG,
+              "[table][select][targets] "
+              "an expression that refers other expressions is used: "
+              "use only the current thread");
+      n_workers = 1;
+    }
+  }
+  if (n_workers > 1) {
+    workers = GRN_CALLOC(sizeof(grn_table_select_targets_worker) * n_workers);
+    exprs = GRN_CALLOC(sizeof(grn_obj *) * n_targets * 2);
+    if (!workers || !exprs) {
+      ERRCLR(ctx);
+      if (workers) {
+        GRN_FREE(workers);
+        workers = NULL;
+      }
+    } else {
+      data.results = exprs + n_targets;
+    }
+  }
+  if (!workers) {
+    grn_table_select_targets_run(ctx, &data, 0, 1, NULL);
+  } else {
+    GRN_LOG(ctx, GRN_LOG_INFO,
+            "[table][select][targets] "
+            "n_workers=<%u> n_targets=<%" GRN_FMT_SIZE ">",
+            n_workers, n_targets);
+    for (; n_initialized_workers < n_workers; n_initialized_workers++) {
+      grn_table_select_targets_worker *worker =
+        &(workers[n_initialized_workers]);
+      grn_ctx *worker_ctx = &(worker->ctx);
+      grn_ctx_init(worker_ctx, 0);
+      grn_ctx_use(worker_ctx, grn_ctx_db(ctx));
+      grn_ctx_set_command_version(worker_ctx,
+                                  grn_ctx_get_command_version(ctx));
+      grn_ctx_set_match_escalation_threshold(
+        worker_ctx,
+        grn_ctx_get_match_escalation_threshold(ctx));
+      grn_ctx_set_force_match_escalation(
+        worker_ctx,
+        grn_ctx_get_force_match_escalation(ctx));
+      /* Targets are already processed in parallel. */
+      worker_ctx->impl->table_select_n_workers = 1;
+      worker->data = &data;
+      worker->offset = n_initialized_workers;
+      worker->step = n_workers;
+      worker->exprs = exprs;
+      for (j = worker->offset; j < n_targets; j += worker->step) {
+        exprs[j] = grn_expr_copy_to_ctx(ctx, targets[j].expr, worker_ctx);
+        if (!exprs[j]) {
+          break;
+        }
+      }
+      if (ctx->rc != GRN_SUCCESS) {
+        n_initialized_workers++;
+        break;
+      }
+    }
+    if (ctx->rc == GRN_SUCCESS) {
+      for (i = 0; i < n_workers; i++) {
+        grn_table_select_targets_worker *worker = &(workers[i]);
+        if (THREAD_CREATE(worker->thread,
+                          grn_table_select_targets_worker_run,
+                          worker) == 0) {
+          worker->thread_created = GRN_TRUE;
+        } else {
+          GRN_LOG(ctx, GRN_LOG_WARNING,
+                  "[table][select][targets][worker] "
+                  "failed to create a thread: <%u>: "
+                  "run in the current thread",
+                  i);
+          grn_table_select_targets_worker_run(worker);
+        }
+      }
+      for (i = 0; i < n_workers; i++) {
+        grn_table_select_targets_worker *worker = &(workers[i]);
+        if (worker->thread_created) {
+          THREAD_JOIN(worker->thread);
+        }
+      }
+      for (i = 0; i < n_workers; i++) {
+        grn_table_select_targets_worker *worker = &(workers[i]);
+        if (worker->rc != GRN_SUCCESS) {
+          ERR(worker->rc,
+              "[table][select][targets][worker] %s",
+              worker->ctx.errbuf);
+          break;
+        }
+      }
+    }
+    /* Results of workers must be merged and closed before their
+     * contexts are finalized because their memory belongs to the
+     * contexts. The j-th target is processed by the (j % n_workers)-th
+     * worker. */
+    for (j = 0; j < n_targets; j++) {
+      grn_obj *result = data.results[j];
+      if (!result) {
+        continue;
+      }
+      if (ctx->rc == GRN_SUCCESS) {
+        grn_table_setoperation(ctx,
+                               targets[j].result,
+                               result,
+                               targets[j].result,
+                               GRN_OP_OR);
+      }
+      grn_obj_close(&(workers[j % n_workers].ctx), result);
+    }
+    for (i = 0; i < n_initialized_workers; i++) {
+      grn_table_select_targets_worker *worker = &(workers[i]);
+      for (j = worker->offset; j < n_targets; j += worker->step) {
+        if (exprs[j]) {
+          grn_obj_close(&(worker->ctx), exprs[j]);
+        }
+      }
+      grn_ctx_fin(&(worker->ctx));
+    }
+    GRN_FREE(workers);
+  }
+  if (exprs) {
+    GRN_FREE(exprs);
+  }
+
+  /* Targets that aren't dispatched by early termination have no
+   * result. */
+  for (j = 0; j < n_targets; j++) {
+    if (!data.dispatched[j]) {
+      grn_obj_close(ctx, targets[j].result);
+      targets[j].result = NULL;
+    }
+  }
+
+  CRITICAL_SECTION_FIN(data.lock);
+  GRN_FREE(data.dispatched);
+
+exit :
+  if (ctx->rc != GRN_SUCCESS) {
+    for (j = 0; j < n_targets; j++) {
+      if (targets[j].result) {
+        grn_obj_close(ctx, targets[j].result);
+        targets[j].result = NULL;
+      }
+    }
+  }
+  GRN_API_RETURN(ctx->rc);
+}
+
 /* grn_expr_parse */
 
 grn_obj *
@@ -5863,29 +7421,90 @@ exit :
 static grn_rc
 get_string(grn_ctx *ctx, efs_info *q, char quote)
 {
+  return grn_expr_parse_script_string(ctx,
+                                      q->cur,
+                                      q->str_end,
+                                      &(q->buf),
+                                      &(q->cur));
+}
+
+grn_rc
+grn_expr_parse_script_string(grn_ctx *ctx,
+                             const char *start,
+                             const char *end,
+                             grn_obj *buffer,
+                             const char **rest)
+{
+  const char quote = *start;
   const char *s;
   unsigned int len;
   grn_rc rc = GRN_END_OF_DATA;
-  GRN_BULK_REWIND(&q->buf);
-  for (s = q->cur + 1; s < q->str_end; s += len) {
-    if (!(len = grn_charlen(ctx, s, q->str_end))) { break; }
+  GRN_BULK_REWIND(buffer);
+  for (s = start + 1; s < end; s += len) {
+    if (!(len = grn_charlen(ctx, s, end))) { break; }
     if (len == 1) {
       if (*s == quote) {
         s++;
         rc = GRN_SUCCESS;
         break;
       }
-      if (*s == GRN_QUERY_ESCAPE && s + 1 < q->str_end) {
+      if (*s == GRN_QUERY_ESCAPE && s + 1 < end) {
         s++;
-        if (!(len = grn_charlen(ctx, s, q->str_end))) { break; }
+        if (!(len = grn_charlen(ctx, s, end))) { break; }
       }
     }
-    GRN_TEXT_PUT(ctx, &q->buf, s, len);
+    GRN_TEXT_PUT(ctx, buffer, s, len);
   }
-  q->cur = s;
+  *rest = s;
   return rc;
 }
 
+const char *
+grn_expr_parse_script_number(grn_ctx *ctx,
+                             const char *start,
+                             const char *end,
+                             grn_obj *number)
+{
+  const char *rest;
+  int64_t int64 = grn_atoll(start, end, &rest);
+  // checks to see grn_atoll was appropriate
+  // (NOTE: *start begins with a digit. Thus, grn_atoll parses at least
+  //        one char.)
+  if (end != rest &&
+      (*rest == '.' || *rest == 'e' || *rest == 'E' ||
+       (*rest >= '0' && *rest <= '9'))) {
+    grn_obj buffer;
+    char *rest_float;
+    double d;
+    GRN_TEXT_INIT(&buffer, 0);
+    GRN_TEXT_SET(ctx, &buffer, start, end - start);
+    GRN_TEXT_PUTC(ctx, &buffer, '\0');
+    errno = 0;
+    d = strtod(GRN_TEXT_VALUE(&buffer), &rest_float);
+    rest = start + (rest_float - GRN_TEXT_VALUE(&buffer));
+    GRN_OBJ_FIN(ctx, &buffer);
+    grn_obj_reinit(ctx, number, GRN_DB_FLOAT, 0);
+    GRN_FLOAT_SET(ctx, number, d);
+  } else {
+    const char *rest64 = rest;
+    grn_atoui(start, end, &rest);
+    // checks to see grn_atoi failed (see above NOTE)
+    if ((int64 > UINT32_MAX) ||
+        (end != rest && *rest >= '0' && *rest <= '9')) {
+      grn_obj_reinit(ctx, number, GRN_DB_INT64, 0);
+      GRN_INT64_SET(ctx, number, int64);
+      rest = rest64;
+    } else if (int64 > INT32_MAX || int64 < INT32_MIN) {
+      grn_obj_reinit(ctx, number, GRN_DB_INT64, 0);
+      GRN_INT64_SET(ctx, number, int64);
+    } else {
+      grn_obj_reinit(ctx, number, GRN_DB_INT32, 0);
+      GRN_INT32_SET(ctx, number, (int32_t)int64);
+    }
+  }
+  return rest;
+}
+
 static grn_obj *
 resolve_top_level_name(grn_ctx *ctx, const char *name, unsigned int name_size)
 {
@@ -6531,50 +8150,11 @@ parse_script(grn_ctx *ctx, efs_info *q)
     case '5' : case '6' : case '7' : case '8' : case '9' :
       {
         const char *rest;
-        int64_t int64 = grn_atoll(q->cur, q->str_end, &rest);
-        // checks to see grn_atoll was appropriate
-        // (NOTE: *q->cur begins with a digit. Thus, grn_atoll parses at least
-        //        one char.)
-        if (q->str_end != rest &&
-            (*rest == '.' || *rest == 'e' || *rest == 'E' ||
-             (*rest >= '0' && *rest <= '9'))) {
-          grn_obj buffer;
-          char *rest_float;
-          double d;
-          grn_obj floatbuf;
-          GRN_TEXT_INIT(&buffer, 0);
-          GRN_TEXT_SET(ctx, &buffer, q->cur, q->str_end - q->cur);
-          GRN_TEXT_PUTC(ctx, &buffer, '\0');
-          errno = 0;
-          d = strtod(GRN_TEXT_VALUE(&buffer), &rest_float);
-          rest = q->cur + (rest_float - GRN_TEXT_VALUE(&buffer));
-          GRN_OBJ_FIN(ctx, &buffer);
-          GRN_FLOAT_INIT(&floatbuf, 0);
-          GRN_FLOAT_SET(ctx, &floatbuf, d);
-          grn_expr_append_const(ctx, q->e, &floatbuf, GRN_OP_PUSH, 1);
-        } else {
-          const char *rest64 = rest;
-          grn_atoui(q->cur, q->str_end, &rest);
-          // checks to see grn_atoi failed (see above NOTE)
-          if ((int64 > UINT32_MAX) ||
-              (q->str_end != rest && *rest >= '0' && *rest <= '9')) {
-            grn_obj int64buf;
-            GRN_INT64_INIT(&int64buf, 0);
-            GRN_INT64_SET(ctx, &int64buf, int64);
-            grn_expr_append_const(ctx, q->e, &int64buf, GRN_OP_PUSH, 1);
-            rest = rest64;
-          } else if (int64 > INT32_MAX || int64 < INT32_MIN) {
-            grn_obj int64buf;
-            GRN_INT64_INIT(&int64buf, 0);
-            GRN_INT64_SET(ctx, &int64buf, int64);
-            grn_expr_append_const(ctx, q->e, &int64buf, GRN_OP_PUSH, 1);
-          } else {
-            grn_obj int32buf;
-            GRN_INT32_INIT(&int32buf, 0);
-            GRN_INT32_SET(ctx, &int32buf, (int32_t)int64);
-            grn_expr_append_const(ctx, q->e, &int32buf, GRN_OP_PUSH, 1);
-          }
-        }
+        grn_obj number;
+        GRN_VOID_INIT(&number);
+        rest = grn_expr_parse_script_number(ctx, q->cur, q->str_end, &number);
+        grn_expr_append_const(ctx, q->e, &number, GRN_OP_PUSH, 1);
+        GRN_OBJ_FIN(ctx, &number);
         PARSE(GRN_EXPR_TOKEN_DECIMAL);
         q->cur = rest;
       }
@@ -6599,8 +8179,25 @@ grn_expr_parse(grn_ctx *ctx, grn_obj *expr,
                grn_operator default_op, grn_expr_flags flags)
 {
   efs_info efsi;
+  grn_expr_cache_lookup cache_lookup;
+  grn_bool use_cache;
   if (grn_expr_parser_open(ctx)) { return ctx->rc; }
   GRN_API_ENTER;
+  use_cache = grn_expr_cache_lookup_init(ctx,
+                                         &cache_lookup,
+                                         expr,
+                                         str,
+                                         str_size,
+                                         default_column,
+                                         default_mode,
+                                         default_op,
+                                         flags);
+  if (use_cache) {
+    if (grn_expr_cache_lookup_fetch(ctx, &cache_lookup, expr)) {
+      grn_expr_cache_lookup_fin(ctx, &cache_lookup);
+      GRN_API_RETURN(ctx->rc);
+    }
+  }
   efsi.ctx = ctx;
   efsi.str = str;
   if ((efsi.v = grn_expr_get_var_by_offset(ctx, expr, 0)) &&
@@ -6688,6 +8285,12 @@ grn_expr_parse(grn_ctx *ctx, grn_obj *expr,
   } else {
     ERR(GRN_INVALID_ARGUMENT, "variable is not defined correctly");
   }
+  if (use_cache) {
+    if (ctx->rc == GRN_SUCCESS) {
+      grn_expr_cache_lookup_update(ctx, &cache_lookup, expr);
+    }
+    grn_expr_cache_lookup_fin(ctx, &cache_lookup);
+  }
   GRN_API_RETURN(ctx->rc);
 }
 
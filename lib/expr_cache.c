@@ -0,0 +1,1055 @@
+/* -*- c-basic-offset: 2 -*- */
+/*
+  Copyright(C) 2019 Kouhei Sutou <kou@clear-code.com>
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License version 2.1 as published by the Free Software Foundation.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "grn_expr_cache.h"
+#include "grn_ctx_impl.h"
+#include "grn_db.h"
+#include "grn_expr.h"
+#include "grn_hash.h"
+
+#include <string.h>
+
+static uint32_t grn_expr_cache_max_n_entries = 100;
+
+void
+grn_expr_cache_init_from_env(void)
+{
+  char grn_expr_cache_max_n_entries_env[GRN_ENV_BUFFER_SIZE];
+  grn_getenv("GRN_EXPR_CACHE_MAX_N_ENTRIES",
+             grn_expr_cache_max_n_entries_env,
+             GRN_ENV_BUFFER_SIZE);
+  if (grn_expr_cache_max_n_entries_env[0]) {
+    grn_expr_cache_max_n_entries =
+      grn_atoui(grn_expr_cache_max_n_entries_env,
+                grn_expr_cache_max_n_entries_env +
+                strlen(grn_expr_cache_max_n_entries_env),
+                NULL);
+  }
+}
+
+typedef enum {
+  GRN_EXPR_CACHE_VALUE_NULL,
+  GRN_EXPR_CACHE_VALUE_VARIABLE,
+  GRN_EXPR_CACHE_VALUE_DEFAULT_COLUMN,
+  GRN_EXPR_CACHE_VALUE_OBJECT,
+  GRN_EXPR_CACHE_VALUE_ACCESSOR,
+  GRN_EXPR_CACHE_VALUE_CONST
+} grn_expr_cache_value_type;
+
+typedef struct {
+  /* code.value is used only for GRN_EXPR_CACHE_VALUE_OBJECT. */
+  grn_expr_code code;
+  grn_expr_cache_value_type value_type;
+  uint32_t value_index;
+} grn_expr_cache_code;
+
+typedef struct {
+  /* -1 means NULL. */
+  int32_t code_index;
+  grn_id domain;
+  unsigned char type;
+} grn_expr_cache_dfi;
+
+typedef struct {
+  uint32_t offset;
+  uint32_t length;
+  grn_bool is_parameter;
+} grn_expr_cache_literal;
+
+typedef struct _grn_expr_cache_entry grn_expr_cache_entry;
+
+struct _grn_expr_cache_entry {
+  grn_expr_cache_entry *prev;
+  grn_expr_cache_entry *next;
+  grn_id id;
+  uint32_t schema_generation;
+  grn_expr_cache_code *codes;
+  uint32_t n_codes;
+  uint32_t nvars;
+  grn_obj *consts;
+  /* The index of the literal bound to each constant. -1 means that
+     the constant is copied as is. */
+  int32_t *const_literals;
+  uint32_t n_consts;
+  grn_obj **accessors;
+  uint32_t n_accessors;
+  grn_expr_cache_dfi *dfis;
+  uint32_t n_dfis;
+  int32_t code0_index;
+  grn_bool clear_cacheable;
+  grn_bool set_taintable;
+  /* Literals can't be re-bound when the parser doesn't create a
+     constant for each literal as is. The entry is used only for the
+     same text in the case. */
+  grn_bool parameterized;
+  grn_obj text;
+};
+
+struct _grn_expr_cache {
+  grn_ctx ctx;
+  grn_hash *entries;
+  grn_critical_section lock;
+  grn_expr_cache_entry *head;
+  grn_expr_cache_entry *tail;
+  uint32_t max_n_entries;
+};
+
+#define GRN_EXPR_CACHE_KEY_HEADER_SIZE                                  \
+  (sizeof(grn_id) * 2 + sizeof(grn_expr_flags) + sizeof(int32_t) * 2 + 2)
+#define GRN_EXPR_CACHE_LITERAL_MARK '\0'
+#define GRN_EXPR_CACHE_LITERAL_STRING 's'
+
+grn_expr_cache *
+grn_expr_cache_open(grn_ctx *ctx)
+{
+  grn_expr_cache *cache;
+
+  cache = GRN_CALLOC(sizeof(grn_expr_cache));
+  if (!cache) {
+    ERR(GRN_NO_MEMORY_AVAILABLE,
+        "[expr][cache][open] failed to allocate expression cache");
+    return NULL;
+  }
+
+  grn_ctx_init(&(cache->ctx), 0);
+  cache->entries = grn_hash_create(&(cache->ctx),
+                                   NULL,
+                                   GRN_TABLE_MAX_KEY_SIZE,
+                                   sizeof(grn_expr_cache_entry *),
+                                   GRN_OBJ_KEY_VAR_SIZE);
+  if (!cache->entries) {
+    ERR(GRN_NO_MEMORY_AVAILABLE,
+        "[expr][cache][open] failed to create hash table: %s",
+        cache->ctx.errbuf);
+    grn_ctx_fin(&(cache->ctx));
+    GRN_FREE(cache);
+    return NULL;
+  }
+  CRITICAL_SECTION_INIT(cache->lock);
+  cache->head = NULL;
+  cache->tail = NULL;
+  cache->max_n_entries = grn_expr_cache_max_n_entries;
+
+  return cache;
+}
+
+static void
+grn_expr_cache_entry_free(grn_ctx *ctx, grn_expr_cache_entry *entry)
+{
+  uint32_t i;
+
+  for (i = 0; i < entry->n_consts; i++) {
+    GRN_OBJ_FIN(ctx, &(entry->consts[i]));
+  }
+  for (i = 0; i < entry->n_accessors; i++) {
+    grn_obj_close(ctx, entry->accessors[i]);
+  }
+  GRN_OBJ_FIN(ctx, &(entry->text));
+  if (entry->codes) {
+    GRN_FREE(entry->codes);
+  }
+  if (entry->consts) {
+    GRN_FREE(entry->consts);
+  }
+  if (entry->const_literals) {
+    GRN_FREE(entry->const_literals);
+  }
+  if (entry->accessors) {
+    GRN_FREE(entry->accessors);
+  }
+  if (entry->dfis) {
+    GRN_FREE(entry->dfis);
+  }
+  GRN_FREE(entry);
+}
+
+void
+grn_expr_cache_close(grn_ctx *ctx, grn_expr_cache *cache)
+{
+  grn_expr_cache_entry *entry;
+  grn_expr_cache_entry *next;
+
+  if (!cache) {
+    return;
+  }
+
+  for (entry = cache->head; entry; entry = next) {
+    next = entry->next;
+    grn_expr_cache_entry_free(&(cache->ctx), entry);
+  }
+  grn_hash_close(&(cache->ctx), cache->entries);
+  CRITICAL_SECTION_FIN(cache->lock);
+  grn_ctx_fin(&(cache->ctx));
+  GRN_FREE(cache);
+}
+
+static void
+grn_expr_cache_unlink_entry(grn_expr_cache *cache, grn_expr_cache_entry *entry)
+{
+  if (entry->prev) {
+    entry->prev->next = entry->next;
+  } else {
+    cache->head = entry->next;
+  }
+  if (entry->next) {
+    entry->next->prev = entry->prev;
+  } else {
+    cache->tail = entry->prev;
+  }
+  entry->prev = NULL;
+  entry->next = NULL;
+}
+
+static void
+grn_expr_cache_prepend_entry(grn_expr_cache *cache, grn_expr_cache_entry *entry)
+{
+  entry->prev = NULL;
+  entry->next = cache->head;
+  if (cache->head) {
+    cache->head->prev = entry;
+  } else {
+    cache->tail = entry;
+  }
+  cache->head = entry;
+}
+
+static void
+grn_expr_cache_delete_entry(grn_expr_cache *cache, grn_expr_cache_entry *entry)
+{
+  grn_expr_cache_unlink_entry(cache, entry);
+  grn_hash_delete_by_id(&(cache->ctx), cache->entries, entry->id, NULL);
+  grn_expr_cache_entry_free(&(cache->ctx), entry);
+}
+
+void
+grn_expr_cache_clear(grn_ctx *ctx, grn_expr_cache *cache)
+{
+  if (!cache) {
+    return;
+  }
+
+  CRITICAL_SECTION_ENTER(cache->lock);
+  while (cache->tail) {
+    grn_expr_cache_delete_entry(cache, cache->tail);
+  }
+  CRITICAL_SECTION_LEAVE(cache->lock);
+}
+
+static grn_bool
+grn_expr_cache_is_persistent_object(grn_obj *object)
+{
+  grn_id id;
+  if (!GRN_DB_OBJP(object)) {
+    return GRN_FALSE;
+  }
+  id = DB_OBJ(object)->id;
+  return id != GRN_ID_NIL && !(id & GRN_OBJ_TMP_OBJECT);
+}
+
+static grn_bool
+grn_expr_cache_is_persistent_accessor(grn_obj *accessor)
+{
+  grn_accessor *a;
+  for (a = (grn_accessor *)accessor; a; a = a->next) {
+    if (a->obj && !grn_expr_cache_is_persistent_object(a->obj)) {
+      return GRN_FALSE;
+    }
+  }
+  return GRN_TRUE;
+}
+
+/* Normalizes expression text in script syntax. String and number
+   literals are replaced with a mark and their type because parsed
+   codes don't depend on their values. Numbers just after "-" or "+"
+   are kept because the parser may fold them into a constant. */
+static grn_bool
+grn_expr_cache_lookup_normalize_script(grn_ctx *ctx,
+                                       grn_expr_cache_lookup *lookup)
+{
+  const char *start = lookup->str;
+  const char *end = start + lookup->str_size;
+  const char *current = start;
+  char previous = '\0';
+  grn_bool succeeded = GRN_TRUE;
+  grn_obj value;
+
+  GRN_VOID_INIT(&value);
+  while (current < end) {
+    const char *rest;
+    grn_expr_cache_literal literal;
+    int space_length;
+    unsigned int length = grn_charlen(ctx, current, end);
+    if (length == 0) {
+      succeeded = GRN_FALSE;
+      break;
+    }
+    space_length = grn_isspace(current, ctx->encoding);
+    if (space_length > 0) {
+      GRN_TEXT_PUT(ctx, &(lookup->key), current, space_length);
+      current += space_length;
+      continue;
+    }
+    switch (length == 1 ? current[0] : 'a') {
+    case '"' :
+    case '\'' :
+      if (grn_expr_parse_script_string(ctx,
+                                       current,
+                                       end,
+                                       &value,
+                                       &rest) != GRN_SUCCESS) {
+        succeeded = GRN_FALSE;
+        break;
+      }
+      literal.offset = current - start;
+      literal.length = rest - current;
+      literal.is_parameter = GRN_TRUE;
+      GRN_TEXT_PUT(ctx, &(lookup->literals), &literal, sizeof(literal));
+      GRN_TEXT_PUTC(ctx, &(lookup->key), GRN_EXPR_CACHE_LITERAL_MARK);
+      GRN_TEXT_PUTC(ctx, &(lookup->key), GRN_EXPR_CACHE_LITERAL_STRING);
+      current = rest;
+      break;
+    case '0' : case '1' : case '2' : case '3' : case '4' :
+    case '5' : case '6' : case '7' : case '8' : case '9' :
+      rest = grn_expr_parse_script_number(ctx, current, end, &value);
+      literal.offset = current - start;
+      literal.length = rest - current;
+      literal.is_parameter = !(previous == '-' || previous == '+');
+      GRN_TEXT_PUT(ctx, &(lookup->literals), &literal, sizeof(literal));
+      if (literal.is_parameter) {
+        GRN_TEXT_PUTC(ctx, &(lookup->key), GRN_EXPR_CACHE_LITERAL_MARK);
+        GRN_TEXT_PUTC(ctx, &(lookup->key), (char)(value.header.domain));
+      } else {
+        GRN_TEXT_PUT(ctx, &(lookup->key), current, rest - current);
+      }
+      current = rest;
+      break;
+    case '*' :
+      rest = current + 1;
+      if (rest < end && (*rest == 'N' || *rest == 'S' || *rest == 'Q')) {
+        rest++;
+        grn_atoi(rest, end, &rest);
+      }
+      GRN_TEXT_PUT(ctx, &(lookup->key), current, rest - current);
+      current = rest;
+      break;
+    case '\0' :
+      succeeded = GRN_FALSE;
+      break;
+    case '(' : case ')' : case '{' : case '}' : case '[' : case ']' :
+    case ',' : case '.' : case ':' : case '@' : case '~' : case '?' :
+    case '+' : case '-' : case '|' : case '/' : case '%' : case '!' :
+    case '^' : case '&' : case '>' : case '<' : case '=' :
+      GRN_TEXT_PUTC(ctx, &(lookup->key), current[0]);
+      current++;
+      break;
+    default :
+      /* The same delimiters as get_identifier() in expr.c. */
+      rest = current;
+      while (rest < end) {
+        length = grn_charlen(ctx, rest, end);
+        if (length == 0 || grn_isspace(rest, ctx->encoding)) {
+          break;
+        }
+        if (length == 1 && strchr("()[]{},:@?\"*+-|/%!^&><=~", rest[0])) {
+          break;
+        }
+        rest += length;
+      }
+      GRN_TEXT_PUT(ctx, &(lookup->key), current, rest - current);
+      current = rest;
+      break;
+    }
+    if (!succeeded) {
+      break;
+    }
+    if (current > start) {
+      previous = current[-1];
+    }
+  }
+  GRN_OBJ_FIN(ctx, &value);
+
+  return succeeded;
+}
+
+grn_bool
+grn_expr_cache_lookup_init(grn_ctx *ctx,
+                           grn_expr_cache_lookup *lookup,
+                           grn_obj *expr,
+                           const char *str,
+                           unsigned int str_size,
+                           grn_obj *default_column,
+                           grn_operator default_mode,
+                           grn_operator default_op,
+                           grn_expr_flags flags)
+{
+  grn_expr *e = (grn_expr *)expr;
+  grn_obj *db = grn_ctx_db(ctx);
+  grn_hash *vars;
+  unsigned int nvars;
+  grn_obj *variable;
+  grn_id table_id;
+  int32_t mode = default_mode;
+  int32_t op = default_op;
+  /* The parser uses only the type and the range of the default
+     column. So the default column itself isn't a part of the key. */
+  uint8_t default_column_type = GRN_VOID;
+  grn_id default_column_range = GRN_ID_NIL;
+  uint8_t encoding = ctx->encoding;
+
+  if (grn_expr_cache_max_n_entries == 0) {
+    return GRN_FALSE;
+  }
+  if (!db || !GRN_DB_P(db)) {
+    return GRN_FALSE;
+  }
+  if (flags & (GRN_EXPR_SYNTAX_OUTPUT_COLUMNS | GRN_EXPR_SYNTAX_ADJUSTER)) {
+    return GRN_FALSE;
+  }
+  if (e->code0) {
+    return GRN_FALSE;
+  }
+  vars = grn_expr_get_vars(ctx, expr, &nvars);
+  if (nvars == 0) {
+    return GRN_FALSE;
+  }
+  variable = grn_expr_get_var_by_offset(ctx, expr, 0);
+  if (!variable) {
+    return GRN_FALSE;
+  }
+  table_id = variable->header.domain;
+  if (table_id == GRN_ID_NIL || (table_id & GRN_OBJ_TMP_OBJECT)) {
+    return GRN_FALSE;
+  }
+  if (str_size == 0 ||
+      str_size > GRN_TABLE_MAX_KEY_SIZE - GRN_EXPR_CACHE_KEY_HEADER_SIZE) {
+    return GRN_FALSE;
+  }
+
+  if (default_column) {
+    default_column_type = default_column->header.type;
+    default_column_range = grn_obj_get_range(ctx, default_column);
+  }
+
+  lookup->cache = grn_db_get_expr_cache(ctx, db);
+  if (!lookup->cache) {
+    ERRCLR(ctx);
+    return GRN_FALSE;
+  }
+  lookup->str = str;
+  lookup->str_size = str_size;
+  lookup->default_column = default_column;
+  GRN_TEXT_INIT(&(lookup->key), 0);
+  GRN_TEXT_INIT(&(lookup->literals), 0);
+  GRN_TEXT_INIT(&(lookup->codes_snapshot), 0);
+  GRN_TEXT_INIT(&(lookup->dfi_snapshot), 0);
+
+  GRN_TEXT_PUT(ctx, &(lookup->key), &table_id, sizeof(grn_id));
+  GRN_TEXT_PUT(ctx, &(lookup->key), &flags, sizeof(grn_expr_flags));
+  GRN_TEXT_PUT(ctx, &(lookup->key), &mode, sizeof(int32_t));
+  GRN_TEXT_PUT(ctx, &(lookup->key), &op, sizeof(int32_t));
+  GRN_TEXT_PUT(ctx, &(lookup->key), &default_column_type, sizeof(uint8_t));
+  GRN_TEXT_PUT(ctx,
+               &(lookup->key),
+               &default_column_range,
+               sizeof(grn_id));
+  GRN_TEXT_PUT(ctx, &(lookup->key), &encoding, sizeof(uint8_t));
+  if (flags & GRN_EXPR_SYNTAX_SCRIPT) {
+    if (!grn_expr_cache_lookup_normalize_script(ctx, lookup)) {
+      grn_expr_cache_lookup_fin(ctx, lookup);
+      return GRN_FALSE;
+    }
+  } else {
+    GRN_TEXT_PUT(ctx, &(lookup->key), str, str_size);
+  }
+  if (GRN_TEXT_LEN(&(lookup->key)) > GRN_TABLE_MAX_KEY_SIZE) {
+    grn_expr_cache_lookup_fin(ctx, lookup);
+    return GRN_FALSE;
+  }
+
+  lookup->schema_generation = grn_db_get_schema_generation(ctx, db);
+  lookup->codes_start = e->codes_curr;
+  lookup->nconsts_start = e->nconsts;
+  lookup->nvars_start = nvars;
+  lookup->vars_start = vars;
+  lookup->cacheable_start = e->cacheable;
+  lookup->taintable_start = e->taintable;
+  GRN_TEXT_SET(ctx,
+               &(lookup->codes_snapshot),
+               e->codes,
+               sizeof(grn_expr_code) * e->codes_curr);
+  GRN_TEXT_SET(ctx,
+               &(lookup->dfi_snapshot),
+               GRN_BULK_HEAD(&(e->dfi)),
+               GRN_BULK_VSIZE(&(e->dfi)));
+
+  return GRN_TRUE;
+}
+
+void
+grn_expr_cache_lookup_fin(grn_ctx *ctx, grn_expr_cache_lookup *lookup)
+{
+  GRN_OBJ_FIN(ctx, &(lookup->key));
+  GRN_OBJ_FIN(ctx, &(lookup->literals));
+  GRN_OBJ_FIN(ctx, &(lookup->codes_snapshot));
+  GRN_OBJ_FIN(ctx, &(lookup->dfi_snapshot));
+}
+
+static void
+grn_expr_cache_copy_const(grn_ctx *ctx, grn_obj *dest, grn_obj *src)
+{
+  GRN_OBJ_INIT(dest, src->header.type, 0, src->header.domain);
+  if (src->header.type == GRN_VECTOR) {
+    unsigned int i, n = grn_vector_size(ctx, src);
+    for (i = 0; i < n; i++) {
+      const char *content;
+      unsigned int content_length;
+      unsigned int weight;
+      grn_id domain;
+      content_length = grn_vector_get_element(ctx,
+                                              src,
+                                              i,
+                                              &content,
+                                              &weight,
+                                              &domain);
+      grn_vector_add_element(ctx, dest, content, content_length,
+                             weight, domain);
+    }
+  } else {
+    grn_bulk_write(ctx, dest, GRN_BULK_HEAD(src), GRN_BULK_VSIZE(src));
+  }
+}
+
+static void
+grn_expr_cache_lookup_parse_literal(grn_ctx *ctx,
+                                    grn_expr_cache_lookup *lookup,
+                                    grn_expr_cache_literal *literal,
+                                    grn_obj *value)
+{
+  const char *start = lookup->str + literal->offset;
+  const char *end = start + literal->length;
+  const char *rest;
+  if (start[0] == '"' || start[0] == '\'') {
+    grn_obj_reinit(ctx, value, GRN_DB_TEXT, 0);
+    grn_expr_parse_script_string(ctx, start, end, value, &rest);
+  } else {
+    grn_expr_parse_script_number(ctx, start, end, value);
+  }
+}
+
+/* The parser may cast a constant for a literal to the type of the
+   compared column. So constants of builtin types except Bool are
+   candidates. Bool constants are created for "true" and "false". */
+static grn_bool
+grn_expr_cache_const_is_literal_candidate(grn_obj *value)
+{
+  if (value->header.type != GRN_BULK) {
+    return GRN_FALSE;
+  }
+  return (GRN_DB_BOOL < value->header.domain &&
+          value->header.domain <= GRN_DB_WGS84_GEO_POINT);
+}
+
+/* Binds each literal in the text to the constant created for it.
+   Constants are allocated in the order of literals because the parser
+   creates a constant for each literal token. The parser may cast the
+   constant later. This fails when the parser creates other constants
+   or changes a literal except casting. */
+static grn_bool
+grn_expr_cache_entry_bind_literals(grn_ctx *expr_ctx,
+                                   grn_expr_cache_entry *entry,
+                                   grn_expr_cache_lookup *lookup,
+                                   grn_bool *const_pushed)
+{
+  grn_expr_cache_literal *literals;
+  uint32_t i, n_literals;
+  uint32_t nth_literal = 0;
+  grn_bool bound = GRN_TRUE;
+  grn_obj value;
+
+  literals = (grn_expr_cache_literal *)GRN_BULK_HEAD(&(lookup->literals));
+  n_literals = GRN_BULK_VSIZE(&(lookup->literals)) /
+    sizeof(grn_expr_cache_literal);
+  GRN_VOID_INIT(&value);
+  for (i = 0; i < entry->n_consts; i++) {
+    grn_obj *constant = &(entry->consts[i]);
+    grn_expr_cache_literal *literal;
+    if (constant->header.type == GRN_UVECTOR ||
+        constant->header.type == GRN_VECTOR) {
+      bound = GRN_FALSE;
+      break;
+    }
+    if (!grn_expr_cache_const_is_literal_candidate(constant)) {
+      continue;
+    }
+    if (nth_literal == n_literals) {
+      bound = GRN_FALSE;
+      break;
+    }
+    literal = &(literals[nth_literal]);
+    if (literal->is_parameter) {
+      if (!const_pushed[i]) {
+        bound = GRN_FALSE;
+        break;
+      }
+      grn_expr_cache_lookup_parse_literal(expr_ctx, lookup, literal, &value);
+      if (value.header.domain != constant->header.domain) {
+        grn_expr_append_obj_resolve_const(expr_ctx,
+                                          &value,
+                                          constant->header.domain);
+      }
+      if (value.header.domain != constant->header.domain ||
+          GRN_BULK_VSIZE(&value) != GRN_BULK_VSIZE(constant) ||
+          memcmp(GRN_BULK_HEAD(&value),
+                 GRN_BULK_HEAD(constant),
+                 GRN_BULK_VSIZE(constant)) != 0) {
+        bound = GRN_FALSE;
+        break;
+      }
+      entry->const_literals[i] = nth_literal;
+    }
+    nth_literal++;
+  }
+  GRN_OBJ_FIN(expr_ctx, &value);
+  if (nth_literal != n_literals) {
+    bound = GRN_FALSE;
+  }
+  if (!bound) {
+    for (i = 0; i < entry->n_consts; i++) {
+      entry->const_literals[i] = -1;
+    }
+  }
+  return bound;
+}
+
+static int32_t
+grn_expr_cache_find_const(grn_expr *e, uint32_t nconsts_start, grn_obj *value)
+{
+  uint32_t i;
+  for (i = nconsts_start; i < e->nconsts; i++) {
+    uint32_t blk_id = i / GRN_EXPR_CONST_BLK_SIZE;
+    uint32_t id = i % GRN_EXPR_CONST_BLK_SIZE;
+    if (&(e->const_blks[blk_id][id]) == value) {
+      return i - nconsts_start;
+    }
+  }
+  return -1;
+}
+
+static grn_obj *
+grn_expr_cache_get_const(grn_expr *e, uint32_t i)
+{
+  return &(e->const_blks[i / GRN_EXPR_CONST_BLK_SIZE][i % GRN_EXPR_CONST_BLK_SIZE]);
+}
+
+/* Memory for the entry is allocated by ctx that is the context of the
+   cache. expr_ctx is the context that parses expr. */
+static grn_expr_cache_entry *
+grn_expr_cache_entry_open(grn_ctx *ctx,
+                          grn_ctx *expr_ctx,
+                          grn_expr_cache_lookup *lookup,
+                          grn_obj *expr)
+{
+  grn_expr *e = (grn_expr *)expr;
+  grn_expr_cache_entry *entry;
+  grn_hash *vars;
+  unsigned int nvars;
+  grn_bool *const_pushed = NULL;
+  grn_expr_dfi *dfis;
+  uint32_t i, n_consts, n_dfis_start, n_dfis;
+  grn_bool succeeded = GRN_FALSE;
+
+  vars = grn_expr_get_vars(expr_ctx, expr, &nvars);
+  if (e->codes_curr < lookup->codes_start ||
+      e->nconsts < lookup->nconsts_start ||
+      nvars != lookup->nvars_start ||
+      (void *)vars != lookup->vars_start) {
+    return NULL;
+  }
+  if (memcmp(GRN_BULK_HEAD(&(lookup->codes_snapshot)),
+             e->codes,
+             GRN_BULK_VSIZE(&(lookup->codes_snapshot))) != 0) {
+    return NULL;
+  }
+  if (GRN_BULK_VSIZE(&(e->dfi)) < GRN_BULK_VSIZE(&(lookup->dfi_snapshot)) ||
+      memcmp(GRN_BULK_HEAD(&(lookup->dfi_snapshot)),
+             GRN_BULK_HEAD(&(e->dfi)),
+             GRN_BULK_VSIZE(&(lookup->dfi_snapshot))) != 0) {
+    return NULL;
+  }
+
+  entry = GRN_CALLOC(sizeof(grn_expr_cache_entry));
+  if (!entry) {
+    return NULL;
+  }
+  GRN_TEXT_INIT(&(entry->text), 0);
+  entry->schema_generation = lookup->schema_generation;
+  entry->n_codes = e->codes_curr - lookup->codes_start;
+  n_consts = e->nconsts - lookup->nconsts_start;
+  entry->nvars = nvars;
+  n_dfis_start = GRN_BULK_VSIZE(&(lookup->dfi_snapshot)) / sizeof(grn_expr_dfi);
+  n_dfis = GRN_BULK_VSIZE(&(e->dfi)) / sizeof(grn_expr_dfi);
+  entry->n_dfis = n_dfis - n_dfis_start;
+  entry->clear_cacheable = (lookup->cacheable_start && !e->cacheable);
+  entry->set_taintable = (!lookup->taintable_start && e->taintable);
+
+  if (entry->n_codes > 0) {
+    entry->codes = GRN_MALLOCN(grn_expr_cache_code, entry->n_codes);
+    entry->accessors = GRN_MALLOCN(grn_obj *, entry->n_codes);
+    if (!entry->codes || !entry->accessors) {
+      goto exit;
+    }
+  }
+  if (n_consts > 0) {
+    entry->consts = GRN_MALLOCN(grn_obj, n_consts);
+    entry->const_literals = GRN_MALLOCN(int32_t, n_consts);
+    const_pushed = GRN_CALLOC(sizeof(grn_bool) * n_consts);
+    if (!entry->consts || !entry->const_literals || !const_pushed) {
+      goto exit;
+    }
+  }
+  if (entry->n_dfis > 0) {
+    entry->dfis = GRN_MALLOCN(grn_expr_cache_dfi, entry->n_dfis);
+    if (!entry->dfis) {
+      goto exit;
+    }
+  }
+
+  for (i = 0; i < n_consts; i++) {
+    grn_obj *constant = grn_expr_cache_get_const(e, lookup->nconsts_start + i);
+    switch (constant->header.type) {
+    case GRN_VOID :
+    case GRN_BULK :
+    case GRN_UVECTOR :
+    case GRN_VECTOR :
+      break;
+    default :
+      goto exit;
+    }
+    grn_expr_cache_copy_const(ctx, &(entry->consts[i]), constant);
+    entry->const_literals[i] = -1;
+    entry->n_consts++;
+  }
+
+  for (i = 0; i < entry->n_codes; i++) {
+    grn_expr_code *code = &(e->codes[lookup->codes_start + i]);
+    grn_expr_cache_code *cache_code = &(entry->codes[i]);
+    grn_obj *value = code->value;
+    cache_code->code = *code;
+    cache_code->code.value = NULL;
+    cache_code->value_index = 0;
+    if (!value) {
+      cache_code->value_type = GRN_EXPR_CACHE_VALUE_NULL;
+    } else if (lookup->default_column && value == lookup->default_column) {
+      cache_code->value_type = GRN_EXPR_CACHE_VALUE_DEFAULT_COLUMN;
+    } else if (value->header.impl_flags & GRN_OBJ_EXPRCONST) {
+      int32_t const_index;
+      const_index = grn_expr_cache_find_const(e, lookup->nconsts_start, value);
+      if (const_index < 0) {
+        goto exit;
+      }
+      cache_code->value_type = GRN_EXPR_CACHE_VALUE_CONST;
+      cache_code->value_index = const_index;
+      if (code->op == GRN_OP_PUSH) {
+        const_pushed[const_index] = GRN_TRUE;
+      }
+    } else if (GRN_ACCESSORP(value)) {
+      grn_obj *accessor;
+      if (!grn_expr_cache_is_persistent_accessor(value)) {
+        goto exit;
+      }
+      accessor = grn_accessor_copy(ctx, value);
+      if (!accessor) {
+        goto exit;
+      }
+      cache_code->value_type = GRN_EXPR_CACHE_VALUE_ACCESSOR;
+      cache_code->value_index = entry->n_accessors;
+      entry->accessors[entry->n_accessors++] = accessor;
+    } else if (grn_expr_cache_is_persistent_object(value)) {
+      cache_code->value_type = GRN_EXPR_CACHE_VALUE_OBJECT;
+      cache_code->code.value = value;
+    } else {
+      uint32_t j;
+      for (j = 0; j < nvars; j++) {
+        if (value == grn_expr_get_var_by_offset(expr_ctx, expr, j)) {
+          break;
+        }
+      }
+      if (j == nvars) {
+        goto exit;
+      }
+      cache_code->value_type = GRN_EXPR_CACHE_VALUE_VARIABLE;
+      cache_code->value_index = j;
+    }
+  }
+
+  dfis = ((grn_expr_dfi *)GRN_BULK_HEAD(&(e->dfi))) + n_dfis_start;
+  for (i = 0; i < entry->n_dfis; i++) {
+    grn_expr_code *code = dfis[i].code;
+    if (code) {
+      if (code < e->codes + lookup->codes_start ||
+          code >= e->codes + e->codes_curr) {
+        goto exit;
+      }
+      entry->dfis[i].code_index = code - (e->codes + lookup->codes_start);
+    } else {
+      entry->dfis[i].code_index = -1;
+    }
+    entry->dfis[i].domain = dfis[i].domain;
+    entry->dfis[i].type = dfis[i].type;
+  }
+  if (e->code0) {
+    if (e->code0 < e->codes + lookup->codes_start ||
+        e->code0 >= e->codes + e->codes_curr) {
+      goto exit;
+    }
+    entry->code0_index = e->code0 - (e->codes + lookup->codes_start);
+  } else {
+    entry->code0_index = -1;
+  }
+
+  entry->parameterized =
+    grn_expr_cache_entry_bind_literals(expr_ctx,
+                                       entry,
+                                       lookup,
+                                       const_pushed);
+  if (!entry->parameterized) {
+    GRN_TEXT_SET(ctx, &(entry->text), lookup->str, lookup->str_size);
+  }
+  succeeded = GRN_TRUE;
+
+exit :
+  if (const_pushed) {
+    GRN_FREE(const_pushed);
+  }
+  if (!succeeded) {
+    grn_expr_cache_entry_free(ctx, entry);
+    entry = NULL;
+  }
+  return entry;
+}
+
+static void
+grn_expr_cache_entry_apply(grn_ctx *ctx,
+                           grn_expr_cache_entry *entry,
+                           grn_expr_cache_lookup *lookup,
+                           grn_obj *expr)
+{
+  grn_expr *e = (grn_expr *)expr;
+  grn_expr_cache_literal *literals;
+  grn_obj **consts = NULL;
+  grn_obj **accessors = NULL;
+  grn_expr_code *codes;
+  uint32_t i;
+
+  if (grn_expr_reserve_codes(ctx, expr, entry->n_codes) != GRN_SUCCESS) {
+    return;
+  }
+  if (entry->n_consts > 0) {
+    consts = GRN_MALLOCN(grn_obj *, entry->n_consts);
+    if (!consts) {
+      ERR(GRN_NO_MEMORY_AVAILABLE,
+          "[expr][cache][apply] failed to allocate constants");
+      goto exit;
+    }
+  }
+  if (entry->n_accessors > 0) {
+    accessors = GRN_MALLOCN(grn_obj *, entry->n_accessors);
+    if (!accessors) {
+      ERR(GRN_NO_MEMORY_AVAILABLE,
+          "[expr][cache][apply] failed to allocate accessors");
+      goto exit;
+    }
+  }
+
+  literals = (grn_expr_cache_literal *)GRN_BULK_HEAD(&(lookup->literals));
+  for (i = 0; i < entry->n_consts; i++) {
+    grn_obj *constant = grn_expr_alloc_const(ctx, expr);
+    if (!constant) {
+      goto exit;
+    }
+    if (entry->const_literals[i] >= 0) {
+      GRN_VOID_INIT(constant);
+      grn_expr_cache_lookup_parse_literal(ctx,
+                                          lookup,
+                                          &(literals[entry->const_literals[i]]),
+                                          constant);
+      if (constant->header.domain != entry->consts[i].header.domain) {
+        grn_expr_append_obj_resolve_const(ctx,
+                                          constant,
+                                          entry->consts[i].header.domain);
+      }
+    } else {
+      grn_expr_cache_copy_const(ctx, constant, &(entry->consts[i]));
+    }
+    constant->header.impl_flags |= GRN_OBJ_EXPRCONST;
+    consts[i] = constant;
+  }
+  for (i = 0; i < entry->n_accessors; i++) {
+    accessors[i] = grn_accessor_copy(ctx, entry->accessors[i]);
+    if (!accessors[i]) {
+      goto exit;
+    }
+    grn_expr_take_obj(ctx, expr, accessors[i]);
+  }
+
+  codes = e->codes + e->codes_curr;
+  for (i = 0; i < entry->n_codes; i++) {
+    grn_expr_cache_code *cache_code = &(entry->codes[i]);
+    codes[i] = cache_code->code;
+    switch (cache_code->value_type) {
+    case GRN_EXPR_CACHE_VALUE_NULL :
+      codes[i].value = NULL;
+      break;
+    case GRN_EXPR_CACHE_VALUE_VARIABLE :
+      codes[i].value = grn_expr_get_var_by_offset(ctx,
+                                                  expr,
+                                                  cache_code->value_index);
+      break;
+    case GRN_EXPR_CACHE_VALUE_DEFAULT_COLUMN :
+      codes[i].value = lookup->default_column;
+      break;
+    case GRN_EXPR_CACHE_VALUE_OBJECT :
+      break;
+    case GRN_EXPR_CACHE_VALUE_ACCESSOR :
+      codes[i].value = accessors[cache_code->value_index];
+      break;
+    case GRN_EXPR_CACHE_VALUE_CONST :
+      codes[i].value = consts[cache_code->value_index];
+      break;
+    }
+  }
+  for (i = 0; i < entry->n_dfis; i++) {
+    grn_expr_dfi dfi;
+    if (entry->dfis[i].code_index >= 0) {
+      dfi.code = codes + entry->dfis[i].code_index;
+    } else {
+      dfi.code = NULL;
+    }
+    dfi.domain = entry->dfis[i].domain;
+    dfi.type = entry->dfis[i].type;
+    GRN_TEXT_PUT(ctx, &(e->dfi), &dfi, sizeof(grn_expr_dfi));
+  }
+  if (entry->code0_index >= 0) {
+    e->code0 = codes + entry->code0_index;
+  }
+  if (entry->clear_cacheable) {
+    e->cacheable = 0;
+  }
+  if (entry->set_taintable) {
+    e->taintable = 1;
+  }
+  e->codes_curr += entry->n_codes;
+
+exit :
+  if (consts) {
+    GRN_FREE(consts);
+  }
+  if (accessors) {
+    GRN_FREE(accessors);
+  }
+}
+
+grn_bool
+grn_expr_cache_lookup_fetch(grn_ctx *ctx,
+                            grn_expr_cache_lookup *lookup,
+                            grn_obj *expr)
+{
+  grn_expr_cache *cache = lookup->cache;
+  grn_expr_cache_entry **value;
+  grn_expr_cache_entry *entry;
+  grn_id id;
+  unsigned int nvars;
+  grn_bool hit = GRN_FALSE;
+
+  CRITICAL_SECTION_ENTER(cache->lock);
+  id = grn_hash_get(&(cache->ctx),
+                    cache->entries,
+                    GRN_TEXT_VALUE(&(lookup->key)),
+                    GRN_TEXT_LEN(&(lookup->key)),
+                    (void **)&value);
+  if (id == GRN_ID_NIL) {
+    goto exit;
+  }
+  entry = *value;
+  if (entry->schema_generation !=
+      grn_db_get_schema_generation(ctx, grn_ctx_db(ctx))) {
+    grn_expr_cache_delete_entry(cache, entry);
+    goto exit;
+  }
+  grn_expr_get_vars(ctx, expr, &nvars);
+  if (entry->nvars != nvars) {
+    goto exit;
+  }
+  if (!entry->parameterized &&
+      !(GRN_TEXT_LEN(&(entry->text)) == lookup->str_size &&
+        memcmp(GRN_TEXT_VALUE(&(entry->text)),
+               lookup->str,
+               lookup->str_size) == 0)) {
+    goto exit;
+  }
+  grn_expr_cache_entry_apply(ctx, entry, lookup, expr);
+  grn_expr_cache_unlink_entry(cache, entry);
+  grn_expr_cache_prepend_entry(cache, entry);
+  hit = GRN_TRUE;
+
+exit :
+  CRITICAL_SECTION_LEAVE(cache->lock);
+
+  return hit;
+}
+
+void
+grn_expr_cache_lookup_update(grn_ctx *ctx,
+                             grn_expr_cache_lookup *lookup,
+                             grn_obj *expr)
+{
+  grn_expr_cache *cache = lookup->cache;
+  grn_expr_cache_entry **value;
+  grn_expr_cache_entry *entry;
+  int added;
+
+  CRITICAL_SECTION_ENTER(cache->lock);
+  entry = grn_expr_cache_entry_open(&(cache->ctx), ctx, lookup, expr);
+  if (!entry) {
+    goto exit;
+  }
+  entry->id = grn_hash_add(&(cache->ctx),
+                           cache->entries,
+                           GRN_TEXT_VALUE(&(lookup->key)),
+                           GRN_TEXT_LEN(&(lookup->key)),
+                           (void **)&value,
+                           &added);
+  if (entry->id == GRN_ID_NIL) {
+    grn_expr_cache_entry_free(&(cache->ctx), entry);
+    goto exit;
+  }
+  if (!added) {
+    grn_expr_cache_entry *old_entry = *value;
+    grn_expr_cache_unlink_entry(cache, old_entry);
+    grn_expr_cache_entry_free(&(cache->ctx), old_entry);
+  }
+  *value = entry;
+  grn_expr_cache_prepend_entry(cache, entry);
+  while (grn_hash_size(&(cache->ctx), cache->entries) > cache->max_n_entries) {
+    grn_expr_cache_delete_entry(cache, cache->tail);
+  }
+
+exit :
+  CRITICAL_SECTION_LEAVE(cache->lock);
+  ERRCLR(&(cache->ctx));
+}
@@ -3036,6 +3036,182 @@ grn_expr_executor_fin_simple_condition_constant(grn_ctx *ctx,
               &(executor->data.simple_condition_constant.result_buffer));
 }
 
+#define GRN_EXPR_EXECUTOR_CONDITION_RA_BATCH(type, compare) do {        \
+    const type constant_value = *((type *)GRN_BULK_HEAD(constant_buffer)); \
+    for (i = 0; i < n_ids; i++) {                                       \
+      const type *raw_value;                                            \
+      type value = 0;                                                   \
+      if (need && !need[i]) {                                           \
+        results[i] = GRN_FALSE;                                         \
+        continue;                                                       \
+      }                                                                 \
+      raw_value = grn_ra_ref_cache(ctx, ra, ids[i], ra_cache);          \
+      if (raw_value) {                                                  \
+        value = *raw_value;                                             \
+      }                                                                 \
+      results[i] = (value compare constant_value);                      \
+    }                                                                   \
+  } while (0)
+
+#define GRN_EXPR_EXECUTOR_CONDITION_RA_BATCH_OP(type) do {              \
+    switch (op) {                                                       \
+    case GRN_OP_EQUAL :                                                 \
+      GRN_EXPR_EXECUTOR_CONDITION_RA_BATCH(type, ==);                   \
+      break;                                                            \
+    case GRN_OP_NOT_EQUAL :                                             \
+      GRN_EXPR_EXECUTOR_CONDITION_RA_BATCH(type, !=);                   \
+      break;                                                            \
+    case GRN_OP_LESS :                                                  \
+      GRN_EXPR_EXECUTOR_CONDITION_RA_BATCH(type, <);                    \
+      break;                                                            \
+    case GRN_OP_GREATER :                                               \
+      GRN_EXPR_EXECUTOR_CONDITION_RA_BATCH(type, >);                    \
+      break;                                                            \
+    case GRN_OP_LESS_EQUAL :                                            \
+      GRN_EXPR_EXECUTOR_CONDITION_RA_BATCH(type, <=);                   \
+      break;                                                            \
+    case GRN_OP_GREATER_EQUAL :                                         \
+      GRN_EXPR_EXECUTOR_CONDITION_RA_BATCH(type, >=);                   \
+      break;                                                            \
+    default :                                                           \
+      processed = GRN_FALSE;                                            \
+      break;                                                            \
+    }                                                                   \
+  } while (0)
+
+/* need[i] == GRN_FALSE means that ids[i] doesn't need to be
+ * evaluated. results[i] is GRN_FALSE for it. need may be NULL. */
+static void
+grn_expr_executor_exec_batch_condition_ra(grn_ctx *ctx,
+                                          grn_ra *ra,
+                                          grn_ra_cache *ra_cache,
+                                          unsigned int ra_element_size,
+                                          grn_obj *value_buffer,
+                                          grn_obj *constant_buffer,
+                                          grn_operator op,
+                                          grn_operator_exec_func *exec,
+                                          const grn_id *ids,
+                                          size_t n_ids,
+                                          const grn_bool *need,
+                                          grn_bool *results)
+{
+  size_t i;
+  grn_bool processed = GRN_FALSE;
+
+  /* Values are compared directly when they have the same type. */
+  if (value_buffer->header.domain == constant_buffer->header.domain) {
+    processed = GRN_TRUE;
+    switch (value_buffer->header.domain) {
+    case GRN_DB_INT8 :
+      GRN_EXPR_EXECUTOR_CONDITION_RA_BATCH_OP(int8_t);
+      break;
+    case GRN_DB_UINT8 :
+      GRN_EXPR_EXECUTOR_CONDITION_RA_BATCH_OP(uint8_t);
+      break;
+    case GRN_DB_INT16 :
+      GRN_EXPR_EXECUTOR_CONDITION_RA_BATCH_OP(int16_t);
+      break;
+    case GRN_DB_UINT16 :
+      GRN_EXPR_EXECUTOR_CONDITION_RA_BATCH_OP(uint16_t);
+      break;
+    case GRN_DB_INT32 :
+      GRN_EXPR_EXECUTOR_CONDITION_RA_BATCH_OP(int32_t);
+      break;
+    case GRN_DB_UINT32 :
+      GRN_EXPR_EXECUTOR_CONDITION_RA_BATCH_OP(uint32_t);
+      break;
+    case GRN_DB_INT64 :
+    case GRN_DB_TIME :
+      GRN_EXPR_EXECUTOR_CONDITION_RA_BATCH_OP(int64_t);
+      break;
+    case GRN_DB_UINT64 :
+      GRN_EXPR_EXECUTOR_CONDITION_RA_BATCH_OP(uint64_t);
+      break;
+    case GRN_DB_FLOAT :
+      /* Float equality is evaluated with DBL_EPSILON by exec. */
+      if (op == GRN_OP_EQUAL || op == GRN_OP_NOT_EQUAL) {
+        processed = GRN_FALSE;
+      } else {
+        GRN_EXPR_EXECUTOR_CONDITION_RA_BATCH_OP(double);
+      }
+      break;
+    default :
+      processed = GRN_FALSE;
+      break;
+    }
+  }
+  if (processed) {
+    return;
+  }
+
+  for (i = 0; i < n_ids; i++) {
+    void *raw_value;
+    if (need && !need[i]) {
+      results[i] = GRN_FALSE;
+      continue;
+    }
+    raw_value = grn_ra_ref_cache(ctx, ra, ids[i], ra_cache);
+    GRN_BULK_REWIND(value_buffer);
+    grn_bulk_write(ctx, value_buffer, raw_value, ra_element_size);
+    results[i] = exec(ctx, value_buffer, constant_buffer);
+  }
+}
+
+#undef GRN_EXPR_EXECUTOR_CONDITION_RA_BATCH_OP
+#undef GRN_EXPR_EXECUTOR_CONDITION_RA_BATCH
+
+static void
+grn_expr_executor_exec_batch_condition(grn_ctx *ctx,
+                                       grn_obj *target,
+                                       grn_obj *value_buffer,
+                                       grn_obj *constant_buffer,
+                                       grn_operator_exec_func *exec,
+                                       const grn_id *ids,
+                                       size_t n_ids,
+                                       const grn_bool *need,
+                                       grn_bool *results)
+{
+  size_t i;
+
+  /* Values of a variable size scalar column are read at once. They
+   * are compared without copying. */
+  if (!need &&
+      target->header.type == GRN_COLUMN_VAR_SIZE &&
+      grn_obj_is_scalar_column(ctx, target)) {
+    grn_obj values;
+    GRN_VOID_INIT(&values);
+    if (grn_column_get_values_batch(ctx, target, ids, n_ids, &values) ==
+        GRN_SUCCESS) {
+      grn_obj value;
+      GRN_OBJ_INIT(&value, GRN_BULK, GRN_OBJ_DO_SHALLOW_COPY,
+                   values.header.domain);
+      for (i = 0; i < n_ids; i++) {
+        const char *raw_value;
+        unsigned int raw_value_size;
+        raw_value_size = grn_vector_get_element(ctx, &values, i,
+                                                &raw_value, NULL, NULL);
+        GRN_TEXT_SET_REF(&value, raw_value, raw_value_size);
+        results[i] = exec(ctx, &value, constant_buffer);
+      }
+      GRN_OBJ_FIN(ctx, &value);
+    } else {
+      memset(results, 0, sizeof(grn_bool) * n_ids);
+    }
+    GRN_OBJ_FIN(ctx, &values);
+    return;
+  }
+
+  for (i = 0; i < n_ids; i++) {
+    if (need && !need[i]) {
+      results[i] = GRN_FALSE;
+      continue;
+    }
+    GRN_BULK_REWIND(value_buffer);
+    grn_obj_get_value(ctx, target, ids[i], value_buffer);
+    results[i] = exec(ctx, value_buffer, constant_buffer);
+  }
+}
+
 static void
 grn_expr_executor_init_simple_condition_ra(grn_ctx *ctx,
                                            grn_expr_executor *executor)
@@ -3067,6 +3243,7 @@ grn_expr_executor_init_simple_condition_ra(grn_ctx *ctx,
               executor->data.simple_condition_ra.ra,
               &(executor->data.simple_condition_ra.ra_element_size));
 
+  executor->data.simple_condition_ra.op = op;
   executor->data.simple_condition_ra.exec = grn_operator_to_exec_func(op);
 
   constant_buffer = &(executor->data.simple_condition_ra.constant_buffer);
@@ -3081,21 +3258,12 @@ grn_expr_executor_init_simple_condition_ra(grn_ctx *ctx,
 }
 
 static grn_bool
-grn_expr_executor_is_simple_condition_ra(grn_ctx *ctx,
-                                         grn_expr_executor *executor)
+grn_expr_executor_is_condition_codes(grn_ctx *ctx,
+                                     grn_expr_code *codes)
 {
-  grn_expr *e = (grn_expr *)(executor->expr);
-  grn_expr_code *target;
-  grn_expr_code *constant;
-  grn_expr_code *operator;
-
-  if (e->codes_curr != 3) {
-    return GRN_FALSE;
-  }
-
-  target = &(e->codes[0]);
-  constant = &(e->codes[1]);
-  operator = &(e->codes[2]);
+  grn_expr_code *target = &(codes[0]);
+  grn_expr_code *constant = &(codes[1]);
+  grn_expr_code *operator = &(codes[2]);
 
   switch (operator->op) {
   case GRN_OP_EQUAL :
@@ -3118,7 +3286,7 @@ grn_expr_executor_is_simple_condition_ra(grn_ctx *ctx,
   if (target->nargs != 1) {
     return GRN_FALSE;
   }
-  if (target->value->header.type != GRN_COLUMN_FIX_SIZE) {
+  if (!grn_obj_is_scalar_column(ctx, target->value)) {
     return GRN_FALSE;
   }
 
@@ -3135,6 +3303,24 @@ grn_expr_executor_is_simple_condition_ra(grn_ctx *ctx,
     return GRN_FALSE;
   }
 
+  return GRN_TRUE;
+}
+
+static grn_bool
+grn_expr_executor_is_condition_ra_codes(grn_ctx *ctx,
+                                        grn_expr_code *codes)
+{
+  grn_expr_code *target = &(codes[0]);
+  grn_expr_code *constant = &(codes[1]);
+
+  if (!grn_expr_executor_is_condition_codes(ctx, codes)) {
+    return GRN_FALSE;
+  }
+
+  if (target->value->header.type != GRN_COLUMN_FIX_SIZE) {
+    return GRN_FALSE;
+  }
+
   if (!grn_obj_is_reference_column(ctx, target->value)) {
     grn_obj constant_buffer;
     grn_rc rc;
@@ -3147,6 +3333,23 @@ grn_expr_executor_is_simple_condition_ra(grn_ctx *ctx,
     }
   }
 
+  return GRN_TRUE;
+}
+
+static grn_bool
+grn_expr_executor_is_simple_condition_ra(grn_ctx *ctx,
+                                         grn_expr_executor *executor)
+{
+  grn_expr *e = (grn_expr *)(executor->expr);
+
+  if (e->codes_curr != 3) {
+    return GRN_FALSE;
+  }
+
+  if (!grn_expr_executor_is_condition_ra_codes(ctx, e->codes)) {
+    return GRN_FALSE;
+  }
+
   grn_expr_executor_init_simple_condition_ra(ctx, executor);
 
   return GRN_TRUE;
@@ -3188,6 +3391,33 @@ grn_expr_executor_exec_simple_condition_ra(grn_ctx *ctx,
   return result_buffer;
 }
 
+static void
+grn_expr_executor_exec_batch_simple_condition_ra(grn_ctx *ctx,
+                                                 grn_expr_executor *executor,
+                                                 const grn_id *ids,
+                                                 size_t n_ids,
+                                                 grn_bool *results)
+{
+  if (ctx->rc) {
+    memset(results, 0, sizeof(grn_bool) * n_ids);
+    return;
+  }
+
+  grn_expr_executor_exec_batch_condition_ra(
+    ctx,
+    executor->data.simple_condition_ra.ra,
+    &(executor->data.simple_condition_ra.ra_cache),
+    executor->data.simple_condition_ra.ra_element_size,
+    &(executor->data.simple_condition_ra.value_buffer),
+    &(executor->data.simple_condition_ra.constant_buffer),
+    executor->data.simple_condition_ra.op,
+    executor->data.simple_condition_ra.exec,
+    ids,
+    n_ids,
+    NULL,
+    results);
+}
+
 static void
 grn_expr_executor_fin_simple_condition_ra(grn_ctx *ctx,
                                           grn_expr_executor *executor)
@@ -3262,53 +3492,12 @@ grn_expr_executor_is_simple_condition(grn_ctx *ctx,
                                       grn_expr_executor *executor)
 {
   grn_expr *e = (grn_expr *)(executor->expr);
-  grn_expr_code *target;
-  grn_expr_code *constant;
-  grn_expr_code *operator;
 
   if (e->codes_curr != 3) {
     return GRN_FALSE;
   }
 
-  target = &(e->codes[0]);
-  constant = &(e->codes[1]);
-  operator = &(e->codes[2]);
-
-  switch (operator->op) {
-  case GRN_OP_EQUAL :
-  case GRN_OP_NOT_EQUAL :
-  case GRN_OP_LESS :
-  case GRN_OP_GREATER :
-  case GRN_OP_LESS_EQUAL :
-  case GRN_OP_GREATER_EQUAL :
-    break;
-  default :
-    return GRN_FALSE;
-  }
-  if (operator->nargs != 2) {
-    return GRN_FALSE;
-  }
-
-  if (target->op != GRN_OP_GET_VALUE) {
-    return GRN_FALSE;
-  }
-  if (target->nargs != 1) {
-    return GRN_FALSE;
-  }
-  if (!grn_obj_is_scalar_column(ctx, target->value)) {
-    return GRN_FALSE;
-  }
-
-  if (constant->op != GRN_OP_PUSH) {
-    return GRN_FALSE;
-  }
-  if (constant->nargs != 1) {
-    return GRN_FALSE;
-  }
-  if (!constant->value) {
-    return GRN_FALSE;
-  }
-  if (constant->value->header.type != GRN_BULK) {
+  if (!grn_expr_executor_is_condition_codes(ctx, e->codes)) {
     return GRN_FALSE;
   }
 
@@ -3349,6 +3538,39 @@ grn_expr_executor_exec_simple_condition(grn_ctx *ctx,
   return result_buffer;
 }
 
+static void
+grn_expr_executor_exec_batch_simple_condition(grn_ctx *ctx,
+                                              grn_expr_executor *executor,
+                                              const grn_id *ids,
+                                              size_t n_ids,
+                                              grn_bool *results)
+{
+  grn_expr *e = (grn_expr *)(executor->expr);
+
+  if (ctx->rc) {
+    memset(results, 0, sizeof(grn_bool) * n_ids);
+    return;
+  }
+
+  if (!executor->data.simple_condition.need_exec) {
+    grn_bool result =
+      GRN_BOOL_VALUE(&(executor->data.simple_condition.result_buffer));
+    memset(results, result, sizeof(grn_bool) * n_ids);
+    return;
+  }
+
+  grn_expr_executor_exec_batch_condition(
+    ctx,
+    e->codes[0].value,
+    &(executor->data.simple_condition.value_buffer),
+    &(executor->data.simple_condition.constant_buffer),
+    executor->data.simple_condition.exec,
+    ids,
+    n_ids,
+    NULL,
+    results);
+}
+
 static void
 grn_expr_executor_fin_simple_condition(grn_ctx *ctx,
                                        grn_expr_executor *executor)
@@ -3358,6 +3580,333 @@ grn_expr_executor_fin_simple_condition(grn_ctx *ctx,
   GRN_OBJ_FIN(ctx, &(executor->data.simple_condition.constant_buffer));
 }
 
+static grn_bool
+grn_expr_executor_init_condition(grn_ctx *ctx,
+                                 grn_expr_executor_condition *condition,
+                                 grn_expr_code *codes)
+{
+  grn_obj *target = codes[0].value;
+  grn_obj *constant = codes[1].value;
+  grn_operator op = codes[2].op;
+
+  condition->target = target;
+  condition->need_exec = GRN_TRUE;
+  condition->result = GRN_FALSE;
+  condition->ra = NULL;
+  condition->ra_element_size = 0;
+  condition->op = op;
+  condition->exec = grn_operator_to_exec_func(op);
+  GRN_VOID_INIT(&(condition->value_buffer));
+  grn_obj_reinit_for(ctx, &(condition->value_buffer), target);
+
+  if (grn_expr_executor_is_condition_ra_codes(ctx, codes)) {
+    condition->ra = (grn_ra *)target;
+    GRN_RA_CACHE_INIT(condition->ra, &(condition->ra_cache));
+    grn_ra_info(ctx, condition->ra, &(condition->ra_element_size));
+    if (grn_obj_is_reference_column(ctx, target)) {
+      GRN_OBJ_INIT(&(condition->constant_buffer),
+                   GRN_BULK, 0, constant->header.domain);
+    } else {
+      GRN_VOID_INIT(&(condition->constant_buffer));
+      grn_obj_reinit_for(ctx, &(condition->constant_buffer), target);
+    }
+    grn_obj_cast(ctx, constant, &(condition->constant_buffer), GRN_FALSE);
+  } else {
+    grn_rc rc;
+
+    GRN_VOID_INIT(&(condition->constant_buffer));
+    grn_obj_reinit_for(ctx, &(condition->constant_buffer), target);
+    rc = grn_obj_cast(ctx, constant, &(condition->constant_buffer), GRN_FALSE);
+    if (rc != GRN_SUCCESS) {
+      grn_obj *type;
+
+      type = grn_ctx_at(ctx, condition->constant_buffer.header.domain);
+      if (!grn_obj_is_table(ctx, type)) {
+        /* The general executor reports the cast error. */
+        GRN_OBJ_FIN(ctx, &(condition->value_buffer));
+        GRN_OBJ_FIN(ctx, &(condition->constant_buffer));
+        return GRN_FALSE;
+      }
+      condition->need_exec = GRN_FALSE;
+      condition->result = (op == GRN_OP_NOT_EQUAL);
+    }
+  }
+
+  return GRN_TRUE;
+}
+
+static void
+grn_expr_executor_fin_condition(grn_ctx *ctx,
+                                grn_expr_executor_condition *condition)
+{
+  if (condition->ra) {
+    GRN_RA_CACHE_FIN(condition->ra, &(condition->ra_cache));
+  }
+  GRN_OBJ_FIN(ctx, &(condition->value_buffer));
+  GRN_OBJ_FIN(ctx, &(condition->constant_buffer));
+}
+
+static void
+grn_expr_executor_exec_batch_condition_node(grn_ctx *ctx,
+                                            grn_expr_executor *executor,
+                                            uint32_t node_index,
+                                            const grn_id *ids,
+                                            size_t n_ids,
+                                            const grn_bool *need,
+                                            grn_bool *results)
+{
+  grn_expr_executor_condition_node *node =
+    &(executor->data.simple_conditions.nodes[node_index]);
+  grn_bool *right_need;
+  grn_bool *right_results;
+  size_t i;
+
+  if (node->op == GRN_OP_NOP) {
+    grn_expr_executor_condition *condition = node->condition;
+    if (!condition->need_exec) {
+      for (i = 0; i < n_ids; i++) {
+        results[i] = (!need || need[i]) ? condition->result : GRN_FALSE;
+      }
+    } else if (condition->ra) {
+      grn_expr_executor_exec_batch_condition_ra(ctx,
+                                                condition->ra,
+                                                &(condition->ra_cache),
+                                                condition->ra_element_size,
+                                                &(condition->value_buffer),
+                                                &(condition->constant_buffer),
+                                                condition->op,
+                                                condition->exec,
+                                                ids,
+                                                n_ids,
+                                                need,
+                                                results);
+    } else {
+      grn_expr_executor_exec_batch_condition(ctx,
+                                             condition->target,
+                                             &(condition->value_buffer),
+                                             &(condition->constant_buffer),
+                                             condition->exec,
+                                             ids,
+                                             n_ids,
+                                             need,
+                                             results);
+    }
+    return;
+  }
+
+  /* Each operator node has its own scratch area for the right operand. */
+  right_need =
+    (grn_bool *)GRN_BULK_HEAD(&(executor->data.simple_conditions.buffer)) +
+    (node_index * 2 * n_ids);
+  right_results = right_need + n_ids;
+
+  grn_expr_executor_exec_batch_condition_node(ctx,
+                                              executor,
+                                              node->left,
+                                              ids,
+                                              n_ids,
+                                              need,
+                                              results);
+  if (node->op == GRN_OP_AND) {
+    /* The right operand is evaluated only for matched records. */
+    grn_expr_executor_exec_batch_condition_node(ctx,
+                                                executor,
+                                                node->right,
+                                                ids,
+                                                n_ids,
+                                                results,
+                                                right_results);
+    grn_memcpy(results, right_results, sizeof(grn_bool) * n_ids);
+  } else {
+    /* The right operand is evaluated only for not matched records. */
+    for (i = 0; i < n_ids; i++) {
+      right_need[i] = (!need || need[i]) && !results[i];
+    }
+    grn_expr_executor_exec_batch_condition_node(ctx,
+                                                executor,
+                                                node->right,
+                                                ids,
+                                                n_ids,
+                                                right_need,
+                                                right_results);
+    for (i = 0; i < n_ids; i++) {
+      results[i] = results[i] || right_results[i];
+    }
+  }
+}
+
+static void
+grn_expr_executor_fin_simple_conditions(grn_ctx *ctx,
+                                        grn_expr_executor *executor)
+{
+  uint32_t i;
+
+  for (i = 0; i < executor->data.simple_conditions.n_conditions; i++) {
+    grn_expr_executor_fin_condition(
+      ctx,
+      &(executor->data.simple_conditions.conditions[i]));
+  }
+  if (executor->data.simple_conditions.conditions) {
+    GRN_FREE(executor->data.simple_conditions.conditions);
+  }
+  if (executor->data.simple_conditions.nodes) {
+    GRN_FREE(executor->data.simple_conditions.nodes);
+  }
+  GRN_OBJ_FIN(ctx, &(executor->data.simple_conditions.result_buffer));
+  GRN_OBJ_FIN(ctx, &(executor->data.simple_conditions.buffer));
+}
+
+/* "COLUMN OP CONSTANT" conditions combined by && and ||. */
+static grn_bool
+grn_expr_executor_is_simple_conditions(grn_ctx *ctx,
+                                       grn_expr_executor *executor)
+{
+  grn_expr *e = (grn_expr *)(executor->expr);
+  grn_expr_code *codes = e->codes;
+  uint32_t n_codes = e->codes_curr;
+  grn_expr_executor_condition *conditions;
+  grn_expr_executor_condition_node *nodes;
+  uint32_t *stack;
+  uint32_t stack_size = 0;
+  uint32_t n_conditions = 0;
+  uint32_t n_nodes = 0;
+  uint32_t i;
+  grn_bool is_simple_conditions = GRN_TRUE;
+
+  /* At least "COND1 COND2 &&" */
+  if (n_codes < 7) {
+    return GRN_FALSE;
+  }
+  if (!(codes[n_codes - 1].op == GRN_OP_AND ||
+        codes[n_codes - 1].op == GRN_OP_OR)) {
+    return GRN_FALSE;
+  }
+
+  conditions = GRN_CALLOC(sizeof(grn_expr_executor_condition) *
+                          (n_codes / 3));
+  nodes = GRN_CALLOC(sizeof(grn_expr_executor_condition_node) * n_codes);
+  stack = GRN_MALLOC(sizeof(uint32_t) * n_codes);
+  if (!conditions || !nodes || !stack) {
+    if (conditions) {
+      GRN_FREE(conditions);
+    }
+    if (nodes) {
+      GRN_FREE(nodes);
+    }
+    if (stack) {
+      GRN_FREE(stack);
+    }
+    ERRCLR(ctx);
+    return GRN_FALSE;
+  }
+
+  for (i = 0; i < n_codes && is_simple_conditions;) {
+    grn_expr_code *code = &(codes[i]);
+    grn_expr_executor_condition_node *node;
+
+    if ((code->op == GRN_OP_AND || code->op == GRN_OP_OR) &&
+        code->nargs == 2 &&
+        stack_size >= 2) {
+      node = &(nodes[n_nodes]);
+      node->op = code->op;
+      node->right = stack[--stack_size];
+      node->left = stack[--stack_size];
+      node->condition = NULL;
+      stack[stack_size++] = n_nodes++;
+      i++;
+    } else if (i + 3 <= n_codes &&
+               grn_expr_executor_is_condition_codes(ctx, code)) {
+      grn_expr_executor_condition *condition = &(conditions[n_conditions]);
+      if (!grn_expr_executor_init_condition(ctx, condition, code)) {
+        is_simple_conditions = GRN_FALSE;
+        break;
+      }
+      n_conditions++;
+      node = &(nodes[n_nodes]);
+      node->op = GRN_OP_NOP;
+      node->left = 0;
+      node->right = 0;
+      node->condition = condition;
+      stack[stack_size++] = n_nodes++;
+      i += 3;
+    } else {
+      is_simple_conditions = GRN_FALSE;
+    }
+  }
+  if (stack_size != 1) {
+    is_simple_conditions = GRN_FALSE;
+  }
+
+  executor->data.simple_conditions.conditions = conditions;
+  executor->data.simple_conditions.n_conditions = n_conditions;
+  executor->data.simple_conditions.nodes = nodes;
+  executor->data.simple_conditions.n_nodes = n_nodes;
+  executor->data.simple_conditions.root = stack[0];
+  GRN_BOOL_INIT(&(executor->data.simple_conditions.result_buffer), 0);
+  GRN_BOOL_SET(ctx,
+               &(executor->data.simple_conditions.result_buffer),
+               GRN_FALSE);
+  GRN_TEXT_INIT(&(executor->data.simple_conditions.buffer), 0);
+  GRN_FREE(stack);
+
+  if (!is_simple_conditions) {
+    grn_expr_executor_fin_simple_conditions(ctx, executor);
+    return GRN_FALSE;
+  }
+
+  return GRN_TRUE;
+}
+
+static void
+grn_expr_executor_exec_batch_simple_conditions(grn_ctx *ctx,
+                                               grn_expr_executor *executor,
+                                               const grn_id *ids,
+                                               size_t n_ids,
+                                               grn_bool *results)
+{
+  grn_obj *buffer = &(executor->data.simple_conditions.buffer);
+  size_t buffer_size =
+    sizeof(grn_bool) * 2 * n_ids * executor->data.simple_conditions.n_nodes;
+
+  if (ctx->rc) {
+    memset(results, 0, sizeof(grn_bool) * n_ids);
+    return;
+  }
+
+  if (GRN_BULK_WSIZE(buffer) < buffer_size) {
+    if (grn_bulk_reserve(ctx, buffer, buffer_size) != GRN_SUCCESS) {
+      memset(results, 0, sizeof(grn_bool) * n_ids);
+      return;
+    }
+  }
+
+  grn_expr_executor_exec_batch_condition_node(
+    ctx,
+    executor,
+    executor->data.simple_conditions.root,
+    ids,
+    n_ids,
+    NULL,
+    results);
+}
+
+static grn_obj *
+grn_expr_executor_exec_simple_conditions(grn_ctx *ctx,
+                                         grn_expr_executor *executor,
+                                         grn_id id)
+{
+  grn_obj *result_buffer = &(executor->data.simple_conditions.result_buffer);
+  grn_bool result = GRN_FALSE;
+
+  grn_expr_executor_exec_batch_simple_conditions(ctx,
+                                                 executor,
+                                                 &id,
+                                                 1,
+                                                 &result);
+  GRN_BOOL_SET(ctx, result_buffer, result);
+  return result_buffer;
+}
+
 grn_rc
 grn_expr_executor_init(grn_ctx *ctx,
                        grn_expr_executor *executor,
@@ -3383,6 +3932,7 @@ grn_expr_executor_init(grn_ctx *ctx,
 
   executor->expr = expr;
   executor->variable = grn_expr_get_var_by_offset(ctx, expr, 0);
+  executor->exec_batch = NULL;
   if (grn_expr_executor_is_constant(ctx, executor)) {
     executor->exec = grn_expr_executor_exec_constant;
     executor->fin = grn_expr_executor_fin_constant;
@@ -3402,10 +3952,16 @@ grn_expr_executor_init(grn_ctx *ctx,
     executor->fin = grn_expr_executor_fin_simple_condition_constant;
   } else if (grn_expr_executor_is_simple_condition_ra(ctx, executor)) {
     executor->exec = grn_expr_executor_exec_simple_condition_ra;
+    executor->exec_batch = grn_expr_executor_exec_batch_simple_condition_ra;
     executor->fin = grn_expr_executor_fin_simple_condition_ra;
   } else if (grn_expr_executor_is_simple_condition(ctx, executor)) {
     executor->exec = grn_expr_executor_exec_simple_condition;
+    executor->exec_batch = grn_expr_executor_exec_batch_simple_condition;
     executor->fin = grn_expr_executor_fin_simple_condition;
+  } else if (grn_expr_executor_is_simple_conditions(ctx, executor)) {
+    executor->exec = grn_expr_executor_exec_simple_conditions;
+    executor->exec_batch = grn_expr_executor_exec_batch_simple_conditions;
+    executor->fin = grn_expr_executor_fin_simple_conditions;
   } else {
     grn_expr_executor_init_general(ctx, executor);
     executor->exec = grn_expr_executor_exec_general;
@@ -3487,3 +4043,41 @@ grn_expr_executor_exec(grn_ctx *ctx, grn_expr_executor *executor, grn_id id)
 
   GRN_API_RETURN(value);
 }
+
+grn_bool
+grn_expr_executor_can_exec_batch(grn_ctx *ctx, grn_expr_executor *executor)
+{
+  if (!executor) {
+    return GRN_FALSE;
+  }
+
+  return executor->exec_batch != NULL;
+}
+
+grn_rc
+grn_expr_executor_exec_batch(grn_ctx *ctx,
+                             grn_expr_executor *executor,
+                             const grn_id *ids,
+                             size_t n_ids,
+                             grn_bool *results)
+{
+  GRN_API_ENTER;
+
+  if (!executor) {
+    memset(results, 0, sizeof(grn_bool) * n_ids);
+    GRN_API_RETURN(GRN_INVALID_ARGUMENT);
+  }
+
+  if (executor->exec_batch) {
+    executor->exec_batch(ctx, executor, ids, n_ids, results);
+  } else {
+    size_t i;
+    for (i = 0; i < n_ids; i++) {
+      grn_obj *result;
+      result = executor->exec(ctx, executor, ids[i]);
+      results[i] = (result && grn_obj_is_true(ctx, result));
+    }
+  }
+
+  GRN_API_RETURN(ctx->rc);
+}
@@ -26,11 +26,16 @@ extern "C" {
 
 #define GRN_CACHE_MAX_KEY_SIZE GRN_HASH_MAX_KEY_SIZE_LARGE
 
+#define GRN_CACHE_CONTENT_ENCODING_GZIP    (0x01)
+#define GRN_CACHE_CONTENT_ENCODING_DEFLATE (0x02)
+
 typedef struct {
   uint32_t nentries;
   uint32_t max_nentries;
   uint32_t nfetches;
   uint32_t nhits;
+  uint64_t size;
+  uint64_t max_size;
 } grn_cache_statistics;
 
 void grn_cache_init(void);
@@ -44,6 +49,15 @@ void grn_cache_fin(void);
 void grn_cache_get_statistics(grn_ctx *ctx, grn_cache *cache,
                               grn_cache_statistics *statistics);
 
+GRN_API void grn_cache_set_accept_content_encodings(grn_ctx *ctx,
+                                                    int content_encodings);
+GRN_API const char *grn_cache_get_output_content_encoding(grn_ctx *ctx);
+GRN_API grn_rc grn_cache_encode_output(grn_ctx *ctx,
+                                       grn_obj *head,
+                                       grn_obj *body,
+                                       grn_obj *foot,
+                                       grn_obj *output);
+
 #ifdef __cplusplus
 }
 #endif
@@ -114,6 +114,9 @@ struct _grn_com {
   grn_com_event *ev;
   void *opaque;
   grn_bool accepting;
+  uint32_t n_requests;
+  /* 0 while a worker thread processes a request from this com. */
+  uint64_t last_active_time_msec;
 };
 
 struct _grn_com_event {
@@ -157,6 +160,7 @@ grn_rc grn_com_event_stop_accept(grn_ctx *ctx, grn_com_event *ev);
 grn_rc grn_com_event_add(grn_ctx *ctx, grn_com_event *ev, grn_sock fd, int events, grn_com **com);
 grn_rc grn_com_event_mod(grn_ctx *ctx, grn_com_event *ev, grn_sock fd, int events, grn_com **com);
 GRN_API grn_rc grn_com_event_del(grn_ctx *ctx, grn_com_event *ev, grn_sock fd);
+GRN_API grn_rc grn_com_event_set_events(grn_ctx *ctx, grn_com *com, int events);
 GRN_API grn_rc grn_com_event_poll(grn_ctx *ctx, grn_com_event *ev, int timeout);
 grn_rc grn_com_event_each(grn_ctx *ctx, grn_com_event *ev, grn_com_callback *func);
 
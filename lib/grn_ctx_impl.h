@@ -215,6 +215,34 @@ struct _grn_ctx_impl {
   int64_t match_escalation_threshold;
   grn_bool force_match_escalation;
 
+  /* select portion */
+  /* 0 means that GRN_TABLE_SELECT_N_WORKERS is used. */
+  uint32_t table_select_n_workers;
+
+  /* index build portion */
+  /* 0 means that GRN_II_BUILDER_N_WORKERS is used. */
+  uint32_t ii_builder_n_workers;
+  /* Deferred index updates by load. */
+  struct _grn_ii_batch *ii_batch;
+
+  /* cache portion */
+  /* IDs of tables read by the current cacheable command. NULL means
+     that reads aren't recorded. */
+  grn_obj *cache_dependencies;
+  struct {
+    /* GRN_CACHE_CONTENT_ENCODING_* flags accepted by the client. It's
+       set by a server. A compressed cached result is output as is only
+       when one of them is accepted. */
+    int accept_content_encodings;
+    /* GRN_CACHE_CONTENT_ENCODING_* of the output buffer. 0 means that
+       the output buffer isn't compressed. The following members
+       describe the uncompressed output. */
+    int content_encoding;
+    uint32_t size;
+    uint32_t crc32;
+    uint32_t adler32;
+  } cache_output;
+
   /* lifetime portion */
   grn_proc_func *finalizer;
 
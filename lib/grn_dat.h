@@ -51,7 +51,9 @@ struct grn_dat_header {
   uint32_t file_id;
   grn_id normalizer;
   uint32_t n_dirty_opens;
-  uint32_t reserved[234];
+  /* Used only by the keys table of a database. */
+  uint32_t schema_generation;
+  uint32_t reserved[233];
 };
 
 struct _grn_dat_cursor {
@@ -24,6 +24,7 @@
 #include "grn_options.h"
 #include "grn_store.h"
 #include "grn_rset.h"
+#include "grn_expr_cache.h"
 
 #include <groonga/command.h>
 #include <groonga/token_filter.h>
@@ -52,6 +53,12 @@ struct _grn_db {
   grn_critical_section lock;
   grn_cache *cache;
   grn_options *options;
+  /* Incremented when an object is registered, renamed, removed or
+     closed (grn_obj_delete_by_id()) and when the database is unmapped
+     (grn_db_unmap()). It points to the header of the keys table to
+     share it with other processes. */
+  uint32_t *schema_generation;
+  grn_expr_cache *expr_cache;
 };
 
 #define GRN_SERIALIZED_SPEC_INDEX_SPEC   0
@@ -66,6 +73,9 @@ typedef struct {
   grn_id range;
 } grn_obj_spec;
 
+grn_expr_cache *grn_db_get_expr_cache(grn_ctx *ctx, grn_obj *db);
+uint32_t grn_db_get_schema_generation(grn_ctx *ctx, grn_obj *db);
+
 grn_bool grn_db_spec_unpack(grn_ctx *ctx,
                             grn_id id,
                             void *encoded_spec,
@@ -132,6 +142,9 @@ void grn_db_generate_pathname(grn_ctx *ctx,
                               grn_id id,
                               char *buffer);
 grn_rc grn_db_clear_dirty(grn_ctx *ctx, grn_obj *db);
+uint32_t grn_db_get_last_touched(grn_ctx *ctx, grn_obj *db);
+void grn_db_expand_cache_dependencies(grn_ctx *ctx, grn_obj *table_ids);
+void grn_table_touch_with_references(grn_ctx *ctx, grn_obj *table);
 
 grn_rc grn_db_set_option_values(grn_ctx *ctx,
                                 grn_obj *db,
@@ -360,6 +373,7 @@ enum {
   GRN_ACCESSOR_GET_MIN,
   GRN_ACCESSOR_GET_SUM,
   GRN_ACCESSOR_GET_AVG,
+  GRN_ACCESSOR_GET_APPROX_DISTINCT,
   GRN_ACCESSOR_GET_COLUMN_VALUE,
   GRN_ACCESSOR_GET_DB_OBJ,
   GRN_ACCESSOR_LOOKUP,
@@ -386,6 +400,7 @@ int grn_vector_delimit(grn_ctx *ctx, grn_obj *vector);
 int grn_vector_size(grn_ctx *ctx, grn_obj *vector);
 */
 
+grn_obj *grn_vector_body(grn_ctx *ctx, grn_obj *v);
 grn_rc grn_vector_delimit(grn_ctx *ctx, grn_obj *v, unsigned int weight, grn_id domain);
 grn_rc grn_vector_decode(grn_ctx *ctx, grn_obj *v, const char *data, uint32_t data_size);
 
@@ -463,6 +478,9 @@ grn_rc grn_db_obj_init(grn_ctx *ctx, grn_obj *db, grn_id id, grn_db_obj *obj);
 #define GRN_ACCESSORP(obj) \
   ((obj) && (((grn_obj *)(obj))->header.type == GRN_ACCESSOR))
 
+/* Copies the accessor chain. Objects in the chain aren't copied. */
+grn_obj *grn_accessor_copy(grn_ctx *ctx, grn_obj *accessor);
+
 grn_id grn_obj_register(grn_ctx *ctx, grn_obj *db, const char *name, unsigned int name_size);
 int grn_obj_is_persistent(grn_ctx *ctx, grn_obj *obj);
 void grn_obj_spec_save(grn_ctx *ctx, grn_db_obj *obj);
@@ -477,6 +495,19 @@ GRN_API grn_rc grn_expr_inspect(grn_ctx *ctx, grn_obj *buf, grn_obj *expr);
 grn_hash *grn_expr_get_vars(grn_ctx *ctx, grn_obj *expr, unsigned int *nvars);
 grn_obj *grn_expr_open(grn_ctx *ctx, grn_obj_spec *spec, const uint8_t *p, const uint8_t *pe);
 
+/* Merges result tables of grn_table_group() into results. Result tables in
+ * results that aren't created yet are created by ctx. It's useful to group
+ * records by a grn_ctx that is finished before ctx: a temporary table must be
+ * updated only by the grn_ctx that creates it, so it's grouped into
+ * local_results by the grn_ctx and merged by ctx. Tables in local_results
+ * aren't closed. */
+grn_rc grn_table_group_merge_results(grn_ctx *ctx, grn_obj *table,
+                                     grn_table_sort_key *keys,
+                                     int n_keys,
+                                     grn_table_group_result *results,
+                                     grn_table_group_result *local_results,
+                                     int n_results);
+
 GRN_API grn_rc grn_table_group_with_range_gap(grn_ctx *ctx, grn_obj *table,
                                               grn_table_sort_key *group_key,
                                               grn_obj *result_set,
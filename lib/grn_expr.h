@@ -62,6 +62,13 @@ struct _grn_expr {
   grn_obj *parent;
 };
 
+/* data flow info */
+typedef struct {
+  grn_expr_code *code;
+  grn_id domain;
+  unsigned char type;
+} grn_expr_dfi;
+
 #define SCAN_ACCESSOR                  (0x01)
 #define SCAN_PUSH                      (0x02)
 #define SCAN_POP                       (0x04)
@@ -120,6 +127,27 @@ grn_rc grn_expr_code_inspect_indented(grn_ctx *ctx,
 void grn_p_expr_code(grn_ctx *ctx, grn_expr_code *code);
 
 grn_obj *grn_expr_alloc_const(grn_ctx *ctx, grn_obj *expr);
+grn_rc grn_expr_reserve_codes(grn_ctx *ctx, grn_obj *expr, uint32_t n_codes);
+/* Casts a constant to to_domain. obj isn't changed when it can't be
+ * casted. */
+void grn_expr_append_obj_resolve_const(grn_ctx *ctx,
+                                       grn_obj *obj,
+                                       grn_id to_domain);
+
+/* Parses a string literal in script syntax. start must point to the
+ * opening quote. The unescaped value is stored into buffer. */
+grn_rc grn_expr_parse_script_string(grn_ctx *ctx,
+                                    const char *start,
+                                    const char *end,
+                                    grn_obj *buffer,
+                                    const char **rest);
+/* Parses a number literal in script syntax. start must point to a
+ * digit. number is reinitialized as Int32, Int64 or Float like the
+ * parser does. */
+const char *grn_expr_parse_script_number(grn_ctx *ctx,
+                                         const char *start,
+                                         const char *end,
+                                         grn_obj *number);
 
 grn_rc grn_ctx_expand_stack(grn_ctx *ctx);
 
@@ -140,6 +168,35 @@ grn_rc grn_expr_module_list_get_arguments(grn_ctx *ctx,
                                           unsigned int i,
                                           grn_obj *arguments);
 
+grn_obj *grn_table_select_first_n(grn_ctx *ctx,
+                                  grn_obj *table,
+                                  grn_obj *expr,
+                                  uint32_t n,
+                                  grn_bool estimate,
+                                  uint32_t *n_hits);
+
+typedef struct {
+  grn_obj *table;
+  grn_obj *expr;
+  grn_obj *result;
+} grn_table_select_target;
+
+/* Selects records from each target table by its expression. Targets
+ * are processed by grn_table_select_get_n_workers() threads. Each
+ * result is created by ctx and stored into result.
+ *
+ * If limit is zero or positive, targets that aren't started yet
+ * aren't processed when the finished targets from the first one have
+ * limit or more records in total. Their result is NULL. */
+grn_rc grn_table_select_targets(grn_ctx *ctx,
+                                grn_table_select_target *targets,
+                                size_t n_targets,
+                                int64_t limit);
+
+/* Returns the number of threads for select. select's n_workers parameter
+ * is used if it's specified. GRN_TABLE_SELECT_N_WORKERS is used otherwise. */
+uint32_t grn_table_select_get_n_workers(grn_ctx *ctx);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,86 @@
+/* -*- c-basic-offset: 2 -*- */
+/*
+  Copyright(C) 2019 Kouhei Sutou <kou@clear-code.com>
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License version 2.1 as published by the Free Software Foundation.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#pragma once
+
+#include "grn.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Per database cache of parsed filter and query expressions.
+
+   An entry is keyed by the table, the parse options and the
+   expression text. Literals in script syntax are replaced with
+   placeholders in the key. So "price > 100" and "price > 200" share
+   an entry and the latter only re-binds its literal. Entries are
+   invalidated when the database schema is changed. */
+typedef struct _grn_expr_cache grn_expr_cache;
+
+typedef struct {
+  grn_expr_cache *cache;
+  const char *str;
+  unsigned int str_size;
+  grn_obj *default_column;
+  grn_obj key;
+  grn_obj literals;
+  uint32_t schema_generation;
+  uint32_t codes_start;
+  uint32_t nconsts_start;
+  uint32_t nvars_start;
+  void *vars_start;
+  uint16_t cacheable_start;
+  uint16_t taintable_start;
+  grn_obj codes_snapshot;
+  grn_obj dfi_snapshot;
+} grn_expr_cache_lookup;
+
+void grn_expr_cache_init_from_env(void);
+
+grn_expr_cache *grn_expr_cache_open(grn_ctx *ctx);
+void grn_expr_cache_close(grn_ctx *ctx, grn_expr_cache *cache);
+/* Deletes all entries. Entries refer objects in the database by raw
+   pointers. So they must be dropped when the objects are closed. */
+void grn_expr_cache_clear(grn_ctx *ctx, grn_expr_cache *cache);
+
+/* Returns GRN_FALSE when the parse can't use the cache. lookup must
+   be finalized by grn_expr_cache_lookup_fin() only when this returns
+   GRN_TRUE. */
+grn_bool grn_expr_cache_lookup_init(grn_ctx *ctx,
+                                    grn_expr_cache_lookup *lookup,
+                                    grn_obj *expr,
+                                    const char *str,
+                                    unsigned int str_size,
+                                    grn_obj *default_column,
+                                    grn_operator default_mode,
+                                    grn_operator default_op,
+                                    grn_expr_flags flags);
+/* Appends the cached codes to expr. Returns GRN_FALSE on miss. */
+grn_bool grn_expr_cache_lookup_fetch(grn_ctx *ctx,
+                                     grn_expr_cache_lookup *lookup,
+                                     grn_obj *expr);
+/* Stores the codes appended to expr by the parser. */
+void grn_expr_cache_lookup_update(grn_ctx *ctx,
+                                  grn_expr_cache_lookup *lookup,
+                                  grn_obj *expr);
+void grn_expr_cache_lookup_fin(grn_ctx *ctx, grn_expr_cache_lookup *lookup);
+
+#ifdef __cplusplus
+}
+#endif
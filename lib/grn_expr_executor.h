@@ -26,6 +26,28 @@ extern "C" {
 
 typedef struct _grn_expr_executor grn_expr_executor;
 
+/* A "COLUMN OP CONSTANT" condition in a logical expression. */
+typedef struct {
+  grn_obj *target;
+  grn_bool need_exec;
+  grn_bool result;
+  grn_ra *ra;
+  grn_ra_cache ra_cache;
+  unsigned int ra_element_size;
+  grn_obj value_buffer;
+  grn_obj constant_buffer;
+  grn_operator op;
+  grn_operator_exec_func *exec;
+} grn_expr_executor_condition;
+
+typedef struct {
+  /* GRN_OP_AND, GRN_OP_OR or GRN_OP_NOP for a condition */
+  grn_operator op;
+  uint32_t left;
+  uint32_t right;
+  grn_expr_executor_condition *condition;
+} grn_expr_executor_condition_node;
+
 typedef union {
   struct {
     grn_obj *value;
@@ -54,6 +76,7 @@ typedef union {
     unsigned int ra_element_size;
     grn_obj value_buffer;
     grn_obj constant_buffer;
+    grn_operator op;
     grn_operator_exec_func *exec;
   } simple_condition_ra;
   struct {
@@ -63,11 +86,25 @@ typedef union {
     grn_obj constant_buffer;
     grn_operator_exec_func *exec;
   } simple_condition;
+  struct {
+    grn_obj result_buffer;
+    grn_expr_executor_condition *conditions;
+    uint32_t n_conditions;
+    grn_expr_executor_condition_node *nodes;
+    uint32_t n_nodes;
+    uint32_t root;
+    grn_obj buffer;
+  } simple_conditions;
 } grn_expr_executor_data;
 
 typedef grn_obj *(*grn_expr_executor_exec_func)(grn_ctx *ctx,
                                                 grn_expr_executor *executor,
                                                 grn_id id);
+typedef void (*grn_expr_executor_exec_batch_func)(grn_ctx *ctx,
+                                                  grn_expr_executor *executor,
+                                                  const grn_id *ids,
+                                                  size_t n_ids,
+                                                  grn_bool *results);
 typedef void (*grn_expr_executor_fin_func)(grn_ctx *ctx,
                                            grn_expr_executor *executor);
 
@@ -75,6 +112,8 @@ struct _grn_expr_executor {
   grn_obj *expr;
   grn_obj *variable;
   grn_expr_executor_exec_func exec;
+  /* NULL when the expression doesn't have a batch implementation. */
+  grn_expr_executor_exec_batch_func exec_batch;
   grn_expr_executor_fin_func fin;
   grn_expr_executor_data data;
 };
@@ -99,6 +138,17 @@ grn_expr_executor_exec(grn_ctx *ctx,
                        grn_expr_executor *executor,
                        grn_id id);
 
+grn_bool
+grn_expr_executor_can_exec_batch(grn_ctx *ctx,
+                                 grn_expr_executor *executor);
+/* results[i] is whether the expression is true for ids[i]. */
+grn_rc
+grn_expr_executor_exec_batch(grn_ctx *ctx,
+                             grn_expr_executor *executor,
+                             const grn_id *ids,
+                             size_t n_ids,
+                             grn_bool *results);
+
 #ifdef __cplusplus
 }
 #endif
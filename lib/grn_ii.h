@@ -49,6 +49,7 @@ struct _grn_ii {
     grn_ii_header_normal *normal;
     grn_ii_header_large *large;
   } header;
+  grn_ra *document_lengths; /* Only for GRN_OBJ_WITH_DOCUMENT_LENGTH */
 };
 
 /* BGQ is buffer garbage queue? */
@@ -77,6 +78,11 @@ struct _grn_ii {
 
 #define GRN_II_PSEG_NOT_ASSIGNED  0xffffffff
 
+/* Sections whose lengths are stored separately by
+ * GRN_OBJ_WITH_DOCUMENT_LENGTH. Only the total length is stored for
+ * the other sections. */
+#define GRN_II_N_SECTION_LENGTHS 7
+
 #define GRN_II_HEADER_COMMON_FIELDS                     \
   uint64_t total_chunk_size;                            \
   uint64_t bmax;                                        \
@@ -89,7 +95,16 @@ struct _grn_ii {
   uint32_t bgqhead;                                     \
   uint32_t bgqtail;                                     \
   uint32_t bgqbody[GRN_II_BGQSIZE];                     \
-  uint32_t reserved[288];                               \
+  /* Incremented whenever postings are added or deleted */ \
+  uint64_t generation;                                  \
+  /* Incremented before and after chunks are merged */  \
+  uint64_t chunk_generation;                            \
+  /* Only for GRN_OBJ_WITH_DOCUMENT_LENGTH */           \
+  uint64_t total_document_length;                       \
+  uint64_t n_documents_with_length;                     \
+  uint64_t total_section_lengths[GRN_II_N_SECTION_LENGTHS]; \
+  uint64_t n_sections_with_length[GRN_II_N_SECTION_LENGTHS]; \
+  uint32_t reserved[252];                               \
   uint32_t ainfo[GRN_II_MAX_LSEG]; /* array info */     \
   uint32_t binfo[GRN_II_MAX_LSEG]; /* buffer info */    \
   uint32_t free_chunks[GRN_II_N_CHUNK_VARIATION + 1];   \
@@ -132,6 +147,21 @@ typedef struct _grn_ii_updspec grn_ii_updspec;
 
 void grn_ii_init_from_env(void);
 
+void grn_ii_bitmap_cache_init(void);
+void grn_ii_bitmap_cache_fin(void);
+
+typedef struct {
+  size_t max_size;
+  size_t size;
+  uint32_t n_entries;
+  uint64_t n_hits;
+  uint64_t n_misses;
+} grn_ii_posting_cache_statistics;
+
+void grn_ii_posting_cache_init(void);
+void grn_ii_posting_cache_fin(void);
+void grn_ii_posting_cache_get_statistics(grn_ii_posting_cache_statistics *statistics);
+
 GRN_API grn_ii *grn_ii_create(grn_ctx *ctx, const char *path, grn_obj *lexicon,
                               uint32_t flags);
 GRN_API grn_ii *grn_ii_open(grn_ctx *ctx, const char *path, grn_obj *lexicon);
@@ -151,6 +181,13 @@ void grn_ii_expire(grn_ctx *ctx, grn_ii *ii);
 grn_rc grn_ii_flush(grn_ctx *ctx, grn_ii *ii);
 size_t grn_ii_get_disk_usage(grn_ctx *ctx, grn_ii *ii);
 
+/* section 0 means the whole document. They return 0 for a section
+ * whose length isn't stored. */
+uint32_t grn_ii_get_document_length(grn_ctx *ctx, grn_ii *ii,
+                                    grn_id rid, uint32_t section);
+double grn_ii_get_average_document_length(grn_ctx *ctx, grn_ii *ii,
+                                          uint32_t section);
+
 grn_ii_cursor *grn_ii_cursor_openv1(grn_ii *ii, uint32_t key);
 grn_rc grn_ii_cursor_openv2(grn_ii_cursor **cursors, int ncursors);
 
@@ -194,6 +231,12 @@ struct _grn_select_optarg {
 GRN_API grn_rc grn_ii_column_update(grn_ctx *ctx, grn_ii *ii, grn_id id,
                                     unsigned int section, grn_obj *oldvalue,
                                     grn_obj *newvalue, grn_obj *posting);
+
+typedef struct _grn_ii_batch grn_ii_batch;
+
+grn_ii_batch *grn_ii_batch_open(grn_ctx *ctx);
+grn_rc grn_ii_batch_flush(grn_ctx *ctx, grn_ii_batch *batch);
+grn_rc grn_ii_batch_close(grn_ctx *ctx, grn_ii_batch *batch);
 grn_rc grn_ii_term_extract(grn_ctx *ctx, grn_ii *ii, const char *string,
                             unsigned int string_len, grn_hash *s,
                             grn_operator op, grn_select_optarg *optarg);
@@ -75,7 +75,9 @@ struct grn_pat_header {
   grn_id normalizer;
   uint32_t truncated;
   uint32_t n_dirty_opens;
-  uint32_t reserved[1002];
+  /* Used only by the keys table of a database. */
+  uint32_t schema_generation;
+  uint32_t reserved[1001];
   grn_pat_delinfo delinfos[GRN_PAT_NDELINFOS];
   grn_id garbages[GRN_PAT_MAX_KEY_SIZE + 1];
 };
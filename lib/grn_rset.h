@@ -36,6 +36,22 @@ typedef struct {
   uint32_t pos;
 } grn_rset_posinfo;
 
+/* HyperLogLog sketch for GRN_TABLE_GROUP_CALC_APPROX_DISTINCT. All
+ * members are zero for no values. sum is the sum of
+ * (1 - 2^-register). estimate is updated when a register is
+ * changed. */
+#define GRN_RSET_APPROX_DISTINCT_PRECISION   10
+#define GRN_RSET_APPROX_DISTINCT_N_REGISTERS \
+  (1 << GRN_RSET_APPROX_DISTINCT_PRECISION)
+
+typedef struct {
+  int64_t estimate;
+  double sum;
+  uint32_t n_non_zero_registers;
+  uint32_t reserved;
+  uint8_t registers[GRN_RSET_APPROX_DISTINCT_N_REGISTERS];
+} grn_rset_approx_distinct;
+
 #define GRN_RSET_UTIL_BIT (0x80000000)
 
 #define GRN_RSET_N_SUBRECS_SIZE (sizeof(int))
@@ -43,6 +59,7 @@ typedef struct {
 #define GRN_RSET_MIN_SIZE       (sizeof(int64_t))
 #define GRN_RSET_SUM_SIZE       (sizeof(int64_t))
 #define GRN_RSET_AVG_SIZE       (sizeof(double) + sizeof(uint64_t))
+#define GRN_RSET_APPROX_DISTINCT_SIZE (sizeof(grn_rset_approx_distinct))
 
 #define GRN_RSET_SCORE_SIZE (sizeof(double))
 
@@ -64,6 +81,11 @@ void grn_rset_recinfo_update_calc_values(grn_ctx *ctx,
                                          grn_rset_recinfo *ri,
                                          grn_obj *table,
                                          grn_obj *value);
+void grn_rset_recinfo_merge_calc_values(grn_ctx *ctx,
+                                        grn_rset_recinfo *ri,
+                                        grn_obj *table,
+                                        grn_rset_recinfo *source_ri,
+                                        grn_obj *source_table);
 
 int64_t *grn_rset_recinfo_get_max_(grn_ctx *ctx,
                                    grn_rset_recinfo *ri,
@@ -109,6 +131,13 @@ void grn_rset_recinfo_set_avg(grn_ctx *ctx,
                               grn_obj *table,
                               double avg);
 
+int64_t *grn_rset_recinfo_get_approx_distinct_(grn_ctx *ctx,
+                                               grn_rset_recinfo *ri,
+                                               grn_obj *table);
+int64_t grn_rset_recinfo_get_approx_distinct(grn_ctx *ctx,
+                                             grn_rset_recinfo *ri,
+                                             grn_obj *table);
+
 #ifdef __cplusplus
 }
 #endif
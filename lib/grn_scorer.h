@@ -30,7 +30,9 @@ extern "C" {
 struct _grn_scorer_matched_record {
   grn_obj *table;
   grn_obj *lexicon;
+  grn_ii *ii;
   grn_id id;
+  uint32_t section_id;
   grn_obj terms;
   grn_obj term_weights;
   uint32_t total_term_weights;
@@ -41,8 +43,21 @@ struct _grn_scorer_matched_record {
   int weight;
   grn_obj *args_expr;
   unsigned int args_expr_offset;
+  /* For the previous sections of the same record. They are updated by
+     grn_scorer_matched_record_score(). */
+  grn_id previous_id;
+  uint32_t n_previous_occurrences;
+  uint32_t previous_total_term_weights;
+  /* Set by a score function that sums up normalized TF of all sections
+     by grn_scorer_matched_record_set_normalized_tf(). */
+  double normalized_tf;
+  double previous_normalized_tf;
 };
 
+double grn_scorer_matched_record_score(grn_ctx *ctx,
+                                       grn_scorer_matched_record *record,
+                                       grn_scorer_score_func *score);
+
 
 #ifdef __cplusplus
 }
@@ -30,6 +30,7 @@ extern "C" {
 /**** fixed sized elements ****/
 
 typedef struct _grn_ra grn_ra;
+typedef struct _grn_ra_zone_map grn_ra_zone_map;
 
 struct _grn_ra {
   grn_db_obj obj;
@@ -37,14 +38,21 @@ struct _grn_ra {
   int element_width;
   int element_mask;
   struct grn_ra_header *header;
+  grn_critical_section zone_map_lock;
+  grn_ra_zone_map *zone_map;
 };
 
 struct grn_ra_header {
   uint32_t element_size;
   uint32_t nrecords; /* nrecords is not maintained by default */
-  uint32_t reserved[10];
+  /* It's incremented on each grn_obj_set_value(). Zone maps built
+     before the last modification by other processes are rebuilt. */
+  uint32_t n_modifications;
+  uint32_t reserved[9];
 };
 
+void grn_store_init_from_env(void);
+
 grn_ra *grn_ra_create(grn_ctx *ctx, const char *path, unsigned int element_size);
 grn_ra *grn_ra_open(grn_ctx *ctx, const char *path);
 grn_rc grn_ra_info(grn_ctx *ctx, grn_ra *ra, unsigned int *element_size);
@@ -70,6 +78,45 @@ struct _grn_ra_cache {
 
 void *grn_ra_ref_cache(grn_ctx *ctx, grn_ra *ra, grn_id id, grn_ra_cache *cache);
 
+/* Copies values of ids to values. values must have
+   n_ids * element_size bytes. Values of nonexistent IDs are 0. */
+void grn_ra_get_values(grn_ctx *ctx, grn_ra *ra,
+                       const grn_id *ids, size_t n_ids, void *values);
+
+/* Zone maps have the min and max values of each zone of records of a
+   numeric fixed size column. They are kept in memory. A zone map is
+   built when it's used first and updated by grn_ra_zone_map_update(). */
+
+void grn_ra_zone_map_update(grn_ctx *ctx, grn_ra *ra, grn_id id,
+                            const void *value);
+
+typedef struct {
+  int zone_width;
+  uint32_t n_zones;
+  grn_bool *may_match;
+} grn_ra_zone_filter;
+
+/* Initializes filter with zones that may have a value in the range.
+   min and max must be bulks of the range of ra. NULL means no
+   bound. It returns GRN_FALSE when no zone can be skipped. filter
+   doesn't need grn_ra_zone_filter_fin() in the case. */
+grn_bool grn_ra_zone_filter_init(grn_ctx *ctx,
+                                 grn_ra_zone_filter *filter,
+                                 grn_ra *ra,
+                                 grn_obj *table,
+                                 grn_obj *min,
+                                 grn_bool min_include,
+                                 grn_obj *max,
+                                 grn_bool max_include);
+void grn_ra_zone_filter_fin(grn_ctx *ctx, grn_ra_zone_filter *filter);
+
+grn_inline static grn_bool
+grn_ra_zone_filter_may_match(grn_ra_zone_filter *filter, grn_id id)
+{
+  uint32_t zone = id >> filter->zone_width;
+  return zone >= filter->n_zones || filter->may_match[zone];
+}
+
 /**** variable sized elements ****/
 
 typedef struct _grn_ja grn_ja;
@@ -125,6 +172,7 @@ typedef struct {
   void *body_seg_addr;       /* Address of the current body segment. */
   uint32_t value_size;       /* Size of the current value. */
   uint32_t packed_size;      /* Compressed size of the current value. */
+  grn_bool packed_raw;       /* The current value is stored as is. */
   void *packed_buf;          /* Buffer for decompression. */
   uint32_t packed_buf_size;  /* Size of the buffer for decompression. */
   void *stream;              /* Stream of a compression library. */
@@ -33,6 +33,7 @@
 #include "grn_token_cursor.h"
 #include "grn_pat.h"
 #include "grn_db.h"
+#include "grn_obj.h"
 #include "grn_output.h"
 #include "grn_scorer.h"
 #include "grn_util.h"
@@ -46,6 +47,11 @@
 # include "grn_onigmo.h"
 #endif /* GRN_II_SELECT_ENABLE_SEQUENTIAL_SEARCH */
 
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+# define GRN_II_UNPACK_SIMD_X86
+# include <immintrin.h>
+#endif
+
 /* P is for physical? */
 #define MAX_PSEG                 0x20000
 #define MAX_PSEG_SMALL           0x00200
@@ -103,6 +109,16 @@ static uint32_t grn_ii_max_n_segments_small = MAX_PSEG_SMALL;
 static uint32_t grn_ii_max_n_chunks_small = GRN_II_MAX_CHUNK_SMALL;
 static int64_t grn_ii_reduce_expire_threshold = 32;
 static grn_bool grn_ii_dump_index_source_on_merge = GRN_FALSE;
+static uint32_t grn_ii_builder_n_workers = 1;
+static uint32_t grn_ii_batch_max_n_records = 0;
+static double grn_ii_bitmap_df_ratio = 0.0;
+static size_t grn_ii_bitmap_cache_max_size = 64 * 1024 * 1024;
+static size_t grn_ii_posting_cache_max_size = 0;
+static uint32_t grn_ii_chunk_skip_interval = 1024;
+
+static void grn_ii_decoder_init(const char *simd);
+static void grn_ii_bitmap_cache_forget(grn_ctx *ctx, grn_ii *ii);
+static void grn_ii_posting_cache_forget(grn_ctx *ctx, grn_ii *ii);
 
 void
 grn_ii_init_from_env(void)
@@ -228,6 +244,97 @@ grn_ii_init_from_env(void)
       grn_ii_dump_index_source_on_merge = GRN_FALSE;
     }
   }
+
+  {
+    char grn_ii_batch_max_n_records_env[GRN_ENV_BUFFER_SIZE];
+    grn_getenv("GRN_II_BATCH_MAX_N_RECORDS",
+               grn_ii_batch_max_n_records_env,
+               GRN_ENV_BUFFER_SIZE);
+    if (grn_ii_batch_max_n_records_env[0]) {
+      grn_ii_batch_max_n_records =
+        grn_atoui(grn_ii_batch_max_n_records_env,
+                  grn_ii_batch_max_n_records_env +
+                  strlen(grn_ii_batch_max_n_records_env),
+                  NULL);
+    }
+  }
+
+  {
+    char grn_ii_builder_n_workers_env[GRN_ENV_BUFFER_SIZE];
+    grn_getenv("GRN_II_BUILDER_N_WORKERS",
+               grn_ii_builder_n_workers_env,
+               GRN_ENV_BUFFER_SIZE);
+    if (grn_ii_builder_n_workers_env[0]) {
+      grn_ii_builder_n_workers =
+        grn_atoui(grn_ii_builder_n_workers_env,
+                  grn_ii_builder_n_workers_env +
+                  strlen(grn_ii_builder_n_workers_env),
+                  NULL);
+      if (grn_ii_builder_n_workers == 0) {
+        grn_ii_builder_n_workers = 1;
+      }
+    }
+  }
+
+  {
+    char grn_ii_bitmap_df_ratio_env[GRN_ENV_BUFFER_SIZE];
+    grn_getenv("GRN_II_BITMAP_DF_RATIO",
+               grn_ii_bitmap_df_ratio_env,
+               GRN_ENV_BUFFER_SIZE);
+    if (grn_ii_bitmap_df_ratio_env[0]) {
+      grn_ii_bitmap_df_ratio = atof(grn_ii_bitmap_df_ratio_env);
+    }
+  }
+
+  {
+    char grn_ii_bitmap_cache_max_size_env[GRN_ENV_BUFFER_SIZE];
+    grn_getenv("GRN_II_BITMAP_CACHE_MAX_SIZE",
+               grn_ii_bitmap_cache_max_size_env,
+               GRN_ENV_BUFFER_SIZE);
+    if (grn_ii_bitmap_cache_max_size_env[0]) {
+      grn_ii_bitmap_cache_max_size =
+        grn_atoull(grn_ii_bitmap_cache_max_size_env,
+                   grn_ii_bitmap_cache_max_size_env +
+                   strlen(grn_ii_bitmap_cache_max_size_env),
+                   NULL);
+    }
+  }
+
+  {
+    char grn_ii_posting_cache_max_size_env[GRN_ENV_BUFFER_SIZE];
+    grn_getenv("GRN_II_POSTING_CACHE_MAX_SIZE",
+               grn_ii_posting_cache_max_size_env,
+               GRN_ENV_BUFFER_SIZE);
+    if (grn_ii_posting_cache_max_size_env[0]) {
+      grn_ii_posting_cache_max_size =
+        grn_atoull(grn_ii_posting_cache_max_size_env,
+                   grn_ii_posting_cache_max_size_env +
+                   strlen(grn_ii_posting_cache_max_size_env),
+                   NULL);
+    }
+  }
+
+  {
+    char grn_ii_chunk_skip_interval_env[GRN_ENV_BUFFER_SIZE];
+    grn_getenv("GRN_II_CHUNK_SKIP_INTERVAL",
+               grn_ii_chunk_skip_interval_env,
+               GRN_ENV_BUFFER_SIZE);
+    if (grn_ii_chunk_skip_interval_env[0]) {
+      grn_ii_chunk_skip_interval =
+        grn_atoui(grn_ii_chunk_skip_interval_env,
+                  grn_ii_chunk_skip_interval_env +
+                  strlen(grn_ii_chunk_skip_interval_env),
+                  NULL);
+    }
+  }
+
+  {
+    char grn_ii_decode_simd_env[GRN_ENV_BUFFER_SIZE];
+    grn_getenv("GRN_II_DECODE_SIMD",
+               grn_ii_decode_simd_env,
+               GRN_ENV_BUFFER_SIZE);
+    grn_ii_decoder_init(grn_ii_decode_simd_env);
+  }
 }
 
 void
@@ -2051,6 +2158,175 @@ grn_p_encv(grn_ctx *ctx, datavec *dv, uint32_t dvlen, uint8_t *res)
   p = _p; \
 } while (0)
 
+#ifdef GRN_II_UNPACK_SIMD_X86
+/*
+ * SIMD versions of unpack_1()...unpack_25(). They decode 8 values per
+ * iteration just like the generated functions. Values are stored in
+ * big endian bit order. So we load 4 bytes that include each value,
+ * swap bytes, shift the value to the MSB and shift it back to the LSB.
+ *
+ * They can't process 26 or more bits width values because a value may
+ * be spread over 5 bytes. They return the number of unpacked values.
+ * The caller must unpack the rest values by the scalar version.
+ */
+#define UNPACK_SIMD_MAX_WIDTH 25
+
+__attribute__((target("sse4.1")))
+static int
+unpack_sse4_1(uint32_t *p, uint8_t **dpp, uint8_t *dpe, int w, int i)
+{
+  uint8_t *dp = *dpp;
+  int n = 0;
+  int h, j;
+  int base_offsets[2];
+  uint8_t masks[2][16];
+  uint32_t multipliers[2][4];
+  __m128i mask_vectors[2];
+  __m128i multiplier_vectors[2];
+  const __m128i rshift = _mm_cvtsi32_si128(32 - w);
+
+  for (h = 0; h < 2; h++) {
+    base_offsets[h] = (h * 4 * w) >> 3;
+    for (j = 0; j < 4; j++) {
+      int bit = (h * 4 + j) * w;
+      int offset = (bit >> 3) - base_offsets[h];
+      masks[h][j * 4 + 0] = offset + 3;
+      masks[h][j * 4 + 1] = offset + 2;
+      masks[h][j * 4 + 2] = offset + 1;
+      masks[h][j * 4 + 3] = offset;
+      multipliers[h][j] = 1 << (bit & 7);
+    }
+    mask_vectors[h] = _mm_loadu_si128((const __m128i *)masks[h]);
+    multiplier_vectors[h] = _mm_loadu_si128((const __m128i *)multipliers[h]);
+  }
+
+  /* We may read 16 bytes from the middle of the current 8 values. */
+  while (i - n >= 8 && dp + w + 16 <= dpe) {
+    for (h = 0; h < 2; h++) {
+      __m128i v =
+        _mm_loadu_si128((const __m128i *)(dp + base_offsets[h]));
+      v = _mm_shuffle_epi8(v, mask_vectors[h]);
+      v = _mm_mullo_epi32(v, multiplier_vectors[h]);
+      v = _mm_srl_epi32(v, rshift);
+      _mm_storeu_si128((__m128i *)(p + h * 4), v);
+    }
+    dp += w;
+    p += 8;
+    n += 8;
+  }
+  *dpp = dp;
+  return n;
+}
+
+__attribute__((target("avx2")))
+static int
+unpack_avx2(uint32_t *p, uint8_t **dpp, uint8_t *dpe, int w, int i)
+{
+  uint8_t *dp = *dpp;
+  int n = 0;
+  const __m256i bits =
+    _mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7),
+                       _mm256_set1_epi32(w));
+  const __m256i offsets = _mm256_srli_epi32(bits, 3);
+  const __m256i lshifts = _mm256_and_si256(bits, _mm256_set1_epi32(7));
+  const __m128i rshift = _mm_cvtsi32_si128(32 - w);
+  const __m256i bswap = _mm256_setr_epi8(3, 2, 1, 0,
+                                         7, 6, 5, 4,
+                                         11, 10, 9, 8,
+                                         15, 14, 13, 12,
+                                         3, 2, 1, 0,
+                                         7, 6, 5, 4,
+                                         11, 10, 9, 8,
+                                         15, 14, 13, 12);
+
+  /* The last value may be read from (dp + w - 1) to (dp + w + 3). */
+  while (i - n >= 8 && dp + w + 4 <= dpe) {
+    __m256i v = _mm256_i32gather_epi32((const int *)dp, offsets, 1);
+    v = _mm256_shuffle_epi8(v, bswap);
+    v = _mm256_sllv_epi32(v, lshifts);
+    v = _mm256_srl_epi32(v, rshift);
+    _mm256_storeu_si256((__m256i *)p, v);
+    dp += w;
+    p += 8;
+    n += 8;
+  }
+  *dpp = dp;
+  return n;
+}
+#endif /* GRN_II_UNPACK_SIMD_X86 */
+
+static void
+delta_decode(uint32_t *data, uint32_t n)
+{
+  uint32_t i;
+  for (i = 1; i < n; i++) {
+    data[i] += data[i - 1];
+  }
+}
+
+#ifdef GRN_II_UNPACK_SIMD_X86
+/* Prefix sum of 4 values in a register by 2 shift and add steps. */
+__attribute__((target("sse2")))
+static void
+delta_decode_sse2(uint32_t *data, uint32_t n)
+{
+  uint32_t i = 0;
+  __m128i carry = _mm_setzero_si128();
+  for (; i + 4 <= n; i += 4) {
+    __m128i v = _mm_loadu_si128((const __m128i *)(data + i));
+    v = _mm_add_epi32(v, _mm_slli_si128(v, 4));
+    v = _mm_add_epi32(v, _mm_slli_si128(v, 8));
+    v = _mm_add_epi32(v, carry);
+    _mm_storeu_si128((__m128i *)(data + i), v);
+    carry = _mm_shuffle_epi32(v, _MM_SHUFFLE(3, 3, 3, 3));
+  }
+  for (; i < n; i++) {
+    if (i > 0) {
+      data[i] += data[i - 1];
+    }
+  }
+}
+#endif /* GRN_II_UNPACK_SIMD_X86 */
+
+typedef int (*grn_ii_unpack_simd_func)(uint32_t *p,
+                                       uint8_t **dpp,
+                                       uint8_t *dpe,
+                                       int w,
+                                       int i);
+typedef void (*grn_ii_delta_decode_func)(uint32_t *data, uint32_t n);
+
+static grn_ii_unpack_simd_func grn_ii_unpack_simd = NULL;
+static grn_ii_delta_decode_func grn_ii_delta_decode = delta_decode;
+
+/*
+ * simd: "no" uses only the scalar versions. "sse4.1" and "avx2" use
+ * the specified instruction set at most. Empty value uses the best
+ * instruction set that is supported by the running CPU.
+ */
+static void
+grn_ii_decoder_init(const char *simd)
+{
+  grn_ii_unpack_simd = NULL;
+  grn_ii_delta_decode = delta_decode;
+
+  if (strcmp(simd, "no") == 0) {
+    return;
+  }
+
+#ifdef GRN_II_UNPACK_SIMD_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("sse2")) {
+    grn_ii_delta_decode = delta_decode_sse2;
+  }
+  if (__builtin_cpu_supports("sse4.1")) {
+    grn_ii_unpack_simd = unpack_sse4_1;
+  }
+  if (strcmp(simd, "sse4.1") != 0 && __builtin_cpu_supports("avx2")) {
+    grn_ii_unpack_simd = unpack_avx2;
+  }
+#endif /* GRN_II_UNPACK_SIMD_X86 */
+}
+
 static uint8_t *
 unpack(uint8_t *dp, uint8_t *dpe, int i, uint32_t *rp)
 {
@@ -2065,6 +2341,13 @@ unpack(uint8_t *dp, uint8_t *dpe, int i, uint32_t *rp)
     m = (1 << w) - 1;
   }
   if (w) {
+#ifdef GRN_II_UNPACK_SIMD_X86
+    if (grn_ii_unpack_simd && w <= UNPACK_SIMD_MAX_WIDTH && i >= 8) {
+      int n = grn_ii_unpack_simd(p, &dp, dpe, w, i);
+      p += n;
+      i -= n;
+    }
+#endif /* GRN_II_UNPACK_SIMD_X86 */
     while (i >= 8) {
       if (dp + w > dpe) { return NULL; }
       switch (w) {
@@ -4003,6 +4286,192 @@ exit :
   return ctx->rc;
 }
 
+/*
+ * Splits merged postings of a term into sub-chunks of
+ * grn_ii_chunk_skip_interval postings. Each sub-chunk has a chunk_info
+ * that has the location of the sub-chunk and the record ID gap to its
+ * last posting. They work as skip entries: grn_ii_cursor_set_min()
+ * skips sub-chunks that have only smaller record IDs without decoding
+ * them. Without this, postings are kept in one chunk until it's
+ * larger than CHUNK_SPLIT_THRESHOLD and the whole chunk is decoded to
+ * find a record.
+ *
+ * The default interval is 1024. GRN_II_CHUNK_SKIP_INTERVAL changes it
+ * and 0 disables it. The static index builder splits postings by the
+ * same interval in grn_ii_builder_read_to_chunk(). It uses the existing
+ * CHUNK_SPLIT format, so indexes are still readable by older Groonga
+ * and indexes that aren't split are read as before. Only terms that
+ * are merged or built while it's enabled are split. Each sub-chunk
+ * uses at least (1 << GRN_II_W_LEAST_CHUNK) bytes, so a small interval
+ * increases the chunk size of the index. 1024 postings are usually
+ * larger than that.
+ *
+ * Sub-chunks are merged by chunk_merge() like chunks that are split by
+ * CHUNK_SPLIT_THRESHOLD. buffer_merge() merges each sub-chunk whose
+ * last record ID isn't smaller than the first record ID in the buffer
+ * in place. Merged sub-chunks aren't split again. Only the postings
+ * after the last sub-chunk are split here.
+ *
+ * The rest postings that are less than or equal to the interval are
+ * kept in dv for the chunk in the buffer. A sub-chunk isn't split in
+ * the middle of a record because section IDs are delta encoded in a
+ * record.
+ */
+static grn_rc
+buffer_merge_flush_skip_chunks(grn_ctx *ctx,
+                               merger_data *data,
+                               datavec *dv,
+                               chunk_info **cinfo,
+                               uint32_t *nchunks,
+                               uint32_t *nvchunks,
+                               grn_id *crid)
+{
+  grn_ii *ii = data->ii;
+  const uint32_t flags = ii->header.common->flags;
+  const uint32_t n_elements = ii->n_elements;
+  const uint32_t interval = grn_ii_chunk_skip_interval;
+  uint32_t *rids = dv[0].data;
+  uint32_t *tfs = dv[(flags & GRN_OBJ_WITH_SECTION) ? 2 : 1].data;
+  uint32_t *positions = NULL;
+  uint32_t ndf = data->dest.record_id_gaps - rids;
+  uint32_t start = 0, start_position = 0;
+  uint32_t n_new_chunks = 0;
+  grn_id rid = GRN_ID_NIL, last_chunk_rid = GRN_ID_NIL;
+  uint32_t i, j;
+
+  if (interval == 0 || ndf <= interval) {
+    return GRN_SUCCESS;
+  }
+  if (flags & GRN_OBJ_WITH_POSITION) {
+    positions = dv[n_elements - 1].data;
+  }
+  /* The last record ID of the last sub-chunk that isn't empty. */
+  for (i = 0; i < *nchunks; i++) {
+    if ((*cinfo)[i].size) {
+      last_chunk_rid += (*cinfo)[i].dgap;
+    }
+  }
+
+  while (ndf - start > interval) {
+    datavec sdv[MAX_N_ELEMENTS + 1];
+    uint32_t end = start + interval;
+    uint32_t n, np = 0;
+    uint64_t position = 0;
+    grn_id end_rid;
+    uint8_t *enc;
+    size_t encsize;
+    chunk_info *new_cinfo;
+
+    while (end < ndf && rids[end] == 0) {
+      end++;
+    }
+    if (end == ndf) {
+      break;
+    }
+    n = end - start;
+    rid += rids[start];
+    rids[start] = rid;
+    end_rid = rid;
+    for (i = start + 1; i < end; i++) {
+      end_rid += rids[i];
+    }
+    for (i = start; i < end; i++) {
+      np += 1 + tfs[i];
+    }
+    if (positions) {
+      for (i = 0; i < np; i++) {
+        position += positions[start_position + i];
+      }
+    }
+
+    for (j = 0; j < n_elements; j++) {
+      uint32_t f_s = (n < 3) ? 0 : USE_P_ENC;
+      sdv[j].data = dv[j].data + start;
+      sdv[j].data_size = n;
+      sdv[j].flags = f_s;
+    }
+    sdv[0].flags = ((n < 16) || (n <= (end_rid >> 8))) ? 0 : USE_P_ENC;
+    if (positions) {
+      sdv[n_elements - 1].data = positions + start_position;
+      sdv[n_elements - 1].data_size = np;
+      sdv[n_elements - 1].flags =
+        (((np < 32) || (np <= (position >> 13))) ? 0 : USE_P_ENC) | ODD;
+    }
+
+    new_cinfo = GRN_REALLOC(*cinfo, sizeof(chunk_info) * (*nchunks + 2));
+    if (!new_cinfo) {
+      DEFINE_NAME(ii);
+      MERR("[ii][buffer][merge][skip] failed to allocate chunk info: "
+           "<%.*s>: <%u>",
+           name_size, name,
+           *nchunks + 2);
+      return ctx->rc;
+    }
+    *cinfo = new_cinfo;
+    encsize = grn_p_encv(ctx, sdv, n_elements, NULL);
+    enc = GRN_MALLOC(encsize);
+    if (!enc) {
+      DEFINE_NAME(ii);
+      MERR("[ii][buffer][merge][skip] failed to allocate a encode buffer: "
+           "<%.*s>: <%" GRN_FMT_SIZE ">",
+           name_size, name,
+           encsize);
+      return ctx->rc;
+    }
+    encsize = grn_p_encv(ctx, sdv, n_elements, enc);
+    chunk_flush(ctx, ii, &((*cinfo)[*nchunks]), enc, encsize);
+    GRN_FREE(enc);
+    if (ctx->rc != GRN_SUCCESS) {
+      return ctx->rc;
+    }
+    (*cinfo)[*nchunks].dgap = end_rid - last_chunk_rid;
+    (*nchunks)++;
+    (*nvchunks)++;
+    n_new_chunks++;
+    last_chunk_rid = end_rid;
+    rid = end_rid;
+    start = end;
+    start_position += np;
+  }
+  if (n_new_chunks == 0) {
+    return GRN_SUCCESS;
+  }
+
+  /* Keep the rest postings at the head of dv. */
+  rids[start] += rid;
+  for (j = 0; j < n_elements; j++) {
+    if (positions && j == n_elements - 1) {
+      uint32_t rest_np = data->dest.position_gaps - (positions + start_position);
+      memmove(positions, positions + start_position,
+              sizeof(uint32_t) * rest_np);
+      data->dest.position_gaps = positions + rest_np;
+    } else {
+      memmove(dv[j].data, dv[j].data + start,
+              sizeof(uint32_t) * (ndf - start));
+    }
+  }
+  {
+    j = 0;
+    data->dest.record_id_gaps = dv[j++].data + (ndf - start);
+    if (flags & GRN_OBJ_WITH_SECTION) {
+      data->dest.section_id_gaps = dv[j++].data + (ndf - start);
+    }
+    data->dest.tfs = dv[j++].data + (ndf - start);
+    if (flags & GRN_OBJ_WITH_WEIGHT) {
+      data->dest.weights = dv[j++].data + (ndf - start);
+    }
+  }
+  data->position = 0;
+  if (positions) {
+    uint32_t *p;
+    for (p = positions; p < data->dest.position_gaps; p++) {
+      data->position += *p;
+    }
+  }
+  *crid = last_chunk_rid;
+  return GRN_SUCCESS;
+}
+
 static void
 buffer_merge_dump_datavec(grn_ctx *ctx,
                           grn_ii *ii,
@@ -4444,10 +4913,23 @@ buffer_merge(grn_ctx *ctx, grn_ii *ii, uint32_t seg, grn_hash *h,
           memset(bt, 0, sizeof(buffer_term));
           nterms_void++;
         } else {
+          const uint32_t n_merged_documents = ndf;
           int j = 0;
           uint32_t encsize;
-          uint32_t f_s = (ndf < 3) ? 0 : USE_P_ENC;
-          uint32_t f_d = ((ndf < 16) || (ndf <= (data.last_id.rid >> 8))) ? 0 : USE_P_ENC;
+          uint32_t f_s;
+          uint32_t f_d;
+          if (grn_ii_chunk_skip_interval > 0) {
+            buffer_merge_flush_skip_chunks(ctx, &data, dv,
+                                           &cinfo, &nchunks, &nvchunks, &crid);
+            if (ctx->rc != GRN_SUCCESS) {
+              if (cinfo) { GRN_FREE(cinfo); }
+              array_unref(ii, tid);
+              goto exit;
+            }
+            ndf = data.dest.record_id_gaps - dv[0].data;
+          }
+          f_s = (ndf < 3) ? 0 : USE_P_ENC;
+          f_d = ((ndf < 16) || (ndf <= (data.last_id.rid >> 8))) ? 0 : USE_P_ENC;
           dv[j].data_size = ndf; dv[j++].flags = f_d;
           if ((ii->header.common->flags & GRN_OBJ_WITH_SECTION)) {
             dv[j].data_size = ndf; dv[j++].flags = f_s;
@@ -4470,7 +4952,7 @@ buffer_merge(grn_ctx *ctx, grn_ii *ii, uint32_t seg, grn_hash *h,
           const size_t dc_offset = dcp - dc;
           a[1] =
             (bt->size_in_chunk ? a[1] : 0) +
-            (ndf - chunk_data->n_documents) +
+            (n_merged_documents - chunk_data->n_documents) +
             balance;
           if (nvchunks) {
             buffer_merge_ensure_dc(ctx,
@@ -4533,7 +5015,9 @@ buffer_merge(grn_ctx *ctx, grn_ii *ii, uint32_t seg, grn_hash *h,
             bt->tid |= CHUNK_SPLIT;
           } else {
             dcp += encsize;
-            if (!nvchunks) {
+            if (nvchunks) {
+              bt->tid |= CHUNK_SPLIT;
+            } else {
               bt->tid &= ~CHUNK_SPLIT;
             }
           }
@@ -4632,6 +5116,8 @@ buffer_flush(grn_ctx *ctx, grn_ii *ii, uint32_t lseg, grn_hash *h)
         grn_memcpy(db->terms, sb->terms, n * sizeof(buffer_term));
         db->header.nterms = n;
         uint8_t *dc = NULL;
+        /* Chunks may be reused until the next increment. */
+        ii->header.common->chunk_generation++;
         buffer_merge(ctx, ii, lseg, h, sb, sc, db, &dc);
         if (ctx->rc == GRN_SUCCESS) {
           const uint32_t actual_chunk_size = db->header.chunk_size;
@@ -4676,6 +5162,7 @@ buffer_flush(grn_ctx *ctx, grn_ii *ii, uint32_t lseg, grn_hash *h)
             GRN_FREE(dc);
           }
         }
+        ii->header.common->chunk_generation++;
         if (scn != GRN_II_PSEG_NOT_ASSIGNED) { grn_io_win_unmap(&sw); }
       } else {
         DEFINE_NAME(ii);
@@ -5030,6 +5517,8 @@ buffer_split(grn_ctx *ctx, grn_ii *ii, uint32_t lseg, grn_hash *h)
                           sb->header.chunk_size, GRN_IO_RDONLY))) {
           term_split(ctx, ii->lexicon, sb, db0, db1);
           uint8_t *dc0 = NULL;
+          /* Chunks may be reused until the next increment. */
+          ii->header.common->chunk_generation++;
           buffer_merge(ctx, ii, lseg, h, sb, sc, db0, &dc0);
           if (ctx->rc == GRN_SUCCESS) {
             const uint32_t actual_db0_chunk_size = db0->header.chunk_size;
@@ -5132,6 +5621,7 @@ buffer_split(grn_ctx *ctx, grn_ii *ii, uint32_t lseg, grn_hash *h)
               GRN_FREE(dc0);
             }
           }
+          ii->header.common->chunk_generation++;
           if (scn != GRN_II_PSEG_NOT_ASSIGNED) {
             grn_io_win_unmap(&sw);
           }
@@ -5427,6 +5917,207 @@ buffer_new(grn_ctx *ctx, grn_ii *ii, int size, uint32_t *pos,
   return pseg;
 }
 
+/* document lengths */
+
+static uint32_t
+grn_ii_document_length_size(uint32_t flags)
+{
+  if (flags & GRN_OBJ_WITH_SECTION) {
+    return sizeof(uint32_t) * (1 + GRN_II_N_SECTION_LENGTHS);
+  } else {
+    return sizeof(uint32_t);
+  }
+}
+
+static void
+grn_ii_document_length_add(uint64_t *total_length,
+                           uint64_t *n_documents,
+                           uint32_t *length,
+                           uint32_t old_length,
+                           uint32_t new_length)
+{
+  uint32_t current_length = *length;
+  if (old_length > current_length) {
+    old_length = current_length;
+  }
+  *length = current_length - old_length + new_length;
+  if (current_length == 0 && *length > 0) {
+    (*n_documents)++;
+  } else if (current_length > 0 && *length == 0 && *n_documents > 0) {
+    (*n_documents)--;
+  }
+  if (old_length > *total_length) {
+    old_length = (uint32_t)(*total_length);
+  }
+  *total_length = *total_length - old_length + new_length;
+}
+
+static void
+grn_ii_document_length_update(grn_ctx *ctx,
+                              grn_ii *ii,
+                              grn_id rid,
+                              uint32_t section,
+                              uint32_t old_length,
+                              uint32_t new_length)
+{
+  grn_ii_header_common *header = ii->header.common;
+  uint32_t *lengths;
+
+  if (old_length == new_length) {
+    return;
+  }
+
+  lengths = grn_ra_ref(ctx, ii->document_lengths, rid);
+  if (!lengths) {
+    DEFINE_NAME(ii);
+    MERR("[ii][document-length][update] failed to refer lengths: "
+         "<%.*s>: <%u>",
+         name_size, name,
+         rid);
+    return;
+  }
+  grn_ii_document_length_add(&(header->total_document_length),
+                             &(header->n_documents_with_length),
+                             &(lengths[0]),
+                             old_length,
+                             new_length);
+  if ((header->flags & GRN_OBJ_WITH_SECTION) &&
+      1 <= section && section <= GRN_II_N_SECTION_LENGTHS) {
+    grn_ii_document_length_add(&(header->total_section_lengths[section - 1]),
+                               &(header->n_sections_with_length[section - 1]),
+                               &(lengths[section]),
+                               lengths[section],
+                               new_length);
+  }
+  grn_ra_unref(ctx, ii->document_lengths, rid);
+}
+
+static uint32_t
+grn_ii_document_length_compute(grn_ctx *ctx, grn_hash *specs)
+{
+  uint32_t length = 0;
+  grn_ii_updspec **u;
+  GRN_HASH_EACH(ctx, specs, id, NULL, NULL, &u, {
+    if (*u) {
+      length += (*u)->tf;
+    }
+  });
+  return length;
+}
+
+/* Static index construction doesn't use grn_ii_column_update(). The
+ * lengths are computed from the built postings instead. */
+static void
+grn_ii_document_length_build(grn_ctx *ctx, grn_ii *ii)
+{
+  grn_ii_header_common *header = ii->header.common;
+  const grn_bool with_section = (header->flags & GRN_OBJ_WITH_SECTION);
+  uint32_t i;
+
+  header->total_document_length = 0;
+  header->n_documents_with_length = 0;
+  for (i = 0; i < GRN_II_N_SECTION_LENGTHS; i++) {
+    header->total_section_lengths[i] = 0;
+    header->n_sections_with_length[i] = 0;
+  }
+
+  GRN_TABLE_EACH_BEGIN(ctx, ii->lexicon, cursor, tid) {
+    grn_ii_cursor *ii_cursor;
+    grn_posting *posting;
+    ii_cursor = grn_ii_cursor_open(ctx, ii, tid, GRN_ID_NIL, GRN_ID_MAX,
+                                   ii->n_elements, 0);
+    if (!ii_cursor) {
+      continue;
+    }
+    while ((posting = grn_ii_cursor_next(ctx, ii_cursor))) {
+      uint32_t *lengths;
+      lengths = grn_ra_ref(ctx, ii->document_lengths, posting->rid);
+      if (!lengths) {
+        break;
+      }
+      grn_ii_document_length_add(&(header->total_document_length),
+                                 &(header->n_documents_with_length),
+                                 &(lengths[0]),
+                                 0,
+                                 posting->tf);
+      if (with_section &&
+          1 <= posting->sid && posting->sid <= GRN_II_N_SECTION_LENGTHS) {
+        uint32_t section = posting->sid;
+        grn_ii_document_length_add(
+          &(header->total_section_lengths[section - 1]),
+          &(header->n_sections_with_length[section - 1]),
+          &(lengths[section]),
+          0,
+          posting->tf);
+      }
+      grn_ra_unref(ctx, ii->document_lengths, posting->rid);
+    }
+    grn_ii_cursor_close(ctx, ii_cursor);
+  } GRN_TABLE_EACH_END(ctx, cursor);
+}
+
+static grn_bool
+grn_ii_document_length_is_stored(grn_ii *ii, uint32_t section)
+{
+  if (!ii->document_lengths) {
+    return GRN_FALSE;
+  }
+  if (section == 0) {
+    return GRN_TRUE;
+  }
+  /* The whole document is the only section without WITH_SECTION. */
+  if (!(ii->header.common->flags & GRN_OBJ_WITH_SECTION)) {
+    return GRN_TRUE;
+  }
+  return section <= GRN_II_N_SECTION_LENGTHS;
+}
+
+uint32_t
+grn_ii_get_document_length(grn_ctx *ctx, grn_ii *ii,
+                           grn_id rid, uint32_t section)
+{
+  uint32_t *lengths;
+  uint32_t length;
+
+  if (!grn_ii_document_length_is_stored(ii, section)) {
+    return 0;
+  }
+  lengths = grn_ra_ref(ctx, ii->document_lengths, rid);
+  if (!lengths) {
+    return 0;
+  }
+  if (section > 0 && (ii->header.common->flags & GRN_OBJ_WITH_SECTION)) {
+    length = lengths[section];
+  } else {
+    length = lengths[0];
+  }
+  grn_ra_unref(ctx, ii->document_lengths, rid);
+  return length;
+}
+
+double
+grn_ii_get_average_document_length(grn_ctx *ctx, grn_ii *ii, uint32_t section)
+{
+  grn_ii_header_common *header = ii->header.common;
+  uint64_t total_length;
+  uint64_t n_documents;
+
+  if (!grn_ii_document_length_is_stored(ii, section)) {
+    return 0.0;
+  }
+  if (section > 0 && (header->flags & GRN_OBJ_WITH_SECTION)) {
+    total_length = header->total_section_lengths[section - 1];
+    n_documents = header->n_sections_with_length[section - 1];
+  } else {
+    total_length = header->total_document_length;
+    n_documents = header->n_documents_with_length;
+  }
+  if (n_documents == 0) {
+    return 0.0;
+  }
+  return (double)total_length / (double)n_documents;
+}
+
 /* ii */
 
 static grn_ii *
@@ -5437,6 +6128,7 @@ _grn_ii_create(grn_ctx *ctx, grn_ii *ii, const char *path, grn_obj *lexicon, uin
   uint32_t max_n_segments;
   uint32_t max_n_chunks;
   grn_io *seg, *chunk;
+  grn_ra *document_lengths;
   char path2[PATH_MAX];
   grn_ii_header_common *header;
   grn_table_flags lflags;
@@ -5497,6 +6189,29 @@ _grn_ii_create(grn_ctx *ctx, grn_ii *ii, const char *path, grn_obj *lexicon, uin
     grn_io_remove(ctx, path);
     return NULL;
   }
+  document_lengths = NULL;
+  if (flags & GRN_OBJ_WITH_DOCUMENT_LENGTH) {
+    if (path) {
+      grn_strcpy(path2, PATH_MAX, path);
+      grn_strcat(path2, PATH_MAX, ".l");
+      document_lengths = grn_ra_create(ctx, path2,
+                                       grn_ii_document_length_size(flags));
+    } else {
+      document_lengths = grn_ra_create(ctx, NULL,
+                                       grn_ii_document_length_size(flags));
+    }
+    if (!document_lengths) {
+      grn_io_close(ctx, chunk);
+      grn_io_close(ctx, seg);
+      if (path) {
+        grn_io_remove(ctx, path);
+        grn_strcpy(path2, PATH_MAX, path);
+        grn_strcat(path2, PATH_MAX, ".c");
+        grn_io_remove(ctx, path2);
+      }
+      return NULL;
+    }
+  }
   header = grn_io_header(seg);
   grn_io_set_type(seg, GRN_COLUMN_INDEX);
   for (i = 0; i < GRN_II_MAX_LSEG; i++) {
@@ -5517,6 +6232,7 @@ _grn_ii_create(grn_ctx *ctx, grn_ii *ii, const char *path, grn_obj *lexicon, uin
   header->flags = flags;
   ii->seg = seg;
   ii->chunk = chunk;
+  ii->document_lengths = document_lengths;
   ii->lexicon = lexicon;
   ii->lflags = lflags;
   ii->encoding = encoding;
@@ -5552,7 +6268,12 @@ grn_ii_remove(grn_ctx *ctx, const char *path)
   if ((rc = grn_io_remove(ctx, path))) { goto exit; }
   grn_snprintf(buffer, PATH_MAX, PATH_MAX,
                "%s.c", path);
-  rc = grn_io_remove(ctx, buffer);
+  if ((rc = grn_io_remove(ctx, buffer))) { goto exit; }
+  grn_snprintf(buffer, PATH_MAX, PATH_MAX,
+               "%s.l", path);
+  if (grn_path_exist(buffer)) {
+    rc = grn_ra_remove(ctx, buffer);
+  }
 exit :
   return rc;
 }
@@ -5563,6 +6284,7 @@ grn_ii_truncate(grn_ctx *ctx, grn_ii *ii)
   grn_rc rc;
   const char *io_segpath, *io_chunkpath;
   char *segpath, *chunkpath = NULL;
+  char *document_lengths_path = NULL;
   grn_obj *lexicon;
   uint32_t flags;
   if ((io_segpath = grn_io_path(ii->seg)) && *io_segpath != '\0') {
@@ -5581,20 +6303,43 @@ grn_ii_truncate(grn_ctx *ctx, grn_ii *ii)
   } else {
     segpath = NULL;
   }
+  if (ii->document_lengths) {
+    const char *io_document_lengths_path;
+    io_document_lengths_path = grn_io_path(ii->document_lengths->io);
+    if (io_document_lengths_path && *io_document_lengths_path != '\0') {
+      if (!(document_lengths_path = GRN_STRDUP(io_document_lengths_path))) {
+        ERR(GRN_NO_MEMORY_AVAILABLE, "cannot duplicate path: <%s>",
+            io_document_lengths_path);
+        rc = GRN_NO_MEMORY_AVAILABLE;
+        goto exit;
+      }
+    }
+  }
   lexicon = ii->lexicon;
   flags = ii->header.common->flags;
+  grn_ii_bitmap_cache_forget(ctx, ii);
+  grn_ii_posting_cache_forget(ctx, ii);
   if ((rc = grn_io_close(ctx, ii->seg))) { goto exit; }
   if ((rc = grn_io_close(ctx, ii->chunk))) { goto exit; }
   ii->seg = NULL;
   ii->chunk = NULL;
+  if (ii->document_lengths) {
+    if ((rc = grn_ra_close(ctx, ii->document_lengths))) { goto exit; }
+    ii->document_lengths = NULL;
+  }
   if (segpath && (rc = grn_io_remove(ctx, segpath))) { goto exit; }
   if (chunkpath && (rc = grn_io_remove(ctx, chunkpath))) { goto exit; }
+  if (document_lengths_path &&
+      (rc = grn_ra_remove(ctx, document_lengths_path))) {
+    goto exit;
+  }
   if (!_grn_ii_create(ctx, ii, segpath, lexicon, flags)) {
     rc = GRN_UNKNOWN_ERROR;
   }
 exit:
   if (segpath) { GRN_FREE(segpath); }
   if (chunkpath) { GRN_FREE(chunkpath); }
+  if (document_lengths_path) { GRN_FREE(document_lengths_path); }
   return rc;
 }
 
@@ -5602,6 +6347,7 @@ grn_ii *
 grn_ii_open(grn_ctx *ctx, const char *path, grn_obj *lexicon)
 {
   grn_io *seg, *chunk;
+  grn_ra *document_lengths;
   grn_ii *ii;
   char path2[PATH_MAX];
   grn_ii_header_common *header;
@@ -5633,14 +6379,29 @@ grn_ii_open(grn_ctx *ctx, const char *path, grn_obj *lexicon)
     grn_io_close(ctx, chunk);
     return NULL;
   }
+  document_lengths = NULL;
+  if (header->flags & GRN_OBJ_WITH_DOCUMENT_LENGTH) {
+    grn_strcpy(path2, PATH_MAX, path);
+    grn_strcat(path2, PATH_MAX, ".l");
+    document_lengths = grn_ra_open(ctx, path2);
+    if (!document_lengths) {
+      grn_io_close(ctx, seg);
+      grn_io_close(ctx, chunk);
+      return NULL;
+    }
+  }
   if (!(ii = GRN_MALLOCN(grn_ii, 1))) {
     grn_io_close(ctx, seg);
     grn_io_close(ctx, chunk);
+    if (document_lengths) {
+      grn_ra_close(ctx, document_lengths);
+    }
     return NULL;
   }
   GRN_DB_OBJ_SET_TYPE(ii, GRN_COLUMN_INDEX);
   ii->seg = seg;
   ii->chunk = chunk;
+  ii->document_lengths = document_lengths;
   ii->lexicon = lexicon;
   ii->lflags = lflags;
   ii->encoding = encoding;
@@ -5657,8 +6418,13 @@ grn_ii_close(grn_ctx *ctx, grn_ii *ii)
 {
   grn_rc rc;
   if (!ii) { return GRN_INVALID_ARGUMENT; }
+  grn_ii_bitmap_cache_forget(ctx, ii);
+  grn_ii_posting_cache_forget(ctx, ii);
   if ((rc = grn_io_close(ctx, ii->seg))) { return rc; }
   if ((rc = grn_io_close(ctx, ii->chunk))) { return rc; }
+  if (ii->document_lengths) {
+    if ((rc = grn_ra_close(ctx, ii->document_lengths))) { return rc; }
+  }
   GRN_FREE(ii);
   /*
   {
@@ -5753,11 +6519,806 @@ grn_ii_get_disk_usage(grn_ctx *ctx, grn_ii *ii)
   return usage;
 }
 
-#define BIT11_01(x) ((x >> 1) & 0x7ff)
-#define BIT31_12(x) (x >> 12)
-
-grn_rc
-grn_ii_update_one(grn_ctx *ctx, grn_ii *ii, grn_id tid, grn_ii_updspec *u, grn_hash *h)
+/*
+ * Bitmap postings for very high document frequency terms.
+ *
+ * Postings of a term that appears in most records, e.g. a tag that is
+ * attached to a half of all records, are long and decoding them is
+ * expensive. If the index column has neither position, section nor
+ * weight, postings of such term are just a set of record IDs. We keep
+ * them as a compressed bitmap in memory and use it for intersection
+ * instead of decoding postings for each query.
+ *
+ * A bitmap consists of containers for each 2^16 record IDs. A container
+ * is a sorted array of the lower 16 bits of record IDs when it has only
+ * a few record IDs. Otherwise it's a 2^16 bits bitset.
+ *
+ * Bitmaps aren't stored into the index column. They are built from
+ * postings on demand and invalidated by the generation of the index
+ * column that is incremented whenever postings are changed.
+ *
+ * This is disabled by default. GRN_II_BITMAP_DF_RATIO=0.3 enables
+ * bitmaps for terms that appear in 30% or more records.
+ */
+#define GRN_II_BITMAP_CONTAINER_N_BITS  (1 << 16)
+#define GRN_II_BITMAP_CONTAINER_N_WORDS (GRN_II_BITMAP_CONTAINER_N_BITS / 64)
+#define GRN_II_BITMAP_ARRAY_MAX_SIZE    4096
+
+typedef struct {
+  uint32_t key;
+  uint32_t cardinality;
+  /* Available when cardinality <= GRN_II_BITMAP_ARRAY_MAX_SIZE. */
+  uint16_t *values;
+  /* Available when cardinality > GRN_II_BITMAP_ARRAY_MAX_SIZE. */
+  uint64_t *words;
+} grn_ii_bitmap_container;
+
+typedef struct _grn_ii_bitmap grn_ii_bitmap;
+struct _grn_ii_bitmap {
+  grn_ii *ii;
+  grn_id tid;
+  uint64_t generation;
+  /* GRN_FALSE when postings can't be represented as a bitmap, e.g. a
+   * record has the term twice. It's cached to not try it again. */
+  grn_bool available;
+  grn_bool cached;
+  uint32_t n_refs;
+  uint32_t n_containers;
+  grn_ii_bitmap_container *containers;
+  size_t size;
+  grn_ii_bitmap *bucket_next;
+  grn_ii_bitmap *prev;
+  grn_ii_bitmap *next;
+};
+
+#define GRN_II_BITMAP_CACHE_N_BUCKETS (1 << 10)
+
+static struct {
+  grn_bool initialized;
+  grn_critical_section lock;
+  grn_ii_bitmap **buckets;
+  /* The most recently used bitmap is the head. */
+  grn_ii_bitmap *head;
+  grn_ii_bitmap *tail;
+  size_t size;
+} grn_ii_bitmap_cache;
+
+static grn_inline uint32_t
+grn_ii_bitmap_cache_hash(grn_ii *ii, grn_id tid)
+{
+  uint64_t hash = (uint64_t)(uintptr_t)ii;
+  hash = hash * 31 + tid;
+  hash ^= hash >> 29;
+  hash *= 0xbf58476d1ce4e5b9ULL;
+  hash ^= hash >> 32;
+  return (uint32_t)(hash & (GRN_II_BITMAP_CACHE_N_BUCKETS - 1));
+}
+
+static void
+grn_ii_bitmap_free(grn_ii_bitmap *bitmap)
+{
+  grn_ctx *ctx = &grn_gctx;
+  uint32_t i;
+
+  for (i = 0; i < bitmap->n_containers; i++) {
+    grn_ii_bitmap_container *container = &(bitmap->containers[i]);
+    if (container->values) {
+      GRN_FREE(container->values);
+    }
+    if (container->words) {
+      GRN_FREE(container->words);
+    }
+  }
+  if (bitmap->containers) {
+    GRN_FREE(bitmap->containers);
+  }
+  GRN_FREE(bitmap);
+}
+
+/* grn_ii_bitmap_cache.lock must be held. */
+static grn_ii_bitmap *
+grn_ii_bitmap_cache_find(grn_ii *ii, grn_id tid)
+{
+  grn_ii_bitmap *bitmap;
+
+  bitmap = grn_ii_bitmap_cache.buckets[grn_ii_bitmap_cache_hash(ii, tid)];
+  for (; bitmap; bitmap = bitmap->bucket_next) {
+    if (bitmap->ii == ii && bitmap->tid == tid) {
+      return bitmap;
+    }
+  }
+  return NULL;
+}
+
+/* grn_ii_bitmap_cache.lock must be held. */
+static void
+grn_ii_bitmap_cache_unlink(grn_ii_bitmap *bitmap)
+{
+  grn_ii_bitmap **bucket;
+
+  bucket = &(grn_ii_bitmap_cache.buckets[
+               grn_ii_bitmap_cache_hash(bitmap->ii, bitmap->tid)]);
+  while (*bucket != bitmap) {
+    bucket = &((*bucket)->bucket_next);
+  }
+  *bucket = bitmap->bucket_next;
+  bitmap->bucket_next = NULL;
+
+  if (bitmap->prev) {
+    bitmap->prev->next = bitmap->next;
+  } else {
+    grn_ii_bitmap_cache.head = bitmap->next;
+  }
+  if (bitmap->next) {
+    bitmap->next->prev = bitmap->prev;
+  } else {
+    grn_ii_bitmap_cache.tail = bitmap->prev;
+  }
+  bitmap->prev = NULL;
+  bitmap->next = NULL;
+  bitmap->cached = GRN_FALSE;
+  grn_ii_bitmap_cache.size -= bitmap->size;
+}
+
+/* grn_ii_bitmap_cache.lock must be held. */
+static void
+grn_ii_bitmap_cache_remove(grn_ii_bitmap *bitmap)
+{
+  grn_ii_bitmap_cache_unlink(bitmap);
+  if (bitmap->n_refs == 0) {
+    grn_ii_bitmap_free(bitmap);
+  }
+}
+
+/* grn_ii_bitmap_cache.lock must be held. */
+static void
+grn_ii_bitmap_cache_link(grn_ii_bitmap *bitmap)
+{
+  grn_ii_bitmap **bucket;
+
+  bucket = &(grn_ii_bitmap_cache.buckets[
+               grn_ii_bitmap_cache_hash(bitmap->ii, bitmap->tid)]);
+  bitmap->bucket_next = *bucket;
+  *bucket = bitmap;
+
+  bitmap->prev = NULL;
+  bitmap->next = grn_ii_bitmap_cache.head;
+  if (grn_ii_bitmap_cache.head) {
+    grn_ii_bitmap_cache.head->prev = bitmap;
+  } else {
+    grn_ii_bitmap_cache.tail = bitmap;
+  }
+  grn_ii_bitmap_cache.head = bitmap;
+  bitmap->cached = GRN_TRUE;
+  grn_ii_bitmap_cache.size += bitmap->size;
+}
+
+void
+grn_ii_bitmap_cache_init(void)
+{
+  grn_ctx *ctx = &grn_gctx;
+
+  memset(&grn_ii_bitmap_cache, 0, sizeof(grn_ii_bitmap_cache));
+  grn_ii_bitmap_cache.buckets =
+    GRN_CALLOC(sizeof(grn_ii_bitmap *) * GRN_II_BITMAP_CACHE_N_BUCKETS);
+  if (!grn_ii_bitmap_cache.buckets) {
+    GRN_LOG(ctx, GRN_LOG_ERROR,
+            "[ii][bitmap][cache] failed to allocate buckets");
+    return;
+  }
+  CRITICAL_SECTION_INIT(grn_ii_bitmap_cache.lock);
+  grn_ii_bitmap_cache.initialized = GRN_TRUE;
+}
+
+void
+grn_ii_bitmap_cache_fin(void)
+{
+  grn_ctx *ctx = &grn_gctx;
+
+  if (!grn_ii_bitmap_cache.initialized) {
+    return;
+  }
+
+  CRITICAL_SECTION_ENTER(grn_ii_bitmap_cache.lock);
+  while (grn_ii_bitmap_cache.head) {
+    grn_ii_bitmap_cache_remove(grn_ii_bitmap_cache.head);
+  }
+  CRITICAL_SECTION_LEAVE(grn_ii_bitmap_cache.lock);
+  CRITICAL_SECTION_FIN(grn_ii_bitmap_cache.lock);
+  GRN_FREE(grn_ii_bitmap_cache.buckets);
+  memset(&grn_ii_bitmap_cache, 0, sizeof(grn_ii_bitmap_cache));
+}
+
+/* This must be called before ii is closed. */
+static void
+grn_ii_bitmap_cache_forget(grn_ctx *ctx, grn_ii *ii)
+{
+  grn_ii_bitmap *bitmap;
+
+  if (!grn_ii_bitmap_cache.initialized) {
+    return;
+  }
+
+  CRITICAL_SECTION_ENTER(grn_ii_bitmap_cache.lock);
+  bitmap = grn_ii_bitmap_cache.head;
+  while (bitmap) {
+    grn_ii_bitmap *next = bitmap->next;
+    if (bitmap->ii == ii) {
+      grn_ii_bitmap_cache_remove(bitmap);
+    }
+    bitmap = next;
+  }
+  CRITICAL_SECTION_LEAVE(grn_ii_bitmap_cache.lock);
+}
+
+static void
+grn_ii_bitmap_release(grn_ii_bitmap *bitmap)
+{
+  CRITICAL_SECTION_ENTER(grn_ii_bitmap_cache.lock);
+  bitmap->n_refs--;
+  if (bitmap->n_refs == 0 && !bitmap->cached) {
+    grn_ii_bitmap_free(bitmap);
+  }
+  CRITICAL_SECTION_LEAVE(grn_ii_bitmap_cache.lock);
+}
+
+static grn_bool
+grn_ii_bitmap_add_container(grn_ii_bitmap *bitmap,
+                            uint32_t key,
+                            const uint16_t *values,
+                            uint32_t n_values)
+{
+  grn_ctx *ctx = &grn_gctx;
+  grn_ii_bitmap_container *container;
+
+  if ((bitmap->n_containers & (bitmap->n_containers - 1)) == 0) {
+    uint32_t new_n = bitmap->n_containers ? bitmap->n_containers * 2 : 1;
+    grn_ii_bitmap_container *containers =
+      GRN_REALLOC(bitmap->containers,
+                  sizeof(grn_ii_bitmap_container) * new_n);
+    if (!containers) {
+      return GRN_FALSE;
+    }
+    bitmap->containers = containers;
+  }
+  container = &(bitmap->containers[bitmap->n_containers]);
+  container->key = key;
+  container->cardinality = n_values;
+  container->values = NULL;
+  container->words = NULL;
+  if (n_values <= GRN_II_BITMAP_ARRAY_MAX_SIZE) {
+    container->values = GRN_MALLOCN(uint16_t, n_values);
+    if (!container->values) {
+      return GRN_FALSE;
+    }
+    grn_memcpy(container->values, values, sizeof(uint16_t) * n_values);
+    bitmap->size += sizeof(uint16_t) * n_values;
+  } else {
+    uint32_t i;
+    container->words = GRN_CALLOC(sizeof(uint64_t) *
+                                  GRN_II_BITMAP_CONTAINER_N_WORDS);
+    if (!container->words) {
+      return GRN_FALSE;
+    }
+    for (i = 0; i < n_values; i++) {
+      container->words[values[i] >> 6] |= ((uint64_t)1) << (values[i] & 63);
+    }
+    bitmap->size += sizeof(uint64_t) * GRN_II_BITMAP_CONTAINER_N_WORDS;
+  }
+  bitmap->n_containers++;
+  bitmap->size += sizeof(grn_ii_bitmap_container);
+  return GRN_TRUE;
+}
+
+static grn_ii_bitmap *
+grn_ii_bitmap_build(grn_ctx *ctx, grn_ii *ii, grn_id tid, uint64_t generation)
+{
+  grn_ii_bitmap *bitmap;
+  grn_ii_cursor *cursor;
+  grn_posting *posting;
+  uint16_t *values;
+  uint32_t n_values = 0;
+  uint32_t key = 0;
+
+  bitmap = GRN_CALLOC(sizeof(grn_ii_bitmap));
+  if (!bitmap) {
+    return NULL;
+  }
+  bitmap->ii = ii;
+  bitmap->tid = tid;
+  bitmap->generation = generation;
+  bitmap->available = GRN_TRUE;
+  bitmap->size = sizeof(grn_ii_bitmap);
+
+  values = GRN_MALLOCN(uint16_t, GRN_II_BITMAP_CONTAINER_N_BITS);
+  if (!values) {
+    GRN_FREE(bitmap);
+    return NULL;
+  }
+  cursor = grn_ii_cursor_open(ctx, ii, tid, GRN_ID_NIL, GRN_ID_MAX,
+                              ii->n_elements, 0);
+  if (cursor) {
+    while ((posting = grn_ii_cursor_next(ctx, cursor))) {
+      uint32_t posting_key = posting->rid >> 16;
+      if (posting->tf != 1 ||
+          (n_values > 0 &&
+           posting_key == key &&
+           values[n_values - 1] >= (posting->rid & 0xffff))) {
+        bitmap->available = GRN_FALSE;
+        break;
+      }
+      if (n_values > 0 && posting_key != key) {
+        if (!grn_ii_bitmap_add_container(bitmap, key, values, n_values)) {
+          bitmap->available = GRN_FALSE;
+          break;
+        }
+        n_values = 0;
+      }
+      key = posting_key;
+      values[n_values++] = posting->rid & 0xffff;
+    }
+    grn_ii_cursor_close(ctx, cursor);
+  }
+  if (bitmap->available && n_values > 0) {
+    if (!grn_ii_bitmap_add_container(bitmap, key, values, n_values)) {
+      bitmap->available = GRN_FALSE;
+    }
+  }
+  GRN_FREE(values);
+
+  if (!bitmap->available) {
+    uint32_t i;
+    for (i = 0; i < bitmap->n_containers; i++) {
+      grn_ii_bitmap_container *container = &(bitmap->containers[i]);
+      if (container->values) {
+        GRN_FREE(container->values);
+      }
+      if (container->words) {
+        GRN_FREE(container->words);
+      }
+    }
+    if (bitmap->containers) {
+      GRN_FREE(bitmap->containers);
+    }
+    bitmap->containers = NULL;
+    bitmap->n_containers = 0;
+    bitmap->size = sizeof(grn_ii_bitmap);
+  }
+  return bitmap;
+}
+
+/*
+ * Returns the bitmap of the term. The returned bitmap must be released
+ * by grn_ii_bitmap_release(). NULL is returned when postings of the
+ * term can't be represented as a bitmap.
+ */
+static grn_ii_bitmap *
+grn_ii_bitmap_open(grn_ctx *ctx, grn_ii *ii, grn_id tid)
+{
+  grn_ii_bitmap *bitmap;
+  uint64_t generation;
+
+  if (!grn_ii_bitmap_cache.initialized) {
+    return NULL;
+  }
+
+  generation = ii->header.common->generation;
+  CRITICAL_SECTION_ENTER(grn_ii_bitmap_cache.lock);
+  bitmap = grn_ii_bitmap_cache_find(ii, tid);
+  if (bitmap) {
+    if (bitmap->generation == generation) {
+      if (bitmap->prev) {
+        grn_ii_bitmap_cache_unlink(bitmap);
+        grn_ii_bitmap_cache_link(bitmap);
+      }
+      if (bitmap->available) {
+        bitmap->n_refs++;
+      } else {
+        bitmap = NULL;
+      }
+      CRITICAL_SECTION_LEAVE(grn_ii_bitmap_cache.lock);
+      return bitmap;
+    }
+    grn_ii_bitmap_cache_remove(bitmap);
+  }
+  CRITICAL_SECTION_LEAVE(grn_ii_bitmap_cache.lock);
+
+  bitmap = grn_ii_bitmap_build(ctx, ii, tid, generation);
+  if (!bitmap) {
+    return NULL;
+  }
+  bitmap->n_refs = 1;
+
+  /* Postings may be changed while building. */
+  if (ii->header.common->generation != generation) {
+    if (!bitmap->available) {
+      grn_ii_bitmap_free(bitmap);
+      return NULL;
+    }
+    return bitmap;
+  }
+
+  CRITICAL_SECTION_ENTER(grn_ii_bitmap_cache.lock);
+  if (bitmap->size <= grn_ii_bitmap_cache_max_size) {
+    grn_ii_bitmap *cached;
+    cached = grn_ii_bitmap_cache_find(ii, tid);
+    if (cached) {
+      grn_ii_bitmap_cache_remove(cached);
+    }
+    while (grn_ii_bitmap_cache.tail &&
+           grn_ii_bitmap_cache.size + bitmap->size >
+           grn_ii_bitmap_cache_max_size) {
+      grn_ii_bitmap_cache_remove(grn_ii_bitmap_cache.tail);
+    }
+    grn_ii_bitmap_cache_link(bitmap);
+  }
+  if (!bitmap->available) {
+    bitmap->n_refs--;
+    if (!bitmap->cached) {
+      grn_ii_bitmap_free(bitmap);
+    }
+    bitmap = NULL;
+  }
+  CRITICAL_SECTION_LEAVE(grn_ii_bitmap_cache.lock);
+  return bitmap;
+}
+
+/*
+ * Decoded posting cache.
+ *
+ * Frequently searched terms are decoded by grn_p_decv() for each
+ * query. This process-wide LRU cache keeps decoded chunks and shares
+ * them with all threads. A chunk is identified by the index column, the
+ * term ID and the location of the chunk. A chunk location may be reused
+ * for other postings only by buffer_merge() and chunk_merge(). They
+ * increment the chunk generation of the index column before and after
+ * merging, so cached chunks are valid only while the chunk generation
+ * isn't changed. The chunk generation is odd while merging.
+ *
+ * This is disabled by default. GRN_II_POSTING_CACHE_MAX_SIZE sets the
+ * max total size of cached chunks in bytes.
+ */
+#define GRN_II_POSTING_CACHE_N_BUCKETS (1 << 12)
+
+typedef struct _grn_ii_posting_cache_entry grn_ii_posting_cache_entry;
+struct _grn_ii_posting_cache_entry {
+  grn_ii *ii;
+  grn_id tid;
+  uint32_t segno;
+  uint32_t offset;
+  uint64_t generation;
+  uint32_t n_refs;
+  grn_bool cached;
+  uint32_t n_elements;
+  uint32_t data_sizes[MAX_N_ELEMENTS];
+  uint32_t data_size;
+  uint32_t *data;
+  size_t size;
+  grn_ii_posting_cache_entry *bucket_next;
+  grn_ii_posting_cache_entry *prev;
+  grn_ii_posting_cache_entry *next;
+};
+
+static struct {
+  grn_bool initialized;
+  grn_critical_section lock;
+  grn_ii_posting_cache_entry **buckets;
+  /* The most recently used entry is the head. */
+  grn_ii_posting_cache_entry *head;
+  grn_ii_posting_cache_entry *tail;
+  uint32_t n_entries;
+  size_t size;
+  uint64_t n_hits;
+  uint64_t n_misses;
+} grn_ii_posting_cache;
+
+static grn_inline uint32_t
+grn_ii_posting_cache_hash(grn_ii *ii, grn_id tid, uint32_t segno,
+                          uint32_t offset)
+{
+  uint64_t hash = (uint64_t)(uintptr_t)ii;
+  hash = hash * 31 + tid;
+  hash = hash * 31 + segno;
+  hash = hash * 31 + offset;
+  hash ^= hash >> 29;
+  hash *= 0xbf58476d1ce4e5b9ULL;
+  hash ^= hash >> 32;
+  return (uint32_t)(hash & (GRN_II_POSTING_CACHE_N_BUCKETS - 1));
+}
+
+static void
+grn_ii_posting_cache_entry_free(grn_ii_posting_cache_entry *entry)
+{
+  grn_ctx *ctx = &grn_gctx;
+  GRN_FREE(entry);
+}
+
+/* grn_ii_posting_cache.lock must be held. */
+static void
+grn_ii_posting_cache_remove(grn_ii_posting_cache_entry *entry)
+{
+  grn_ii_posting_cache_entry **bucket;
+
+  bucket = &(grn_ii_posting_cache.buckets[
+               grn_ii_posting_cache_hash(entry->ii, entry->tid,
+                                         entry->segno, entry->offset)]);
+  while (*bucket != entry) {
+    bucket = &((*bucket)->bucket_next);
+  }
+  *bucket = entry->bucket_next;
+
+  if (entry->prev) {
+    entry->prev->next = entry->next;
+  } else {
+    grn_ii_posting_cache.head = entry->next;
+  }
+  if (entry->next) {
+    entry->next->prev = entry->prev;
+  } else {
+    grn_ii_posting_cache.tail = entry->prev;
+  }
+  grn_ii_posting_cache.n_entries--;
+  grn_ii_posting_cache.size -= entry->size;
+  entry->cached = GRN_FALSE;
+  if (entry->n_refs == 0) {
+    grn_ii_posting_cache_entry_free(entry);
+  }
+}
+
+void
+grn_ii_posting_cache_init(void)
+{
+  grn_ctx *ctx = &grn_gctx;
+
+  memset(&grn_ii_posting_cache, 0, sizeof(grn_ii_posting_cache));
+  if (grn_ii_posting_cache_max_size == 0) {
+    return;
+  }
+
+  grn_ii_posting_cache.buckets =
+    GRN_CALLOC(sizeof(grn_ii_posting_cache_entry *) *
+               GRN_II_POSTING_CACHE_N_BUCKETS);
+  if (!grn_ii_posting_cache.buckets) {
+    GRN_LOG(ctx, GRN_LOG_ERROR,
+            "[ii][posting-cache] failed to allocate buckets");
+    return;
+  }
+  CRITICAL_SECTION_INIT(grn_ii_posting_cache.lock);
+  grn_ii_posting_cache.initialized = GRN_TRUE;
+}
+
+void
+grn_ii_posting_cache_fin(void)
+{
+  grn_ctx *ctx = &grn_gctx;
+
+  if (!grn_ii_posting_cache.initialized) {
+    return;
+  }
+
+  CRITICAL_SECTION_ENTER(grn_ii_posting_cache.lock);
+  while (grn_ii_posting_cache.head) {
+    grn_ii_posting_cache_remove(grn_ii_posting_cache.head);
+  }
+  CRITICAL_SECTION_LEAVE(grn_ii_posting_cache.lock);
+  CRITICAL_SECTION_FIN(grn_ii_posting_cache.lock);
+  GRN_FREE(grn_ii_posting_cache.buckets);
+  memset(&grn_ii_posting_cache, 0, sizeof(grn_ii_posting_cache));
+}
+
+/* This must be called before ii is closed. */
+static void
+grn_ii_posting_cache_forget(grn_ctx *ctx, grn_ii *ii)
+{
+  grn_ii_posting_cache_entry *entry;
+
+  if (!grn_ii_posting_cache.initialized) {
+    return;
+  }
+
+  CRITICAL_SECTION_ENTER(grn_ii_posting_cache.lock);
+  entry = grn_ii_posting_cache.head;
+  while (entry) {
+    grn_ii_posting_cache_entry *next = entry->next;
+    if (entry->ii == ii) {
+      grn_ii_posting_cache_remove(entry);
+    }
+    entry = next;
+  }
+  CRITICAL_SECTION_LEAVE(grn_ii_posting_cache.lock);
+}
+
+void
+grn_ii_posting_cache_get_statistics(grn_ii_posting_cache_statistics *statistics)
+{
+  memset(statistics, 0, sizeof(grn_ii_posting_cache_statistics));
+  statistics->max_size = grn_ii_posting_cache_max_size;
+  if (!grn_ii_posting_cache.initialized) {
+    return;
+  }
+
+  CRITICAL_SECTION_ENTER(grn_ii_posting_cache.lock);
+  statistics->n_entries = grn_ii_posting_cache.n_entries;
+  statistics->size = grn_ii_posting_cache.size;
+  statistics->n_hits = grn_ii_posting_cache.n_hits;
+  statistics->n_misses = grn_ii_posting_cache.n_misses;
+  CRITICAL_SECTION_LEAVE(grn_ii_posting_cache.lock);
+}
+
+/*
+ * Copies a cached decoded chunk to dv. Returns the decoded size as
+ * grn_p_decv() does. 0 is returned when the chunk isn't cached.
+ */
+static int
+grn_ii_posting_cache_fetch(grn_ctx *ctx, grn_ii *ii, grn_id tid,
+                           uint32_t segno, uint32_t offset,
+                           uint64_t generation,
+                           datavec *dv, uint32_t dvlen)
+{
+  grn_ii_posting_cache_entry *entry;
+  uint32_t data_size;
+  uint32_t *rp;
+  uint32_t i;
+
+  if ((generation & 1)) {
+    return 0;
+  }
+
+  CRITICAL_SECTION_ENTER(grn_ii_posting_cache.lock);
+  entry = grn_ii_posting_cache.buckets[
+    grn_ii_posting_cache_hash(ii, tid, segno, offset)];
+  for (; entry; entry = entry->bucket_next) {
+    if (entry->ii == ii &&
+        entry->tid == tid &&
+        entry->segno == segno &&
+        entry->offset == offset) {
+      break;
+    }
+  }
+  if (entry &&
+      (entry->generation != generation || entry->n_elements != dvlen)) {
+    grn_ii_posting_cache_remove(entry);
+    entry = NULL;
+  }
+  if (!entry) {
+    grn_ii_posting_cache.n_misses++;
+    CRITICAL_SECTION_LEAVE(grn_ii_posting_cache.lock);
+    return 0;
+  }
+  grn_ii_posting_cache.n_hits++;
+  if (entry->prev) {
+    entry->prev->next = entry->next;
+    if (entry->next) {
+      entry->next->prev = entry->prev;
+    } else {
+      grn_ii_posting_cache.tail = entry->prev;
+    }
+    entry->prev = NULL;
+    entry->next = grn_ii_posting_cache.head;
+    grn_ii_posting_cache.head->prev = entry;
+    grn_ii_posting_cache.head = entry;
+  }
+  entry->n_refs++;
+  CRITICAL_SECTION_LEAVE(grn_ii_posting_cache.lock);
+
+  data_size = entry->data_size;
+  if (dv[dvlen].data < dv[0].data + data_size) {
+    if (dv[0].data) { GRN_FREE(dv[0].data); }
+    dv[0].data = GRN_MALLOCN(uint32_t, data_size);
+    if (dv[0].data) {
+      dv[dvlen].data = dv[0].data + data_size;
+    } else {
+      dv[dvlen].data = NULL;
+    }
+  }
+  if (dv[0].data) {
+    grn_memcpy(dv[0].data, entry->data, sizeof(uint32_t) * data_size);
+    for (i = 0, rp = dv[0].data; i < dvlen; i++) {
+      dv[i].data = rp;
+      dv[i].data_size = entry->data_sizes[i];
+      rp += entry->data_sizes[i];
+    }
+  }
+
+  CRITICAL_SECTION_ENTER(grn_ii_posting_cache.lock);
+  entry->n_refs--;
+  if (entry->n_refs == 0 && !entry->cached) {
+    grn_ii_posting_cache_entry_free(entry);
+  }
+  CRITICAL_SECTION_LEAVE(grn_ii_posting_cache.lock);
+
+  if (!dv[0].data) {
+    return 0;
+  }
+  return data_size;
+}
+
+/*
+ * Stores a chunk decoded by grn_p_decv(). generation must be the chunk
+ * generation before the chunk is decoded. The chunk isn't stored when
+ * it may be changed while decoding.
+ */
+static void
+grn_ii_posting_cache_store(grn_ii *ii, grn_id tid,
+                           uint32_t segno, uint32_t offset,
+                           uint64_t generation,
+                           datavec *dv, uint32_t dvlen,
+                           uint32_t data_size)
+{
+  grn_ctx *ctx = &grn_gctx;
+  grn_ii_posting_cache_entry *entry;
+  grn_ii_posting_cache_entry **bucket;
+  size_t size;
+  uint32_t i;
+
+  if ((generation & 1) ||
+      ii->header.common->chunk_generation != generation) {
+    return;
+  }
+  size = sizeof(grn_ii_posting_cache_entry) + sizeof(uint32_t) * data_size;
+  if (size > grn_ii_posting_cache_max_size) {
+    return;
+  }
+
+  entry = GRN_MALLOC(size);
+  if (!entry) {
+    return;
+  }
+  entry->ii = ii;
+  entry->tid = tid;
+  entry->segno = segno;
+  entry->offset = offset;
+  entry->generation = generation;
+  entry->n_refs = 0;
+  entry->cached = GRN_TRUE;
+  entry->n_elements = dvlen;
+  for (i = 0; i < dvlen; i++) {
+    entry->data_sizes[i] = dv[i].data_size;
+  }
+  entry->data_size = data_size;
+  entry->data = (uint32_t *)(entry + 1);
+  grn_memcpy(entry->data, dv[0].data, sizeof(uint32_t) * data_size);
+  entry->size = size;
+
+  CRITICAL_SECTION_ENTER(grn_ii_posting_cache.lock);
+  bucket = &(grn_ii_posting_cache.buckets[
+               grn_ii_posting_cache_hash(ii, tid, segno, offset)]);
+  {
+    grn_ii_posting_cache_entry *cached;
+    for (cached = *bucket; cached; cached = cached->bucket_next) {
+      if (cached->ii == ii &&
+          cached->tid == tid &&
+          cached->segno == segno &&
+          cached->offset == offset) {
+        grn_ii_posting_cache_remove(cached);
+        break;
+      }
+    }
+  }
+  while (grn_ii_posting_cache.tail &&
+         grn_ii_posting_cache.size + size > grn_ii_posting_cache_max_size) {
+    grn_ii_posting_cache_remove(grn_ii_posting_cache.tail);
+  }
+  entry->bucket_next = *bucket;
+  *bucket = entry;
+  entry->prev = NULL;
+  entry->next = grn_ii_posting_cache.head;
+  if (grn_ii_posting_cache.head) {
+    grn_ii_posting_cache.head->prev = entry;
+  } else {
+    grn_ii_posting_cache.tail = entry;
+  }
+  grn_ii_posting_cache.head = entry;
+  grn_ii_posting_cache.n_entries++;
+  grn_ii_posting_cache.size += size;
+  CRITICAL_SECTION_LEAVE(grn_ii_posting_cache.lock);
+}
+
+#define BIT11_01(x) ((x >> 1) & 0x7ff)
+#define BIT31_12(x) (x >> 12)
+
+grn_rc
+grn_ii_update_one(grn_ctx *ctx, grn_ii *ii, grn_id tid, grn_ii_updspec *u, grn_hash *h)
 {
   buffer *b;
   uint8_t *bs;
@@ -6096,6 +7657,7 @@ grn_ii_update_one(grn_ctx *ctx, grn_ii *ii, grn_id tid, grn_ii_updspec *u, grn_h
   if (!a[0] || POS_IS_EMBED(a[0])) { a[0] = pos; }
 exit :
   array_unref(ii, tid);
+  ii->header.common->generation++;
   if (bs) { GRN_FREE(bs); }
   if (u->tf != u->atf) {
     grn_obj *source_table;
@@ -6287,6 +7849,7 @@ grn_ii_delete_one(grn_ctx *ctx, grn_ii *ii, grn_id tid, grn_ii_updspec *u, grn_h
   }
 exit :
   array_unref(ii, tid);
+  ii->header.common->generation++;
   if (bs) { GRN_FREE(bs); }
   return ctx->rc;
 }
@@ -6323,6 +7886,7 @@ struct _grn_ii_cursor {
   uint32_t curr_chunk;
   chunk_info *cinfo;
   grn_io_win iw;
+  uint32_t pos_in_chunk;
   uint8_t *cp;
   uint8_t *cpe;
   datavec rdv[MAX_N_ELEMENTS + 1];
@@ -6448,6 +8012,7 @@ grn_ii_cursor_open(grn_ctx *ctx, grn_ii *ii, grn_id tid,
           grn_ii_cursor_close(ctx, c);
           continue;
         }
+        c->pos_in_chunk = bt->pos_in_chunk;
         c->cpe = c->cp + bt->size_in_chunk;
         if ((bt->tid & CHUNK_SPLIT)) {
           int i;
@@ -6494,6 +8059,70 @@ exit :
   return c;
 }
 
+/*
+ * Skips postings in the current decoded chunk that are less than
+ * c->min. Record IDs in the decoded chunk are sorted absolute IDs, so
+ * we can gallop (exponential search and then binary search) to the
+ * target posting instead of visiting postings one by one. Other
+ * columns (section, term frequency, weight and position) are advanced
+ * by the number of skipped postings.
+ *
+ * This doesn't reduce decoding by itself. Sub-chunks before the target
+ * posting are skipped without decoding by chunk_info in
+ * grn_ii_cursor_set_min(). buffer_merge_flush_skip_chunks() keeps
+ * sub-chunks small enough to be skip entries.
+ */
+static grn_inline void
+grn_ii_cursor_skip_chunk_postings(grn_ctx *ctx, grn_ii_cursor *c)
+{
+  const uint32_t flags = c->ii->header.common->flags;
+  const uint32_t *rids = c->crp;
+  const uint32_t n_rest = (c->cdp + c->cdf) - c->crp;
+  uint32_t low = 0;
+  uint32_t high = 1;
+  uint32_t i;
+
+  if (n_rest == 0 || rids[0] >= c->min) {
+    return;
+  }
+
+  /* rids[low] < c->min && (high == n_rest || rids[high] >= c->min) */
+  while (high < n_rest && rids[high] < c->min) {
+    low = high;
+    high *= 2;
+  }
+  if (high > n_rest) {
+    high = n_rest;
+  }
+  while (low + 1 < high) {
+    uint32_t middle = low + (high - low) / 2;
+    if (rids[middle] < c->min) {
+      low = middle;
+    } else {
+      high = middle;
+    }
+  }
+
+  if (flags & GRN_OBJ_WITH_POSITION) {
+    c->cpp += c->pc.rest;
+    for (i = 0; i < high; i++) {
+      c->cpp += 1 + c->ctp[i];
+    }
+  }
+  c->crp += high;
+  if (flags & GRN_OBJ_WITH_SECTION) {
+    c->csp += high;
+  }
+  c->ctp += high;
+  if (flags & GRN_OBJ_WITH_WEIGHT) {
+    c->cwp += high;
+  }
+  /* The next posting always has a different record ID from the
+   * skipped one. So section ID is reset in grn_ii_cursor_next(). */
+  c->pc.rid = rids[high - 1];
+  c->pc.rest = 0;
+}
+
 static grn_inline void
 grn_ii_cursor_set_min(grn_ctx *ctx, grn_ii_cursor *c, grn_id min)
 {
@@ -6546,6 +8175,13 @@ grn_ii_cursor_set_min(grn_ctx *ctx, grn_ii_cursor *c, grn_id min)
                 (c->stat & CHUNK_USED) ? "true" : "false");
       }
     }
+    if (c->buf &&
+        c->pc.rid != GRN_ID_NIL &&
+        c->pc.rid < c->min &&
+        c->crp < c->cdp + c->cdf) {
+      grn_ii_cursor_skip_chunk_postings(ctx, c);
+      c->stat |= CHUNK_USED;
+    }
   }
 }
 
@@ -6553,6 +8189,35 @@ typedef struct {
   grn_bool include_garbage;
 } grn_ii_cursor_next_options;
 
+/*
+ * Decodes a chunk at segno and offset into c->rdv. A decoded chunk in
+ * grn_ii_posting_cache is used if it exists. cached is set to
+ * GRN_FALSE when the chunk is decoded by grn_p_decv(). The caller
+ * should store the decoded chunk with generation after it confirms that
+ * the chunk isn't reused while decoding.
+ */
+static grn_inline int
+grn_ii_cursor_decode_chunk(grn_ctx *ctx, grn_ii_cursor *c,
+                           uint8_t *cp, uint32_t size,
+                           uint32_t segno, uint32_t offset,
+                           uint64_t *generation, grn_bool *cached)
+{
+  if (grn_ii_posting_cache.initialized) {
+    int decoded_size;
+    *generation = c->ii->header.common->chunk_generation;
+    decoded_size = grn_ii_posting_cache_fetch(ctx, c->ii, c->id,
+                                              segno, offset,
+                                              *generation,
+                                              c->rdv, c->ii->n_elements);
+    if (decoded_size > 0) {
+      *cached = GRN_TRUE;
+      return decoded_size;
+    }
+  }
+  *cached = GRN_FALSE;
+  return grn_p_decv(ctx, c->ii, c->id, cp, size, c->rdv, c->ii->n_elements);
+}
+
 static grn_inline grn_posting *
 grn_ii_cursor_next_internal(grn_ctx *ctx, grn_ii_cursor *c,
                             grn_ii_cursor_next_options *options)
@@ -6563,9 +8228,10 @@ grn_ii_cursor_next_internal(grn_ctx *ctx, grn_ii_cursor *c,
       if (c->stat & CHUNK_USED) {
         for (;;) {
           if (c->crp < c->cdp + c->cdf) {
-            uint32_t dgap = *c->crp++;
-            c->pc.rid += dgap;
-            if (dgap) { c->pc.sid = 0; }
+            /* Record IDs are already delta decoded. */
+            grn_id rid = *c->crp++;
+            if (rid != c->pc.rid) { c->pc.sid = 0; }
+            c->pc.rid = rid;
             if ((c->ii->header.common->flags & GRN_OBJ_WITH_SECTION)) {
               c->pc.sid += 1 + *c->csp++;
             } else {
@@ -6608,10 +8274,15 @@ grn_ii_cursor_next_internal(grn_ctx *ctx, grn_ii_cursor *c,
               if (c->curr_chunk == c->nchunks) {
                 if (c->cp < c->cpe) {
                   int decoded_size;
+                  uint64_t generation = 0;
+                  grn_bool cached = GRN_FALSE;
                   decoded_size =
-                    grn_p_decv(ctx, c->ii, c->id,
-                               c->cp, c->cpe - c->cp,
-                               c->rdv, c->ii->n_elements);
+                    grn_ii_cursor_decode_chunk(ctx, c,
+                                               c->cp, c->cpe - c->cp,
+                                               c->buf->header.chunk,
+                                               c->pos_in_chunk,
+                                               &generation,
+                                               &cached);
                   if (decoded_size == 0) {
                     DEFINE_NAME(c->ii);
                     GRN_LOG(ctx, GRN_LOG_WARNING,
@@ -6655,6 +8326,14 @@ grn_ii_cursor_next_internal(grn_ctx *ctx, grn_ii_cursor *c,
                     c->pc.rid = GRN_ID_NIL;
                     break;
                   }
+                  if (!cached && grn_ii_posting_cache.initialized) {
+                    grn_ii_posting_cache_store(c->ii, c->id,
+                                               c->buf->header.chunk,
+                                               c->pos_in_chunk,
+                                               generation,
+                                               c->rdv, c->ii->n_elements,
+                                               decoded_size);
+                  }
                 } else {
                   c->pc.rid = GRN_ID_NIL;
                   break;
@@ -6667,9 +8346,15 @@ grn_ii_cursor_next_internal(grn_ctx *ctx, grn_ii_cursor *c,
                                           c->cinfo[c->curr_chunk].segno, 0,
                                           size, GRN_IO_RDONLY))) {
                   int decoded_size;
+                  uint64_t generation = 0;
+                  grn_bool cached = GRN_FALSE;
                   decoded_size =
-                    grn_p_decv(ctx, c->ii, c->id,
-                               cp, size, c->rdv, c->ii->n_elements);
+                    grn_ii_cursor_decode_chunk(ctx, c,
+                                               cp, size,
+                                               c->cinfo[c->curr_chunk].segno,
+                                               0,
+                                               &generation,
+                                               &cached);
                   grn_io_win_unmap(&iw);
                   if (decoded_size == 0) {
                     DEFINE_NAME(c->ii);
@@ -6701,6 +8386,14 @@ grn_ii_cursor_next_internal(grn_ctx *ctx, grn_ii_cursor *c,
                     c->pc.rid = GRN_ID_NIL;
                     break;
                   }
+                  if (!cached && grn_ii_posting_cache.initialized) {
+                    grn_ii_posting_cache_store(c->ii, c->id,
+                                               c->cinfo[c->curr_chunk].segno,
+                                               0,
+                                               generation,
+                                               c->rdv, c->ii->n_elements,
+                                               decoded_size);
+                  }
                 } else {
                   c->pc.rid = GRN_ID_NIL;
                   break;
@@ -6710,6 +8403,7 @@ grn_ii_cursor_next_internal(grn_ctx *ctx, grn_ii_cursor *c,
                 int j = 0;
                 c->cdf = c->rdv[j].data_size;
                 c->crp = c->cdp = c->rdv[j++].data;
+                grn_ii_delta_decode(c->cdp, c->cdf);
                 if ((c->ii->header.common->flags & GRN_OBJ_WITH_SECTION)) {
                   c->csp = c->rdv[j++].data;
                 }
@@ -7737,6 +9431,270 @@ grn_uvector2updspecs(grn_ctx *ctx, grn_ii *ii, grn_id rid,
   }
 }
 
+/*
+ * grn_ii_batch defers index updates for new values. load opens a batch and
+ * grn_ii_column_update appends postings of new values to it instead of
+ * applying them one by one. Pending postings of an index are sorted by
+ * buffer segment, term ID and record ID and applied with one lock
+ * acquisition when the batch becomes full, when a non-new value of the
+ * index is updated or when the batch is closed.
+ *
+ * Batches are disabled by default. GRN_II_BATCH_MAX_N_RECORDS enables
+ * them.
+ */
+typedef struct {
+  uint32_t lseg; /* Buffer segment of the term. It's set in flush. */
+  grn_id tid;
+  grn_ii_updspec *u;
+} grn_ii_batch_posting;
+
+typedef struct {
+  grn_ii *ii;
+  grn_obj postings; /* grn_ii_batch_posting */
+} grn_ii_batch_target;
+
+struct _grn_ii_batch {
+  uint32_t max_n_records;
+  uint32_t n_records;
+  grn_id last_rid;
+  grn_obj targets; /* grn_ii_batch_target */
+};
+
+#define GRN_II_BATCH_NO_LSEG ((uint32_t)-1)
+
+grn_ii_batch *
+grn_ii_batch_open(grn_ctx *ctx)
+{
+  grn_ii_batch *batch;
+
+  if (grn_ii_batch_max_n_records == 0) {
+    return NULL;
+  }
+
+  batch = GRN_MALLOCN(grn_ii_batch, 1);
+  if (!batch) {
+    ERR(GRN_NO_MEMORY_AVAILABLE,
+        "[ii][batch][open] failed to allocate a batch");
+    return NULL;
+  }
+  batch->max_n_records = grn_ii_batch_max_n_records;
+  batch->n_records = 0;
+  batch->last_rid = GRN_ID_NIL;
+  GRN_TEXT_INIT(&(batch->targets), 0);
+  return batch;
+}
+
+static grn_bool
+grn_ii_batch_value_is_empty(grn_ctx *ctx, grn_obj *value)
+{
+  if (!value) {
+    return GRN_TRUE;
+  }
+  switch (value->header.type) {
+  case GRN_VECTOR :
+    return grn_vector_size(ctx, value) == 0;
+  case GRN_BULK :
+  case GRN_UVECTOR :
+    return GRN_BULK_VSIZE(value) == 0;
+  default :
+    return GRN_FALSE;
+  }
+}
+
+static int
+grn_ii_batch_posting_compare(const void *a, const void *b)
+{
+  const grn_ii_batch_posting *posting1 = a;
+  const grn_ii_batch_posting *posting2 = b;
+  if (posting1->lseg != posting2->lseg) {
+    return posting1->lseg < posting2->lseg ? -1 : 1;
+  }
+  if (posting1->tid != posting2->tid) {
+    return posting1->tid < posting2->tid ? -1 : 1;
+  }
+  if (posting1->u->rid != posting2->u->rid) {
+    return posting1->u->rid < posting2->u->rid ? -1 : 1;
+  }
+  if (posting1->u->sid != posting2->u->sid) {
+    return posting1->u->sid < posting2->u->sid ? -1 : 1;
+  }
+  return 0;
+}
+
+static grn_rc
+grn_ii_batch_target_flush(grn_ctx *ctx, grn_ii_batch_target *target)
+{
+  grn_ii *ii = target->ii;
+  grn_ii_batch_posting *postings;
+  size_t i, n_postings;
+  grn_id previous_tid = GRN_ID_NIL;
+  uint32_t previous_lseg = GRN_II_BATCH_NO_LSEG;
+
+  postings = (grn_ii_batch_posting *)GRN_BULK_HEAD(&(target->postings));
+  n_postings = GRN_BULK_VSIZE(&(target->postings)) /
+    sizeof(grn_ii_batch_posting);
+  if (n_postings == 0) {
+    return GRN_SUCCESS;
+  }
+
+  if (grn_io_lock(ctx, ii->seg, grn_lock_timeout) == GRN_SUCCESS) {
+    /* Apply postings in the same buffer segment together. */
+    for (i = 0; i < n_postings; i++) {
+      grn_ii_batch_posting *posting = &(postings[i]);
+      if (posting->tid != previous_tid) {
+        uint32_t *a;
+        previous_tid = posting->tid;
+        previous_lseg = GRN_II_BATCH_NO_LSEG;
+        a = array_at(ctx, ii, posting->tid);
+        if (a) {
+          if (a[0] && !POS_IS_EMBED(a[0])) {
+            previous_lseg = grn_ii_pos_lseg(ii, a[0]);
+          }
+          array_unref(ii, posting->tid);
+        }
+      }
+      posting->lseg = previous_lseg;
+    }
+    qsort(postings, n_postings, sizeof(grn_ii_batch_posting),
+          grn_ii_batch_posting_compare);
+    for (i = 0; i < n_postings; i++) {
+      grn_ii_update_one(ctx, ii, postings[i].tid, postings[i].u, NULL);
+      if (ctx->rc != GRN_SUCCESS) {
+        break;
+      }
+    }
+    grn_io_unlock(ii->seg);
+  }
+  if (ctx->rc != GRN_SUCCESS) {
+    DEFINE_NAME(ii);
+    GRN_LOG(ctx, GRN_LOG_ERROR,
+            "[ii][batch][flush] failed to apply postings: <%.*s>: "
+            "n_postings:<%" GRN_FMT_SIZE ">",
+            name_size, name,
+            n_postings);
+  }
+
+  for (i = 0; i < n_postings; i++) {
+    grn_ii_updspec_close(ctx, postings[i].u);
+  }
+  GRN_BULK_REWIND(&(target->postings));
+  return ctx->rc;
+}
+
+grn_rc
+grn_ii_batch_flush(grn_ctx *ctx, grn_ii_batch *batch)
+{
+  grn_ii_batch_target *targets;
+  size_t i, n_targets;
+  grn_rc rc = GRN_SUCCESS;
+
+  targets = (grn_ii_batch_target *)GRN_BULK_HEAD(&(batch->targets));
+  n_targets = GRN_BULK_VSIZE(&(batch->targets)) / sizeof(grn_ii_batch_target);
+  for (i = 0; i < n_targets; i++) {
+    grn_rc target_rc = grn_ii_batch_target_flush(ctx, &(targets[i]));
+    if (rc == GRN_SUCCESS) {
+      rc = target_rc;
+    }
+  }
+  batch->n_records = 0;
+  return rc;
+}
+
+static grn_rc
+grn_ii_batch_flush_ii(grn_ctx *ctx, grn_ii_batch *batch, grn_ii *ii)
+{
+  grn_ii_batch_target *targets;
+  size_t i, n_targets;
+
+  targets = (grn_ii_batch_target *)GRN_BULK_HEAD(&(batch->targets));
+  n_targets = GRN_BULK_VSIZE(&(batch->targets)) / sizeof(grn_ii_batch_target);
+  for (i = 0; i < n_targets; i++) {
+    if (targets[i].ii == ii) {
+      return grn_ii_batch_target_flush(ctx, &(targets[i]));
+    }
+  }
+  return GRN_SUCCESS;
+}
+
+/*
+ * grn_ii_batch_add moves updspecs in h to the batch. Moved values in h are
+ * set to NULL.
+ */
+static void
+grn_ii_batch_add(grn_ctx *ctx, grn_ii_batch *batch, grn_ii *ii, grn_id rid,
+                 grn_hash *h)
+{
+  grn_ii_batch_target *targets;
+  grn_ii_batch_target *target = NULL;
+  size_t i, n_targets;
+  grn_id *tp;
+  grn_ii_updspec **u;
+
+  targets = (grn_ii_batch_target *)GRN_BULK_HEAD(&(batch->targets));
+  n_targets = GRN_BULK_VSIZE(&(batch->targets)) / sizeof(grn_ii_batch_target);
+  for (i = 0; i < n_targets; i++) {
+    if (targets[i].ii == ii) {
+      target = &(targets[i]);
+      break;
+    }
+  }
+  if (!target) {
+    grn_bulk_space(ctx, &(batch->targets), sizeof(grn_ii_batch_target));
+    if (ctx->rc != GRN_SUCCESS) {
+      return;
+    }
+    target = ((grn_ii_batch_target *)GRN_BULK_CURR(&(batch->targets))) - 1;
+    target->ii = ii;
+    GRN_TEXT_INIT(&(target->postings), 0);
+  }
+
+  GRN_HASH_EACH(ctx, h, id, &tp, NULL, &u, {
+    grn_ii_batch_posting posting;
+    if (!*tp || !(*u)->tf || !(*u)->sid) {
+      continue;
+    }
+    posting.lseg = GRN_II_BATCH_NO_LSEG;
+    posting.tid = *tp;
+    posting.u = *u;
+    if (grn_bulk_write(ctx, &(target->postings),
+                       (const char *)&posting,
+                       sizeof(grn_ii_batch_posting)) != GRN_SUCCESS) {
+      break;
+    }
+    *u = NULL;
+  });
+
+  if (rid != batch->last_rid) {
+    batch->last_rid = rid;
+    batch->n_records++;
+    if (batch->n_records >= batch->max_n_records) {
+      grn_ii_batch_flush(ctx, batch);
+    }
+  }
+}
+
+grn_rc
+grn_ii_batch_close(grn_ctx *ctx, grn_ii_batch *batch)
+{
+  grn_ii_batch_target *targets;
+  size_t i, n_targets;
+  grn_rc rc;
+
+  if (!batch) {
+    return GRN_INVALID_ARGUMENT;
+  }
+
+  rc = grn_ii_batch_flush(ctx, batch);
+  targets = (grn_ii_batch_target *)GRN_BULK_HEAD(&(batch->targets));
+  n_targets = GRN_BULK_VSIZE(&(batch->targets)) / sizeof(grn_ii_batch_target);
+  for (i = 0; i < n_targets; i++) {
+    GRN_OBJ_FIN(ctx, &(targets[i].postings));
+  }
+  GRN_OBJ_FIN(ctx, &(batch->targets));
+  GRN_FREE(batch);
+  return rc;
+}
+
 grn_rc
 grn_ii_column_update(grn_ctx *ctx, grn_ii *ii, grn_id rid, unsigned int section,
                      grn_obj *oldvalue, grn_obj *newvalue, grn_obj *posting)
@@ -7746,6 +9704,7 @@ grn_ii_column_update(grn_ctx *ctx, grn_ii *ii, grn_id rid, unsigned int section,
   grn_ii_updspec **u, **un;
   grn_obj *old_, *old = oldvalue, *new_, *new = newvalue, oldv, newv;
   grn_obj buf, *post = NULL;
+  grn_ii_batch *batch = NULL;
 
   if (!ii) {
     ERR(GRN_INVALID_ARGUMENT, "[ii][column][update] ii is NULL");
@@ -7824,11 +9783,25 @@ grn_ii_column_update(grn_ctx *ctx, grn_ii *ii, grn_id rid, unsigned int section,
       }
     }
   }
+  if (ctx->impl && ctx->impl->ii_batch) {
+    if (!posting && new && grn_ii_batch_value_is_empty(ctx, old)) {
+      /* Postings for a new value are appended to the batch. */
+      batch = ctx->impl->ii_batch;
+      old = NULL;
+    } else {
+      /* Pending postings must be applied before they are updated. */
+      if (grn_ii_batch_flush_ii(ctx, ctx->impl->ii_batch, ii) != GRN_SUCCESS) {
+        return ctx->rc;
+      }
+    }
+  }
   if (posting) {
     GRN_RECORD_INIT(&buf, GRN_OBJ_VECTOR, grn_obj_id(ctx, ii->lexicon));
     post = &buf;
   }
-  if (grn_io_lock(ctx, ii->seg, grn_lock_timeout)) { return ctx->rc; }
+  if (!batch) {
+    if (grn_io_lock(ctx, ii->seg, grn_lock_timeout)) { return ctx->rc; }
+  }
   if (new) {
     unsigned char type = (ii->obj.header.domain == new->header.domain)
       ? GRN_UVECTOR
@@ -8030,6 +10003,28 @@ grn_ii_column_update(grn_ctx *ctx, grn_ii *ii, grn_id rid, unsigned int section,
     }
   }
 
+  if (ii->document_lengths) {
+    uint32_t old_length = 0;
+    uint32_t new_length = 0;
+    if (old) {
+      old_length = grn_ii_document_length_compute(ctx, (grn_hash *)old);
+    }
+    if (new) {
+      new_length = grn_ii_document_length_compute(ctx, (grn_hash *)new);
+    }
+    if (batch) {
+      /* The totals in the header are shared with other threads. The
+         index is already locked without batch. */
+      if (grn_io_lock(ctx, ii->seg, grn_lock_timeout)) { goto exit; }
+    }
+    grn_ii_document_length_update(ctx, ii, rid, section,
+                                  old_length, new_length);
+    if (batch) {
+      grn_io_unlock(ii->seg);
+    }
+    if (ctx->rc != GRN_SUCCESS) { goto exit; }
+  }
+
   if (old) {
     grn_id eid;
     grn_hash *o = (grn_hash *)old;
@@ -8051,19 +10046,25 @@ grn_ii_column_update(grn_ctx *ctx, grn_ii *ii, grn_id rid, unsigned int section,
   }
   if (new) {
     grn_hash *n = (grn_hash *)new;
-    GRN_HASH_EACH(ctx, n, id, &tp, NULL, &u, {
-      grn_ii_update_one(ctx, ii, *tp, *u, n);
-      if (ctx->rc != GRN_SUCCESS) {
-        break;
-      }
-    });
+    if (batch) {
+      grn_ii_batch_add(ctx, batch, ii, rid, n);
+    } else {
+      GRN_HASH_EACH(ctx, n, id, &tp, NULL, &u, {
+        grn_ii_update_one(ctx, ii, *tp, *u, n);
+        if (ctx->rc != GRN_SUCCESS) {
+          break;
+        }
+      });
+    }
   } else {
     if (!section) {
       /* todo: delete key when all sections deleted */
     }
   }
 exit :
-  grn_io_unlock(ii->seg);
+  if (!batch) {
+    grn_io_unlock(ii->seg);
+  }
   if (old && old->header.type == GRN_TABLE_HASH_KEY) {
     grn_hash *o = (grn_hash *)old;
     GRN_HASH_EACH(ctx, o, id, &tp, NULL, &u, {
@@ -8074,7 +10075,9 @@ exit :
   if (new && new->header.type == GRN_TABLE_HASH_KEY) {
     grn_hash *n = (grn_hash *)new;
     GRN_HASH_EACH(ctx, n, id, &tp, NULL, &u, {
-      grn_ii_updspec_close(ctx, *u);
+      if (*u) {
+        grn_ii_updspec_close(ctx, *u);
+      }
     });
     if (new != newvalue) { grn_obj_close(ctx, new); }
   }
@@ -9238,6 +11241,7 @@ grn_ii_term_extract(grn_ctx *ctx, grn_ii *ii, const char *string,
 }
 
 typedef struct {
+  grn_ii *ii;
   grn_obj *lexicon;
   const char *query;
   unsigned int query_len;
@@ -9296,7 +11300,9 @@ grn_ii_select_data_init(grn_ctx *ctx,
     data->score_func = scorer->callbacks.scorer.score;
     data->record.table = grn_ctx_at(ctx, data->result_set->obj.header.domain);
     data->record.lexicon = data->lexicon;
+    data->record.ii = data->ii;
     data->record.id = GRN_ID_NIL;
+    data->record.section_id = 0;
     GRN_RECORD_INIT(&(data->record.terms), GRN_OBJ_VECTOR,
                     data->lexicon->header.domain);
     GRN_UINT32_INIT(&(data->record.term_weights), GRN_OBJ_VECTOR);
@@ -9308,6 +11314,11 @@ grn_ii_select_data_init(grn_ctx *ctx,
     data->record.weight = 0;
     data->record.args_expr = optarg->scorer_args_expr;
     data->record.args_expr_offset = optarg->scorer_args_expr_offset;
+    data->record.previous_id = GRN_ID_NIL;
+    data->record.n_previous_occurrences = 0;
+    data->record.previous_total_term_weights = 0;
+    data->record.normalized_tf = 0.0;
+    data->record.previous_normalized_tf = 0.0;
   }
 }
 
@@ -10040,10 +12051,14 @@ grn_ii_quorum_match(grn_ctx *ctx, grn_ii *ii, grn_ii_select_data *data)
           grn_memcpy(&posinfo, posting, record_key_size);
           if (data->score_func) {
             data->record.id = posting->rid;
+            data->record.section_id = posting->sid;
             data->record.weight = score / record_data->n_occurs;
             data->record.n_occurrences = record_data->n_occurs;
             data->record.total_term_weights = data->record.weight;
-            score = data->score_func(ctx, &(data->record)) * data->record.weight;
+            score = grn_scorer_matched_record_score(ctx,
+                                                    &(data->record),
+                                                    data->score_func) *
+              data->record.weight;
           }
           res_add(ctx, data->result_set, &posinfo, score, data->op);
         }
@@ -10265,6 +12280,122 @@ grn_ii_select_sequential_search(grn_ctx *ctx,
 }
 #endif
 
+static grn_inline grn_bool
+grn_ii_bitmap_contain(grn_ii_bitmap *bitmap, grn_id rid)
+{
+  uint32_t key = rid >> 16;
+  uint16_t value = rid & 0xffff;
+  uint32_t left = 0;
+  uint32_t right = bitmap->n_containers;
+  grn_ii_bitmap_container *container = NULL;
+
+  while (left < right) {
+    uint32_t middle = left + (right - left) / 2;
+    if (bitmap->containers[middle].key < key) {
+      left = middle + 1;
+    } else {
+      right = middle;
+    }
+  }
+  if (left == bitmap->n_containers || bitmap->containers[left].key != key) {
+    return GRN_FALSE;
+  }
+  container = &(bitmap->containers[left]);
+  if (container->words) {
+    return (container->words[value >> 6] >> (value & 63)) & 1;
+  }
+  left = 0;
+  right = container->cardinality;
+  while (left < right) {
+    uint32_t middle = left + (right - left) / 2;
+    if (container->values[middle] < value) {
+      left = middle + 1;
+    } else {
+      right = middle;
+    }
+  }
+  return left < container->cardinality && container->values[left] == value;
+}
+
+/*
+ * Evaluates a query that has only one high document frequency term by
+ * its bitmap. Returns GRN_FALSE when the bitmap isn't available. The
+ * score of a matched record is the same as the one computed by postings
+ * because tf is always 1 and there is no weight in postings.
+ */
+static grn_bool
+grn_ii_select_bitmap(grn_ctx *ctx, grn_ii *ii, grn_ii_select_data *data,
+                     token_info *ti, grn_select_optarg *optarg)
+{
+  grn_hash *s = data->result_set;
+  grn_ii_bitmap *bitmap;
+  double score;
+
+  if (grn_ii_bitmap_df_ratio <= 0.0) {
+    return GRN_FALSE;
+  }
+  if (data->score_func || data->only_skip_token) {
+    return GRN_FALSE;
+  }
+  if (ii->header.common->flags &
+      (GRN_OBJ_WITH_POSITION | GRN_OBJ_WITH_SECTION | GRN_OBJ_WITH_WEIGHT)) {
+    return GRN_FALSE;
+  }
+  if (s->key_size != sizeof(grn_id)) {
+    return GRN_FALSE;
+  }
+  if (ti->cursors->n_entries != 1) {
+    return GRN_FALSE;
+  }
+  if (data->op != GRN_OP_AND && data->op != GRN_OP_AND_NOT) {
+    return GRN_FALSE;
+  }
+  {
+    grn_obj *range = grn_ctx_at(ctx, DB_OBJ(ii)->range);
+    unsigned int n_records;
+    if (!range) {
+      return GRN_FALSE;
+    }
+    n_records = grn_table_size(ctx, range);
+    if (n_records == 0 || ti->size < n_records * grn_ii_bitmap_df_ratio) {
+      return GRN_FALSE;
+    }
+  }
+
+  bitmap = grn_ii_bitmap_open(ctx, ii, ti->cursors->bins[0]->id);
+  if (!bitmap) {
+    return GRN_FALSE;
+  }
+
+  score = 1 + ti->cursors->bins[0]->weight;
+  GRN_HASH_EACH_BEGIN(ctx, s, cursor, id) {
+    void *key;
+    grn_rset_posinfo pi = {GRN_ID_NIL, 1, 0};
+    int weight;
+    grn_hash_cursor_get_key(ctx, cursor, &key);
+    pi.rid = *((grn_id *)key);
+    /* Postings before the previous minimum record ID are skipped. */
+    if (pi.rid < data->previous_min) {
+      continue;
+    }
+    if (!grn_ii_bitmap_contain(bitmap, pi.rid)) {
+      continue;
+    }
+    weight = get_weight(ctx, s, pi.rid, 1, data->wv_mode, optarg);
+    if (weight == 0) {
+      continue;
+    }
+    if (data->set_min_enable_for_and_query) {
+      if (data->current_min == GRN_ID_NIL || pi.rid < data->current_min) {
+        data->current_min = pi.rid;
+      }
+    }
+    res_add(ctx, s, &pi, score * weight, data->op);
+  } GRN_HASH_EACH_END(ctx, cursor);
+  grn_ii_bitmap_release(bitmap);
+  return GRN_TRUE;
+}
+
 grn_rc
 grn_ii_select(grn_ctx *ctx, grn_ii *ii,
               const char *string, unsigned int string_len,
@@ -10285,6 +12416,7 @@ grn_ii_select(grn_ctx *ctx, grn_ii *ii,
   lexicon = ii->lexicon;
   if (!lexicon || !s) { return GRN_INVALID_ARGUMENT; }
 
+  data.ii = ii;
   data.lexicon = lexicon;
   data.query = string;
   data.query_len = string_len;
@@ -10383,6 +12515,10 @@ grn_ii_select(grn_ctx *ctx, grn_ii *ii,
     goto exit;
   }
   */
+  if (n == 1 && grn_ii_select_bitmap(ctx, ii, &data, *tis, optarg)) {
+    goto exit;
+  }
+
 #ifdef GRN_II_SELECT_ENABLE_SEQUENTIAL_SEARCH
   if (grn_ii_select_sequential_search(ctx, ii, string, string_len,
                                       s, op, data.wv_mode, optarg, tis, n)) {
@@ -10514,10 +12650,14 @@ grn_ii_select(grn_ctx *ctx, grn_ii *ii,
           double record_score;
           if (data.score_func) {
             data.record.id = rid;
+            data.record.section_id = sid;
             data.record.weight = weight;
             data.record.n_occurrences = noccur;
             data.record.total_term_weights = tscore;
-            record_score = data.score_func(ctx, &(data.record)) * weight;
+            record_score = grn_scorer_matched_record_score(ctx,
+                                                           &(data.record),
+                                                           data.score_func) *
+              weight;
           } else {
             record_score = (noccur + tscore) * weight;
           }
@@ -12330,6 +14470,11 @@ grn_ii_build(grn_ctx *ctx, grn_ii *ii, uint64_t sparsity)
       ERR(GRN_INVALID_ARGUMENT, "ii->obj.source is void");
     }
     grn_ii_buffer_close(ctx, ii_buffer);
+    if (ii->document_lengths) {
+      grn_ii_document_length_build(ctx, ii);
+    }
+    ii->header.common->generation++;
+    ii->header.common->chunk_generation += 2;
   }
   return ctx->rc;
 }
@@ -12361,6 +14506,9 @@ grn_ii_build(grn_ctx *ctx, grn_ii *ii, uint64_t sparsity)
 #define GRN_II_BUILDER_MAX_BUFFER_MAX_N_TERMS \
   ((S_SEGMENT - sizeof(buffer_header)) / sizeof(buffer_term))
 
+#define GRN_II_BUILDER_MIN_N_WORKERS          1
+#define GRN_II_BUILDER_MAX_N_WORKERS          64
+
 struct grn_ii_builder_options {
   uint32_t lexicon_cache_size; /* Cache size of temporary lexicon */
   /* A block is flushed if builder->n reaches this value. */
@@ -12370,6 +14518,11 @@ struct grn_ii_builder_options {
   /* A chunk is flushed if chunk->n reaches this value. */
   uint32_t chunk_threshold;
   uint32_t buffer_max_n_terms; /* Maximum number of terms in each buffer */
+  /*
+   * Number of threads to append source values. 0 means that the value of
+   * the current context or GRN_II_BUILDER_N_WORKERS is used.
+   */
+  uint32_t n_workers;
 };
 
 static const grn_ii_builder_options grn_ii_builder_default_options = {
@@ -12379,6 +14532,7 @@ static const grn_ii_builder_options grn_ii_builder_default_options = {
   0x10000,   /* block_buf_size */
   0x1000,    /* chunk_threshold */
   0x3000,    /* buffer_max_n_terms */
+  0,         /* n_workers */
 };
 
 /* grn_ii_builder_options_init fills options with the default options. */
@@ -12430,6 +14584,13 @@ grn_ii_builder_options_fix(grn_ii_builder_options *options)
   if (options->buffer_max_n_terms > GRN_II_BUILDER_MAX_BUFFER_MAX_N_TERMS) {
     options->buffer_max_n_terms = GRN_II_BUILDER_MAX_BUFFER_MAX_N_TERMS;
   }
+
+  if (options->n_workers < GRN_II_BUILDER_MIN_N_WORKERS) {
+    options->n_workers = GRN_II_BUILDER_MIN_N_WORKERS;
+  }
+  if (options->n_workers > GRN_II_BUILDER_MAX_N_WORKERS) {
+    options->n_workers = GRN_II_BUILDER_MAX_N_WORKERS;
+  }
 }
 
 #define GRN_II_BUILDER_TERM_INPLACE_SIZE\
@@ -12591,6 +14752,7 @@ typedef struct {
   uint8_t  *cur;   /* Current pointer */
   uint8_t  *end;   /* End pointer */
   uint32_t tid;    /* Term ID */
+  int      fd;     /* File descriptor of a temporary file (not to be closed) */
 } grn_ii_builder_block;
 
 /*
@@ -12606,6 +14768,7 @@ grn_ii_builder_block_init(grn_ctx *ctx, grn_ii_builder_block *block)
   block->cur = NULL;
   block->end = NULL;
   block->tid = GRN_ID_NIL;
+  block->fd = -1;
 }
 
 /* grn_ii_builder_block_fin finalizes a block. */
@@ -13110,6 +15273,24 @@ grn_ii_builder_chunk_encode(grn_ctx *ctx, grn_ii_builder_chunk *chunk,
   return GRN_SUCCESS;
 }
 
+/* A temporary file created by a worker. */
+typedef struct {
+  char path[PATH_MAX]; /* File path */
+  int  fd;             /* File descriptor (to be closed) */
+} grn_ii_builder_file;
+
+/*
+ * A chunk that is read from blocks but isn't encoded yet. It's a part of
+ * a term that is split at chunk_threshold or the last part of a term.
+ */
+typedef struct {
+  grn_ii_builder_chunk chunk;   /* Chunk (to be finalized) */
+  uint32_t             df;      /* Document frequency of the term */
+  grn_bool             is_last; /* Whether this is the last part */
+} grn_ii_builder_pending_chunk;
+
+#define GRN_II_BUILDER_MAX_N_PENDING_CHUNKS 256
+
 typedef struct {
   grn_ii                 *ii;     /* Building inverted index */
   grn_ii_builder_options options; /* Options */
@@ -13121,6 +15302,8 @@ typedef struct {
   uint64_t sid_mask;   /* Mask bits for section ID */
 
   grn_obj  *lexicon;    /* Block lexicon (to be closed) */
+  /* Lock for adding terms to ii->lexicon shared with workers (or NULL). */
+  grn_critical_section *lexicon_lock;
   grn_bool have_tokenizer;  /* Whether lexicon has tokenizer */
   grn_bool have_normalizer; /* Whether lexicon has tokenizer */
 
@@ -13144,6 +15327,9 @@ typedef struct {
   uint32_t             n_blocks;    /* Number of blocks */
   uint32_t             blocks_size; /* Buffer size of blocks */
 
+  grn_ii_builder_file *files;   /* Temporary files of workers (to be freed) */
+  uint32_t            n_files;  /* Number of temporary files of workers */
+
   grn_ii_builder_buffer buf;   /* Buffer (to be finalized) */
   grn_ii_builder_chunk  chunk; /* Chunk (to be finalized) */
 
@@ -13151,6 +15337,10 @@ typedef struct {
   chunk_info *cinfos;     /* Chunk headers (to be freed) */
   uint32_t   n_cinfos;    /* Number of chunks */
   uint32_t   cinfos_size; /* Size of cinfos */
+
+  /* Chunks to be encoded by multiple threads (to be finalized). */
+  grn_ii_builder_pending_chunk *pending_chunks;
+  uint32_t n_pending_chunks; /* Number of pending chunks */
 } grn_ii_builder;
 
 /*
@@ -13166,6 +15356,13 @@ grn_ii_builder_init(grn_ctx *ctx, grn_ii_builder *builder,
   if (grn_ii_builder_block_threshold_force > 0) {
     builder->options.block_threshold = grn_ii_builder_block_threshold_force;
   }
+  if (builder->options.n_workers == 0) {
+    if (ctx->impl && ctx->impl->ii_builder_n_workers > 0) {
+      builder->options.n_workers = ctx->impl->ii_builder_n_workers;
+    } else {
+      builder->options.n_workers = grn_ii_builder_n_workers;
+    }
+  }
   grn_ii_builder_options_fix(&builder->options);
 
   builder->src_table = NULL;
@@ -13175,6 +15372,7 @@ grn_ii_builder_init(grn_ctx *ctx, grn_ii_builder *builder,
   builder->sid_mask = 0;
 
   builder->lexicon = NULL;
+  builder->lexicon_lock = NULL;
   builder->have_tokenizer = GRN_FALSE;
   builder->have_normalizer = GRN_FALSE;
 
@@ -13197,6 +15395,9 @@ grn_ii_builder_init(grn_ctx *ctx, grn_ii_builder *builder,
   builder->n_blocks = 0;
   builder->blocks_size = 0;
 
+  builder->files = NULL;
+  builder->n_files = 0;
+
   grn_ii_builder_buffer_init(ctx, &builder->buf, ii);
   grn_ii_builder_chunk_init(ctx, &builder->chunk);
 
@@ -13205,6 +15406,9 @@ grn_ii_builder_init(grn_ctx *ctx, grn_ii_builder *builder,
   builder->n_cinfos = 0;
   builder->cinfos_size = 0;
 
+  builder->pending_chunks = NULL;
+  builder->n_pending_chunks = 0;
+
   return GRN_SUCCESS;
 }
 
@@ -13224,10 +15428,32 @@ grn_ii_builder_fin_terms(grn_ctx *ctx, grn_ii_builder *builder)
   }
 }
 
+/* grn_ii_builder_remove_file closes and removes a temporary file. */
+static void
+grn_ii_builder_remove_file(grn_ctx *ctx, const char *path, int fd)
+{
+  grn_close(fd);
+  if (grn_unlink(path) == 0) {
+    GRN_LOG(ctx, GRN_LOG_INFO,
+            "[ii][builder][fin] removed path: <%s>",
+            path);
+  } else {
+    ERRNO_ERR("[ii][builder][fin] failed to remove path: <%s>",
+              path);
+  }
+}
+
 /* grn_ii_builder_fin finalizes a builder. */
 static grn_rc
 grn_ii_builder_fin(grn_ctx *ctx, grn_ii_builder *builder)
 {
+  if (builder->pending_chunks) {
+    uint32_t i;
+    for (i = 0; i < GRN_II_BUILDER_MAX_N_PENDING_CHUNKS; i++) {
+      grn_ii_builder_chunk_fin(ctx, &(builder->pending_chunks[i].chunk));
+    }
+    GRN_FREE(builder->pending_chunks);
+  }
   if (builder->cinfos) {
     GRN_FREE(builder->cinfos);
   }
@@ -13244,15 +15470,16 @@ grn_ii_builder_fin(grn_ctx *ctx, grn_ii_builder *builder)
     GRN_FREE(builder->file_buf);
   }
   if (builder->fd != -1) {
-    grn_close(builder->fd);
-    if (grn_unlink(builder->path) == 0) {
-      GRN_LOG(ctx, GRN_LOG_INFO,
-              "[ii][builder][fin] removed path: <%s>",
-              builder->path);
-    } else {
-      ERRNO_ERR("[ii][builder][fin] failed to remove path: <%s>",
-                builder->path);
+    grn_ii_builder_remove_file(ctx, builder->path, builder->fd);
+  }
+  if (builder->files) {
+    uint32_t i;
+    for (i = 0; i < builder->n_files; i++) {
+      grn_ii_builder_remove_file(ctx,
+                                 builder->files[i].path,
+                                 builder->files[i].fd);
     }
+    GRN_FREE(builder->files);
   }
   grn_ii_builder_fin_terms(ctx, builder);
   if (builder->lexicon) {
@@ -13499,7 +15726,13 @@ grn_ii_builder_flush_term(grn_ctx *ctx, grn_ii_builder *builder,
       }
       return ctx->rc;
     }
+    if (builder->lexicon_lock) {
+      CRITICAL_SECTION_ENTER(*(builder->lexicon_lock));
+    }
     global_tid = grn_table_add(ctx, builder->ii->lexicon, key, key_size, NULL);
+    if (builder->lexicon_lock) {
+      CRITICAL_SECTION_LEAVE(*(builder->lexicon_lock));
+    }
     if (global_tid == GRN_ID_NIL) {
       if (ctx->rc == GRN_SUCCESS) {
         ERR(GRN_UNKNOWN_ERROR,
@@ -13641,6 +15874,7 @@ grn_ii_builder_register_block(grn_ctx *ctx, grn_ii_builder *builder)
     block->offset = prev_block->offset + prev_block->rest;
   }
   block->rest = (uint32_t)(file_offset - block->offset);
+  block->fd = builder->fd;
   builder->n_blocks++;
   return GRN_SUCCESS;
 }
@@ -13902,15 +16136,20 @@ grn_ii_builder_append_obj(grn_ctx *ctx, grn_ii_builder *builder,
 
 /*
  * grn_ii_builder_append_srcs reads values from source columns and appends the
- * values.
+ * values. Only records in [min_rid, max_rid] are read. Records in the range
+ * are visited by ID without a table cursor because a cursor of a table with
+ * keys can't start at a record ID. GRN_ID_NIL for max_rid means all records
+ * and they are read by a cursor in the ID order.
  */
 static grn_rc
-grn_ii_builder_append_srcs(grn_ctx *ctx, grn_ii_builder *builder)
+grn_ii_builder_append_srcs(grn_ctx *ctx, grn_ii_builder *builder,
+                           grn_id min_rid, grn_id max_rid)
 {
   size_t i;
   grn_rc rc = GRN_SUCCESS;
   grn_obj *objs;
-  grn_table_cursor *cursor;
+  grn_table_cursor *cursor = NULL;
+  grn_id next_rid = min_rid;
 
   /* Allocate memory for objects to store source values. */
   objs = GRN_MALLOCN(grn_obj, builder->n_srcs);
@@ -13920,15 +16159,17 @@ grn_ii_builder_append_srcs(grn_ctx *ctx, grn_ii_builder *builder)
     return ctx->rc;
   }
 
-  /* Create a cursor to get records in the ID order. */
-  cursor = grn_table_cursor_open(ctx, builder->src_table, NULL, 0, NULL, 0,
-                                 0, -1, GRN_CURSOR_BY_ID);
-  if (!cursor) {
-    if (ctx->rc == GRN_SUCCESS) {
-      ERR(GRN_OBJECT_CORRUPT, "[index] failed to open table cursor");
+  if (max_rid == GRN_ID_NIL) {
+    /* Create a cursor to get records in the ID order. */
+    cursor = grn_table_cursor_open(ctx, builder->src_table, NULL, 0, NULL, 0,
+                                   0, -1, GRN_CURSOR_BY_ID);
+    if (!cursor) {
+      if (ctx->rc == GRN_SUCCESS) {
+        ERR(GRN_OBJECT_CORRUPT, "[index] failed to open table cursor");
+      }
+      GRN_FREE(objs);
+      return ctx->rc;
     }
-    GRN_FREE(objs);
-    return ctx->rc;
   }
 
   /* Read source values and append it. */
@@ -13936,9 +16177,24 @@ grn_ii_builder_append_srcs(grn_ctx *ctx, grn_ii_builder *builder)
     GRN_TEXT_INIT(&objs[i], 0);
   }
   while (rc == GRN_SUCCESS) {
-    grn_id rid = grn_table_cursor_next(ctx, cursor);
-    if (rid == GRN_ID_NIL) {
-      break;
+    grn_id rid;
+    if (cursor) {
+      rid = grn_table_cursor_next(ctx, cursor);
+      if (rid == GRN_ID_NIL) {
+        break;
+      }
+      if (rid < min_rid) {
+        continue;
+      }
+    } else {
+      if (next_rid > max_rid) {
+        break;
+      }
+      /* Skip deleted records. */
+      rid = grn_table_at(ctx, builder->src_table, next_rid++);
+      if (rid == GRN_ID_NIL) {
+        continue;
+      }
     }
     for (i = 0; i < builder->n_srcs; i++) {
       grn_obj *obj = &objs[i];
@@ -13978,7 +16234,9 @@ grn_ii_builder_append_srcs(grn_ctx *ctx, grn_ii_builder *builder)
   for (i = 0; i < builder->n_srcs; i++) {
     GRN_OBJ_FIN(ctx, &objs[i]);
   }
-  grn_table_cursor_close(ctx, cursor);
+  if (cursor) {
+    grn_table_cursor_close(ctx, cursor);
+  }
   GRN_FREE(objs);
   return rc;
 }
@@ -13993,88 +16251,337 @@ grn_ii_builder_set_src_table(grn_ctx *ctx, grn_ii_builder *builder)
       ERR(GRN_INVALID_ARGUMENT, "source table is null: range = %d",
           DB_OBJ(builder->ii)->range);
     }
-    return ctx->rc;
+    return ctx->rc;
+  }
+  return GRN_SUCCESS;
+}
+
+/* grn_ii_builder_set_sid_bits calculates sid_bits and sid_mask. */
+static grn_rc
+grn_ii_builder_set_sid_bits(grn_ctx *ctx, grn_ii_builder *builder)
+{
+  /* Calculate the number of bits required to represent a section ID. */
+  if (builder->n_srcs == 1 && builder->have_tokenizer &&
+      (builder->srcs[0]->header.flags & GRN_OBJ_COLUMN_VECTOR) != 0) {
+    /* If the source column is a vector column and the index has a tokenizer, */
+    /* the maximum sid equals to the maximum number of elements. */
+    size_t max_elems = 0;
+    grn_table_cursor *cursor;
+    grn_obj obj;
+    cursor = grn_table_cursor_open(ctx, builder->src_table, NULL, 0, NULL, 0,
+                                    0, -1, GRN_CURSOR_BY_ID);
+    if (!cursor) {
+      if (ctx->rc == GRN_SUCCESS) {
+        ERR(GRN_OBJECT_CORRUPT, "[index] failed to open table cursor");
+      }
+      return ctx->rc;
+    }
+    GRN_TEXT_INIT(&obj, 0);
+    for (;;) {
+      grn_id rid = grn_table_cursor_next(ctx, cursor);
+      if (rid == GRN_ID_NIL) {
+        break;
+      }
+      GRN_BULK_REWIND(&obj);
+      if (!grn_obj_get_value(ctx, builder->srcs[0], rid, &obj)) {
+        continue;
+      }
+      if (obj.u.v.n_sections > max_elems) {
+        max_elems = obj.u.v.n_sections;
+      }
+    }
+    GRN_OBJ_FIN(ctx, &obj);
+    grn_table_cursor_close(ctx, cursor);
+    while (((uint32_t)1 << builder->sid_bits) < max_elems) {
+      builder->sid_bits++;
+    }
+  }
+  if (builder->sid_bits == 0) {
+    while (((uint32_t)1 << builder->sid_bits) < builder->n_srcs) {
+      builder->sid_bits++;
+    }
+  }
+  builder->sid_mask = ((uint64_t)1 << builder->sid_bits) - 1;
+  return GRN_SUCCESS;
+}
+
+/* grn_ii_builder_set_srcs sets source columns. */
+static grn_rc
+grn_ii_builder_set_srcs(grn_ctx *ctx, grn_ii_builder *builder)
+{
+  size_t i;
+  grn_id *source;
+  builder->n_srcs = builder->ii->obj.source_size / sizeof(grn_id);
+  source = (grn_id *)builder->ii->obj.source;
+  if (!source || !builder->n_srcs) {
+    ERR(GRN_INVALID_ARGUMENT,
+        "source is not available: source = %p, source_size = %u",
+        builder->ii->obj.source, builder->ii->obj.source_size);
+    return ctx->rc;
+  }
+  builder->srcs = GRN_MALLOCN(grn_obj *, builder->n_srcs);
+  if (!builder->srcs) {
+    return GRN_NO_MEMORY_AVAILABLE;
+  }
+  for (i = 0; i < builder->n_srcs; i++) {
+    builder->srcs[i] = grn_ctx_at(ctx, source[i]);
+    if (!builder->srcs[i]) {
+      if (ctx->rc == GRN_SUCCESS) {
+        ERR(GRN_OBJECT_CORRUPT, "source not found: id = %d", source[i]);
+      }
+      return ctx->rc;
+    }
+  }
+  return grn_ii_builder_set_sid_bits(ctx, builder);
+}
+
+typedef struct {
+  grn_ctx        ctx;     /* Context for the worker (to be finalized) */
+  grn_ii_builder builder; /* Sub builder (to be finalized) */
+  grn_id         min_rid; /* The first record ID to be appended */
+  grn_id         max_rid; /* The last record ID to be appended */
+  grn_thread     thread;
+  grn_bool       thread_created;
+  grn_rc         rc;
+} grn_ii_builder_worker;
+
+static grn_thread_func_result CALLBACK
+grn_ii_builder_worker_run(void *data)
+{
+  grn_ii_builder_worker *worker = data;
+  grn_ctx *ctx = &worker->ctx;
+  worker->rc = grn_ii_builder_append_srcs(ctx, &worker->builder,
+                                          worker->min_rid, worker->max_rid);
+  if (worker->rc == GRN_SUCCESS) {
+    grn_ii_builder_fin_terms(ctx, &worker->builder);
+  }
+  return GRN_THREAD_FUNC_RETURN_VALUE;
+}
+
+/*
+ * grn_ii_builder_worker_init initializes a worker that appends values of
+ * records in [min_rid, max_rid]. The worker shares the source columns,
+ * section ID bits and lexicon lock of the parent builder but has its own
+ * context, block lexicon and temporary file. Note that ctx must be the
+ * context of the worker and an initialized worker must be finalized by
+ * grn_ii_builder_worker_fin.
+ */
+static grn_rc
+grn_ii_builder_worker_init(grn_ctx *ctx, grn_ii_builder_worker *worker,
+                           grn_ii_builder *parent,
+                           grn_id min_rid, grn_id max_rid)
+{
+  grn_ii_builder *builder = &worker->builder;
+  grn_ii_builder_options options = parent->options;
+
+  /* Workers share the memory budget of a block. */
+  options.block_threshold /= options.n_workers;
+  options.n_workers = 1;
+  grn_ii_builder_init(ctx, builder, parent->ii, &options);
+  worker->min_rid = min_rid;
+  worker->max_rid = max_rid;
+  worker->thread_created = GRN_FALSE;
+  worker->rc = GRN_SUCCESS;
+
+  builder->src_table = parent->src_table;
+  builder->srcs = GRN_MALLOCN(grn_obj *, parent->n_srcs);
+  if (!builder->srcs) {
+    ERR(GRN_NO_MEMORY_AVAILABLE,
+        "[ii][builder][worker] failed to allocate memory for srcs: "
+        "n_srcs = %u",
+        parent->n_srcs);
+    return ctx->rc;
+  }
+  grn_memcpy(builder->srcs, parent->srcs, sizeof(grn_obj *) * parent->n_srcs);
+  builder->n_srcs = parent->n_srcs;
+  builder->sid_bits = parent->sid_bits;
+  builder->sid_mask = parent->sid_mask;
+  builder->lexicon_lock = parent->lexicon_lock;
+
+  return grn_ii_builder_create_lexicon(ctx, builder);
+}
+
+/* grn_ii_builder_worker_fin finalizes a worker. */
+static void
+grn_ii_builder_worker_fin(grn_ctx *ctx, grn_ii_builder_worker *worker)
+{
+  grn_ii_builder_fin(ctx, &worker->builder);
+}
+
+/*
+ * grn_ii_builder_worker_collect moves blocks and a temporary file of a
+ * finished worker to the builder. Blocks of workers are collected in record ID
+ * order because grn_ii_builder_read_to_chunk requires it.
+ */
+static grn_rc
+grn_ii_builder_worker_collect(grn_ctx *ctx, grn_ii_builder *builder,
+                              grn_ii_builder_worker *worker)
+{
+  grn_ii_builder *worker_builder = &worker->builder;
+  uint32_t n_blocks;
+
+  if (worker_builder->fd == -1) {
+    return GRN_SUCCESS;
+  }
+
+  if (!builder->files) {
+    builder->files = GRN_MALLOCN(grn_ii_builder_file,
+                                 builder->options.n_workers);
+    if (!builder->files) {
+      ERR(GRN_NO_MEMORY_AVAILABLE,
+          "[ii][builder][worker] failed to allocate memory for files: "
+          "n_workers = %u",
+          builder->options.n_workers);
+      return ctx->rc;
+    }
+  }
+  grn_strcpy(builder->files[builder->n_files].path, PATH_MAX,
+             worker_builder->path);
+  builder->files[builder->n_files].fd = worker_builder->fd;
+  builder->n_files++;
+  worker_builder->fd = -1;
+
+  n_blocks = builder->n_blocks + worker_builder->n_blocks;
+  if (n_blocks > builder->blocks_size) {
+    size_t n_bytes;
+    uint32_t blocks_size = 1;
+    grn_ii_builder_block *blocks;
+    while (blocks_size < n_blocks) {
+      blocks_size *= 2;
+    }
+    n_bytes = blocks_size * sizeof(grn_ii_builder_block);
+    blocks = (grn_ii_builder_block *)GRN_REALLOC(builder->blocks, n_bytes);
+    if (!blocks) {
+      ERR(GRN_NO_MEMORY_AVAILABLE,
+          "failed to allocate memory for block: n_bytes = %" GRN_FMT_SIZE,
+          n_bytes);
+      return ctx->rc;
+    }
+    builder->blocks = blocks;
+    builder->blocks_size = blocks_size;
   }
+  /* Blocks of workers don't have buffers yet. */
+  grn_memcpy(builder->blocks + builder->n_blocks,
+             worker_builder->blocks,
+             sizeof(grn_ii_builder_block) * worker_builder->n_blocks);
+  builder->n_blocks = n_blocks;
+  worker_builder->n_blocks = 0;
   return GRN_SUCCESS;
 }
 
-/* grn_ii_builder_set_sid_bits calculates sid_bits and sid_mask. */
+/*
+ * grn_ii_builder_append_srcs_parallel splits records into contiguous record
+ * ID ranges and appends them by workers in parallel. Each worker tokenizes
+ * its range into its own blocks. Global term IDs are assigned by
+ * grn_table_add on the shared lexicon. Hash, patricia trie and double array
+ * tables aren't safe for concurrent grn_table_add, so workers serialize it by
+ * lexicon_lock.
+ */
 static grn_rc
-grn_ii_builder_set_sid_bits(grn_ctx *ctx, grn_ii_builder *builder)
+grn_ii_builder_append_srcs_parallel(grn_ctx *ctx, grn_ii_builder *builder)
 {
-  /* Calculate the number of bits required to represent a section ID. */
-  if (builder->n_srcs == 1 && builder->have_tokenizer &&
-      (builder->srcs[0]->header.flags & GRN_OBJ_COLUMN_VECTOR) != 0) {
-    /* If the source column is a vector column and the index has a tokenizer, */
-    /* the maximum sid equals to the maximum number of elements. */
-    size_t max_elems = 0;
+  grn_rc rc = GRN_SUCCESS;
+  uint32_t i, n_workers = builder->options.n_workers;
+  uint32_t n_initialized_workers;
+  grn_id max_rid = GRN_ID_NIL, n_rids_per_worker;
+  grn_ii_builder_worker *workers;
+  grn_critical_section lexicon_lock;
+
+  {
     grn_table_cursor *cursor;
-    grn_obj obj;
     cursor = grn_table_cursor_open(ctx, builder->src_table, NULL, 0, NULL, 0,
-                                    0, -1, GRN_CURSOR_BY_ID);
+                                   0, 1,
+                                   GRN_CURSOR_BY_ID | GRN_CURSOR_DESCENDING);
     if (!cursor) {
       if (ctx->rc == GRN_SUCCESS) {
         ERR(GRN_OBJECT_CORRUPT, "[index] failed to open table cursor");
       }
       return ctx->rc;
     }
-    GRN_TEXT_INIT(&obj, 0);
-    for (;;) {
-      grn_id rid = grn_table_cursor_next(ctx, cursor);
-      if (rid == GRN_ID_NIL) {
-        break;
-      }
-      GRN_BULK_REWIND(&obj);
-      if (!grn_obj_get_value(ctx, builder->srcs[0], rid, &obj)) {
-        continue;
-      }
-      if (obj.u.v.n_sections > max_elems) {
-        max_elems = obj.u.v.n_sections;
-      }
-    }
-    GRN_OBJ_FIN(ctx, &obj);
+    max_rid = grn_table_cursor_next(ctx, cursor);
     grn_table_cursor_close(ctx, cursor);
-    while (((uint32_t)1 << builder->sid_bits) < max_elems) {
-      builder->sid_bits++;
-    }
   }
-  if (builder->sid_bits == 0) {
-    while (((uint32_t)1 << builder->sid_bits) < builder->n_srcs) {
-      builder->sid_bits++;
-    }
+  if (max_rid == GRN_ID_NIL) {
+    return GRN_SUCCESS;
   }
-  builder->sid_mask = ((uint64_t)1 << builder->sid_bits) - 1;
-  return GRN_SUCCESS;
-}
+  n_rids_per_worker = (max_rid + n_workers - 1) / n_workers;
 
-/* grn_ii_builder_set_srcs sets source columns. */
-static grn_rc
-grn_ii_builder_set_srcs(grn_ctx *ctx, grn_ii_builder *builder)
-{
-  size_t i;
-  grn_id *source;
-  builder->n_srcs = builder->ii->obj.source_size / sizeof(grn_id);
-  source = (grn_id *)builder->ii->obj.source;
-  if (!source || !builder->n_srcs) {
-    ERR(GRN_INVALID_ARGUMENT,
-        "source is not available: source = %p, source_size = %u",
-        builder->ii->obj.source, builder->ii->obj.source_size);
+  workers = GRN_MALLOCN(grn_ii_builder_worker, n_workers);
+  if (!workers) {
+    ERR(GRN_NO_MEMORY_AVAILABLE,
+        "[ii][builder][worker] failed to allocate memory for workers: "
+        "n_workers = %u",
+        n_workers);
     return ctx->rc;
   }
-  builder->srcs = GRN_MALLOCN(grn_obj *, builder->n_srcs);
-  if (!builder->srcs) {
-    return GRN_NO_MEMORY_AVAILABLE;
+  GRN_LOG(ctx, GRN_LOG_INFO,
+          "[ii][builder][append] n_workers=<%u> n_rids_per_worker=<%u>",
+          n_workers, n_rids_per_worker);
+
+  CRITICAL_SECTION_INIT(lexicon_lock);
+  builder->lexicon_lock = &lexicon_lock;
+  for (n_initialized_workers = 0;
+       n_initialized_workers < n_workers;
+       n_initialized_workers++) {
+    grn_ii_builder_worker *worker = &(workers[n_initialized_workers]);
+    grn_id min_rid = n_rids_per_worker * n_initialized_workers + 1;
+    grn_id worker_max_rid = n_rids_per_worker * (n_initialized_workers + 1);
+    if (worker_max_rid > max_rid) {
+      worker_max_rid = max_rid;
+    }
+    grn_ctx_init(&(worker->ctx), 0);
+    grn_ctx_use(&(worker->ctx), grn_ctx_db(ctx));
+    rc = grn_ii_builder_worker_init(&(worker->ctx), worker, builder,
+                                    min_rid, worker_max_rid);
+    if (rc != GRN_SUCCESS) {
+      ERR(rc, "[ii][builder][worker] %s", worker->ctx.errbuf);
+      n_initialized_workers++;
+      break;
+    }
   }
-  for (i = 0; i < builder->n_srcs; i++) {
-    builder->srcs[i] = grn_ctx_at(ctx, source[i]);
-    if (!builder->srcs[i]) {
-      if (ctx->rc == GRN_SUCCESS) {
-        ERR(GRN_OBJECT_CORRUPT, "source not found: id = %d", source[i]);
+  if (rc == GRN_SUCCESS) {
+    for (i = 0; i < n_workers; i++) {
+      grn_ii_builder_worker *worker = &(workers[i]);
+      if (THREAD_CREATE(worker->thread,
+                        grn_ii_builder_worker_run,
+                        worker) == 0) {
+        worker->thread_created = GRN_TRUE;
+      } else {
+        GRN_LOG(ctx, GRN_LOG_WARNING,
+                "[ii][builder][worker] failed to create a thread: <%u>: "
+                "run in the current thread",
+                i);
+        grn_ii_builder_worker_run(worker);
+      }
+    }
+    for (i = 0; i < n_workers; i++) {
+      grn_ii_builder_worker *worker = &(workers[i]);
+      if (worker->thread_created) {
+        THREAD_JOIN(worker->thread);
+      }
+    }
+    for (i = 0; i < n_workers; i++) {
+      grn_ii_builder_worker *worker = &(workers[i]);
+      if (worker->rc != GRN_SUCCESS) {
+        ERR(worker->rc, "[ii][builder][worker] %s", worker->ctx.errbuf);
+        rc = worker->rc;
+        break;
+      }
+      rc = grn_ii_builder_worker_collect(ctx, builder, worker);
+      if (rc != GRN_SUCCESS) {
+        break;
       }
-      return ctx->rc;
     }
   }
-  return grn_ii_builder_set_sid_bits(ctx, builder);
+
+  for (i = 0; i < n_initialized_workers; i++) {
+    grn_ii_builder_worker_fin(&(workers[i].ctx), &(workers[i]));
+    grn_ctx_fin(&(workers[i].ctx));
+  }
+  builder->lexicon_lock = NULL;
+  CRITICAL_SECTION_FIN(lexicon_lock);
+  GRN_FREE(workers);
+  return rc;
 }
 
 /* grn_ii_builder_append_source appends values in source columns. */
@@ -14098,7 +16605,13 @@ grn_ii_builder_append_source(grn_ctx *ctx, grn_ii_builder *builder)
   if (rc != GRN_SUCCESS) {
     return rc;
   }
-  rc = grn_ii_builder_append_srcs(ctx, builder);
+  if (builder->options.n_workers > 1 &&
+      grn_table_size(ctx, builder->src_table) >= builder->options.n_workers &&
+      !(grn_obj_get_io(ctx, builder->ii->lexicon)->flags & GRN_IO_TEMPORARY)) {
+    rc = grn_ii_builder_append_srcs_parallel(ctx, builder);
+  } else {
+    rc = grn_ii_builder_append_srcs(ctx, builder, GRN_ID_NIL, GRN_ID_NIL);
+  }
   if (rc != GRN_SUCCESS) {
     return rc;
   }
@@ -14140,7 +16653,7 @@ grn_ii_builder_fill_block(grn_ctx *ctx, grn_ii_builder *builder,
   block->end = block->buf + buf_rest;
 
   /* Read the next data. */
-  file_offset = grn_lseek(builder->fd, block->offset, SEEK_SET);
+  file_offset = grn_lseek(block->fd, block->offset, SEEK_SET);
   if (file_offset != block->offset) {
     SERR("failed to seek file: expected = %" GRN_FMT_INT64U
          ", actual = %" GRN_FMT_INT64D,
@@ -14151,7 +16664,7 @@ grn_ii_builder_fill_block(grn_ctx *ctx, grn_ii_builder *builder,
   if (block->rest < buf_rest) {
     buf_rest = block->rest;
   }
-  size = grn_read(builder->fd, block->end, buf_rest);
+  size = grn_read(block->fd, block->end, buf_rest);
   if (size <= 0) {
     SERR("failed to read data: expected = %u, actual = %" GRN_FMT_INT64D,
          buf_rest, (int64_t)size);
@@ -14185,11 +16698,10 @@ grn_ii_builder_read_from_block(grn_ctx *ctx, grn_ii_builder *builder,
 /* grn_ii_builder_pack_chunk tries to pack a chunk. */
 static grn_rc
 grn_ii_builder_pack_chunk(grn_ctx *ctx, grn_ii_builder *builder,
-                          grn_bool *packed)
+                          grn_ii_builder_chunk *chunk, grn_bool *packed)
 {
   grn_id rid;
   uint32_t sid, pos, *a;
-  grn_ii_builder_chunk *chunk = &builder->chunk;
   *packed = GRN_FALSE;
   if (chunk->offset != 1) { /* df != 1 */
     return GRN_SUCCESS;
@@ -14281,21 +16793,20 @@ grn_ii_builder_get_cinfo(grn_ctx *ctx, grn_ii_builder *builder,
   return GRN_SUCCESS;
 }
 
-/* grn_ii_builder_flush_chunk flushes a chunk. */
+/*
+ * grn_ii_builder_flush_encoded_chunk copies an encoded chunk to a new chunk
+ * of the index and appends a cinfo for it.
+ */
 static grn_rc
-grn_ii_builder_flush_chunk(grn_ctx *ctx, grn_ii_builder *builder)
+grn_ii_builder_flush_encoded_chunk(grn_ctx *ctx, grn_ii_builder *builder,
+                                   grn_ii_builder_chunk *chunk)
 {
   grn_rc rc;
   chunk_info *cinfo = NULL;
-  grn_ii_builder_chunk *chunk = &builder->chunk;
   void *seg;
   uint8_t *in;
   uint32_t in_size, chunk_id, seg_id, seg_offset, seg_rest;
 
-  rc = grn_ii_builder_chunk_encode(ctx, chunk, NULL, 0);
-  if (rc != GRN_SUCCESS) {
-    return rc;
-  }
   in = chunk->enc_buf;
   in_size = chunk->enc_offset;
 
@@ -14365,6 +16876,20 @@ grn_ii_builder_flush_chunk(grn_ctx *ctx, grn_ii_builder *builder)
   return GRN_SUCCESS;
 }
 
+/* grn_ii_builder_flush_chunk flushes a chunk. */
+static grn_rc
+grn_ii_builder_flush_chunk(grn_ctx *ctx, grn_ii_builder *builder)
+{
+  grn_rc rc = grn_ii_builder_chunk_encode(ctx, &builder->chunk, NULL, 0);
+  if (rc != GRN_SUCCESS) {
+    return rc;
+  }
+  return grn_ii_builder_flush_encoded_chunk(ctx, builder, &builder->chunk);
+}
+
+static grn_rc grn_ii_builder_push_chunk(grn_ctx *ctx, grn_ii_builder *builder,
+                                        grn_bool is_last);
+
 /* grn_ii_builder_read_to_chunk read values from a block to a chunk. */
 static grn_rc
 grn_ii_builder_read_to_chunk(grn_ctx *ctx, grn_ii_builder *builder,
@@ -14396,8 +16921,16 @@ grn_ii_builder_read_to_chunk(grn_ctx *ctx, grn_ii_builder *builder,
     /* Read record ID. */
     gap = value >> builder->sid_bits; /* In-block gap */
     if (gap) {
-      if (chunk->n >= builder->options.chunk_threshold) {
-        rc = grn_ii_builder_flush_chunk(ctx, builder);
+      /* A chunk is also split every grn_ii_chunk_skip_interval postings
+       * to be a skip entry. See buffer_merge_flush_skip_chunks(). */
+      if (chunk->n >= builder->options.chunk_threshold ||
+          (grn_ii_chunk_skip_interval > 0 &&
+           chunk->offset >= grn_ii_chunk_skip_interval)) {
+        if (builder->options.n_workers > 1) {
+          rc = grn_ii_builder_push_chunk(ctx, builder, GRN_FALSE);
+        } else {
+          rc = grn_ii_builder_flush_chunk(ctx, builder);
+        }
         if (rc != GRN_SUCCESS) {
           return rc;
         }
@@ -14484,23 +17017,21 @@ grn_ii_builder_read_to_chunk(grn_ctx *ctx, grn_ii_builder *builder,
   return GRN_SUCCESS;
 }
 
-/* grn_ii_builder_register_chunks registers chunks. */
+/*
+ * grn_ii_builder_register_encoded_chunks registers an encoded chunk that has
+ * cinfos of the term in its header. df is the document frequency of the term.
+ */
 static grn_rc
-grn_ii_builder_register_chunks(grn_ctx *ctx, grn_ii_builder *builder)
+grn_ii_builder_register_encoded_chunks(grn_ctx *ctx, grn_ii_builder *builder,
+                                       grn_ii_builder_chunk *chunk,
+                                       uint32_t df)
 {
   grn_rc rc;
   uint32_t buf_tid, *a;
   buffer_term *buf_term;
 
-  rc = grn_ii_builder_chunk_encode(ctx, &builder->chunk, builder->cinfos,
-                                   builder->n_cinfos);
-  if (rc != GRN_SUCCESS) {
-    return rc;
-  }
-
   if (!grn_ii_builder_buffer_is_assigned(ctx, &builder->buf)) {
-    rc = grn_ii_builder_buffer_assign(ctx, &builder->buf,
-                                      builder->chunk.enc_offset);
+    rc = grn_ii_builder_buffer_assign(ctx, &builder->buf, chunk->enc_offset);
     if (rc != GRN_SUCCESS) {
       return rc;
     }
@@ -14508,38 +17039,37 @@ grn_ii_builder_register_chunks(grn_ctx *ctx, grn_ii_builder *builder)
   buf_tid = builder->buf.buf->header.nterms;
   if (buf_tid >= builder->options.buffer_max_n_terms ||
       builder->buf.chunk_size - builder->buf.chunk_offset <
-      builder->chunk.enc_offset) {
+      chunk->enc_offset) {
     rc = grn_ii_builder_buffer_flush(ctx, &builder->buf);
     if (rc != GRN_SUCCESS) {
       return rc;
     }
-    rc = grn_ii_builder_buffer_assign(ctx, &builder->buf,
-                                      builder->chunk.enc_offset);
+    rc = grn_ii_builder_buffer_assign(ctx, &builder->buf, chunk->enc_offset);
     if (rc != GRN_SUCCESS) {
       return rc;
     }
     buf_tid = 0;
   }
   buf_term = &builder->buf.buf->terms[buf_tid];
-  buf_term->tid = builder->chunk.tid;
+  buf_term->tid = chunk->tid;
   if (builder->n_cinfos) {
     buf_term->tid |= CHUNK_SPLIT;
   }
   buf_term->size_in_buffer = 0;
   buf_term->pos_in_buffer = 0;
-  buf_term->size_in_chunk = builder->chunk.enc_offset;
+  buf_term->size_in_chunk = chunk->enc_offset;
   buf_term->pos_in_chunk = builder->buf.chunk_offset;
 
   grn_memcpy(builder->buf.chunk + builder->buf.chunk_offset,
-             builder->chunk.enc_buf, builder->chunk.enc_offset);
-  builder->buf.chunk_offset += builder->chunk.enc_offset;
+             chunk->enc_buf, chunk->enc_offset);
+  builder->buf.chunk_offset += chunk->enc_offset;
 
-  a = array_get(ctx, builder->ii, builder->chunk.tid);
+  a = array_get(ctx, builder->ii, chunk->tid);
   if (!a) {
     grn_obj token;
     DEFINE_NAME(builder->ii);
     GRN_TEXT_INIT(&token, 0);
-    grn_ii_get_term(ctx, builder->ii, builder->chunk.tid, &token);
+    grn_ii_get_term(ctx, builder->ii, chunk->tid, &token);
     MERR("[ii][builder][chunk][register] "
          "failed to allocate an array in segment: "
          "<%.*s>: "
@@ -14547,7 +17077,7 @@ grn_ii_builder_register_chunks(grn_ctx *ctx, grn_ii_builder *builder)
          "max_n_segments=<%u>",
          name_size, name,
          (int)GRN_TEXT_LEN(&token), GRN_TEXT_VALUE(&token),
-         builder->chunk.tid,
+         chunk->tid,
          builder->ii->seg->header->max_segment);
     GRN_OBJ_FIN(ctx, &token);
     return ctx->rc;
@@ -14555,15 +17085,296 @@ grn_ii_builder_register_chunks(grn_ctx *ctx, grn_ii_builder *builder)
   a[0] = grn_ii_pos_pack(builder->ii,
                          builder->buf.buf_id,
                          POS_LOFFSET_HEADER + POS_LOFFSET_TERM * buf_tid);
-  a[1] = builder->df;
-  array_unref(builder->ii, builder->chunk.tid);
+  a[1] = df;
+  array_unref(builder->ii, chunk->tid);
 
   builder->buf.buf->header.nterms++;
   builder->n_cinfos = 0;
+  grn_ii_builder_chunk_clear(ctx, chunk);
+  return GRN_SUCCESS;
+}
+
+/* grn_ii_builder_register_chunks registers chunks. */
+static grn_rc
+grn_ii_builder_register_chunks(grn_ctx *ctx, grn_ii_builder *builder)
+{
+  grn_rc rc = grn_ii_builder_chunk_encode(ctx, &builder->chunk,
+                                          builder->cinfos, builder->n_cinfos);
+  if (rc != GRN_SUCCESS) {
+    return rc;
+  }
+  return grn_ii_builder_register_encoded_chunks(ctx, builder, &builder->chunk,
+                                                builder->df);
+}
+
+/*
+ * grn_ii_builder_chunk_prepend_cinfos prepends a header that has cinfos to an
+ * encoded chunk.
+ */
+static grn_rc
+grn_ii_builder_chunk_prepend_cinfos(grn_ctx *ctx, grn_ii_builder_chunk *chunk,
+                                    chunk_info *cinfos, uint32_t n_cinfos)
+{
+  uint32_t i;
+  size_t header_size = GRN_B_ENC_SIZE(n_cinfos);
+  uint8_t *p;
+  for (i = 0; i < n_cinfos; i++) {
+    header_size += GRN_B_ENC_SIZE(cinfos[i].segno);
+    header_size += GRN_B_ENC_SIZE(cinfos[i].size);
+    header_size += GRN_B_ENC_SIZE(cinfos[i].dgap);
+  }
+  if (chunk->enc_size < chunk->enc_offset + header_size) {
+    size_t size = chunk->enc_offset + header_size;
+    uint8_t *buf = GRN_REALLOC(chunk->enc_buf, size);
+    if (!buf) {
+      ERR(GRN_NO_MEMORY_AVAILABLE,
+          "failed to allocate memory for encoding: size = %" GRN_FMT_SIZE,
+          size);
+      return ctx->rc;
+    }
+    chunk->enc_buf = buf;
+    chunk->enc_size = size;
+  }
+  memmove(chunk->enc_buf + header_size, chunk->enc_buf, chunk->enc_offset);
+  p = chunk->enc_buf;
+  GRN_B_ENC(n_cinfos, p);
+  for (i = 0; i < n_cinfos; i++) {
+    GRN_B_ENC(cinfos[i].segno, p);
+    GRN_B_ENC(cinfos[i].size, p);
+    GRN_B_ENC(cinfos[i].dgap, p);
+  }
+  chunk->enc_offset += header_size;
+  return GRN_SUCCESS;
+}
+
+typedef struct {
+  grn_ctx                      ctx;     /* Context (to be finalized) */
+  grn_ii_builder_pending_chunk *chunks; /* Chunks to be encoded */
+  uint32_t                     n_chunks;
+  grn_thread                   thread;
+  grn_bool                     thread_created;
+  grn_rc                       rc;
+} grn_ii_builder_encoder;
+
+static grn_thread_func_result CALLBACK
+grn_ii_builder_encoder_run(void *data)
+{
+  grn_ii_builder_encoder *encoder = data;
+  uint32_t i;
+  encoder->rc = GRN_SUCCESS;
+  for (i = 0; i < encoder->n_chunks; i++) {
+    encoder->rc = grn_ii_builder_chunk_encode(&(encoder->ctx),
+                                              &(encoder->chunks[i].chunk),
+                                              NULL, 0);
+    if (encoder->rc != GRN_SUCCESS) {
+      break;
+    }
+  }
+  return GRN_THREAD_FUNC_RETURN_VALUE;
+}
+
+/*
+ * grn_ii_builder_encode_pending_chunks encodes pending chunks. Contiguous
+ * ranges of them are encoded by threads because encoding doesn't touch the
+ * index. Small batches are encoded by the current thread.
+ */
+static grn_rc
+grn_ii_builder_encode_pending_chunks(grn_ctx *ctx, grn_ii_builder *builder)
+{
+  grn_rc rc = GRN_SUCCESS;
+  uint32_t i, n_encoders = builder->options.n_workers;
+  uint32_t n_chunks = builder->n_pending_chunks, n_chunks_per_encoder;
+  uint64_t n_values = 0;
+  grn_ii_builder_encoder *encoders;
+
+  for (i = 0; i < n_chunks; i++) {
+    n_values += builder->pending_chunks[i].chunk.n;
+  }
+  if (n_encoders > n_chunks) {
+    n_encoders = n_chunks;
+  }
+  if (n_encoders <= 1 ||
+      n_values < (uint64_t)builder->options.chunk_threshold * n_encoders) {
+    for (i = 0; i < n_chunks; i++) {
+      rc = grn_ii_builder_chunk_encode(ctx,
+                                       &(builder->pending_chunks[i].chunk),
+                                       NULL, 0);
+      if (rc != GRN_SUCCESS) {
+        return rc;
+      }
+    }
+    return GRN_SUCCESS;
+  }
+
+  encoders = GRN_MALLOCN(grn_ii_builder_encoder, n_encoders);
+  if (!encoders) {
+    ERR(GRN_NO_MEMORY_AVAILABLE,
+        "[ii][builder][commit] failed to allocate memory for encoders: "
+        "n_encoders = %u",
+        n_encoders);
+    return ctx->rc;
+  }
+  n_chunks_per_encoder = (n_chunks + n_encoders - 1) / n_encoders;
+  for (i = 0; i < n_encoders; i++) {
+    grn_ii_builder_encoder *encoder = &(encoders[i]);
+    uint32_t offset = n_chunks_per_encoder * i;
+    grn_ctx_init(&(encoder->ctx), 0);
+    encoder->chunks = builder->pending_chunks + offset;
+    encoder->n_chunks = 0;
+    if (offset < n_chunks) {
+      encoder->n_chunks = n_chunks - offset;
+      if (encoder->n_chunks > n_chunks_per_encoder) {
+        encoder->n_chunks = n_chunks_per_encoder;
+      }
+    }
+    encoder->thread_created = GRN_FALSE;
+    encoder->rc = GRN_SUCCESS;
+  }
+  for (i = 0; i < n_encoders; i++) {
+    grn_ii_builder_encoder *encoder = &(encoders[i]);
+    if (THREAD_CREATE(encoder->thread,
+                      grn_ii_builder_encoder_run,
+                      encoder) == 0) {
+      encoder->thread_created = GRN_TRUE;
+    } else {
+      grn_ii_builder_encoder_run(encoder);
+    }
+  }
+  for (i = 0; i < n_encoders; i++) {
+    grn_ii_builder_encoder *encoder = &(encoders[i]);
+    if (encoder->thread_created) {
+      THREAD_JOIN(encoder->thread);
+    }
+  }
+  for (i = 0; i < n_encoders; i++) {
+    grn_ii_builder_encoder *encoder = &(encoders[i]);
+    if (rc == GRN_SUCCESS && encoder->rc != GRN_SUCCESS) {
+      ERR(encoder->rc, "[ii][builder][commit] %s", encoder->ctx.errbuf);
+      rc = encoder->rc;
+    }
+    grn_ctx_fin(&(encoder->ctx));
+  }
+  GRN_FREE(encoders);
+  return rc;
+}
+
+/*
+ * grn_ii_builder_drain_pending_chunks encodes pending chunks and writes them
+ * to the index in the order they were pushed. Chunks and buffer segments are
+ * allocated in the same order as grn_ii_builder_flush_chunk and
+ * grn_ii_builder_register_chunks do.
+ */
+static grn_rc
+grn_ii_builder_drain_pending_chunks(grn_ctx *ctx, grn_ii_builder *builder)
+{
+  grn_rc rc;
+  uint32_t i;
+
+  if (!builder->n_pending_chunks) {
+    return GRN_SUCCESS;
+  }
+  rc = grn_ii_builder_encode_pending_chunks(ctx, builder);
+  if (rc != GRN_SUCCESS) {
+    return rc;
+  }
+  for (i = 0; i < builder->n_pending_chunks; i++) {
+    grn_ii_builder_pending_chunk *pending = &(builder->pending_chunks[i]);
+    grn_ii_builder_chunk *chunk = &(pending->chunk);
+    if (!pending->is_last) {
+      rc = grn_ii_builder_flush_encoded_chunk(ctx, builder, chunk);
+      if (rc != GRN_SUCCESS) {
+        return rc;
+      }
+      continue;
+    }
+    if (builder->n_cinfos) {
+      rc = grn_ii_builder_chunk_prepend_cinfos(ctx, chunk,
+                                               builder->cinfos,
+                                               builder->n_cinfos);
+      if (rc != GRN_SUCCESS) {
+        return rc;
+      }
+    } else {
+      grn_bool packed;
+      rc = grn_ii_builder_pack_chunk(ctx, builder, chunk, &packed);
+      if (rc != GRN_SUCCESS) {
+        return rc;
+      }
+      if (packed) {
+        continue;
+      }
+    }
+    rc = grn_ii_builder_register_encoded_chunks(ctx, builder, chunk,
+                                                pending->df);
+    if (rc != GRN_SUCCESS) {
+      return rc;
+    }
+  }
+  builder->n_pending_chunks = 0;
+  return GRN_SUCCESS;
+}
+
+/*
+ * grn_ii_builder_push_chunk moves builder->chunk to pending chunks. is_last
+ * must be GRN_TRUE for the last part of a term. Pending chunks are drained
+ * when there is no room.
+ */
+static grn_rc
+grn_ii_builder_push_chunk(grn_ctx *ctx, grn_ii_builder *builder,
+                          grn_bool is_last)
+{
+  grn_rc rc;
+  grn_ii_builder_pending_chunk *pending;
+  grn_ii_builder_chunk chunk;
+
+  if (!builder->pending_chunks) {
+    uint32_t i;
+    builder->pending_chunks =
+      GRN_MALLOCN(grn_ii_builder_pending_chunk,
+                  GRN_II_BUILDER_MAX_N_PENDING_CHUNKS);
+    if (!builder->pending_chunks) {
+      ERR(GRN_NO_MEMORY_AVAILABLE,
+          "[ii][builder][commit] "
+          "failed to allocate memory for pending chunks: n_chunks = %u",
+          GRN_II_BUILDER_MAX_N_PENDING_CHUNKS);
+      return ctx->rc;
+    }
+    for (i = 0; i < GRN_II_BUILDER_MAX_N_PENDING_CHUNKS; i++) {
+      grn_ii_builder_chunk_init(ctx, &(builder->pending_chunks[i].chunk));
+    }
+  } else if (builder->n_pending_chunks ==
+             GRN_II_BUILDER_MAX_N_PENDING_CHUNKS) {
+    rc = grn_ii_builder_drain_pending_chunks(ctx, builder);
+    if (rc != GRN_SUCCESS) {
+      return rc;
+    }
+  }
+
+  /* Swap buffers to keep builder->chunk ready for the next values. */
+  pending = &(builder->pending_chunks[builder->n_pending_chunks++]);
+  chunk = pending->chunk;
+  pending->chunk = builder->chunk;
+  pending->df = builder->df;
+  pending->is_last = is_last;
+  builder->chunk = chunk;
+  builder->chunk.tid = pending->chunk.tid;
+  builder->chunk.rid = pending->chunk.rid;
   grn_ii_builder_chunk_clear(ctx, &builder->chunk);
+  if (builder->chunk.offset == builder->chunk.size) {
+    return grn_ii_builder_chunk_extend_bufs(ctx, &builder->chunk,
+                                            builder->ii->header.common->flags);
+  }
   return GRN_SUCCESS;
 }
 
+/*
+ * Merges postings in blocks and encodes them into the index column in
+ * key order. Blocks are read sequentially because they don't have per-term
+ * offsets. When options.n_workers > 1, read chunks are queued and encoded
+ * by threads in batches, and then they are written in key order. Buffer
+ * segments and chunks are allocated in the same order as the single-thread
+ * mode, so the result doesn't depend on the number of workers.
+ */
 static grn_rc
 grn_ii_builder_commit(grn_ctx *ctx, grn_ii_builder *builder)
 {
@@ -14580,6 +17391,11 @@ grn_ii_builder_commit(grn_ctx *ctx, grn_ii_builder *builder)
     builder->blocks[i].tid = value;
   }
 
+  if (builder->options.n_workers > 1) {
+    GRN_LOG(ctx, GRN_LOG_INFO,
+            "[ii][builder][commit] n_workers=<%u>",
+            builder->options.n_workers);
+  }
   cursor = grn_table_cursor_open(ctx, builder->ii->lexicon,
                                  NULL, 0, NULL, 0, 0, -1, GRN_CURSOR_BY_KEY);
   for (;;) {
@@ -14602,9 +17418,16 @@ grn_ii_builder_commit(grn_ctx *ctx, grn_ii_builder *builder)
       /* This term does not appear. */
       continue;
     }
+    if (builder->options.n_workers > 1) {
+      rc = grn_ii_builder_push_chunk(ctx, builder, GRN_TRUE);
+      if (rc != GRN_SUCCESS) {
+        return rc;
+      }
+      continue;
+    }
     if (!builder->n_cinfos) {
       grn_bool packed;
-      rc = grn_ii_builder_pack_chunk(ctx, builder, &packed);
+      rc = grn_ii_builder_pack_chunk(ctx, builder, &builder->chunk, &packed);
       if (rc != GRN_SUCCESS) {
         return rc;
       }
@@ -14618,6 +17441,10 @@ grn_ii_builder_commit(grn_ctx *ctx, grn_ii_builder *builder)
     }
   }
   grn_table_cursor_close(ctx, cursor);
+  rc = grn_ii_builder_drain_pending_chunks(ctx, builder);
+  if (rc != GRN_SUCCESS) {
+    return rc;
+  }
   if (grn_ii_builder_buffer_is_assigned(ctx, &builder->buf)) {
     rc = grn_ii_builder_buffer_flush(ctx, &builder->buf);
     if (rc != GRN_SUCCESS) {
@@ -14642,6 +17469,11 @@ grn_ii_build2(grn_ctx *ctx, grn_ii *ii, const grn_ii_builder_options *options)
     if (rc == GRN_SUCCESS) {
       rc = rc_close;
     }
+    if (ii->document_lengths) {
+      grn_ii_document_length_build(ctx, ii);
+    }
+    ii->header.common->generation++;
+    ii->header.common->chunk_generation += 2;
   }
   return rc;
 }
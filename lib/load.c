@@ -19,6 +19,7 @@
 
 #include "grn_ctx_impl.h"
 #include "grn_db.h"
+#include "grn_ii.h"
 #include "grn_load.h"
 #include "grn_obj.h"
 #include "grn_util.h"
@@ -1266,6 +1267,10 @@ grn_load_internal(grn_ctx *ctx, grn_load_input *input)
     loader->output_ids = input->output_ids;
     loader->output_errors = input->output_errors;
     loader->lock_table = input->lock_table;
+    if (!loader->ifexists && !loader->each) {
+      /* Expressions may refer indexes. So they disable batch. */
+      ctx->impl->ii_batch = grn_ii_batch_open(ctx);
+    }
   } else {
     if (!loader->table) {
       ERR(GRN_INVALID_ARGUMENT, "mandatory \"table\" parameter is absent");
@@ -1287,6 +1292,14 @@ grn_load_internal(grn_ctx *ctx, grn_load_input *input)
     // todo
     break;
   }
+  if (loader->stat == GRN_LOADER_END && ctx->impl->ii_batch) {
+    grn_rc rc = ctx->rc;
+    grn_ii_batch_close(ctx, ctx->impl->ii_batch);
+    ctx->impl->ii_batch = NULL;
+    if (ctx->rc != GRN_SUCCESS && rc == GRN_SUCCESS) {
+      grn_loader_save_error(ctx, loader);
+    }
+  }
 }
 
 grn_rc
@@ -28,6 +28,7 @@
 #include <mruby/string.h>
 
 #include "../grn_encoding.h"
+#include "../grn_expr.h"
 #include "../grn_mrb.h"
 #include "mrb_ctx.h"
 #include "mrb_bulk.h"
@@ -249,6 +250,14 @@ ctx_set_command_version(mrb_state *mrb, mrb_value self)
   return mrb_fixnum_value(command_version);
 }
 
+static mrb_value
+ctx_get_table_select_n_workers(mrb_state *mrb, mrb_value self)
+{
+  grn_ctx *ctx = (grn_ctx *)mrb->ud;
+
+  return mrb_fixnum_value(grn_table_select_get_n_workers(ctx));
+}
+
 static mrb_value
 ctx_get_output(mrb_state *mrb, mrb_value self)
 {
@@ -863,6 +872,9 @@ grn_mrb_ctx_init(grn_ctx *ctx)
   mrb_define_method(mrb, klass, "command_version=",
                     ctx_set_command_version, MRB_ARGS_REQ(1));
 
+  mrb_define_method(mrb, klass, "table_select_n_workers",
+                    ctx_get_table_select_n_workers, MRB_ARGS_NONE());
+
   mrb_define_method(mrb, klass, "output",
                     ctx_get_output, MRB_ARGS_NONE());
   mrb_define_method(mrb, klass, "output=",
@@ -28,6 +28,7 @@
 #include <mruby/array.h>
 #include <mruby/string.h>
 
+#include "../grn_expr.h"
 #include "mrb_ctx.h"
 #include "mrb_table.h"
 #include "mrb_converter.h"
@@ -268,6 +269,65 @@ mrb_grn_table_select(mrb_state *mrb, mrb_value self)
   return grn_mrb_value_from_grn_obj(mrb, result);
 }
 
+static mrb_value
+mrb_grn_table_class_select_targets(mrb_state *mrb, mrb_value klass)
+{
+  grn_ctx *ctx = (grn_ctx *)mrb->ud;
+  mrb_value mrb_targets;
+  mrb_value mrb_options = mrb_nil_value();
+  mrb_value mrb_results;
+  grn_table_select_target *targets;
+  mrb_int i, n_targets;
+  int64_t limit = -1;
+
+  mrb_get_args(mrb, "o|H", &mrb_targets, &mrb_options);
+
+  mrb_targets = mrb_convert_type(mrb, mrb_targets,
+                                 MRB_TT_ARRAY, "Array", "to_ary");
+
+  if (!mrb_nil_p(mrb_options)) {
+    mrb_value mrb_limit;
+
+    mrb_limit = grn_mrb_options_get_lit(mrb, mrb_options, "limit");
+    if (!mrb_nil_p(mrb_limit)) {
+      limit = mrb_fixnum(mrb_limit);
+    }
+  }
+
+  n_targets = RARRAY_LEN(mrb_targets);
+  if (n_targets == 0) {
+    return mrb_ary_new(mrb);
+  }
+  targets = GRN_MALLOCN(grn_table_select_target, n_targets);
+  if (!targets) {
+    grn_mrb_ctx_check(mrb);
+  }
+  for (i = 0; i < n_targets; i++) {
+    mrb_value mrb_target;
+
+    mrb_target = mrb_convert_type(mrb, RARRAY_PTR(mrb_targets)[i],
+                                  MRB_TT_ARRAY, "Array", "to_ary");
+    targets[i].table = DATA_PTR(RARRAY_PTR(mrb_target)[0]);
+    targets[i].expr = DATA_PTR(RARRAY_PTR(mrb_target)[1]);
+    targets[i].result = NULL;
+  }
+
+  grn_table_select_targets(ctx, targets, n_targets, limit);
+  if (ctx->rc != GRN_SUCCESS) {
+    GRN_FREE(targets);
+    grn_mrb_ctx_check(mrb);
+  }
+
+  mrb_results = mrb_ary_new_capa(mrb, n_targets);
+  for (i = 0; i < n_targets; i++) {
+    mrb_ary_push(mrb, mrb_results,
+                 grn_mrb_value_from_grn_obj(mrb, targets[i].result));
+  }
+  GRN_FREE(targets);
+
+  return mrb_results;
+}
+
 static mrb_value
 mrb_grn_table_sort_raw(mrb_state *mrb, mrb_value self)
 {
@@ -530,6 +590,9 @@ grn_mrb_table_init(grn_ctx *ctx)
 
   mrb_define_method(mrb, klass, "select",
                     mrb_grn_table_select, MRB_ARGS_ARG(1, 1));
+  mrb_define_class_method(mrb, klass, "select_targets",
+                          mrb_grn_table_class_select_targets,
+                          MRB_ARGS_ARG(1, 1));
   mrb_define_method(mrb, klass, "sort_raw",
                     mrb_grn_table_sort_raw, MRB_ARGS_REQ(4));
   mrb_define_method(mrb, klass, "group_raw",
@@ -44,5 +44,7 @@ grn_mrb_table_group_flags_init(grn_ctx *ctx)
                    mrb_fixnum_value(GRN_TABLE_GROUP_CALC_SUM));
   mrb_define_const(mrb, flags_module, "CALC_AVG",
                    mrb_fixnum_value(GRN_TABLE_GROUP_CALC_AVG));
+  mrb_define_const(mrb, flags_module, "CALC_APPROX_DISTINCT",
+                   mrb_fixnum_value(GRN_TABLE_GROUP_CALC_APPROX_DISTINCT));
 }
 #endif
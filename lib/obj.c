@@ -428,6 +428,23 @@ grn_obj_is_avg_accessor(grn_ctx *ctx, grn_obj *obj)
   return accessor->action == GRN_ACCESSOR_GET_AVG;
 }
 
+bool
+grn_obj_is_approx_distinct_accessor(grn_ctx *ctx, grn_obj *obj)
+{
+  grn_accessor *accessor;
+
+  if (!grn_obj_is_accessor(ctx, obj)) {
+    return GRN_FALSE;
+  }
+
+  accessor = (grn_accessor *)obj;
+  if (accessor->next) {
+    return GRN_FALSE;
+  }
+
+  return accessor->action == GRN_ACCESSOR_GET_APPROX_DISTINCT;
+}
+
 bool
 grn_obj_is_column_value_accessor(grn_ctx *ctx, grn_obj *obj)
 {
@@ -823,6 +823,15 @@ grn_text_atoj(grn_ctx *ctx, grn_obj *outbuf, grn_content_type output_type,
         }
         buf.header.domain = GRN_DB_FLOAT;
         break;
+      case GRN_ACCESSOR_GET_APPROX_DISTINCT :
+        {
+          grn_rset_recinfo *ri = (grn_rset_recinfo *)grn_obj_get_value_(ctx, a->obj, id, &vs);
+          int64_t approx_distinct;
+          approx_distinct = grn_rset_recinfo_get_approx_distinct(ctx, ri, a->obj);
+          GRN_INT64_PUT(ctx, &buf, approx_distinct);
+        }
+        buf.header.domain = GRN_DB_INT64;
+        break;
       case GRN_ACCESSOR_GET_COLUMN_VALUE :
         if ((a->obj->header.flags & GRN_OBJ_COLUMN_TYPE_MASK) == GRN_OBJ_COLUMN_VECTOR) {
           if (a->next) {
@@ -272,7 +272,7 @@ proc_load(grn_ctx *ctx, int nargs, grn_obj **args, grn_user_data *user_data)
       GRN_OUTPUT_INT64(ctx->impl->loader.nrecords);
     }
     if (ctx->impl->loader.table) {
-      grn_db_touch(ctx, DB_OBJ(ctx->impl->loader.table)->db);
+      grn_table_touch_with_references(ctx, ctx->impl->loader.table);
     }
     grn_ctx_loader_clear(ctx);
   }
@@ -285,7 +285,8 @@ proc_status(grn_ctx *ctx, int nargs, grn_obj **args, grn_user_data *user_data)
   grn_timeval now;
   grn_cache *cache;
   grn_cache_statistics statistics;
-  const int n_elements = 10;
+  grn_ii_posting_cache_statistics posting_cache_statistics;
+  const int n_elements = 12;
 
   grn_timeval_now(ctx, &now);
   cache = grn_cache_current_get(ctx);
@@ -311,12 +312,37 @@ proc_status(grn_ctx *ctx, int nargs, grn_obj **args, grn_user_data *user_data)
     cache_hit_rate = (double)statistics.nhits / (double)statistics.nfetches;
     GRN_OUTPUT_FLOAT(cache_hit_rate * 100.0);
   }
+  GRN_OUTPUT_CSTR("cache");
+  GRN_OUTPUT_MAP_OPEN("cache", 4);
+  GRN_OUTPUT_CSTR("max_n_entries");
+  GRN_OUTPUT_UINT64(statistics.max_nentries);
+  GRN_OUTPUT_CSTR("n_entries");
+  GRN_OUTPUT_UINT64(statistics.nentries);
+  GRN_OUTPUT_CSTR("max_size");
+  GRN_OUTPUT_UINT64(statistics.max_size);
+  GRN_OUTPUT_CSTR("size");
+  GRN_OUTPUT_UINT64(statistics.size);
+  GRN_OUTPUT_MAP_CLOSE();
   GRN_OUTPUT_CSTR("command_version");
   GRN_OUTPUT_INT32(grn_ctx_get_command_version(ctx));
   GRN_OUTPUT_CSTR("default_command_version");
   GRN_OUTPUT_INT32(grn_get_default_command_version());
   GRN_OUTPUT_CSTR("max_command_version");
   GRN_OUTPUT_INT32(GRN_COMMAND_VERSION_MAX);
+  GRN_OUTPUT_CSTR("posting_cache");
+  grn_ii_posting_cache_get_statistics(&posting_cache_statistics);
+  GRN_OUTPUT_MAP_OPEN("posting_cache", 5);
+  GRN_OUTPUT_CSTR("max_size");
+  GRN_OUTPUT_UINT64(posting_cache_statistics.max_size);
+  GRN_OUTPUT_CSTR("size");
+  GRN_OUTPUT_UINT64(posting_cache_statistics.size);
+  GRN_OUTPUT_CSTR("n_entries");
+  GRN_OUTPUT_INT64(posting_cache_statistics.n_entries);
+  GRN_OUTPUT_CSTR("n_hits");
+  GRN_OUTPUT_UINT64(posting_cache_statistics.n_hits);
+  GRN_OUTPUT_CSTR("n_misses");
+  GRN_OUTPUT_UINT64(posting_cache_statistics.n_misses);
+  GRN_OUTPUT_MAP_CLOSE();
   GRN_OUTPUT_MAP_CLOSE();
 
 #ifdef USE_MEMORY_DEBUG
@@ -1082,6 +1108,23 @@ proc_cache_limit(grn_ctx *ctx, int nargs, grn_obj **args, grn_user_data *user_da
           (int)GRN_TEXT_LEN(VAR(0)), GRN_TEXT_VALUE(VAR(0)));
     }
   }
+  if (ctx->rc == GRN_SUCCESS && GRN_TEXT_LEN(VAR(1))) {
+    const char *rest;
+    uint64_t max_size = grn_atoull(GRN_TEXT_VALUE(VAR(1)),
+                                   GRN_BULK_CURR(VAR(1)), &rest);
+    if (GRN_BULK_CURR(VAR(1)) == rest) {
+      grn_rc rc = grn_cache_set_max_size(ctx, cache, max_size);
+      if (rc != GRN_SUCCESS) {
+        ERR(rc,
+            "max_size can't be set to the current cache: <%.*s>",
+            (int)GRN_TEXT_LEN(VAR(1)), GRN_TEXT_VALUE(VAR(1)));
+      }
+    } else {
+      ERR(GRN_INVALID_ARGUMENT,
+          "max_size value is invalid unsigned integer format: <%.*s>",
+          (int)GRN_TEXT_LEN(VAR(1)), GRN_TEXT_VALUE(VAR(1)));
+    }
+  }
   if (ctx->rc == GRN_SUCCESS) {
     GRN_OUTPUT_INT64(current_max_n_entries);
   }
@@ -3012,6 +3055,8 @@ selector_between_sequential_search(grn_ctx *ctx,
     grn_table_cursor *cursor;
     grn_id id;
     grn_obj value;
+    grn_ra_zone_filter zone_filter;
+    grn_bool use_zone_filter = GRN_FALSE;
 
     if (op == GRN_OP_AND) {
       target_table = res;
@@ -3045,6 +3090,22 @@ selector_between_sequential_search(grn_ctx *ctx,
       less = grn_operator_exec_less;
     }
 
+    if (target_column &&
+        target_column->header.type == GRN_COLUMN_FIX_SIZE &&
+        target_column->header.domain == DB_OBJ(table)->id) {
+      use_zone_filter =
+        grn_ra_zone_filter_init(ctx,
+                                &zone_filter,
+                                (grn_ra *)target_column,
+                                table,
+                                data->min,
+                                data->min_border_type ==
+                                BETWEEN_BORDER_INCLUDE,
+                                data->max,
+                                data->max_border_type ==
+                                BETWEEN_BORDER_INCLUDE);
+    }
+
     GRN_VOID_INIT(&value);
     while ((id = grn_table_cursor_next(ctx, cursor)) != GRN_ID_NIL) {
       grn_id record_id;
@@ -3057,6 +3118,11 @@ selector_between_sequential_search(grn_ctx *ctx,
         record_id = id;
       }
 
+      if (use_zone_filter &&
+          !grn_ra_zone_filter_may_match(&zone_filter, record_id)) {
+        continue;
+      }
+
       GRN_BULK_REWIND(&value);
       grn_obj_get_value(ctx, target_column, record_id, &value);
       if (greater(ctx, &value, data->min) && less(ctx, &value, data->max)) {
@@ -3070,6 +3136,9 @@ selector_between_sequential_search(grn_ctx *ctx,
     }
 
     GRN_OBJ_FIN(ctx, &value);
+    if (use_zone_filter) {
+      grn_ra_zone_filter_fin(ctx, &zone_filter);
+    }
 
     if (target_column != data->value &&
         target_column->header.type == GRN_ACCESSOR) {
@@ -3942,8 +4011,20 @@ proc_reindex(grn_ctx *ctx, int nargs, grn_obj **args,
 {
   grn_obj *target_name;
   grn_obj *target;
+  int32_t n_workers;
+  uint32_t original_n_workers;
 
   target_name = VAR(0);
+  n_workers = grn_plugin_proc_get_var_int32(ctx, user_data,
+                                            "n_workers", -1,
+                                            0);
+  if (n_workers < 0) {
+    ERR(GRN_INVALID_ARGUMENT,
+        "[reindex] n_workers must be zero or positive: <%d>",
+        n_workers);
+    GRN_OUTPUT_BOOL(GRN_FALSE);
+    return NULL;
+  }
   if (GRN_TEXT_LEN(target_name) == 0) {
     target = grn_ctx_db(ctx);
   } else {
@@ -3960,7 +4041,10 @@ proc_reindex(grn_ctx *ctx, int nargs, grn_obj **args,
     }
   }
 
+  original_n_workers = ctx->impl->ii_builder_n_workers;
+  ctx->impl->ii_builder_n_workers = (uint32_t)n_workers;
   grn_obj_reindex(ctx, target);
+  ctx->impl->ii_builder_n_workers = original_n_workers;
 
   GRN_OUTPUT_BOOL(ctx->rc == GRN_SUCCESS);
 
@@ -4224,7 +4308,8 @@ grn_db_init_builtin_commands(grn_ctx *ctx)
   DEF_COMMAND("delete", proc_delete, 4, vars);
 
   DEF_VAR(vars[0], "max");
-  DEF_COMMAND("cache_limit", proc_cache_limit, 1, vars);
+  DEF_VAR(vars[1], "max_size");
+  DEF_COMMAND("cache_limit", proc_cache_limit, 2, vars);
 
   grn_proc_init_dump(ctx);
 
@@ -4389,7 +4474,8 @@ grn_db_init_builtin_commands(grn_ctx *ctx)
   grn_proc_init_schema(ctx);
 
   DEF_VAR(vars[0], "target_name");
-  DEF_COMMAND("reindex", proc_reindex, 1, vars);
+  DEF_VAR(vars[1], "n_workers");
+  DEF_COMMAND("reindex", proc_reindex, 2, vars);
 
   {
     grn_obj *selector_proc;
@@ -62,6 +62,7 @@ grn_proc_column_parse_flags(grn_ctx *ctx,
     CHECK_FLAG(INDEX_SMALL);
     CHECK_FLAG(INDEX_MEDIUM);
     CHECK_FLAG(INDEX_LARGE);
+    CHECK_FLAG(WITH_DOCUMENT_LENGTH);
 
 #undef CHECK_FLAG
 
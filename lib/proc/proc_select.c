@@ -69,6 +69,11 @@ typedef struct {
     grn_obj *expression;
   } condition;
   grn_obj *filtered;
+  struct {
+    uint32_t n;
+    grn_bool estimate;
+    uint32_t n_hits;
+  } first_n;
 } grn_filter_data;
 
 typedef struct {
@@ -103,6 +108,7 @@ typedef struct {
   grn_raw_string filter;
   grn_raw_string adjuster;
   grn_raw_string table_name;
+  int approx_max_n_groups;
   grn_columns columns;
   grn_table_group_result result;
   grn_obj *filtered_result;
@@ -126,6 +132,8 @@ typedef struct {
   grn_raw_string match_escalation_threshold;
   grn_raw_string adjuster;
   grn_raw_string match_escalation;
+  int32_t n_workers;
+  grn_raw_string n_hits_mode;
   grn_columns columns;
 
   /* for processing */
@@ -136,6 +144,7 @@ typedef struct {
     grn_obj *sorted;
     grn_obj *output;
   } tables;
+  uint32_t n_hits;
   uint16_t cacheable;
   uint16_t taintable;
   struct {
@@ -324,6 +333,7 @@ grn_parse_table_group_calc_types(grn_ctx *ctx,
     CHECK_TABLE_GROUP_CALC_TYPE(MIN);
     CHECK_TABLE_GROUP_CALC_TYPE(SUM);
     CHECK_TABLE_GROUP_CALC_TYPE(AVG);
+    CHECK_TABLE_GROUP_CALC_TYPE(APPROX_DISTINCT);
 
 #define GRN_TABLE_GROUP_CALC_NONE 0
     CHECK_TABLE_GROUP_CALC_TYPE(NONE);
@@ -716,6 +726,9 @@ grn_filter_data_init(grn_ctx *ctx, grn_filter_data *data)
   data->condition.match_columns = NULL;
   data->condition.expression = NULL;
   data->filtered = NULL;
+  data->first_n.n = 0;
+  data->first_n.estimate = GRN_FALSE;
+  data->first_n.n_hits = 0;
 }
 
 static void
@@ -896,6 +909,18 @@ grn_filter_data_execute(grn_ctx *ctx,
                                     data->condition.expression,
                                     query_log_tag_prefix,
                                     -1);
+  if (data->first_n.n > 0) {
+    data->filtered = grn_table_select_first_n(ctx,
+                                              table,
+                                              data->condition.expression,
+                                              data->first_n.n,
+                                              data->first_n.estimate,
+                                              &(data->first_n.n_hits));
+    if (data->filtered || ctx->rc != GRN_SUCCESS) {
+      return ctx->rc == GRN_SUCCESS;
+    }
+    data->first_n.n = 0;
+  }
   data->filtered = grn_table_select(ctx,
                                     table,
                                     data->condition.expression,
@@ -925,6 +950,7 @@ grn_drilldown_data_init(grn_ctx *ctx,
   GRN_RAW_STRING_INIT(drilldown->filter);
   GRN_RAW_STRING_INIT(drilldown->adjuster);
   GRN_RAW_STRING_INIT(drilldown->table_name);
+  drilldown->approx_max_n_groups = 0;
   grn_columns_init(ctx, &(drilldown->columns));
   drilldown->result.table = NULL;
   drilldown->filtered_result = NULL;
@@ -975,7 +1001,8 @@ grn_drilldown_data_fill(grn_ctx *ctx,
                         grn_obj *calc_target,
                         grn_obj *filter,
                         grn_obj *adjuster,
-                        grn_obj *table)
+                        grn_obj *table,
+                        grn_obj *approx_max_n_groups)
 {
   GRN_RAW_STRING_FILL(drilldown->keys, keys);
 
@@ -1017,6 +1044,15 @@ grn_drilldown_data_fill(grn_ctx *ctx,
   GRN_RAW_STRING_FILL(drilldown->adjuster, adjuster);
 
   GRN_RAW_STRING_FILL(drilldown->table_name, table);
+
+  if (approx_max_n_groups && GRN_TEXT_LEN(approx_max_n_groups)) {
+    drilldown->approx_max_n_groups =
+      grn_atoi(GRN_TEXT_VALUE(approx_max_n_groups),
+               GRN_BULK_CURR(approx_max_n_groups),
+               NULL);
+  } else {
+    drilldown->approx_max_n_groups = 0;
+  }
 }
 
 static void
@@ -1647,10 +1683,50 @@ grn_select_apply_initial_columns(grn_ctx *ctx,
   return ctx->rc == GRN_SUCCESS;
 }
 
+static grn_bool
+grn_select_can_use_first_n(grn_ctx *ctx,
+                           grn_select_data *data)
+{
+  if (data->n_hits_mode.length == 0 ||
+      GRN_RAW_STRING_EQUAL_CSTRING(data->n_hits_mode, "exact")) {
+    return GRN_FALSE;
+  }
+  if (data->filter.query.length == 0 && data->filter.filter.length == 0) {
+    return GRN_FALSE;
+  }
+  if (data->sort_keys.length > 0) {
+    return GRN_FALSE;
+  }
+  if (data->offset < 0 || data->limit <= 0) {
+    return GRN_FALSE;
+  }
+  if (data->scorer.length > 0 || data->adjuster.length > 0) {
+    return GRN_FALSE;
+  }
+  if (data->slices ||
+      data->drilldown.keys.length > 0 ||
+      data->drilldowns) {
+    return GRN_FALSE;
+  }
+  if (data->columns.initial || data->columns.filtered) {
+    return GRN_FALSE;
+  }
+  if (data->load.table.length > 0) {
+    return GRN_FALSE;
+  }
+  return GRN_TRUE;
+}
+
 static grn_bool
 grn_select_filter(grn_ctx *ctx,
                   grn_select_data *data)
 {
+  if (grn_select_can_use_first_n(ctx, data)) {
+    data->filter.first_n.n = (uint32_t)(data->offset) + (uint32_t)(data->limit);
+    data->filter.first_n.estimate =
+      GRN_RAW_STRING_EQUAL_CSTRING(data->n_hits_mode, "estimate");
+  }
+
   if (!grn_filter_data_execute(ctx,
                                &(data->filter),
                                data->tables.initial,
@@ -1663,6 +1739,11 @@ grn_select_filter(grn_ctx *ctx,
   if (!data->tables.result) {
     data->tables.result = data->tables.initial;
   }
+  if (data->filter.first_n.n > 0) {
+    data->n_hits = data->filter.first_n.n_hits;
+  } else {
+    data->n_hits = grn_table_size(ctx, data->tables.result);
+  }
 
   {
     grn_expr *expression;
@@ -2149,7 +2230,7 @@ grn_select_output_match_open(grn_ctx *ctx,
                                    data,
                                    format,
                                    output_table,
-                                   grn_table_size(ctx, data->tables.result),
+                                   data->n_hits,
                                    offset,
                                    data->limit,
                                    data->output_columns.value,
@@ -2191,52 +2272,94 @@ grn_select_output_match(grn_ctx *ctx, grn_select_data *data)
   return grn_select_output_match_close(ctx, data, &format);
 }
 
-static grn_bool
-grn_select_drilldown_execute(grn_ctx *ctx,
-                             grn_select_data *data,
-                             grn_hash *drilldowns,
-                             grn_obj *table,
-                             grn_hash *slices,
-                             grn_obj *condition,
-                             grn_id id,
-                             const bool is_labeled,
-                             const char *log_tag_context,
-                             const char *query_log_tag_prefix)
-{
-  grn_bool success = GRN_TRUE;
-  grn_table_sort_key *keys = NULL;
-  unsigned int n_keys = 0;
-  grn_obj *target_table = table;
+typedef struct {
+  grn_id id;
   grn_drilldown_data *drilldown;
-  grn_table_group_result *result;
+  grn_obj *target_table;
+  grn_table_sort_key *keys;
+  unsigned int n_keys;
+  grn_bool prepared;
+  grn_table_group_result local_result;
   grn_obj log_tag_prefix;
   grn_obj full_query_log_tag_prefix;
+} grn_drilldown_task;
+
+static void
+grn_drilldown_task_init(grn_ctx *ctx,
+                        grn_drilldown_task *task,
+                        grn_hash *drilldowns,
+                        grn_obj *table,
+                        grn_id id,
+                        const bool is_labeled,
+                        const char *log_tag_context,
+                        const char *query_log_tag_prefix)
+{
+  grn_drilldown_data *drilldown;
 
   drilldown =
     (grn_drilldown_data *)grn_hash_get_value_(ctx, drilldowns, id, NULL);
 
-  GRN_TEXT_INIT(&log_tag_prefix, 0);
-  grn_text_printf(ctx, &log_tag_prefix,
+  task->id = id;
+  task->drilldown = drilldown;
+  task->target_table = table;
+  task->keys = NULL;
+  task->n_keys = 0;
+  task->prepared = GRN_FALSE;
+  memset(&(task->local_result), 0, sizeof(grn_table_group_result));
+
+  GRN_TEXT_INIT(&(task->log_tag_prefix), 0);
+  grn_text_printf(ctx, &(task->log_tag_prefix),
                   "[select]%s[drilldowns]%s%.*s%s",
                   log_tag_context,
                   drilldown->label.length > 0 ? "[" : "",
                   (int)(drilldown->label.length),
                   drilldown->label.value,
                   drilldown->label.length > 0 ? "]" : "");
-  GRN_TEXT_PUTC(ctx, &log_tag_prefix, '\0');
-  GRN_TEXT_INIT(&full_query_log_tag_prefix, 0);
+  GRN_TEXT_PUTC(ctx, &(task->log_tag_prefix), '\0');
+  GRN_TEXT_INIT(&(task->full_query_log_tag_prefix), 0);
   if (is_labeled) {
-    grn_text_printf(ctx, &full_query_log_tag_prefix,
+    grn_text_printf(ctx, &(task->full_query_log_tag_prefix),
                     "%sdrilldowns[%.*s].",
                     query_log_tag_prefix,
                     (int)(drilldown->label.length),
                     drilldown->label.value);
   } else {
-    grn_text_printf(ctx, &full_query_log_tag_prefix,
+    grn_text_printf(ctx, &(task->full_query_log_tag_prefix),
                     "%sdrilldown.",
                     query_log_tag_prefix);
   }
-  GRN_TEXT_PUTC(ctx, &full_query_log_tag_prefix, '\0');
+  GRN_TEXT_PUTC(ctx, &(task->full_query_log_tag_prefix), '\0');
+}
+
+static void
+grn_drilldown_task_close_keys(grn_ctx *ctx, grn_drilldown_task *task)
+{
+  if (task->keys) {
+    grn_table_sort_key_close(ctx, task->keys, task->n_keys);
+    task->keys = NULL;
+    task->n_keys = 0;
+  }
+}
+
+static void
+grn_drilldown_task_fin(grn_ctx *ctx, grn_drilldown_task *task)
+{
+  grn_drilldown_task_close_keys(ctx, task);
+  GRN_OBJ_FIN(ctx, &(task->log_tag_prefix));
+  GRN_OBJ_FIN(ctx, &(task->full_query_log_tag_prefix));
+}
+
+/* Resolves the target table, the group keys and the calc target. They
+ * must be resolved by the grn_ctx for the request because they may
+ * create temporary objects. */
+static grn_bool
+grn_drilldown_task_prepare(grn_ctx *ctx,
+                           grn_drilldown_task *task,
+                           grn_hash *drilldowns,
+                           grn_hash *slices)
+{
+  grn_drilldown_data *drilldown = task->drilldown;
+  grn_table_group_result *result;
 
   result = &(drilldown->result);
   result->limit = 1;
@@ -2271,18 +2394,17 @@ grn_select_drilldown_execute(grn_ctx *ctx,
                                                   slices,
                                                   dependent_id,
                                                   NULL);
-          target_table = slice->tables.result;
+          task->target_table = slice->tables.result;
         }
       }
       if (dependent_id == GRN_ID_NIL) {
         GRN_PLUGIN_ERROR(ctx, GRN_INVALID_ARGUMENT,
                          "%s[table] "
                          "nonexistent label: <%.*s>",
-                         GRN_TEXT_VALUE(&log_tag_prefix),
+                         GRN_TEXT_VALUE(&(task->log_tag_prefix)),
                          (int)(drilldown->table_name.length),
                          drilldown->table_name.value);
-        success = GRN_FALSE;
-        goto exit;
+        return GRN_FALSE;
       }
     } else {
       grn_drilldown_data *dependent_drilldown;
@@ -2294,62 +2416,120 @@ grn_select_drilldown_execute(grn_ctx *ctx,
                                                   dependent_id,
                                                   NULL);
       dependent_result = &(dependent_drilldown->result);
-      target_table = dependent_result->table;
+      task->target_table = dependent_result->table;
     }
   }
 
   if (drilldown->parsed_keys) {
     result->key_end = drilldown->n_parsed_keys;
   } else if (drilldown->keys.length > 0) {
-    keys = grn_table_sort_key_from_str(ctx,
-                                       drilldown->keys.value,
-                                       drilldown->keys.length,
-                                       target_table, &n_keys);
-    if (!keys) {
+    task->keys = grn_table_sort_key_from_str(ctx,
+                                             drilldown->keys.value,
+                                             drilldown->keys.length,
+                                             task->target_table,
+                                             &(task->n_keys));
+    if (!task->keys) {
       GRN_PLUGIN_CLEAR_ERROR(ctx);
-      success = GRN_FALSE;
-      goto exit;
+      return GRN_FALSE;
     }
 
-    result->key_end = n_keys - 1;
-    if (n_keys > 1) {
+    result->key_end = task->n_keys - 1;
+    if (task->n_keys > 1) {
       result->max_n_subrecs = 1;
     }
   }
 
   if (drilldown->calc_target_name.length > 0) {
-    result->calc_target = grn_obj_column(ctx, target_table,
+    result->calc_target = grn_obj_column(ctx, task->target_table,
                                          drilldown->calc_target_name.value,
                                          drilldown->calc_target_name.length);
   }
   if (result->calc_target) {
     result->flags |= drilldown->calc_types;
   }
+  if (drilldown->approx_max_n_groups > 0) {
+    result->flags |= GRN_TABLE_GROUP_APPROX_TOP_N;
+    result->limit = drilldown->approx_max_n_groups;
+  }
+
+  task->prepared = GRN_TRUE;
+  return GRN_TRUE;
+}
+
+/* This may be called by a worker thread with its own grn_ctx. result
+ * must be &(task->local_result) in the case. */
+static void
+grn_drilldown_task_group(grn_ctx *ctx,
+                         grn_drilldown_task *task,
+                         grn_table_group_result *result)
+{
+  grn_drilldown_data *drilldown = task->drilldown;
 
   if (drilldown->parsed_keys) {
     grn_table_group(ctx,
-                    target_table,
+                    task->target_table,
                     drilldown->parsed_keys,
                     drilldown->n_parsed_keys,
                     result,
                     1);
   } else {
-    grn_table_group(ctx, target_table, keys, n_keys, result, 1);
+    grn_table_group(ctx,
+                    task->target_table,
+                    task->keys,
+                    task->n_keys,
+                    result,
+                    1);
   }
+}
 
-  if (keys) {
-    grn_table_sort_key_close(ctx, keys, n_keys);
+/* Merges the result grouped by a worker into the result of the
+ * drilldown by the grn_ctx for the request. */
+static void
+grn_drilldown_task_merge(grn_ctx *ctx, grn_drilldown_task *task)
+{
+  grn_drilldown_data *drilldown = task->drilldown;
+
+  if (drilldown->parsed_keys) {
+    grn_table_group_merge_results(ctx,
+                                  task->target_table,
+                                  drilldown->parsed_keys,
+                                  drilldown->n_parsed_keys,
+                                  &(drilldown->result),
+                                  &(task->local_result),
+                                  1);
+  } else {
+    grn_table_group_merge_results(ctx,
+                                  task->target_table,
+                                  task->keys,
+                                  task->n_keys,
+                                  &(drilldown->result),
+                                  &(task->local_result),
+                                  1);
   }
+}
+
+static grn_bool
+grn_drilldown_task_finish(grn_ctx *ctx,
+                          grn_select_data *data,
+                          grn_drilldown_task *task,
+                          grn_obj *condition)
+{
+  grn_drilldown_data *drilldown = task->drilldown;
+  grn_table_group_result *result = &(drilldown->result);
+  const char *log_tag_prefix = GRN_TEXT_VALUE(&(task->log_tag_prefix));
+  const char *full_query_log_tag_prefix =
+    GRN_TEXT_VALUE(&(task->full_query_log_tag_prefix));
+
+  grn_drilldown_task_close_keys(ctx, task);
 
   if (!result->table) {
-    success = GRN_FALSE;
-    goto exit;
+    return GRN_FALSE;
   }
 
   GRN_QUERY_LOG(ctx, GRN_QUERY_LOG_SIZE,
                 ":", "%.*s(%u)",
-                (int)(GRN_TEXT_LEN(&full_query_log_tag_prefix) - 2),
-                GRN_TEXT_VALUE(&full_query_log_tag_prefix),
+                (int)(GRN_TEXT_LEN(&(task->full_query_log_tag_prefix)) - 2),
+                full_query_log_tag_prefix,
                 grn_table_size(ctx, result->table));
 
   if (drilldown->columns.initial) {
@@ -2358,8 +2538,8 @@ grn_select_drilldown_execute(grn_ctx *ctx,
                              result->table,
                              drilldown->columns.initial,
                              condition,
-                             GRN_TEXT_VALUE(&log_tag_prefix),
-                             GRN_TEXT_VALUE(&full_query_log_tag_prefix));
+                             log_tag_prefix,
+                             full_query_log_tag_prefix);
   }
 
   if (drilldown->filter.length > 0) {
@@ -2371,10 +2551,9 @@ grn_select_drilldown_execute(grn_ctx *ctx,
                        GRN_INVALID_ARGUMENT,
                        "%s[filter] "
                        "failed to create expression for filter: %s",
-                       GRN_TEXT_VALUE(&log_tag_prefix),
+                       log_tag_prefix,
                        ctx->errbuf);
-      success = GRN_FALSE;
-      goto exit;
+      return GRN_FALSE;
     }
     grn_expr_parse(ctx,
                    expression,
@@ -2390,12 +2569,11 @@ grn_select_drilldown_execute(grn_ctx *ctx,
                        GRN_INVALID_ARGUMENT,
                        "%s[filter] "
                        "failed to parse filter: <%.*s>: %s",
-                       GRN_TEXT_VALUE(&log_tag_prefix),
+                       log_tag_prefix,
                        (int)(drilldown->filter.length),
                        drilldown->filter.value,
                        ctx->errbuf);
-      success = GRN_FALSE;
-      goto exit;
+      return GRN_FALSE;
     }
     drilldown->filtered_result = grn_table_select(ctx,
                                                   result->table,
@@ -2412,18 +2590,17 @@ grn_select_drilldown_execute(grn_ctx *ctx,
                        GRN_INVALID_ARGUMENT,
                        "%s[filter] "
                        "failed to execute filter: <%.*s>: %s",
-                       GRN_TEXT_VALUE(&log_tag_prefix),
+                       log_tag_prefix,
                        (int)(drilldown->filter.length),
                        drilldown->filter.value,
                        ctx->errbuf);
-      success = GRN_FALSE;
-      goto exit;
+      return GRN_FALSE;
     }
     grn_obj_close(ctx, expression);
 
     GRN_QUERY_LOG(ctx, GRN_QUERY_LOG_SIZE,
                   ":", "%sfilter(%u)",
-                  GRN_TEXT_VALUE(&full_query_log_tag_prefix),
+                  full_query_log_tag_prefix,
                   grn_table_size(ctx, drilldown->filtered_result));
   }
 
@@ -2439,13 +2616,42 @@ grn_select_drilldown_execute(grn_ctx *ctx,
                               &(drilldown->adjuster),
                               result->table,
                               adjuster_result_table,
-                              GRN_TEXT_VALUE(&log_tag_prefix),
-                              GRN_TEXT_VALUE(&full_query_log_tag_prefix));
+                              log_tag_prefix,
+                              full_query_log_tag_prefix);
   }
 
-exit :
-  GRN_OBJ_FIN(ctx, &log_tag_prefix);
-  GRN_OBJ_FIN(ctx, &full_query_log_tag_prefix);
+  return GRN_TRUE;
+}
+
+static grn_bool
+grn_select_drilldown_execute(grn_ctx *ctx,
+                             grn_select_data *data,
+                             grn_hash *drilldowns,
+                             grn_obj *table,
+                             grn_hash *slices,
+                             grn_obj *condition,
+                             grn_id id,
+                             const bool is_labeled,
+                             const char *log_tag_context,
+                             const char *query_log_tag_prefix)
+{
+  grn_bool success;
+  grn_drilldown_task task;
+
+  grn_drilldown_task_init(ctx,
+                          &task,
+                          drilldowns,
+                          table,
+                          id,
+                          is_labeled,
+                          log_tag_context,
+                          query_log_tag_prefix);
+  success = grn_drilldown_task_prepare(ctx, &task, drilldowns, slices);
+  if (success) {
+    grn_drilldown_task_group(ctx, &task, &(task.drilldown->result));
+    success = grn_drilldown_task_finish(ctx, data, &task, condition);
+  }
+  grn_drilldown_task_fin(ctx, &task);
 
   return success;
 }
@@ -2564,6 +2770,282 @@ drilldown_tsort(grn_ctx *ctx,
   return succeeded;
 }
 
+typedef struct {
+  grn_ctx ctx;
+  grn_drilldown_task **tasks;
+  size_t n_tasks;
+  size_t offset;
+  size_t step;
+  grn_thread thread;
+  grn_bool thread_created;
+  grn_rc rc;
+} grn_drilldowns_worker;
+
+static grn_thread_func_result CALLBACK
+grn_drilldowns_worker_run(void *data)
+{
+  grn_drilldowns_worker *worker = data;
+  grn_ctx *ctx = &(worker->ctx);
+  size_t i;
+
+  for (i = worker->offset; i < worker->n_tasks; i += worker->step) {
+    grn_drilldown_task *task = worker->tasks[i];
+    grn_drilldown_task_group(ctx, task, &(task->local_result));
+    if (ctx->rc != GRN_SUCCESS) {
+      break;
+    }
+  }
+  worker->rc = ctx->rc;
+  return GRN_THREAD_FUNC_RETURN_VALUE;
+}
+
+/* Groups prepared tasks by worker threads. Each worker has its own
+ * grn_ctx. A temporary table must be updated only by the grn_ctx that
+ * creates it, so each worker groups records into a local result table
+ * created by its grn_ctx. Local result tables are merged into the
+ * result tables of drilldowns by the grn_ctx for the request and
+ * closed before the grn_ctx of the worker is finished. */
+static void
+grn_select_drilldowns_group_parallel(grn_ctx *ctx,
+                                     grn_drilldown_task **tasks,
+                                     size_t n_tasks,
+                                     uint32_t n_workers,
+                                     const char *log_tag_context)
+{
+  grn_drilldowns_worker *workers;
+  size_t n_parallel_tasks = 0;
+  size_t i;
+
+  for (i = 0; i < n_tasks; i++) {
+    grn_drilldown_task *task = tasks[i];
+
+    if (!task->target_table) {
+      grn_drilldown_task_group(ctx, task, &(task->drilldown->result));
+      if (ctx->rc != GRN_SUCCESS) {
+        return;
+      }
+    } else {
+      tasks[n_parallel_tasks++] = task;
+    }
+  }
+
+  if (n_workers > n_parallel_tasks) {
+    n_workers = n_parallel_tasks;
+  }
+  if (n_workers < 2) {
+    for (i = 0; i < n_parallel_tasks; i++) {
+      grn_drilldown_task *task = tasks[i];
+      grn_drilldown_task_group(ctx, task, &(task->drilldown->result));
+      if (ctx->rc != GRN_SUCCESS) {
+        return;
+      }
+    }
+    return;
+  }
+
+  for (i = 0; i < n_parallel_tasks; i++) {
+    grn_drilldown_task *task = tasks[i];
+    task->local_result = task->drilldown->result;
+    task->local_result.table = NULL;
+  }
+
+  workers = GRN_PLUGIN_CALLOC(ctx, sizeof(grn_drilldowns_worker) * n_workers);
+  if (!workers) {
+    return;
+  }
+  GRN_PLUGIN_LOG(ctx, GRN_LOG_DEBUG,
+                 "[select]%s[drilldowns] "
+                 "n_workers=<%u> n_drilldowns=<%" GRN_FMT_SIZE ">",
+                 log_tag_context,
+                 n_workers,
+                 n_parallel_tasks);
+
+  for (i = 0; i < n_workers; i++) {
+    grn_drilldowns_worker *worker = &(workers[i]);
+    grn_ctx_init(&(worker->ctx), 0);
+    grn_ctx_use(&(worker->ctx), grn_ctx_db(ctx));
+    /* Drilldowns are already processed in parallel. */
+    worker->ctx.impl->table_select_n_workers = 1;
+    worker->tasks = tasks;
+    worker->n_tasks = n_parallel_tasks;
+    worker->offset = i;
+    worker->step = n_workers;
+  }
+  for (i = 0; i < n_workers; i++) {
+    grn_drilldowns_worker *worker = &(workers[i]);
+    if (THREAD_CREATE(worker->thread,
+                      grn_drilldowns_worker_run,
+                      worker) == 0) {
+      worker->thread_created = GRN_TRUE;
+    } else {
+      GRN_PLUGIN_LOG(ctx, GRN_LOG_WARNING,
+                     "[select]%s[drilldowns][worker] "
+                     "failed to create a thread: <%" GRN_FMT_SIZE ">: "
+                     "run in the current thread",
+                     log_tag_context,
+                     i);
+      grn_drilldowns_worker_run(worker);
+    }
+  }
+  for (i = 0; i < n_workers; i++) {
+    grn_drilldowns_worker *worker = &(workers[i]);
+    if (worker->thread_created) {
+      THREAD_JOIN(worker->thread);
+    }
+  }
+  for (i = 0; i < n_workers; i++) {
+    grn_drilldowns_worker *worker = &(workers[i]);
+    if (worker->rc != GRN_SUCCESS) {
+      GRN_PLUGIN_ERROR(ctx,
+                       worker->rc,
+                       "[select]%s[drilldowns][worker] %s",
+                       log_tag_context,
+                       worker->ctx.errbuf);
+      break;
+    }
+  }
+  /* The i-th task is grouped by the (i % n_workers)-th worker. */
+  for (i = 0; i < n_parallel_tasks; i++) {
+    grn_drilldown_task *task = tasks[i];
+    if (!task->local_result.table) {
+      continue;
+    }
+    if (ctx->rc == GRN_SUCCESS) {
+      grn_drilldown_task_merge(ctx, task);
+    }
+    grn_obj_close(&(workers[i % n_workers].ctx), task->local_result.table);
+    task->local_result.table = NULL;
+  }
+  for (i = 0; i < n_workers; i++) {
+    grn_ctx_fin(&(workers[i].ctx));
+  }
+  GRN_PLUGIN_FREE(ctx, workers);
+}
+
+/* Executes drilldowns in the topologically sorted order by batches. A
+ * batch is a run of drilldowns that don't depend on each other. Only
+ * grouping in a batch is processed in parallel. Preparing and finishing
+ * (query log, columns, filter and adjuster) are processed in the
+ * sorted order by the grn_ctx for the request. So the result is the
+ * same as the serial execution. */
+static grn_bool
+grn_select_drilldowns_execute_parallel(grn_ctx *ctx,
+                                       grn_select_data *data,
+                                       grn_hash *drilldowns,
+                                       grn_obj *table,
+                                       grn_hash *slices,
+                                       grn_obj *condition,
+                                       grn_obj *tsorted_ids,
+                                       uint32_t n_workers,
+                                       const bool is_labeled,
+                                       const char *log_tag_context,
+                                       const char *query_log_tag_prefix)
+{
+  grn_bool succeeded = GRN_TRUE;
+  size_t n_drilldowns = GRN_BULK_VSIZE(tsorted_ids) / sizeof(grn_id);
+  size_t n_positions = grn_hash_size(ctx, drilldowns);
+  size_t *positions;
+  grn_drilldown_task *tasks;
+  grn_drilldown_task **group_tasks;
+  size_t start;
+  size_t i;
+
+  positions = GRN_PLUGIN_MALLOCN(ctx, size_t, n_positions);
+  tasks = GRN_PLUGIN_MALLOCN(ctx, grn_drilldown_task, n_drilldowns);
+  group_tasks = GRN_PLUGIN_MALLOCN(ctx, grn_drilldown_task *, n_drilldowns);
+  if (!positions || !tasks || !group_tasks) {
+    succeeded = GRN_FALSE;
+    goto exit;
+  }
+  for (i = 0; i < n_drilldowns; i++) {
+    positions[GRN_RECORD_VALUE_AT(tsorted_ids, i) - 1] = i;
+  }
+
+  for (start = 0; start < n_drilldowns; ) {
+    size_t end;
+    size_t n_group_tasks = 0;
+
+    for (end = start + 1; end < n_drilldowns; end++) {
+      grn_id id = GRN_RECORD_VALUE_AT(tsorted_ids, end);
+      grn_drilldown_data *drilldown;
+      grn_id dependent_id;
+
+      drilldown =
+        (grn_drilldown_data *)grn_hash_get_value_(ctx, drilldowns, id, NULL);
+      if (drilldown->table_name.length == 0) {
+        continue;
+      }
+      dependent_id = grn_hash_get(ctx,
+                                  drilldowns,
+                                  drilldown->table_name.value,
+                                  drilldown->table_name.length,
+                                  NULL);
+      if (dependent_id != GRN_ID_NIL &&
+          positions[dependent_id - 1] >= start) {
+        break;
+      }
+    }
+
+    for (i = start; i < end; i++) {
+      grn_drilldown_task_init(ctx,
+                              &(tasks[i]),
+                              drilldowns,
+                              table,
+                              GRN_RECORD_VALUE_AT(tsorted_ids, i),
+                              is_labeled,
+                              log_tag_context,
+                              query_log_tag_prefix);
+    }
+    for (i = start; i < end; i++) {
+      if (grn_drilldown_task_prepare(ctx, &(tasks[i]), drilldowns, slices)) {
+        group_tasks[n_group_tasks++] = &(tasks[i]);
+      } else if (ctx->rc != GRN_SUCCESS) {
+        break;
+      }
+    }
+    if (ctx->rc == GRN_SUCCESS) {
+      grn_select_drilldowns_group_parallel(ctx,
+                                           group_tasks,
+                                           n_group_tasks,
+                                           n_workers,
+                                           log_tag_context);
+    }
+    if (ctx->rc == GRN_SUCCESS) {
+      for (i = start; i < end; i++) {
+        if (!tasks[i].prepared) {
+          continue;
+        }
+        if (!grn_drilldown_task_finish(ctx, data, &(tasks[i]), condition)) {
+          if (ctx->rc != GRN_SUCCESS) {
+            break;
+          }
+        }
+      }
+    }
+    for (i = start; i < end; i++) {
+      grn_drilldown_task_fin(ctx, &(tasks[i]));
+    }
+    if (ctx->rc != GRN_SUCCESS) {
+      succeeded = GRN_FALSE;
+      break;
+    }
+    start = end;
+  }
+
+exit :
+  if (group_tasks) {
+    GRN_PLUGIN_FREE(ctx, group_tasks);
+  }
+  if (tasks) {
+    GRN_PLUGIN_FREE(ctx, tasks);
+  }
+  if (positions) {
+    GRN_PLUGIN_FREE(ctx, positions);
+  }
+
+  return succeeded;
+}
+
 static bool
 grn_select_drilldowns_execute(grn_ctx *ctx,
                               grn_select_data *data,
@@ -2579,6 +3061,7 @@ grn_select_drilldowns_execute(grn_ctx *ctx,
   grn_obj tsorted_ids;
   size_t i;
   size_t n_drilldowns;
+  uint32_t n_workers;
 
   GRN_RECORD_INIT(&tsorted_ids, GRN_OBJ_VECTOR, GRN_ID_NIL);
   if (!drilldown_tsort(ctx, drilldowns, &tsorted_ids)) {
@@ -2587,6 +3070,22 @@ grn_select_drilldowns_execute(grn_ctx *ctx,
   }
 
   n_drilldowns = GRN_BULK_VSIZE(&tsorted_ids) / sizeof(grn_id);
+  n_workers = grn_table_select_get_n_workers(ctx);
+  if (n_workers > 1 && n_drilldowns > 1) {
+    succeeded = grn_select_drilldowns_execute_parallel(ctx,
+                                                       data,
+                                                       drilldowns,
+                                                       table,
+                                                       slices,
+                                                       condition,
+                                                       &tsorted_ids,
+                                                       n_workers,
+                                                       is_labeled,
+                                                       log_tag_context,
+                                                       query_log_tag_prefix);
+    goto exit;
+  }
+
   for (i = 0; i < n_drilldowns; i++) {
     grn_id id;
 
@@ -2700,6 +3199,7 @@ grn_select_prepare_drilldowns(grn_ctx *ctx,
         COPY(calc_target_name);
         COPY(filter);
         COPY(adjuster);
+        COPY(approx_max_n_groups);
 
 #undef COPY
       }
@@ -3417,7 +3917,10 @@ grn_select(grn_ctx *ctx, grn_select_data *data)
   uint32_t cache_key_size;
   long long int original_match_escalation_threshold = 0;
   grn_bool original_force_match_escalation = GRN_FALSE;
+  uint32_t original_n_workers = ctx->impl->table_select_n_workers;
   grn_cache *cache_obj = grn_cache_current_get(ctx);
+  grn_obj cache_dependencies;
+  grn_obj *original_cache_dependencies = ctx->impl->cache_dependencies;
 
   if (grn_ctx_get_command_version(ctx) < GRN_COMMAND_VERSION_3) {
     data->output.formatter = &grn_select_output_formatter_v1;
@@ -3445,6 +3948,7 @@ grn_select(grn_ctx *ctx, grn_select_data *data)
     data->filter.query_flags.length + 1 +
     data->adjuster.length + 1 +
     data->match_escalation.length + 1 +
+    data->n_hits_mode.length + 1 +
     sizeof(grn_content_type) +
     sizeof(int) * 2 +
     sizeof(grn_command_version) +
@@ -3475,7 +3979,7 @@ grn_select(grn_ctx *ctx, grn_select_data *data)
     drilldown->filter.length + 1 +              \
     drilldown->adjuster.length + 1 +            \
     drilldown->table_name.length + 1 +          \
-    sizeof(int) * 2 +                           \
+    sizeof(int) * 3 +                           \
     sizeof(grn_table_group_flags)
   if (data->drilldown.keys.length > 0) {
     grn_drilldown_data *drilldown = &(data->drilldown);
@@ -3517,6 +4021,10 @@ grn_select(grn_ctx *ctx, grn_select_data *data)
       cp += sizeof(int);                                        \
       grn_memcpy(cp, &(drilldown->limit), sizeof(int));         \
       cp += sizeof(int);                                        \
+      grn_memcpy(cp,                                            \
+                 &(drilldown->approx_max_n_groups),             \
+                 sizeof(int));                                  \
+      cp += sizeof(int);                                        \
       grn_memcpy(cp,                                            \
                  &(drilldown->calc_types),                      \
                  sizeof(grn_table_group_flags));                \
@@ -3564,6 +4072,7 @@ grn_select(grn_ctx *ctx, grn_select_data *data)
     PUT_CACHE_KEY(data->filter.query_flags);
     PUT_CACHE_KEY(data->adjuster);
     PUT_CACHE_KEY(data->match_escalation);
+    PUT_CACHE_KEY(data->n_hits_mode);
     PUT_CACHE_KEY(data->load.table);
     PUT_CACHE_KEY(data->load.columns);
     PUT_CACHE_KEY(data->load.values);
@@ -3583,14 +4092,23 @@ grn_select(grn_ctx *ctx, grn_select_data *data)
       grn_rc rc;
       rc = grn_cache_fetch(ctx, cache_obj, cache_key, cache_key_size, outbuf);
       if (rc == GRN_SUCCESS) {
+        long long int output_size = GRN_TEXT_LEN(outbuf);
+        if (ctx->impl->cache_output.content_encoding != 0) {
+          output_size = ctx->impl->cache_output.size;
+        }
         GRN_QUERY_LOG(ctx, GRN_QUERY_LOG_CACHE,
                       ":", "cache(%" GRN_FMT_LLD ")",
-                      (long long int)GRN_TEXT_LEN(outbuf));
+                      output_size);
         return ctx->rc;
       }
     }
   }
 
+  /* Records tables read by this select to invalidate the cached result
+     only when they are changed. */
+  GRN_RECORD_INIT(&cache_dependencies, GRN_OBJ_VECTOR, GRN_ID_NIL);
+  ctx->impl->cache_dependencies = &cache_dependencies;
+
   original_match_escalation_threshold =
     grn_ctx_get_match_escalation_threshold(ctx);
   original_force_match_escalation =
@@ -3617,6 +4135,9 @@ grn_select(grn_ctx *ctx, grn_select_data *data)
       grn_ctx_set_match_escalation_threshold(ctx, -1);
     }
   }
+  if (data->n_workers > 0) {
+    ctx->impl->table_select_n_workers = (uint32_t)(data->n_workers);
+  }
 
   data->tables.target = grn_ctx_get(ctx, data->table.value, data->table.length);
   if (!data->tables.target) {
@@ -3664,7 +4185,7 @@ grn_select(grn_ctx *ctx, grn_select_data *data)
       goto exit;
     }
 
-    nhits = grn_table_size(ctx, data->tables.result);
+    nhits = data->n_hits;
     GRN_QUERY_LOG(ctx, GRN_QUERY_LOG_SIZE,
                   ":", "select(%d)", nhits);
 
@@ -3738,6 +4259,9 @@ exit :
   grn_ctx_set_match_escalation_threshold(ctx,
                                          original_match_escalation_threshold);
   grn_ctx_set_force_match_escalation(ctx, original_force_match_escalation);
+  ctx->impl->table_select_n_workers = original_n_workers;
+  ctx->impl->cache_dependencies = original_cache_dependencies;
+  GRN_OBJ_FIN(ctx, &cache_dependencies);
 
   /* GRN_LOG(ctx, GRN_LOG_NONE, "%d", ctx->seqno); */
 
@@ -3867,6 +4391,7 @@ grn_select_fill_drilldowns(grn_ctx *ctx,
     grn_obj *filter = NULL;
     grn_obj *adjuster = NULL;
     grn_obj *table = NULL;
+    grn_obj *approx_max_n_groups = NULL;
 
     grn_hash_cursor_get_value(ctx, cursor, (void **)&drilldown);
 
@@ -3926,6 +4451,7 @@ grn_select_fill_drilldowns(grn_ctx *ctx,
     GET_VAR(filter);
     GET_VAR(adjuster);
     GET_VAR(table);
+    GET_VAR(approx_max_n_groups);
 
 #undef GET_VAR
 
@@ -3942,7 +4468,8 @@ grn_select_fill_drilldowns(grn_ctx *ctx,
                             calc_target,
                             filter,
                             adjuster,
-                            table);
+                            table,
+                            approx_max_n_groups);
   } GRN_HASH_EACH_END(ctx, cursor);
 
   return succeeded;
@@ -3985,6 +4512,7 @@ grn_select_data_fill_drilldowns(grn_ctx *ctx,
                                                     "drilldown_filter", -1),
                             grn_plugin_proc_get_var(ctx, user_data,
                                                     "drilldown_adjuster", -1),
+                            NULL,
                             NULL);
     return GRN_TRUE;
   } else {
@@ -4189,6 +4717,7 @@ command_select(grn_ctx *ctx, int nargs, grn_obj **args, grn_user_data *user_data
   data.tables.initial = NULL;
   data.tables.result = NULL;
   data.tables.sorted = NULL;
+  data.n_hits = 0;
 
   data.slices = NULL;
   grn_drilldown_data_init(ctx, &(data.drilldown), NULL, 0);
@@ -4264,6 +4793,32 @@ command_select(grn_ctx *ctx, int nargs, grn_obj **args, grn_user_data *user_data
     grn_plugin_proc_get_var_string(ctx, user_data,
                                    "match_escalation", -1,
                                    &(data.match_escalation.length));
+  data.n_workers = grn_plugin_proc_get_var_int32(ctx, user_data,
+                                                 "n_workers", -1,
+                                                 0);
+  if (data.n_workers < 0) {
+    GRN_PLUGIN_ERROR(ctx,
+                     GRN_INVALID_ARGUMENT,
+                     "[select] n_workers must be zero or positive: <%d>",
+                     data.n_workers);
+    goto exit;
+  }
+  data.n_hits_mode.value =
+    grn_plugin_proc_get_var_string(ctx, user_data,
+                                   "n_hits_mode", -1,
+                                   &(data.n_hits_mode.length));
+  if (data.n_hits_mode.length > 0 &&
+      !GRN_RAW_STRING_EQUAL_CSTRING(data.n_hits_mode, "exact") &&
+      !GRN_RAW_STRING_EQUAL_CSTRING(data.n_hits_mode, "lower_bound") &&
+      !GRN_RAW_STRING_EQUAL_CSTRING(data.n_hits_mode, "estimate")) {
+    GRN_PLUGIN_ERROR(ctx,
+                     GRN_INVALID_ARGUMENT,
+                     "[select][n_hits_mode] "
+                     "must be exact, lower_bound or estimate: <%.*s>",
+                     (int)(data.n_hits_mode.length),
+                     data.n_hits_mode.value);
+    goto exit;
+  }
   data.load.table.value =
     grn_plugin_proc_get_var_string(ctx, user_data,
                                    "load_table", -1,
@@ -4335,7 +4890,7 @@ exit :
   return NULL;
 }
 
-#define N_VARS 31
+#define N_VARS 33
 #define DEFINE_VARS grn_expr_var vars[N_VARS]
 
 static void
@@ -4375,6 +4930,8 @@ init_vars(grn_ctx *ctx, grn_expr_var *vars)
   grn_plugin_expr_var_init(ctx, &(vars[28]), "load_table", -1);
   grn_plugin_expr_var_init(ctx, &(vars[29]), "load_columns", -1);
   grn_plugin_expr_var_init(ctx, &(vars[30]), "load_values", -1);
+  grn_plugin_expr_var_init(ctx, &(vars[31]), "n_workers", -1);
+  grn_plugin_expr_var_init(ctx, &(vars[32]), "n_hits_mode", -1);
 }
 
 void
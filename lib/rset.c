@@ -16,6 +16,8 @@
 */
 #include "grn_db.h"
 
+#include <math.h>
+
 uint32_t
 grn_rset_recinfo_calc_values_size(grn_ctx *ctx, grn_table_group_flags flags)
 {
@@ -33,10 +35,92 @@ grn_rset_recinfo_calc_values_size(grn_ctx *ctx, grn_table_group_flags flags)
   if (flags & GRN_TABLE_GROUP_CALC_AVG) {
     size += GRN_RSET_AVG_SIZE;
   }
+  if (flags & GRN_TABLE_GROUP_CALC_APPROX_DISTINCT) {
+    size += GRN_RSET_APPROX_DISTINCT_SIZE;
+  }
 
   return size;
 }
 
+/* 64bit FNV-1a with the splitmix64 finalizer. HyperLogLog needs well
+ * distributed upper bits. */
+static uint64_t
+grn_rset_approx_distinct_hash(const byte *data, size_t size)
+{
+  uint64_t hash = 14695981039346656037ULL;
+  size_t i;
+
+  for (i = 0; i < size; i++) {
+    hash ^= data[i];
+    hash *= 1099511628211ULL;
+  }
+  hash ^= hash >> 30;
+  hash *= 0xbf58476d1ce4e5b9ULL;
+  hash ^= hash >> 27;
+  hash *= 0x94d049bb133111ebULL;
+  hash ^= hash >> 31;
+  return hash;
+}
+
+static void
+grn_rset_approx_distinct_update_estimate(grn_rset_approx_distinct *approx_distinct)
+{
+  const double m = GRN_RSET_APPROX_DISTINCT_N_REGISTERS;
+  const double alpha = 0.7213 / (1 + 1.079 / m);
+  uint32_t n_zero_registers;
+  double estimate;
+
+  estimate = alpha * m * m / (m - approx_distinct->sum);
+  n_zero_registers =
+    GRN_RSET_APPROX_DISTINCT_N_REGISTERS -
+    approx_distinct->n_non_zero_registers;
+  if (estimate <= 2.5 * m && n_zero_registers > 0) {
+    /* Linear counting is more accurate for small cardinalities. */
+    estimate = m * log(m / n_zero_registers);
+  }
+  approx_distinct->estimate = (int64_t)(estimate + 0.5);
+}
+
+static grn_bool
+grn_rset_approx_distinct_update_register(grn_rset_approx_distinct *approx_distinct,
+                                         uint32_t i,
+                                         uint8_t rank)
+{
+  uint8_t current_rank = approx_distinct->registers[i];
+
+  if (rank <= current_rank) {
+    return GRN_FALSE;
+  }
+  if (current_rank == 0) {
+    approx_distinct->n_non_zero_registers++;
+  }
+  approx_distinct->sum += ldexp(1.0, -current_rank) - ldexp(1.0, -rank);
+  approx_distinct->registers[i] = rank;
+  return GRN_TRUE;
+}
+
+static void
+grn_rset_approx_distinct_add(grn_rset_approx_distinct *approx_distinct,
+                             const byte *data,
+                             size_t size)
+{
+  uint64_t hash;
+  uint32_t i;
+  uint8_t rank = 1;
+
+  hash = grn_rset_approx_distinct_hash(data, size);
+  i = (uint32_t)(hash >> (64 - GRN_RSET_APPROX_DISTINCT_PRECISION));
+  hash <<= GRN_RSET_APPROX_DISTINCT_PRECISION;
+  while (rank <= 64 - GRN_RSET_APPROX_DISTINCT_PRECISION &&
+         !(hash & (1ULL << 63))) {
+    rank++;
+    hash <<= 1;
+  }
+  if (grn_rset_approx_distinct_update_register(approx_distinct, i, rank)) {
+    grn_rset_approx_distinct_update_estimate(approx_distinct);
+  }
+}
+
 static void
 grn_rset_recinfo_update_calc_values_bulk(grn_ctx *ctx,
                                          grn_table_group_flags flags,
@@ -84,6 +168,12 @@ grn_rset_recinfo_update_calc_values_bulk(grn_ctx *ctx,
     *current_average += (value_raw - *current_average) / *n_values;
     values += GRN_RSET_AVG_SIZE;
   }
+  if (flags & GRN_TABLE_GROUP_CALC_APPROX_DISTINCT) {
+    grn_rset_approx_distinct_add((grn_rset_approx_distinct *)values,
+                                 GRN_BULK_HEAD(value),
+                                 GRN_BULK_VSIZE(value));
+    values += GRN_RSET_APPROX_DISTINCT_SIZE;
+  }
 }
 
 static void
@@ -170,6 +260,83 @@ grn_rset_recinfo_update_calc_values(grn_ctx *ctx,
   GRN_OBJ_FIN(ctx, &value_int64);
 }
 
+void
+grn_rset_recinfo_merge_calc_values(grn_ctx *ctx,
+                                   grn_rset_recinfo *ri,
+                                   grn_obj *table,
+                                   grn_rset_recinfo *source_ri,
+                                   grn_obj *source_table)
+{
+  grn_table_group_flags flags;
+  byte *values;
+  byte *source_values;
+
+  flags = DB_OBJ(table)->flags.group;
+
+  values = (((byte *)ri->subrecs) +
+            GRN_RSET_SUBRECS_SIZE(DB_OBJ(table)->subrec_size,
+                                  DB_OBJ(table)->max_n_subrecs));
+  source_values = (((byte *)source_ri->subrecs) +
+                   GRN_RSET_SUBRECS_SIZE(DB_OBJ(source_table)->subrec_size,
+                                         DB_OBJ(source_table)->max_n_subrecs));
+
+  if (flags & GRN_TABLE_GROUP_CALC_MAX) {
+    int64_t source_max = *((int64_t *)source_values);
+    if (source_max > *((int64_t *)values)) {
+      *((int64_t *)values) = source_max;
+    }
+    values += GRN_RSET_MAX_SIZE;
+    source_values += GRN_RSET_MAX_SIZE;
+  }
+  if (flags & GRN_TABLE_GROUP_CALC_MIN) {
+    int64_t source_min = *((int64_t *)source_values);
+    if (source_min < *((int64_t *)values)) {
+      *((int64_t *)values) = source_min;
+    }
+    values += GRN_RSET_MIN_SIZE;
+    source_values += GRN_RSET_MIN_SIZE;
+  }
+  if (flags & GRN_TABLE_GROUP_CALC_SUM) {
+    *((int64_t *)values) += *((int64_t *)source_values);
+    values += GRN_RSET_SUM_SIZE;
+    source_values += GRN_RSET_SUM_SIZE;
+  }
+  if (flags & GRN_TABLE_GROUP_CALC_AVG) {
+    double *current_average = (double *)values;
+    uint64_t *n_values = (uint64_t *)(((double *)values) + 1);
+    double source_average = *((double *)source_values);
+    uint64_t n_source_values = *((uint64_t *)(((double *)source_values) + 1));
+    if (n_source_values > 0) {
+      *n_values += n_source_values;
+      *current_average +=
+        (source_average - *current_average) * n_source_values / *n_values;
+    }
+    values += GRN_RSET_AVG_SIZE;
+    source_values += GRN_RSET_AVG_SIZE;
+  }
+  if (flags & GRN_TABLE_GROUP_CALC_APPROX_DISTINCT) {
+    grn_rset_approx_distinct *approx_distinct =
+      (grn_rset_approx_distinct *)values;
+    grn_rset_approx_distinct *source_approx_distinct =
+      (grn_rset_approx_distinct *)source_values;
+    grn_bool updated = GRN_FALSE;
+    uint32_t i;
+    for (i = 0; i < GRN_RSET_APPROX_DISTINCT_N_REGISTERS; i++) {
+      if (grn_rset_approx_distinct_update_register(
+            approx_distinct,
+            i,
+            source_approx_distinct->registers[i])) {
+        updated = GRN_TRUE;
+      }
+    }
+    if (updated) {
+      grn_rset_approx_distinct_update_estimate(approx_distinct);
+    }
+    values += GRN_RSET_APPROX_DISTINCT_SIZE;
+    source_values += GRN_RSET_APPROX_DISTINCT_SIZE;
+  }
+}
+
 int64_t *
 grn_rset_recinfo_get_max_(grn_ctx *ctx,
                           grn_rset_recinfo *ri,
@@ -394,3 +561,52 @@ grn_rset_recinfo_set_avg(grn_ctx *ctx,
 
   *avg_address = avg;
 }
+
+int64_t *
+grn_rset_recinfo_get_approx_distinct_(grn_ctx *ctx,
+                                      grn_rset_recinfo *ri,
+                                      grn_obj *table)
+{
+  grn_table_group_flags flags;
+  byte *values;
+
+  flags = DB_OBJ(table)->flags.group;
+  if (!(flags & GRN_TABLE_GROUP_CALC_APPROX_DISTINCT)) {
+    return NULL;
+  }
+
+  values = (((byte *)ri->subrecs) +
+            GRN_RSET_SUBRECS_SIZE(DB_OBJ(table)->subrec_size,
+                                  DB_OBJ(table)->max_n_subrecs));
+
+  if (flags & GRN_TABLE_GROUP_CALC_MAX) {
+    values += GRN_RSET_MAX_SIZE;
+  }
+  if (flags & GRN_TABLE_GROUP_CALC_MIN) {
+    values += GRN_RSET_MIN_SIZE;
+  }
+  if (flags & GRN_TABLE_GROUP_CALC_SUM) {
+    values += GRN_RSET_SUM_SIZE;
+  }
+  if (flags & GRN_TABLE_GROUP_CALC_AVG) {
+    values += GRN_RSET_AVG_SIZE;
+  }
+
+  return &(((grn_rset_approx_distinct *)values)->estimate);
+}
+
+int64_t
+grn_rset_recinfo_get_approx_distinct(grn_ctx *ctx,
+                                     grn_rset_recinfo *ri,
+                                     grn_obj *table)
+{
+  int64_t *approx_distinct_address;
+
+  approx_distinct_address =
+    grn_rset_recinfo_get_approx_distinct_(ctx, ri, table);
+  if (approx_distinct_address) {
+    return *approx_distinct_address;
+  } else {
+    return 0;
+  }
+}
@@ -21,6 +21,7 @@
 #include "grn.h"
 #include "grn_db.h"
 #include "grn_expr.h"
+#include "grn_ii.h"
 #include "grn_scorer.h"
 #include <groonga/scorer.h>
 
@@ -101,6 +102,87 @@ grn_scorer_matched_record_get_weight(grn_ctx *ctx,
   return record->weight;
 }
 
+unsigned int
+grn_scorer_matched_record_get_section_id(grn_ctx *ctx,
+                                         grn_scorer_matched_record *record)
+{
+  return record->section_id;
+}
+
+unsigned int
+grn_scorer_matched_record_get_document_length(grn_ctx *ctx,
+                                              grn_scorer_matched_record *record)
+{
+  if (!record->ii) {
+    return 0;
+  }
+  return grn_ii_get_document_length(ctx, record->ii, record->id, 0);
+}
+
+double
+grn_scorer_matched_record_get_average_document_length(grn_ctx *ctx,
+                                                      grn_scorer_matched_record *record)
+{
+  if (!record->ii) {
+    return 0.0;
+  }
+  return grn_ii_get_average_document_length(ctx, record->ii, 0);
+}
+
+unsigned int
+grn_scorer_matched_record_get_section_length(grn_ctx *ctx,
+                                             grn_scorer_matched_record *record)
+{
+  if (!record->ii) {
+    return 0;
+  }
+  return grn_ii_get_document_length(ctx,
+                                    record->ii,
+                                    record->id,
+                                    record->section_id);
+}
+
+double
+grn_scorer_matched_record_get_average_section_length(grn_ctx *ctx,
+                                                     grn_scorer_matched_record *record)
+{
+  if (!record->ii) {
+    return 0.0;
+  }
+  return grn_ii_get_average_document_length(ctx,
+                                            record->ii,
+                                            record->section_id);
+}
+
+unsigned int
+grn_scorer_matched_record_get_n_previous_occurrences(grn_ctx *ctx,
+                                                     grn_scorer_matched_record *record)
+{
+  return record->n_previous_occurrences;
+}
+
+unsigned int
+grn_scorer_matched_record_get_previous_total_term_weights(grn_ctx *ctx,
+                                                          grn_scorer_matched_record *record)
+{
+  return record->previous_total_term_weights;
+}
+
+double
+grn_scorer_matched_record_get_previous_normalized_tf(grn_ctx *ctx,
+                                                     grn_scorer_matched_record *record)
+{
+  return record->previous_normalized_tf;
+}
+
+void
+grn_scorer_matched_record_set_normalized_tf(grn_ctx *ctx,
+                                            grn_scorer_matched_record *record,
+                                            double normalized_tf)
+{
+  record->normalized_tf = normalized_tf;
+}
+
 grn_obj *
 grn_scorer_matched_record_get_arg(grn_ctx *ctx,
                                   grn_scorer_matched_record *record,
@@ -128,6 +210,54 @@ grn_scorer_matched_record_get_arg(grn_ctx *ctx,
   return arg;
 }
 
+grn_obj *
+grn_scorer_matched_record_get_nth_arg(grn_ctx *ctx,
+                                      grn_scorer_matched_record *record,
+                                      unsigned int i)
+{
+  grn_expr *expr;
+  grn_expr_code *codes_original;
+  uint32_t codes_curr_original;
+  uint32_t offset;
+  unsigned int n_args = 0;
+  grn_obj *arg;
+
+  if (!record->args_expr || record->args_expr_offset == 0) {
+    return NULL;
+  }
+
+  expr = (grn_expr *)(record->args_expr);
+  /* TODO: support getting column value */
+  /* Each argument is one code for now. */
+  for (offset = record->args_expr_offset;
+       offset < expr->codes_curr;
+       offset++) {
+    grn_operator op = expr->codes[offset].op;
+    if (op == GRN_OP_CALL) {
+      return NULL;
+    }
+    if (op == GRN_OP_COMMA) {
+      continue;
+    }
+    if (n_args == i) {
+      break;
+    }
+    n_args++;
+  }
+  if (offset == expr->codes_curr) {
+    return NULL;
+  }
+  codes_original = expr->codes;
+  codes_curr_original = expr->codes_curr;
+  expr->codes += offset;
+  expr->codes_curr = 1; /* TODO: support 1 or more codes */
+  arg = grn_expr_exec(ctx, (grn_obj *)expr, 0);
+  expr->codes_curr = codes_curr_original;
+  expr->codes = codes_original;
+
+  return arg;
+}
+
 unsigned int
 grn_scorer_matched_record_get_n_args(grn_ctx *ctx,
                                      grn_scorer_matched_record *record)
@@ -156,6 +286,28 @@ grn_scorer_matched_record_get_n_args(grn_ctx *ctx,
   return n_args;
 }
 
+double
+grn_scorer_matched_record_score(grn_ctx *ctx,
+                                grn_scorer_matched_record *record,
+                                grn_scorer_score_func *score)
+{
+  double value;
+
+  if (record->id != record->previous_id) {
+    record->previous_id = record->id;
+    record->n_previous_occurrences = 0;
+    record->previous_total_term_weights = 0;
+    record->previous_normalized_tf = 0.0;
+  }
+  record->normalized_tf = 0.0;
+  value = score(ctx, record);
+  record->n_previous_occurrences += record->n_occurrences;
+  record->previous_total_term_weights += record->total_term_weights;
+  record->previous_normalized_tf += record->normalized_tf;
+
+  return value;
+}
+
 grn_rc
 grn_scorer_register(grn_ctx *ctx,
                     const char *scorer_name_ptr,
@@ -87,10 +87,209 @@ scorer_tf_at_most(grn_ctx *ctx, grn_scorer_matched_record *record)
   return fmin(tf, max);
 }
 
+static double
+scorer_get_float_arg(grn_ctx *ctx,
+                     grn_scorer_matched_record *record,
+                     unsigned int i,
+                     double default_value)
+{
+  grn_obj *raw;
+  double value;
+
+  raw = grn_scorer_matched_record_get_nth_arg(ctx, record, i);
+  if (!raw) {
+    return default_value;
+  }
+
+  if (raw->header.type != GRN_BULK) {
+    return default_value;
+  }
+
+  if (raw->header.domain == GRN_DB_FLOAT) {
+    value = GRN_FLOAT_VALUE(raw);
+  } else {
+    grn_obj casted_raw;
+    GRN_FLOAT_INIT(&casted_raw, 0);
+    if (grn_obj_cast(ctx, raw, &casted_raw, GRN_FALSE) != GRN_SUCCESS) {
+      value = default_value;
+    } else {
+      value = GRN_FLOAT_VALUE(&casted_raw);
+    }
+    GRN_OBJ_FIN(ctx, &casted_raw);
+  }
+
+  return value;
+}
+
+static double
+scorer_bm25_saturate_tf(double tf, double k1, double length_factor)
+{
+  return (tf * (k1 + 1.0)) / (tf + k1 * length_factor);
+}
+
+static double
+scorer_bm25_compute_idf(grn_ctx *ctx, grn_scorer_matched_record *record)
+{
+  double n_all_documents;
+  double n_candidates;
+  double n_tokens;
+  double n_estimated_match_documents;
+
+  n_all_documents = grn_scorer_matched_record_get_n_documents(ctx, record);
+  n_candidates = grn_scorer_matched_record_get_n_candidates(ctx, record);
+  n_tokens = grn_scorer_matched_record_get_n_tokens(ctx, record);
+  n_estimated_match_documents = n_candidates / n_tokens;
+  if (n_estimated_match_documents > n_all_documents) {
+    n_estimated_match_documents = n_all_documents;
+  }
+  return log(1.0 +
+             (n_all_documents - n_estimated_match_documents + 0.5) /
+             (n_estimated_match_documents + 0.5));
+}
+
+static double
+scorer_bm25_compute_length_factor(double b,
+                                  double length,
+                                  double average_length)
+{
+  double normalized_length = 1.0;
+
+  /* Length normalization is disabled without WITH_DOCUMENT_LENGTH. */
+  if (average_length > 0.0) {
+    normalized_length = length / average_length;
+  }
+
+  return 1.0 - b + b * normalized_length;
+}
+
+/*
+  previous_tf is TF of the sections of the same record that are already
+  scored. This returns the increase of the score by TF of this section.
+  So the sum of the returned scores of all sections is the score of the
+  sum of TF of all sections.
+ */
+static double
+scorer_bm25_compute(grn_ctx *ctx,
+                    grn_scorer_matched_record *record,
+                    double length,
+                    double average_length,
+                    double previous_tf)
+{
+  double k1;
+  double b;
+  double tf;
+  double length_factor;
+  double idf;
+
+  k1 = scorer_get_float_arg(ctx, record, 0, 1.2);
+  b = scorer_get_float_arg(ctx, record, 1, 0.75);
+
+  tf = grn_scorer_matched_record_get_n_occurrences(ctx, record) +
+    grn_scorer_matched_record_get_total_term_weights(ctx, record);
+  idf = scorer_bm25_compute_idf(ctx, record);
+  length_factor = scorer_bm25_compute_length_factor(b, length, average_length);
+  return idf *
+    (scorer_bm25_saturate_tf(previous_tf + tf, k1, length_factor) -
+     scorer_bm25_saturate_tf(previous_tf, k1, length_factor));
+}
+
+/* scorer_bm25(k1 = 1.2, b = 0.75)
+ *
+ * A record is scored by TF of all matched sections such as elements
+ * of a vector column. */
+static double
+scorer_bm25(grn_ctx *ctx, grn_scorer_matched_record *record)
+{
+  double previous_tf;
+
+  previous_tf =
+    grn_scorer_matched_record_get_n_previous_occurrences(ctx, record) +
+    grn_scorer_matched_record_get_previous_total_term_weights(ctx, record);
+  return scorer_bm25_compute(
+    ctx,
+    record,
+    grn_scorer_matched_record_get_document_length(ctx, record),
+    grn_scorer_matched_record_get_average_document_length(ctx, record),
+    previous_tf);
+}
+
+/* scorer_bm25_per_section(k1 = 1.2, b = 0.75)
+ *
+ * Each section is scored separately and normalized by its own average
+ * length. Section scores are summed up. Section weights are applied by
+ * the caller. */
+static double
+scorer_bm25_per_section(grn_ctx *ctx, grn_scorer_matched_record *record)
+{
+  return scorer_bm25_compute(
+    ctx,
+    record,
+    grn_scorer_matched_record_get_section_length(ctx, record),
+    grn_scorer_matched_record_get_average_section_length(ctx, record),
+    0.0);
+}
+
+/* scorer_bm25f(k1 = 1.2, b = 0.75, scale = 1.0)
+ *
+ * TF of each section is weighted and normalized by its section
+ * length. Normalized TF of all matched sections of a record is summed
+ * up into one pseudo TF and it is saturated once. Weight of each
+ * section is used only for the pseudo TF. So the score is multiplied
+ * by scale instead. */
+static double
+scorer_bm25f(grn_ctx *ctx, grn_scorer_matched_record *record)
+{
+  double k1;
+  double b;
+  double scale;
+  double weight;
+  double tf;
+  double length_factor;
+  double normalized_tf;
+  double previous_normalized_tf;
+  double idf;
+
+  weight = grn_scorer_matched_record_get_weight(ctx, record);
+  if (weight == 0.0) {
+    return 0.0;
+  }
+
+  k1 = scorer_get_float_arg(ctx, record, 0, 1.2);
+  b = scorer_get_float_arg(ctx, record, 1, 0.75);
+  scale = scorer_get_float_arg(ctx, record, 2, 1.0);
+
+  tf = grn_scorer_matched_record_get_n_occurrences(ctx, record) +
+    grn_scorer_matched_record_get_total_term_weights(ctx, record);
+  length_factor = scorer_bm25_compute_length_factor(
+    b,
+    grn_scorer_matched_record_get_section_length(ctx, record),
+    grn_scorer_matched_record_get_average_section_length(ctx, record));
+  if (length_factor > 0.0) {
+    normalized_tf = weight * tf / length_factor;
+  } else {
+    normalized_tf = weight * tf;
+  }
+  grn_scorer_matched_record_set_normalized_tf(ctx, record, normalized_tf);
+  previous_normalized_tf =
+    grn_scorer_matched_record_get_previous_normalized_tf(ctx, record);
+
+  idf = scorer_bm25_compute_idf(ctx, record);
+  /* The caller multiplies the returned score by the weight. The weight
+     is already applied to the pseudo TF. So it is canceled here. */
+  return idf *
+    (scorer_bm25_saturate_tf(previous_normalized_tf + normalized_tf, k1, 1.0) -
+     scorer_bm25_saturate_tf(previous_normalized_tf, k1, 1.0)) *
+    scale / weight;
+}
+
 grn_rc
 grn_db_init_builtin_scorers(grn_ctx *ctx)
 {
   grn_scorer_register(ctx, "scorer_tf_idf", -1, scorer_tf_idf);
   grn_scorer_register(ctx, "scorer_tf_at_most", -1, scorer_tf_at_most);
+  grn_scorer_register(ctx, "scorer_bm25", -1, scorer_bm25);
+  grn_scorer_register(ctx, "scorer_bm25_per_section", -1,
+                      scorer_bm25_per_section);
+  grn_scorer_register(ctx, "scorer_bm25f", -1, scorer_bm25f);
   return GRN_SUCCESS;
 }
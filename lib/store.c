@@ -28,6 +28,41 @@
 #define GRN_RA_W_SEGMENT    22
 #define GRN_RA_SEGMENT_SIZE (1 << GRN_RA_W_SEGMENT)
 
+static grn_bool grn_ra_zone_map_enable = GRN_TRUE;
+static uint32_t grn_ra_zone_map_zone_size = 0;
+
+void
+grn_store_init_from_env(void)
+{
+  {
+    char grn_ra_zone_map_enable_env[GRN_ENV_BUFFER_SIZE];
+    grn_getenv("GRN_RA_ZONE_MAP_ENABLE",
+               grn_ra_zone_map_enable_env,
+               GRN_ENV_BUFFER_SIZE);
+    if (strcmp(grn_ra_zone_map_enable_env, "no") == 0) {
+      grn_ra_zone_map_enable = GRN_FALSE;
+    } else {
+      grn_ra_zone_map_enable = GRN_TRUE;
+    }
+  }
+
+  {
+    char grn_ra_zone_map_zone_size_env[GRN_ENV_BUFFER_SIZE];
+    grn_getenv("GRN_RA_ZONE_MAP_ZONE_SIZE",
+               grn_ra_zone_map_zone_size_env,
+               GRN_ENV_BUFFER_SIZE);
+    if (grn_ra_zone_map_zone_size_env[0]) {
+      grn_ra_zone_map_zone_size =
+        grn_atoui(grn_ra_zone_map_zone_size_env,
+                  grn_ra_zone_map_zone_size_env +
+                  strlen(grn_ra_zone_map_zone_size_env),
+                  NULL);
+    }
+  }
+}
+
+static void grn_ra_zone_map_close(grn_ctx *ctx, grn_ra *ra);
+
 static grn_ra *
 _grn_ra_create(grn_ctx *ctx, grn_ra *ra, const char *path, unsigned int element_size)
 {
@@ -54,6 +89,7 @@ _grn_ra_create(grn_ctx *ctx, grn_ra *ra, const char *path, unsigned int element_
   ra->header = header;
   ra->element_mask =  n_elm - 1;
   ra->element_width = w_elm;
+  ra->zone_map = NULL;
   return ra;
 }
 
@@ -69,6 +105,7 @@ grn_ra_create(grn_ctx *ctx, const char *path, unsigned int element_size)
     GRN_FREE(ra);
     return NULL;
   }
+  CRITICAL_SECTION_INIT(ra->zone_map_lock);
   return ra;
 }
 
@@ -103,6 +140,8 @@ grn_ra_open(grn_ctx *ctx, const char *path)
   ra->header = header;
   ra->element_mask =  n_elm - 1;
   ra->element_width = w_elm;
+  CRITICAL_SECTION_INIT(ra->zone_map_lock);
+  ra->zone_map = NULL;
   return ra;
 }
 
@@ -119,6 +158,8 @@ grn_ra_close(grn_ctx *ctx, grn_ra *ra)
 {
   grn_rc rc;
   if (!ra) { return GRN_INVALID_ARGUMENT; }
+  grn_ra_zone_map_close(ctx, ra);
+  CRITICAL_SECTION_FIN(ra->zone_map_lock);
   rc = grn_io_close(ctx, ra->io);
   GRN_FREE(ra);
   return rc;
@@ -147,6 +188,9 @@ grn_ra_truncate(grn_ctx *ctx, grn_ra *ra)
     path = NULL;
   }
   element_size = ra->header->element_size;
+  CRITICAL_SECTION_ENTER(ra->zone_map_lock);
+  grn_ra_zone_map_close(ctx, ra);
+  CRITICAL_SECTION_LEAVE(ra->zone_map_lock);
   if ((rc = grn_io_close(ctx, ra->io))) { goto exit; }
   ra->io = NULL;
   if (path && (rc = grn_io_remove(ctx, path))) { goto exit; }
@@ -209,6 +253,461 @@ grn_ra_cache_fin(grn_ctx *ctx, grn_ra *ra, grn_id id)
   return GRN_SUCCESS;
 }
 
+void
+grn_ra_get_values(grn_ctx *ctx, grn_ra *ra,
+                  const grn_id *ids, size_t n_ids, void *values)
+{
+  const uint32_t element_size = ra->header->element_size;
+  byte *output = values;
+  int current_seg = -1;
+  byte *current_p = NULL;
+  size_t i = 0;
+
+  while (i < n_ids) {
+    grn_id id = ids[i];
+    size_t n_elements = 1;
+    int seg;
+
+    if (id == GRN_ID_NIL || id > GRN_ID_MAX) {
+      memset(output, 0, element_size);
+      output += element_size;
+      i++;
+      continue;
+    }
+
+    seg = id >> ra->element_width;
+    if (seg != current_seg) {
+      if (current_seg != -1) {
+        GRN_IO_SEG_UNREF(ra->io, current_seg);
+      }
+      GRN_IO_SEG_REF(ra->io, seg, current_p);
+      current_seg = seg;
+    }
+    /* Consecutive IDs in the same segment are copied at once. */
+    while (i + n_elements < n_ids &&
+           ids[i + n_elements] == id + n_elements &&
+           ((id + n_elements) >> ra->element_width) == (grn_id)seg) {
+      n_elements++;
+    }
+    if (current_p) {
+      grn_memcpy(output,
+                 current_p + ((id & ra->element_mask) * element_size),
+                 element_size * n_elements);
+    } else {
+      memset(output, 0, element_size * n_elements);
+    }
+    output += element_size * n_elements;
+    i += n_elements;
+  }
+  if (current_seg != -1) {
+    GRN_IO_SEG_UNREF(ra->io, current_seg);
+  }
+}
+
+typedef enum {
+  GRN_RA_ZONE_VALUE_NONE,
+  GRN_RA_ZONE_VALUE_INT,
+  GRN_RA_ZONE_VALUE_UINT,
+  GRN_RA_ZONE_VALUE_FLOAT
+} grn_ra_zone_value_type;
+
+typedef union {
+  int64_t int_value;
+  uint64_t uint_value;
+  double float_value;
+} grn_ra_zone_value;
+
+typedef struct {
+  grn_bool have_value;
+  grn_ra_zone_value min;
+  grn_ra_zone_value max;
+} grn_ra_zone;
+
+struct _grn_ra_zone_map {
+  int zone_width;
+  uint32_t n_zones;
+  uint32_t n_modifications;
+  grn_ra_zone *zones;
+};
+
+static grn_ra_zone_value_type
+grn_ra_zone_value_type_of(grn_id range)
+{
+  switch (range) {
+  case GRN_DB_INT8 :
+  case GRN_DB_INT16 :
+  case GRN_DB_INT32 :
+  case GRN_DB_INT64 :
+  case GRN_DB_TIME :
+    return GRN_RA_ZONE_VALUE_INT;
+  case GRN_DB_UINT8 :
+  case GRN_DB_UINT16 :
+  case GRN_DB_UINT32 :
+  case GRN_DB_UINT64 :
+    return GRN_RA_ZONE_VALUE_UINT;
+  case GRN_DB_FLOAT :
+    return GRN_RA_ZONE_VALUE_FLOAT;
+  default :
+    return GRN_RA_ZONE_VALUE_NONE;
+  }
+}
+
+static grn_inline grn_bool
+grn_ra_zone_value_read(grn_id range, const void *raw, grn_ra_zone_value *value)
+{
+  switch (range) {
+  case GRN_DB_INT8 :
+    value->int_value = *((const int8_t *)raw);
+    break;
+  case GRN_DB_INT16 :
+    value->int_value = *((const int16_t *)raw);
+    break;
+  case GRN_DB_INT32 :
+    value->int_value = *((const int32_t *)raw);
+    break;
+  case GRN_DB_INT64 :
+  case GRN_DB_TIME :
+    value->int_value = *((const int64_t *)raw);
+    break;
+  case GRN_DB_UINT8 :
+    value->uint_value = *((const uint8_t *)raw);
+    break;
+  case GRN_DB_UINT16 :
+    value->uint_value = *((const uint16_t *)raw);
+    break;
+  case GRN_DB_UINT32 :
+    value->uint_value = *((const uint32_t *)raw);
+    break;
+  case GRN_DB_UINT64 :
+    value->uint_value = *((const uint64_t *)raw);
+    break;
+  case GRN_DB_FLOAT :
+    value->float_value = *((const double *)raw);
+    /* NaN never matches any range. */
+    if (value->float_value != value->float_value) {
+      return GRN_FALSE;
+    }
+    break;
+  default :
+    return GRN_FALSE;
+  }
+  return GRN_TRUE;
+}
+
+static grn_inline int
+grn_ra_zone_value_compare(grn_ra_zone_value_type type,
+                          grn_ra_zone_value *value1,
+                          grn_ra_zone_value *value2)
+{
+  switch (type) {
+  case GRN_RA_ZONE_VALUE_INT :
+    if (value1->int_value < value2->int_value) {
+      return -1;
+    } else if (value1->int_value > value2->int_value) {
+      return 1;
+    }
+    break;
+  case GRN_RA_ZONE_VALUE_UINT :
+    if (value1->uint_value < value2->uint_value) {
+      return -1;
+    } else if (value1->uint_value > value2->uint_value) {
+      return 1;
+    }
+    break;
+  case GRN_RA_ZONE_VALUE_FLOAT :
+    if (value1->float_value < value2->float_value) {
+      return -1;
+    } else if (value1->float_value > value2->float_value) {
+      return 1;
+    }
+    break;
+  default :
+    break;
+  }
+  return 0;
+}
+
+static grn_inline void
+grn_ra_zone_add(grn_ra_zone *zone,
+                grn_ra_zone_value_type type,
+                grn_ra_zone_value *value)
+{
+  if (!zone->have_value) {
+    zone->have_value = GRN_TRUE;
+    zone->min = *value;
+    zone->max = *value;
+    return;
+  }
+  if (grn_ra_zone_value_compare(type, value, &(zone->min)) < 0) {
+    zone->min = *value;
+  }
+  if (grn_ra_zone_value_compare(type, value, &(zone->max)) > 0) {
+    zone->max = *value;
+  }
+}
+
+static void
+grn_ra_zone_map_close(grn_ctx *ctx, grn_ra *ra)
+{
+  grn_ra_zone_map *zone_map = ra->zone_map;
+
+  if (!zone_map) {
+    return;
+  }
+  if (zone_map->zones) {
+    GRN_FREE(zone_map->zones);
+  }
+  GRN_FREE(zone_map);
+  ra->zone_map = NULL;
+}
+
+static grn_id
+grn_ra_zone_map_get_max_id(grn_ctx *ctx, grn_obj *table)
+{
+  grn_table_cursor *cursor;
+  grn_id max_id;
+
+  cursor = grn_table_cursor_open(ctx, table,
+                                 NULL, 0,
+                                 NULL, 0,
+                                 0, 1,
+                                 GRN_CURSOR_BY_ID | GRN_CURSOR_DESCENDING);
+  if (!cursor) {
+    return GRN_ID_NIL;
+  }
+  max_id = grn_table_cursor_next(ctx, cursor);
+  grn_table_cursor_close(ctx, cursor);
+  return max_id;
+}
+
+/* It must be called in ra->zone_map_lock. Only zones whose all IDs are
+   less than or equal to the max ID of table are summarized. Records
+   after them may be added without grn_obj_set_value(). */
+static grn_ra_zone_map *
+grn_ra_zone_map_prepare(grn_ctx *ctx, grn_ra *ra, grn_obj *table)
+{
+  grn_ra_zone_map *zone_map = ra->zone_map;
+  grn_id range = ra->obj.range;
+  grn_ra_zone_value_type type = grn_ra_zone_value_type_of(range);
+  grn_id max_id;
+  uint32_t n_zones;
+
+  if (zone_map &&
+      zone_map->n_modifications != ra->header->n_modifications) {
+    grn_ra_zone_map_close(ctx, ra);
+    zone_map = NULL;
+  }
+  if (!zone_map) {
+    int zone_width = ra->element_width;
+    if (grn_ra_zone_map_zone_size > 0) {
+      int width;
+      for (width = 0;
+           width < zone_width &&
+             (2U << width) <= grn_ra_zone_map_zone_size;
+           width++) {
+      }
+      zone_width = width;
+    }
+    zone_map = GRN_CALLOC(sizeof(grn_ra_zone_map));
+    if (!zone_map) {
+      return NULL;
+    }
+    zone_map->zone_width = zone_width;
+    zone_map->n_zones = 0;
+    zone_map->n_modifications = ra->header->n_modifications;
+    zone_map->zones = NULL;
+    ra->zone_map = zone_map;
+  }
+
+  max_id = grn_ra_zone_map_get_max_id(ctx, table);
+  n_zones = ((uint64_t)max_id + 1) >> zone_map->zone_width;
+  if (n_zones > zone_map->n_zones) {
+    grn_ra_zone *zones;
+    grn_ra_cache cache;
+    uint32_t i;
+
+    zones = GRN_REALLOC(zone_map->zones, sizeof(grn_ra_zone) * n_zones);
+    if (!zones) {
+      return zone_map;
+    }
+    zone_map->zones = zones;
+    GRN_RA_CACHE_INIT(ra, &cache);
+    for (i = zone_map->n_zones; i < n_zones; i++) {
+      grn_ra_zone *zone = &(zones[i]);
+      grn_id id = (grn_id)i << zone_map->zone_width;
+      grn_id end_id = id + (1U << zone_map->zone_width);
+      zone->have_value = GRN_FALSE;
+      for (; id < end_id; id++) {
+        void *raw = grn_ra_ref_cache(ctx, ra, id, &cache);
+        grn_ra_zone_value value;
+        if (!raw) {
+          break;
+        }
+        if (grn_ra_zone_value_read(range, raw, &value)) {
+          grn_ra_zone_add(zone, type, &value);
+        }
+      }
+      if (id < end_id) {
+        /* This zone isn't summarized. Its values may match. */
+        break;
+      }
+    }
+    GRN_RA_CACHE_FIN(ra, &cache);
+    zone_map->n_zones = i;
+  }
+
+  return zone_map;
+}
+
+void
+grn_ra_zone_map_update(grn_ctx *ctx, grn_ra *ra, grn_id id, const void *value)
+{
+  grn_ra_zone_map *zone_map;
+
+  if (!ra->zone_map) {
+    ra->header->n_modifications++;
+    return;
+  }
+
+  CRITICAL_SECTION_ENTER(ra->zone_map_lock);
+  zone_map = ra->zone_map;
+  if (zone_map &&
+      zone_map->n_modifications == ra->header->n_modifications) {
+    uint32_t zone = id >> zone_map->zone_width;
+    if (zone < zone_map->n_zones) {
+      grn_id range = ra->obj.range;
+      grn_ra_zone_value zone_value;
+      if (grn_ra_zone_value_read(range, value, &zone_value)) {
+        grn_ra_zone_add(&(zone_map->zones[zone]),
+                        grn_ra_zone_value_type_of(range),
+                        &zone_value);
+      }
+    }
+    zone_map->n_modifications++;
+  }
+  ra->header->n_modifications++;
+  CRITICAL_SECTION_LEAVE(ra->zone_map_lock);
+}
+
+static grn_inline grn_bool
+grn_ra_zone_may_match(grn_ra_zone *zone,
+                      grn_ra_zone_value_type type,
+                      grn_ra_zone_value *min,
+                      grn_bool min_include,
+                      grn_ra_zone_value *max,
+                      grn_bool max_include)
+{
+  if (!zone->have_value) {
+    return GRN_FALSE;
+  }
+  if (min) {
+    int compared = grn_ra_zone_value_compare(type, &(zone->max), min);
+    if (compared < 0 || (compared == 0 && !min_include)) {
+      return GRN_FALSE;
+    }
+  }
+  if (max) {
+    int compared = grn_ra_zone_value_compare(type, &(zone->min), max);
+    if (compared > 0 || (compared == 0 && !max_include)) {
+      return GRN_FALSE;
+    }
+  }
+  return GRN_TRUE;
+}
+
+grn_bool
+grn_ra_zone_filter_init(grn_ctx *ctx,
+                        grn_ra_zone_filter *filter,
+                        grn_ra *ra,
+                        grn_obj *table,
+                        grn_obj *min,
+                        grn_bool min_include,
+                        grn_obj *max,
+                        grn_bool max_include)
+{
+  grn_id range = ra->obj.range;
+  grn_ra_zone_value_type type = grn_ra_zone_value_type_of(range);
+  grn_ra_zone_value min_value;
+  grn_ra_zone_value max_value;
+  grn_ra_zone_map *zone_map;
+  uint32_t n_skipped_zones = 0;
+  uint32_t i;
+
+  filter->zone_width = 0;
+  filter->n_zones = 0;
+  filter->may_match = NULL;
+
+  if (!grn_ra_zone_map_enable) {
+    return GRN_FALSE;
+  }
+  if (type == GRN_RA_ZONE_VALUE_NONE) {
+    return GRN_FALSE;
+  }
+  if (!min && !max) {
+    return GRN_FALSE;
+  }
+  if (min) {
+    if (min->header.type != GRN_BULK ||
+        min->header.domain != range ||
+        GRN_BULK_VSIZE(min) != ra->header->element_size ||
+        !grn_ra_zone_value_read(range, GRN_BULK_HEAD(min), &min_value)) {
+      return GRN_FALSE;
+    }
+  }
+  if (max) {
+    if (max->header.type != GRN_BULK ||
+        max->header.domain != range ||
+        GRN_BULK_VSIZE(max) != ra->header->element_size ||
+        !grn_ra_zone_value_read(range, GRN_BULK_HEAD(max), &max_value)) {
+      return GRN_FALSE;
+    }
+  }
+
+  CRITICAL_SECTION_ENTER(ra->zone_map_lock);
+  zone_map = grn_ra_zone_map_prepare(ctx, ra, table);
+  if (zone_map && zone_map->n_zones > 0) {
+    filter->may_match = GRN_MALLOCN(grn_bool, zone_map->n_zones);
+  }
+  if (filter->may_match) {
+    filter->zone_width = zone_map->zone_width;
+    filter->n_zones = zone_map->n_zones;
+    for (i = 0; i < zone_map->n_zones; i++) {
+      filter->may_match[i] =
+        grn_ra_zone_may_match(&(zone_map->zones[i]),
+                              type,
+                              min ? &min_value : NULL,
+                              min_include,
+                              max ? &max_value : NULL,
+                              max_include);
+      if (!filter->may_match[i]) {
+        n_skipped_zones++;
+      }
+    }
+  }
+  CRITICAL_SECTION_LEAVE(ra->zone_map_lock);
+
+  if (n_skipped_zones == 0) {
+    grn_ra_zone_filter_fin(ctx, filter);
+    return GRN_FALSE;
+  }
+
+  GRN_LOG(ctx, GRN_LOG_DEBUG,
+          "[ra][zone-map] skip zones: <%u>/<%u>",
+          n_skipped_zones, filter->n_zones);
+  return GRN_TRUE;
+}
+
+void
+grn_ra_zone_filter_fin(grn_ctx *ctx, grn_ra_zone_filter *filter)
+{
+  if (filter->may_match) {
+    GRN_FREE(filter->may_match);
+  }
+  filter->zone_width = 0;
+  filter->n_zones = 0;
+  filter->may_match = NULL;
+}
+
 /**** jagged arrays ****/
 
 #define GRN_JA_W_SEGREGATE_THRESH_V1   7
@@ -2603,8 +3102,10 @@ grn_ja_reader_init(grn_ctx *ctx, grn_ja_reader *reader, grn_ja *ja)
   reader->ref_seg_ids_size = 0;
   reader->body_seg_id = JA_ESEG_VOID;
   reader->body_seg_addr = NULL;
+  reader->packed_raw = GRN_FALSE;
   reader->packed_buf = NULL;
   reader->packed_buf_size = 0;
+  reader->stream = NULL;
 #ifdef GRN_WITH_ZLIB
   if (reader->ja->header->flags & GRN_OBJ_COMPRESS_ZLIB) {
     z_stream *new_stream = GRN_MALLOCN(z_stream, 1);
@@ -2704,7 +3205,13 @@ grn_ja_reader_seek_compressed(grn_ctx *ctx, grn_ja_reader *reader, grn_id id)
   einfo = (grn_ja_einfo *)reader->einfo_seg_addr;
   einfo += id & JA_M_EINFO_IN_A_SEGMENT;
   reader->einfo = einfo;
-  /* ETINY_P(einfo) is always false because the original size needs 8 bytes. */
+  /* Only empty values are tiny because others have the original size. */
+  if (ETINY_P(einfo)) {
+    ETINY_DEC(einfo, reader->value_size);
+    reader->packed_size = 0;
+    reader->packed_raw = GRN_TRUE;
+    return GRN_SUCCESS;
+  }
   if (EHUGE_P(einfo)) {
     EHUGE_DEC(einfo, seg_id, reader->packed_size);
     reader->body_seg_offset = 0;
@@ -2723,7 +3230,15 @@ grn_ja_reader_seek_compressed(grn_ctx *ctx, grn_ja_reader *reader, grn_id id)
     reader->body_seg_addr = seg_addr;
   }
   seg_addr = (char *)reader->body_seg_addr + reader->body_seg_offset;
-  reader->value_size = (uint32_t)*(uint64_t *)seg_addr;
+  {
+    uint64_t compressed_value_meta = *(uint64_t *)seg_addr;
+    reader->value_size =
+      (uint32_t)COMPRESSED_VALUE_META_UNCOMPRESSED_LEN(compressed_value_meta);
+    /* Small values are stored without compression. */
+    reader->packed_raw =
+      (COMPRESSED_VALUE_META_FLAG(compressed_value_meta) ==
+       COMPRESSED_VALUE_META_FLAG_RAW);
+  }
   return GRN_SUCCESS;
 }
 #endif /* GRN_WITH_COMPRESSED */
@@ -3020,14 +3535,14 @@ grn_ja_reader_read_zstd(grn_ctx *ctx, grn_ja_reader *reader, void *buf)
     GRN_IO_SEG_UNREF(io, seg_id);
     seg_id++;
     src_size = (int)(reader->packed_size - sizeof(uint64_t));
-    dest_size = ZSTD_decompress(reader->packed_buf, reader->value_size,
-                                buf, src_size);
+    dest_size = ZSTD_decompress(buf, reader->value_size,
+                                reader->packed_buf, src_size);
   } else {
     char *packed_addr = (char *)reader->body_seg_addr;
     packed_addr += reader->body_seg_offset + sizeof(uint64_t);
     src_size = (int)(reader->packed_size - sizeof(uint64_t));
-    dest_size = ZSTD_decompress(packed_addr, reader->value_size,
-                                buf, src_size);
+    dest_size = ZSTD_decompress(buf, reader->value_size,
+                                packed_addr, src_size);
   }
   if ((uint32_t)dest_size != reader->value_size) {
     return GRN_ZSTD_ERROR;
@@ -3080,20 +3595,48 @@ grn_ja_reader_read_raw(grn_ctx *ctx, grn_ja_reader *reader, void *buf)
   return GRN_SUCCESS;
 }
 
+#ifdef GRN_WITH_COMPRESSED
+/* grn_ja_reader_read_packed_raw() reads a value that isn't compressed
+   in a column with compression. */
+static grn_rc
+grn_ja_reader_read_packed_raw(grn_ctx *ctx, grn_ja_reader *reader, void *buf)
+{
+  grn_ja_einfo *einfo = (grn_ja_einfo *)reader->einfo;
+  if (ETINY_P(einfo)) {
+    grn_memcpy(buf, einfo, reader->value_size);
+  } else {
+    grn_memcpy(buf,
+               (char *)reader->body_seg_addr +
+               reader->body_seg_offset + sizeof(uint64_t),
+               reader->value_size);
+  }
+  return GRN_SUCCESS;
+}
+#endif /* GRN_WITH_COMPRESSED */
+
 grn_rc
 grn_ja_reader_read(grn_ctx *ctx, grn_ja_reader *reader, void *buf)
 {
   switch (reader->ja->header->flags & GRN_OBJ_COMPRESS_MASK) {
 #ifdef GRN_WITH_ZLIB
   case GRN_OBJ_COMPRESS_ZLIB :
+    if (reader->packed_raw) {
+      return grn_ja_reader_read_packed_raw(ctx, reader, buf);
+    }
     return grn_ja_reader_read_zlib(ctx, reader, buf);
 #endif /* GRN_WITH_ZLIB */
 #ifdef GRN_WITH_LZ4
   case GRN_OBJ_COMPRESS_LZ4 :
+    if (reader->packed_raw) {
+      return grn_ja_reader_read_packed_raw(ctx, reader, buf);
+    }
     return grn_ja_reader_read_lz4(ctx, reader, buf);
 #endif /* GRN_WITH_LZ4 */
 #ifdef GRN_WITH_ZSTD
   case GRN_OBJ_COMPRESS_ZSTD :
+    if (reader->packed_raw) {
+      return grn_ja_reader_read_packed_raw(ctx, reader, buf);
+    }
     return grn_ja_reader_read_zstd(ctx, reader, buf);
 #endif /* GRN_WITH_ZSTD */
   default :
@@ -70,6 +70,7 @@ module Groonga
 
       class Counter
         include Loggable
+        include ParallelSelectable
 
         def initialize(input, target_range)
           @filter = input[:filter]
@@ -157,9 +158,11 @@ module Groonga
               @dynamic_columns.apply_initial(apply_targets)
             end
           end
+          selects = create_selects
           @contexts.each do |context|
-            filter_shard(context)
+            filter_shard(context, selects)
           end
+          execute_selects(selects)
           if @post_filter
             if @dynamic_columns.have_filtered?
               apply_targets = @contexts.collect do |context|
@@ -167,13 +170,47 @@ module Groonga
               end
               @dynamic_columns.apply_filtered(apply_targets)
             end
+            selects = create_selects
             @contexts.each do |context|
-              post_filter_shard(context)
+              post_filter_shard(context, selects)
             end
+            execute_selects(selects)
           end
         end
 
-        def filter_shard(context)
+        def create_selects
+          if select_in_parallel?
+            []
+          else
+            nil
+          end
+        end
+
+        def select_shard(context, expression, selects)
+          if selects
+            selects << [context, expression]
+          else
+            filtered_table = context.table.select(expression)
+            @temporary_tables << filtered_table
+            context.table = filtered_table
+          end
+        end
+
+        def execute_selects(selects)
+          return if selects.nil?
+          return if selects.empty?
+
+          targets = selects.collect do |context, expression|
+            [context.table, expression]
+          end
+          filtered_tables = select_in_parallel(targets)
+          @temporary_tables.concat(filtered_tables)
+          selects.each_with_index do |(context, _), i|
+            context.table = filtered_tables[i]
+          end
+        end
+
+        def filter_shard(context, selects)
           return if context.range_index
 
           if context.cover_type == :all and @filter.nil?
@@ -198,9 +235,7 @@ module Groonga
             when :partial_min_and_max
               expression_builder.build_partial_min_and_max(expression)
             end
-            filtered_table = context.table.select(expression)
-            @temporary_tables << filtered_table
-            context.table = filtered_table
+            select_shard(context, expression, selects)
           end
         end
 
@@ -212,15 +247,13 @@ module Groonga
           end
         end
 
-        def post_filter_shard(context)
+        def post_filter_shard(context, selects)
           expression = nil
           post_filtered_table = nil
           expression = Expression.create(context.table)
           @temporary_expressions << expression
           expression.parse(@post_filter)
-          filtered_table = context.table.select(expression)
-          @temporary_tables << filtered_table
-          context.table = filtered_table
+          select_shard(context, expression, selects)
         end
 
         def count_n_records_in_range(context)
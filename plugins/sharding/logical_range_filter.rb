@@ -209,6 +209,8 @@ module Groonga
       end
 
       class Executor
+        include ParallelSelectable
+
         def initialize(context)
           @context = context
         end
@@ -262,12 +264,53 @@ module Groonga
             end
             executors << previous_executor if previous_executor
             executors.each(&block)
+          elsif select_in_parallel? and @context.dynamic_columns.empty?
+            executors = []
+            enumerator.send(each_method) do |shard, shard_range|
+              executors << ShardExecutor.new(@context, shard, shard_range)
+            end
+            prefilter(executors)
+            executors.each(&block)
           else
             enumerator.send(each_method) do |shard, shard_range|
               yield(ShardExecutor.new(@context, shard, shard_range))
             end
           end
         end
+
+        # Filters shards that don't use range index by multiple threads
+        # before they are executed in order. Shards after enough
+        # records are collected aren't filtered here. They are filtered
+        # when they are executed if they are still needed.
+        def prefilter(executors)
+          targets = []
+          target_executors = []
+          executors.each do |executor|
+            target = executor.create_prefilter_target
+            next if target.nil?
+            targets << target
+            target_executors << executor
+          end
+          return if targets.empty?
+
+          options = {}
+          if @context.post_filter.nil? and @context.current_limit >= 0
+            options[:limit] = @context.current_offset + @context.current_limit
+          end
+          begin
+            result_sets = select_in_parallel(targets, options)
+          ensure
+            targets.each do |_, expression|
+              expression.close
+            end
+          end
+          result_sets.each do |result_set|
+            @context.temporary_tables << result_set if result_set
+          end
+          target_executors.each_with_index do |executor, i|
+            executor.prefiltered_result_set = result_sets[i]
+          end
+        end
       end
 
       class Window
@@ -512,6 +555,7 @@ module Groonga
         attr_reader :shard
         attr_writer :previous_executor
         attr_writer :next_executor
+        attr_writer :prefiltered_result_set
         def initialize(context, shard, shard_range)
           @context = context
           @shard = shard
@@ -540,6 +584,8 @@ module Groonga
 
           @prepared = false
           @filtered = false
+
+          @prefiltered_result_set = nil
         end
 
         def execute
@@ -594,6 +640,31 @@ module Groonga
           end
         end
 
+        def create_prefilter_target
+          ensure_prepared
+          return nil unless have_record?
+          return nil if @range_index
+          return nil if @cover_type == :all and @filter.nil?
+
+          expression = Expression.create(@target_table)
+          begin
+            case @cover_type
+            when :all
+              @expression_builder.build_all(expression)
+            when :partial_min
+              @expression_builder.build_partial_min(expression)
+            when :partial_max
+              @expression_builder.build_partial_max(expression)
+            when :partial_min_and_max
+              @expression_builder.build_partial_min_and_max(expression)
+            end
+          rescue
+            expression.close
+            raise
+          end
+          [@target_table, expression]
+        end
+
         private
         def have_record?
           return false if @cover_type == :none
@@ -1064,6 +1135,12 @@ module Groonga
         end
 
         def filter_table
+          if @prefiltered_result_set
+            add_filtered_result_set(@prefiltered_result_set)
+            @prefiltered_result_set = nil
+            return
+          end
+
           table = @target_table
           create_expression(table) do |expression|
             yield(expression)
@@ -347,6 +347,8 @@ module Groonga
               types |= TableGroupFlags::CALC_SUM
             when "AVG"
               types |= TableGroupFlags::CALC_AVG
+            when "APPROX_DISTINCT"
+              types |= TableGroupFlags::CALC_APPROX_DISTINCT
             when "NONE"
               # Do nothing
             else
@@ -376,6 +378,7 @@ module Groonga
         attr_reader :result_sets
         attr_reader :shard_targets
         attr_reader :shard_results
+        attr_reader :shard_selects
         attr_reader :plain_drilldown
         attr_reader :labeled_drilldowns
         attr_reader :temporary_tables
@@ -400,6 +403,7 @@ module Groonga
           @result_sets = []
           @shard_targets = []
           @shard_results = []
+          @shard_selects = []
           @plain_drilldown = PlainDrilldownExecuteContext.new(@input)
           @labeled_drilldowns = LabeledDrilldowns.parse(@input)
 
@@ -617,6 +621,7 @@ module Groonga
 
       class Executor
         include QueryLoggable
+        include ParallelSelectable
 
         def initialize(context)
           @context = context
@@ -658,6 +663,7 @@ module Groonga
           @context.shard_targets.each do |shard_executor, target_table|
             shard_executor.execute
           end
+          execute_shard_selects
 
           if @context.shard_results.empty?
             result_set = HashTable.create(:flags => ObjectFlags::WITH_SUBREC,
@@ -679,6 +685,26 @@ module Groonga
           end
         end
 
+        def execute_shard_selects
+          shard_selects = @context.shard_selects
+          return if shard_selects.empty?
+
+          targets = []
+          shard_selects.each do |_, table, expression|
+            targets << [table, expression] if expression
+          end
+          result_sets = select_in_parallel(targets)
+          i = 0
+          shard_selects.each do |shard_executor, table, expression|
+            if expression
+              shard_executor.add_result(result_sets[i], expression)
+              i += 1
+            else
+              shard_executor.add_result(table, nil)
+            end
+          end
+        end
+
         def execute_plain_drilldown
           drilldown = @context.plain_drilldown
           query_log_prefix = "drilldown"
@@ -788,6 +814,7 @@ module Groonga
 
       class ShardExecutor
         include QueryLoggable
+        include ParallelSelectable
 
         def initialize(context, shard, shard_range)
           @context = context
@@ -869,11 +896,36 @@ module Groonga
           @result_sets << result_set
         end
 
+        def add_result(result_set, condition)
+          query_logger.log(:size, ":",
+                           "select(#{result_set.size})[#{@shard.table_name}]")
+
+          if result_set.empty?
+            result_set.close
+            return
+          end
+
+          if result_set == @shard.table
+            if @context.dynamic_columns.have_filtered?
+              result_set = result_set.select_all
+              @temporary_tables << result_set
+            end
+          else
+            @temporary_tables << result_set
+          end
+
+          @shard_results << [self, result_set, condition]
+        end
+
         private
         def filter_shard_all(expression_builder)
           if @query.nil? and @filter.nil?
             @temporary_tables.delete(@target_table)
-            add_result(@target_table, nil)
+            if select_in_parallel?
+              @context.shard_selects << [self, @target_table, nil]
+            else
+              add_result(@target_table, nil)
+            end
           else
             filter_table do |expression|
               expression_builder.build_all(expression)
@@ -905,7 +957,11 @@ module Groonga
           table = @target_table
           expression = create_expression(table)
           yield(expression)
-          add_result(table.select(expression), expression)
+          if select_in_parallel?
+            @context.shard_selects << [self, table, expression]
+          else
+            add_result(table.select(expression), expression)
+          end
         end
 
         def apply_post_filter(table)
@@ -913,27 +969,6 @@ module Groonga
           expression.parse(@post_filter)
           table.select(expression)
         end
-
-        def add_result(result_set, condition)
-          query_logger.log(:size, ":",
-                           "select(#{result_set.size})[#{@shard.table_name}]")
-
-          if result_set.empty?
-            result_set.close
-            return
-          end
-
-          if result_set == @shard.table
-            if @context.dynamic_columns.have_filtered?
-              result_set = result_set.select_all
-              @temporary_tables << result_set
-            end
-          else
-            @temporary_tables << result_set
-          end
-
-          @shard_results << [self, result_set, condition]
-        end
       end
     end
   end
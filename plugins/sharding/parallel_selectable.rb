@@ -0,0 +1,21 @@
+module Groonga
+  module Sharding
+    module ParallelSelectable
+      private
+      def select_in_parallel?
+        Context.instance.table_select_n_workers > 1
+      end
+
+      # Selects records from shards by multiple threads. targets is an
+      # array of [table, expression]. Result sets are returned in the
+      # same order as targets.
+      #
+      # If options[:limit] is specified, targets after enough records
+      # are collected from the preceding targets aren't selected.
+      # Their result sets are nil.
+      def select_in_parallel(targets, options={})
+        Table.select_targets(targets, options)
+      end
+    end
+  end
+end
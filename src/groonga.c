@@ -31,6 +31,7 @@
 
 #include <grn_com.h>
 #include <grn_ctx_impl.h>
+#include <grn_cache.h>
 #include <grn_proc.h>
 #include <grn_db.h>
 #include <grn_util.h>
@@ -54,6 +55,10 @@
 # include <sys/sysctl.h>
 #endif /* HAVE_SYS_SYSCTL_H */
 
+#ifdef __linux__
+# include <sched.h>
+#endif /* __linux__ */
+
 #ifdef WIN32
 # include <io.h>
 # include <direct.h>
@@ -82,6 +87,8 @@
 #define DEFAULT_GQTP_PORT 10043
 #define DEFAULT_DEST "localhost"
 #define DEFAULT_MAX_N_FLOATING_THREADS 8
+#define DEFAULT_HTTP_KEEP_ALIVE_TIMEOUT 0.0
+#define DEFAULT_HTTP_MAX_KEEP_ALIVE_REQUESTS 1000
 #define MAX_CON 0x10000
 
 #define RLIMIT_NOFILE_MINIMUM 4096
@@ -94,6 +101,9 @@ static int number_of_lines = 0;
 static int newdb;
 static grn_bool is_daemon_mode = GRN_FALSE;
 static int listen_backlog = GRN_COM_EVENT_LISTEN_BACKLOG_DEFAULT;
+static double http_keep_alive_timeout = DEFAULT_HTTP_KEEP_ALIVE_TIMEOUT;
+static int http_max_keep_alive_requests = DEFAULT_HTTP_MAX_KEEP_ALIVE_REQUESTS;
+static grn_bool is_http_keep_alive_enabled = GRN_FALSE;
 static int (*do_client)(int argc, char **argv);
 static int (*do_server)(char *path);
 static const char *pid_file_path = NULL;
@@ -502,8 +512,18 @@ static grn_com_queue ctx_old;
 static grn_critical_section q_critical_section;
 static grn_cond q_cond;
 static uint32_t n_running_threads = 0;
+/* The number of GQTP workers that wait for an edge. HTTP workers
+   aren't counted. */
 static uint32_t n_floating_threads = 0;
 static uint32_t max_n_floating_threads;
+static grn_bool use_http_workers = GRN_FALSE;
+/* It protects events and last_active_time_msec of keep-alive HTTP
+   connections. A worker updates them when it returns a connection to
+   the event loop. The event loop thread reads them to close idle
+   connections. */
+static grn_critical_section http_connections_critical_section;
+
+static void http_workers_wake_up(void);
 
 static uint32_t
 groonga_get_thread_limit(void *data)
@@ -552,6 +572,7 @@ groonga_set_thread_limit_with_ctx(grn_ctx *ctx, uint32_t new_limit, void *data)
     if (is_reduced) {
       break;
     }
+    http_workers_wake_up();
     if (ctx && ctx->rc == GRN_CANCEL) {
       CRITICAL_SECTION_ENTER(q_critical_section);
       max_n_floating_threads = current_max_n_floating_threads;
@@ -934,6 +955,45 @@ daemonize(void)
   return exit_code;
 }
 
+static void
+close_idle_http_connections(grn_ctx *ctx, grn_com_event *ev)
+{
+  static uint64_t last_checked_time_msec = 0;
+  uint64_t timeout_msec = http_keep_alive_timeout * 1000;
+  uint64_t check_interval_msec = 1000;
+  uint64_t now_msec;
+  grn_timeval tv;
+  grn_com *com;
+
+  grn_timeval_now(ctx, &tv);
+  now_msec = GRN_TIMEVAL_TO_MSEC(&tv);
+  if (timeout_msec < check_interval_msec) {
+    check_interval_msec = timeout_msec;
+  }
+  if (now_msec < last_checked_time_msec + check_interval_msec) {
+    return;
+  }
+  last_checked_time_msec = now_msec;
+
+  GRN_HASH_EACH(ctx, ev->hash, id, NULL, NULL, &com, {
+    grn_bool is_idle;
+    if (com == ev->acceptor) {
+      continue;
+    }
+    /* A connection that is processed by a worker has 0 as the last
+       active time and no events. A worker doesn't use the connection
+       after it sets them. */
+    CRITICAL_SECTION_ENTER(http_connections_critical_section);
+    is_idle = ((com->events & GRN_COM_POLLIN) &&
+               com->last_active_time_msec > 0 &&
+               com->last_active_time_msec + timeout_msec <= now_msec);
+    CRITICAL_SECTION_LEAVE(http_connections_critical_section);
+    if (is_idle) {
+      grn_com_close(ctx, com);
+    }
+  });
+}
+
 static void
 run_server_loop(grn_ctx *ctx, grn_com_event *ev)
 {
@@ -957,17 +1017,28 @@ run_server_loop(grn_ctx *ctx, grn_com_event *ev)
       grn_edges_delete(ctx, edge);
     }
     request_timer_process_timeout();
+    if (is_http_keep_alive_enabled) {
+      close_idle_http_connections(ctx, ev);
+    }
     /* todo : log stat */
   }
   running_event_loop = GRN_FALSE;
   for (;;) {
     uint32_t i;
     CRITICAL_SECTION_ENTER(q_critical_section);
-    for (i = 0; i < n_floating_threads; i++) {
-      COND_SIGNAL(q_cond);
+    if (use_http_workers) {
+      /* HTTP workers exit when they find GRN_CTX_QUIT. */
+      if (n_running_threads == 0) { break; }
+    } else {
+      for (i = 0; i < n_floating_threads; i++) {
+        COND_SIGNAL(q_cond);
+      }
+      if (n_running_threads == n_floating_threads) { break; }
     }
-    if (n_running_threads == n_floating_threads) { break; }
     CRITICAL_SECTION_LEAVE(q_critical_section);
+    if (use_http_workers) {
+      http_workers_wake_up();
+    }
     grn_nanosleep(1000000);
   }
   {
@@ -993,6 +1064,10 @@ run_server_loop(grn_ctx *ctx, grn_com_event *ev)
   }
 }
 
+static void h_handler(grn_ctx *ctx, grn_obj *msg);
+static void http_workers_start(grn_ctx *ctx, grn_obj *db);
+static void http_workers_fin(grn_ctx *ctx);
+
 static int
 run_server(grn_ctx *ctx, grn_obj *db, grn_com_event *ev,
            grn_edge_dispatcher_func dispatcher, grn_handler_func handler)
@@ -1006,8 +1081,14 @@ run_server(grn_ctx *ctx, grn_obj *db, grn_com_event *ev,
     ev->opaque = db;
     grn_edges_init(ctx, dispatcher);
     if (!grn_com_sopen(ctx, ev, bind_address, port, handler, he)) {
+      if (handler == h_handler) {
+        http_workers_start(ctx, db);
+      }
       send_ready_notify();
       run_server_loop(ctx, ev);
+      if (handler == h_handler) {
+        http_workers_fin(ctx);
+      }
       exit_code = EXIT_SUCCESS;
     } else {
       send_ready_notify();
@@ -1073,8 +1154,14 @@ start_service(grn_ctx *ctx, const char *db_path,
 
 typedef struct {
   grn_msg *msg;
+  /* NULL when keep-alive is disabled. */
+  grn_com *com;
+  grn_sock fd;
   grn_bool in_body;
   grn_bool is_chunked;
+  grn_bool is_keep_alive;
+  /* The next pipelined request starts here in msg if any. */
+  const char *request_end;
 } ht_context;
 
 static void
@@ -1082,7 +1169,9 @@ h_output_set_header(grn_ctx *ctx,
                     grn_obj *header,
                     grn_rc rc,
                     long long int content_length,
-                    grn_obj *foot)
+                    grn_obj *foot,
+                    grn_bool is_keep_alive,
+                    const char *content_encoding)
 {
   switch (rc) {
   case GRN_SUCCESS :
@@ -1116,12 +1205,27 @@ h_output_set_header(grn_ctx *ctx,
     GRN_TEXT_PUTS(ctx, header, grn_ctx_get_mime_type(ctx));
   }
   GRN_TEXT_PUTS(ctx, header, "\r\n");
+  if (content_encoding) {
+    GRN_TEXT_PUTS(ctx, header, "Content-Encoding: ");
+    GRN_TEXT_PUTS(ctx, header, content_encoding);
+    GRN_TEXT_PUTS(ctx, header, "\r\n");
+    GRN_TEXT_PUTS(ctx, header, "Vary: Accept-Encoding\r\n");
+  }
   if (content_length >= 0) {
-    GRN_TEXT_PUTS(ctx, header, "Connection: close\r\n");
+    if (is_keep_alive) {
+      GRN_TEXT_PUTS(ctx, header, "Connection: keep-alive\r\n");
+    } else {
+      GRN_TEXT_PUTS(ctx, header, "Connection: close\r\n");
+    }
     GRN_TEXT_PUTS(ctx, header, "Content-Length: ");
     grn_text_lltoa(ctx, header, content_length);
     GRN_TEXT_PUTS(ctx, header, "\r\n");
   } else {
+    if (is_keep_alive) {
+      GRN_TEXT_PUTS(ctx, header, "Connection: keep-alive\r\n");
+    } else {
+      GRN_TEXT_PUTS(ctx, header, "Connection: close\r\n");
+    }
     GRN_TEXT_PUTS(ctx, header, "Transfer-Encoding: chunked\r\n");
   }
   GRN_TEXT_PUTS(ctx, header, "\r\n");
@@ -1217,7 +1321,7 @@ static void
 h_output_raw(grn_ctx *ctx, int flags, ht_context *hc)
 {
   grn_rc expr_rc = ctx->rc;
-  grn_sock fd = hc->msg->u.fd;
+  grn_sock fd = hc->fd;
   grn_obj header_;
   grn_obj head_;
   grn_obj body_;
@@ -1241,10 +1345,12 @@ h_output_raw(grn_ctx *ctx, int flags, ht_context *hc)
 
   if (!hc->in_body) {
     if (is_last_message) {
-      h_output_set_header(ctx, &header_, expr_rc, GRN_TEXT_LEN(&body_), NULL);
+      h_output_set_header(ctx, &header_, expr_rc, GRN_TEXT_LEN(&body_), NULL,
+                          hc->is_keep_alive, NULL);
       hc->is_chunked = GRN_FALSE;
     } else {
-      h_output_set_header(ctx, &header_, expr_rc, -1, NULL);
+      h_output_set_header(ctx, &header_, expr_rc, -1, NULL,
+                          hc->is_keep_alive, NULL);
       hc->is_chunked = GRN_TRUE;
     }
     header = &header_;
@@ -1265,7 +1371,6 @@ h_output_raw(grn_ctx *ctx, int flags, ht_context *hc)
   if (is_last_message) {
     if (hc->is_chunked) {
       GRN_TEXT_PUTS(ctx, &foot_, "0\r\n");
-      GRN_TEXT_PUTS(ctx, &foot_, "Connection: close\r\n");
       GRN_TEXT_PUTS(ctx, &foot_, "\r\n");
       foot = &foot_;
     }
@@ -1283,12 +1388,13 @@ static void
 h_output_typed(grn_ctx *ctx, int flags, ht_context *hc)
 {
   grn_rc expr_rc = ctx->rc;
-  grn_sock fd = hc->msg->u.fd;
+  grn_sock fd = hc->fd;
   grn_obj header, head, body, foot;
   char *chunk = NULL;
   unsigned int chunk_size = 0;
   int recv_flags;
   grn_bool should_return_body;
+  const char *content_encoding;
 
   if (!(flags & GRN_CTX_TAIL)) { return; }
 
@@ -1309,18 +1415,40 @@ h_output_typed(grn_ctx *ctx, int flags, ht_context *hc)
 
   grn_ctx_recv(ctx, &chunk, &chunk_size, &recv_flags);
   GRN_TEXT_SET(ctx, &body, chunk, chunk_size);
+  /* Not NULL when body is a compressed cached result. */
+  content_encoding = grn_cache_get_output_content_encoding(ctx);
 
   output_envelope(ctx, expr_rc, &head, &body, &foot);
-  h_output_set_header(ctx, &header, expr_rc,
-                      GRN_TEXT_LEN(&head) +
-                      GRN_TEXT_LEN(&body) +
-                      GRN_TEXT_LEN(&foot),
-                      &foot);
-  if (should_return_body) {
-    h_output_send(ctx, fd, &header, &head, &body, &foot);
+  if (content_encoding) {
+    grn_obj encoded;
+    GRN_TEXT_INIT(&encoded, 0);
+    grn_cache_encode_output(ctx, &head, &body, &foot, &encoded);
+    h_output_set_header(ctx, &header, expr_rc,
+                        GRN_TEXT_LEN(&encoded),
+                        &foot,
+                        hc->is_keep_alive,
+                        content_encoding);
+    if (should_return_body) {
+      h_output_send(ctx, fd, &header, &encoded, NULL, NULL);
+    } else {
+      h_output_send(ctx, fd, &header, NULL, NULL, NULL);
+    }
+    GRN_OBJ_FIN(ctx, &encoded);
   } else {
-    h_output_send(ctx, fd, &header, NULL, NULL, NULL);
+    h_output_set_header(ctx, &header, expr_rc,
+                        GRN_TEXT_LEN(&head) +
+                        GRN_TEXT_LEN(&body) +
+                        GRN_TEXT_LEN(&foot),
+                        &foot,
+                        hc->is_keep_alive,
+                        NULL);
+    if (should_return_body) {
+      h_output_send(ctx, fd, &header, &head, &body, &foot);
+    } else {
+      h_output_send(ctx, fd, &header, NULL, NULL, NULL);
+    }
   }
+  grn_cache_set_accept_content_encodings(ctx, 0);
   GRN_OBJ_FIN(ctx, &foot);
   GRN_OBJ_FIN(ctx, &body);
   GRN_OBJ_FIN(ctx, &head);
@@ -1343,38 +1471,40 @@ h_output(grn_ctx *ctx, int flags, void *arg)
   }
 }
 
-static void
-do_htreq_get(grn_ctx *ctx, ht_context *hc)
-{
-  grn_msg *msg = hc->msg;
-  char *path = NULL;
-  char *pathe = GRN_BULK_HEAD((grn_obj *)msg);
-  char *e = GRN_BULK_CURR((grn_obj *)msg);
-  for (;; pathe++) {
-    if (e <= pathe + 6) {
-      /* invalid request */
-      return;
-    }
-    if (*pathe == ' ') {
-      if (!path) {
-        path = pathe + 1;
-      } else {
-        if (!memcmp(pathe + 1, "HTTP/1", 6)) {
-          break;
-        }
-      }
-    }
-  }
-  grn_ctx_send(ctx, path, pathe - path, GRN_CTX_TAIL);
-}
-
 typedef struct {
+  const char *method_start;
+  int method_length;
   const char *path_start;
   int path_length;
+  grn_bool is_http_1_1;
   long long int content_length;
   grn_bool have_100_continue;
+  grn_bool have_transfer_encoding;
+  grn_bool have_connection_close;
+  grn_bool have_connection_keep_alive;
+  /* GRN_CACHE_CONTENT_ENCODING_* flags. */
+  int accept_content_encodings;
   const char *body_start;
-} h_post_header;
+  const char *end;
+} h_header;
+
+static void
+h_header_init(h_header *header)
+{
+  header->method_start = NULL;
+  header->method_length = -1;
+  header->path_start = NULL;
+  header->path_length = -1;
+  header->is_http_1_1 = GRN_FALSE;
+  header->content_length = -1;
+  header->have_100_continue = GRN_FALSE;
+  header->have_transfer_encoding = GRN_FALSE;
+  header->have_connection_close = GRN_FALSE;
+  header->have_connection_keep_alive = GRN_FALSE;
+  header->accept_content_encodings = 0;
+  header->body_start = NULL;
+  header->end = NULL;
+}
 
 #define STRING_EQUAL(string, string_length, constant_string)\
   (string_length == strlen(constant_string) &&\
@@ -1385,31 +1515,27 @@ typedef struct {
    grn_strncasecmp(string, constant_string, string_length) == 0)
 
 static const char *
-do_htreq_post_parse_header_request_line(grn_ctx *ctx,
+do_htreq_parse_header_request_line(grn_ctx *ctx,
                                         const char *start,
                                         const char *end,
-                                        h_post_header *header)
+                                        h_header *header)
 {
   const char *current;
 
   {
-    const char *method = start;
-    int method_length = -1;
-
-    for (current = method; current < end; current++) {
+    header->method_start = start;
+    header->method_length = -1;
+    for (current = header->method_start; current < end; current++) {
       if (current[0] == '\n') {
         return NULL;
       }
       if (current[0] == ' ') {
-        method_length = current - method;
+        header->method_length = current - header->method_start;
         current++;
         break;
       }
     }
-    if (method_length == -1) {
-      return NULL;
-    }
-    if (!STRING_EQUAL_CI(method, method_length, "POST")) {
+    if (header->method_length == -1) {
       return NULL;
     }
   }
@@ -1449,8 +1575,10 @@ do_htreq_post_parse_header_request_line(grn_ctx *ctx,
     if (http_version_length == -1) {
       return NULL;
     }
-    if (!(STRING_EQUAL_CI(http_version_start, http_version_length, "HTTP/1.0") ||
-          STRING_EQUAL_CI(http_version_start, http_version_length, "HTTP/1.1"))) {
+    if (STRING_EQUAL_CI(http_version_start, http_version_length, "HTTP/1.1")) {
+      header->is_http_1_1 = GRN_TRUE;
+    } else if (!STRING_EQUAL_CI(http_version_start, http_version_length,
+                                "HTTP/1.0")) {
       return NULL;
     }
   }
@@ -1458,11 +1586,105 @@ do_htreq_post_parse_header_request_line(grn_ctx *ctx,
   return current;
 }
 
+static void
+do_htreq_parse_header_connection(grn_ctx *ctx,
+                                 const char *value,
+                                 int value_length,
+                                 h_header *header)
+{
+  const char *current = value;
+  const char *end = value + value_length;
+
+  while (current < end) {
+    const char *token = current;
+    int token_length;
+    while (current < end && current[0] != ',') {
+      current++;
+    }
+    token_length = current - token;
+    while (token_length > 0 && token[0] == ' ') {
+      token++;
+      token_length--;
+    }
+    while (token_length > 0 && token[token_length - 1] == ' ') {
+      token_length--;
+    }
+    if (STRING_EQUAL_CI(token, token_length, "close")) {
+      header->have_connection_close = GRN_TRUE;
+    } else if (STRING_EQUAL_CI(token, token_length, "keep-alive")) {
+      header->have_connection_keep_alive = GRN_TRUE;
+    }
+    current++;
+  }
+}
+
+static void
+do_htreq_parse_header_accept_encoding(grn_ctx *ctx,
+                                      const char *value,
+                                      int value_length,
+                                      h_header *header)
+{
+  const char *current = value;
+  const char *end = value + value_length;
+
+  while (current < end) {
+    const char *token = current;
+    int token_length;
+    const char *parameters;
+    grn_bool is_acceptable = GRN_TRUE;
+    while (current < end && current[0] != ',') {
+      current++;
+    }
+    token_length = current - token;
+    while (token_length > 0 && token[0] == ' ') {
+      token++;
+      token_length--;
+    }
+    for (parameters = token; parameters < token + token_length; parameters++) {
+      if (parameters[0] == ';') {
+        break;
+      }
+    }
+    if (parameters < token + token_length) {
+      /* "q=0", "q=0.0" and so on mean "not acceptable". */
+      const char *q = parameters + 1;
+      const char *q_end = token + token_length;
+      token_length = parameters - token;
+      while (q < q_end && q[0] == ' ') {
+        q++;
+      }
+      if (q_end - q >= 3 && (q[0] == 'q' || q[0] == 'Q') && q[1] == '=') {
+        q += 2;
+        is_acceptable = GRN_FALSE;
+        for (; q < q_end && q[0] != ' '; q++) {
+          if (q[0] != '0' && q[0] != '.') {
+            is_acceptable = GRN_TRUE;
+            break;
+          }
+        }
+      }
+    }
+    while (token_length > 0 && token[token_length - 1] == ' ') {
+      token_length--;
+    }
+    if (is_acceptable) {
+      if (STRING_EQUAL_CI(token, token_length, "gzip") ||
+          STRING_EQUAL_CI(token, token_length, "x-gzip")) {
+        header->accept_content_encodings |= GRN_CACHE_CONTENT_ENCODING_GZIP;
+      } else if (STRING_EQUAL_CI(token, token_length, "deflate")) {
+        header->accept_content_encodings |=
+          GRN_CACHE_CONTENT_ENCODING_DEFLATE;
+      }
+    }
+    current++;
+  }
+}
+
 static const char *
-do_htreq_post_parse_header_values(grn_ctx *ctx,
+do_htreq_parse_header_values(grn_ctx *ctx,
                                   const char *start,
                                   const char *end,
-                                  h_post_header *header)
+                                  h_header *header)
 {
   const char *current;
   const char *name = start;
@@ -1499,6 +1721,15 @@ do_htreq_post_parse_header_values(grn_ctx *ctx,
           if (STRING_EQUAL(value, value_length, "100-continue")) {
             header->have_100_continue = GRN_TRUE;
           }
+        } else if (STRING_EQUAL_CI(name, name_length, "Transfer-Encoding")) {
+          header->have_transfer_encoding = GRN_TRUE;
+        } else if (STRING_EQUAL_CI(name, name_length, "Connection")) {
+          do_htreq_parse_header_connection(ctx, value, value_length, header);
+        } else if (STRING_EQUAL_CI(name, name_length, "Accept-Encoding")) {
+          do_htreq_parse_header_accept_encoding(ctx,
+                                                value,
+                                                value_length,
+                                                header);
         }
       }
       name = current + 1;
@@ -1521,22 +1752,23 @@ do_htreq_post_parse_header_values(grn_ctx *ctx,
 }
 
 static grn_bool
-do_htreq_post_parse_header(grn_ctx *ctx,
+do_htreq_parse_header(grn_ctx *ctx,
                            const char *start,
                            const char *end,
-                           h_post_header *header)
+                           h_header *header)
 {
   const char *current;
 
-  current = do_htreq_post_parse_header_request_line(ctx, start, end, header);
+  current = do_htreq_parse_header_request_line(ctx, start, end, header);
   if (!current) {
     return GRN_FALSE;
   }
-  current = do_htreq_post_parse_header_values(ctx, current, end, header);
+  current = do_htreq_parse_header_values(ctx, current, end, header);
   if (!current) {
     return GRN_FALSE;
   }
 
+  header->end = current;
   if (current == end) {
     header->body_start = NULL;
   } else {
@@ -1546,34 +1778,142 @@ do_htreq_post_parse_header(grn_ctx *ctx,
   return GRN_TRUE;
 }
 
+static const char *
+h_find_header_end(const char *start, const char *end)
+{
+  const char *current;
+
+  for (current = start; current + 4 <= end; current++) {
+    if (memcmp(current, "\r\n\r\n", 4) == 0) {
+      return current + 4;
+    }
+  }
+  return NULL;
+}
+
+/* The connection must be decided to be kept alive or closed before
+   the response header is sent because the response header has
+   "Connection: close" in the case. */
+static grn_bool
+h_is_keep_alive(ht_context *hc, h_header *header)
+{
+  if (!hc->com) {
+    return GRN_FALSE;
+  }
+  if (grn_gctx.stat == GRN_CTX_QUIT) {
+    return GRN_FALSE;
+  }
+  if (http_max_keep_alive_requests > 0 &&
+      hc->com->n_requests >= http_max_keep_alive_requests) {
+    return GRN_FALSE;
+  }
+  /* We can't find the end of a request body that isn't sent with
+     Content-Length. */
+  if (header->have_transfer_encoding) {
+    return GRN_FALSE;
+  }
+  if (header->have_connection_close) {
+    return GRN_FALSE;
+  }
+  {
+    const char *msg_end = GRN_BULK_CURR((grn_obj *)(hc->msg));
+    const char *request_end = header->end;
+    if (header->body_start && header->content_length > 0) {
+      if (msg_end - header->body_start > header->content_length) {
+        request_end = header->body_start + header->content_length;
+      } else {
+        request_end = msg_end;
+      }
+    }
+    /* The rest of a partial header of the next pipelined request isn't
+       received. See do_htreq_prepare_next(). */
+    if (request_end < msg_end &&
+        !h_find_header_end(request_end, msg_end)) {
+      return GRN_FALSE;
+    }
+  }
+  if (header->is_http_1_1) {
+    return GRN_TRUE;
+  }
+  return header->have_connection_keep_alive;
+}
+
+static void
+do_htreq_get(grn_ctx *ctx, ht_context *hc)
+{
+  grn_msg *msg = hc->msg;
+  char *path = NULL;
+  char *pathe = GRN_BULK_HEAD((grn_obj *)msg);
+  char *e = GRN_BULK_CURR((grn_obj *)msg);
+  for (;; pathe++) {
+    if (e <= pathe + 6) {
+      /* invalid request */
+      return;
+    }
+    if (*pathe == ' ') {
+      if (!path) {
+        path = pathe + 1;
+      } else {
+        if (!memcmp(pathe + 1, "HTTP/1", 6)) {
+          break;
+        }
+      }
+    }
+  }
+  grn_cache_set_accept_content_encodings(ctx, 0);
+  {
+    h_header header;
+    h_header_init(&header);
+    if (do_htreq_parse_header(ctx, GRN_BULK_HEAD((grn_obj *)msg), e, &header)) {
+      grn_cache_set_accept_content_encodings(ctx,
+                                             header.accept_content_encodings);
+      if (hc->com && header.content_length <= 0) {
+        hc->is_keep_alive = h_is_keep_alive(hc, &header);
+        hc->request_end = header.end;
+      }
+    }
+  }
+  grn_ctx_send(ctx, path, pathe - path, GRN_CTX_TAIL);
+}
+
 static void
 do_htreq_post(grn_ctx *ctx, ht_context *hc)
 {
   grn_msg *msg = hc->msg;
-  grn_sock fd = msg->u.fd;
+  grn_sock fd = hc->fd;
   const char *end;
-  h_post_header header;
+  const char *request_end;
+  h_header header;
 
-  header.path_start = NULL;
-  header.path_length = -1;
-  header.content_length = -1;
-  header.body_start = NULL;
-  header.have_100_continue = GRN_FALSE;
+  h_header_init(&header);
 
   end = GRN_BULK_CURR((grn_obj *)msg);
-  if (!do_htreq_post_parse_header(ctx,
-                                  GRN_BULK_HEAD((grn_obj *)msg),
-                                  end,
-                                  &header)) {
+  if (!do_htreq_parse_header(ctx,
+                             GRN_BULK_HEAD((grn_obj *)msg),
+                             end,
+                             &header)) {
     return;
   }
+  if (!STRING_EQUAL_CI(header.method_start, header.method_length, "POST")) {
+    return;
+  }
+  if (header.content_length >= 0) {
+    hc->is_keep_alive = h_is_keep_alive(hc, &header);
+  }
+  request_end = header.end;
 
+  grn_cache_set_accept_content_encodings(ctx, header.accept_content_encodings);
   grn_ctx_send(ctx, header.path_start, header.path_length, GRN_CTX_MORE);
   if (ctx->rc != GRN_SUCCESS) {
     ht_context context;
     context.msg = msg;
+    context.com = hc->com;
+    context.fd = fd;
     context.in_body = GRN_FALSE;
     context.is_chunked = GRN_FALSE;
+    context.is_keep_alive = GRN_FALSE;
+    context.request_end = NULL;
+    hc->is_keep_alive = GRN_FALSE;
     h_output(ctx, GRN_CTX_TAIL, &context);
     return;
   }
@@ -1603,11 +1943,21 @@ do_htreq_post(grn_ctx *ctx, ht_context *hc)
       if (header.body_start) {
         buffer_start = header.body_start;
         buffer_end = end;
+        /* The rest may be the next pipelined request. */
+        if (buffer_end - buffer_start > header.content_length) {
+          buffer_end = buffer_start + header.content_length;
+        }
+        request_end = buffer_end;
         header.body_start = NULL;
       } else {
         ssize_t recv_length;
         int recv_flags = 0;
-        recv_length = recv(fd, buffer, POST_BUFFER_SIZE, recv_flags);
+        size_t recv_size = POST_BUFFER_SIZE;
+        if (header.content_length - read_content_length <
+            (long long int)recv_size) {
+          recv_size = header.content_length - read_content_length;
+        }
+        recv_length = recv(fd, buffer, recv_size, recv_flags);
         if (recv_length == 0) {
           break;
         }
@@ -1669,6 +2019,14 @@ do_htreq_post(grn_ctx *ctx, ht_context *hc)
       }
     }
 
+    /* This is decided before the last part is sent because the
+       response header may be sent with it. */
+    if (read_content_length == header.content_length) {
+      hc->request_end = request_end;
+    } else {
+      hc->is_keep_alive = GRN_FALSE;
+    }
+
     if (ctx->rc == GRN_SUCCESS && GRN_TEXT_LEN(&chunk_buffer) > 0) {
       grn_ctx_send(ctx,
                    GRN_TEXT_VALUE(&chunk_buffer),
@@ -1682,25 +2040,87 @@ do_htreq_post(grn_ctx *ctx, ht_context *hc)
   }
 }
 
+/* Moves the next pipelined request to the head of msg. Returns
+   GRN_FALSE when there is no buffered request. The connection is
+   returned to the event loop to wait for the next request in the case.
+
+   The next request is processed only when its header is already in
+   msg. This doesn't receive the rest of a partial header because a
+   worker must not wait for a slow client. The connection isn't kept
+   alive in the case. The client resends the request that isn't
+   responded to a new connection. */
+static grn_bool
+do_htreq_prepare_next(grn_ctx *ctx, ht_context *hc)
+{
+  grn_obj *msg = (grn_obj *)(hc->msg);
+  size_t rest_size;
+
+  if (!hc->is_keep_alive || !hc->request_end) {
+    return GRN_FALSE;
+  }
+
+  rest_size = GRN_BULK_CURR(msg) - hc->request_end;
+  if (rest_size == 0) {
+    return GRN_FALSE;
+  }
+  if (!h_find_header_end(hc->request_end, GRN_BULK_CURR(msg))) {
+    hc->is_keep_alive = GRN_FALSE;
+    return GRN_FALSE;
+  }
+  memmove(GRN_BULK_HEAD(msg), hc->request_end, rest_size);
+  GRN_BULK_REWIND(msg);
+  GRN_BULK_INCR_LEN(msg, rest_size);
+  hc->msg->header.qtype = *GRN_BULK_HEAD(msg);
+
+  return GRN_TRUE;
+}
+
 static void
 do_htreq(grn_ctx *ctx, ht_context *hc)
 {
   grn_msg *msg = hc->msg;
   grn_com_header *header = &msg->header;
-  switch (header->qtype) {
-  case 'G' : /* GET */
-  case 'H' : /* HEAD */
-    do_htreq_get(ctx, hc);
-    break;
-  case 'P' : /* POST */
-    do_htreq_post(ctx, hc);
-    break;
-  }
+  grn_com *acceptor = msg->acceptor;
+  do {
+    if (ctx->rc == GRN_CANCEL) {
+      ctx->rc = GRN_SUCCESS;
+    }
+    hc->in_body = GRN_FALSE;
+    hc->is_chunked = GRN_FALSE;
+    hc->is_keep_alive = GRN_FALSE;
+    hc->request_end = NULL;
+    if (hc->com) {
+      hc->com->n_requests++;
+    }
+    switch (header->qtype) {
+    case 'G' : /* GET */
+    case 'H' : /* HEAD */
+      do_htreq_get(ctx, hc);
+      break;
+    case 'P' : /* POST */
+      do_htreq_post(ctx, hc);
+      break;
+    }
+  } while (do_htreq_prepare_next(ctx, hc));
   /* if (ctx->rc != GRN_OPERATION_WOULD_BLOCK) {...} */
   grn_msg_close(ctx, (grn_obj *)msg);
-  /* if not keep alive connection */
-  grn_sock_close(msg->u.fd);
-  grn_com_event_start_accept(ctx, msg->acceptor->ev);
+  if (hc->com) {
+    grn_timeval tv;
+    if (!hc->is_keep_alive) {
+      /* The event loop closes the connection when it detects this. */
+      shutdown(hc->fd, SHUT_RDWR);
+    }
+    grn_timeval_now(ctx, &tv);
+    /* The event loop thread may close the connection after this. */
+    CRITICAL_SECTION_ENTER(http_connections_critical_section);
+    hc->com->last_active_time_msec = GRN_TIMEVAL_TO_MSEC(&tv);
+    grn_com_event_set_events(ctx, hc->com, GRN_COM_POLLIN);
+    CRITICAL_SECTION_LEAVE(http_connections_critical_section);
+  } else {
+    /* if not keep alive connection */
+    grn_sock_close(hc->fd);
+    grn_com_event_start_accept(ctx, acceptor->ev);
+  }
 }
 
 enum {
@@ -2430,53 +2850,390 @@ check_rlimit_nofile(grn_ctx *ctx)
 #endif /* WIN32 */
 }
 
+/* HTTP worker pool */
+
+/*
+ * Each HTTP worker has its own request queue. The event loop thread
+ * pushes a request to an idle worker if any. If all workers are busy,
+ * it pushes the request to a worker in round robin. A worker that
+ * finishes its queue steals requests from other workers' queues before
+ * it sleeps. So workers don't contend on one lock for each request.
+ *
+ * Workers are spawned when the server starts. The total number of
+ * running threads is still counted by n_running_threads under
+ * q_critical_section for thread_limit.
+ */
+
+#define MAX_N_HTTP_WORKERS 1024
+
+typedef struct {
+  uint32_t id;
+  grn_ctx ctx;
+  grn_obj *db;
+  grn_com_queue queue;
+  grn_critical_section critical_section;
+  grn_cond cond;
+  /* The following members are protected by critical_section. */
+  grn_bool is_running;
+  grn_bool is_waiting;
+} http_worker;
+
+static http_worker *http_workers[MAX_N_HTTP_WORKERS];
+static uint32_t n_http_workers = 0;
+static uint32_t next_http_worker_id = 0;
+static grn_bool use_http_worker_cpu_affinity = GRN_FALSE;
+
+static uint32_t get_core_number(void);
+
+static void
+http_worker_set_cpu_affinity(grn_ctx *ctx, http_worker *worker)
+{
+#if defined(__linux__) && defined(CPU_SET)
+  uint32_t n_cores;
+  cpu_set_t cpu_set;
+
+  if (!use_http_worker_cpu_affinity) {
+    return;
+  }
+
+  n_cores = get_core_number();
+  if (n_cores == 0) {
+    return;
+  }
+  CPU_ZERO(&cpu_set);
+  CPU_SET(worker->id % n_cores, &cpu_set);
+  if (sched_setaffinity(0, sizeof(cpu_set_t), &cpu_set) == -1) {
+    GRN_LOG(ctx, GRN_LOG_WARNING,
+            "[http][worker][%u] failed to set CPU affinity: %s",
+            worker->id, strerror(errno));
+  }
+#endif /* defined(__linux__) && defined(CPU_SET) */
+}
+
+/* If only_waiting is GRN_TRUE, msg is pushed only when the worker is
+   waiting for a request. */
+static grn_bool
+http_worker_push(grn_ctx *ctx,
+                 http_worker *worker,
+                 grn_obj *msg,
+                 grn_bool only_waiting)
+{
+  grn_bool pushed = GRN_FALSE;
+
+  CRITICAL_SECTION_ENTER(worker->critical_section);
+  if (worker->is_running && (!only_waiting || worker->is_waiting)) {
+    grn_com_queue_enque(ctx, &(worker->queue), (grn_com_queue_entry *)msg);
+    if (worker->is_waiting) {
+      worker->is_waiting = GRN_FALSE;
+      COND_SIGNAL(worker->cond);
+    }
+    pushed = GRN_TRUE;
+  }
+  CRITICAL_SECTION_LEAVE(worker->critical_section);
+
+  return pushed;
+}
+
+static grn_obj *
+http_worker_take(grn_ctx *ctx, http_worker *worker)
+{
+  grn_obj *msg;
+  uint32_t i;
+  uint32_t n_workers;
+
+  msg = (grn_obj *)grn_com_queue_deque(ctx, &(worker->queue));
+  if (msg) {
+    return msg;
+  }
+
+  n_workers = n_http_workers;
+  for (i = 1; i < n_workers; i++) {
+    http_worker *victim = http_workers[(worker->id + i) % n_workers];
+    if (!victim) {
+      continue;
+    }
+    CRITICAL_SECTION_ENTER(victim->critical_section);
+    msg = (grn_obj *)grn_com_queue_deque(ctx, &(victim->queue));
+    CRITICAL_SECTION_LEAVE(victim->critical_section);
+    if (msg) {
+      return msg;
+    }
+  }
+
+  return NULL;
+}
+
+/*
+ * Returns GRN_FALSE when the worker exits. The decision to exit and
+ * the decrement of n_running_threads are done in the same critical
+ * section. Otherwise other workers that are woken up at the same time
+ * see the old n_running_threads and exit too. The worker must not be
+ * used after this returns GRN_FALSE because it may be reused by a new
+ * thread.
+ */
+static grn_bool
+http_worker_wait(grn_ctx *ctx, http_worker *worker)
+{
+  if (grn_gctx.stat == GRN_CTX_QUIT ||
+      n_running_threads > max_n_floating_threads) {
+    grn_bool should_exit = GRN_FALSE;
+    CRITICAL_SECTION_ENTER(q_critical_section);
+    if (grn_gctx.stat == GRN_CTX_QUIT ||
+        n_running_threads > max_n_floating_threads) {
+      CRITICAL_SECTION_ENTER(worker->critical_section);
+      if (!worker->queue.next) {
+        worker->is_running = GRN_FALSE;
+        should_exit = GRN_TRUE;
+      }
+      CRITICAL_SECTION_LEAVE(worker->critical_section);
+    }
+    if (should_exit) {
+      n_running_threads--;
+      GRN_LOG(ctx, GRN_LOG_NOTICE, "thread end (%u/%u)",
+              worker->id, n_running_threads);
+      if (grn_gctx.stat == GRN_CTX_QUIT && running_event_loop) {
+        break_accept_event_loop(ctx);
+      }
+    }
+    CRITICAL_SECTION_LEAVE(q_critical_section);
+    if (should_exit) {
+      return GRN_FALSE;
+    }
+  }
+
+  CRITICAL_SECTION_ENTER(worker->critical_section);
+  if (!worker->queue.next) {
+    worker->is_waiting = GRN_TRUE;
+    COND_WAIT(worker->cond, worker->critical_section);
+    worker->is_waiting = GRN_FALSE;
+  }
+  CRITICAL_SECTION_LEAVE(worker->critical_section);
+
+  return GRN_TRUE;
+}
+
 static grn_thread_func_result CALLBACK
-h_worker(void *arg)
+http_worker_run(void *arg)
 {
+  http_worker *worker = arg;
+  grn_ctx *ctx = &(worker->ctx);
   ht_context hc;
-  grn_ctx ctx_, *ctx = &ctx_;
-  grn_ctx_init(ctx, 0);
-  grn_ctx_use(ctx, (grn_obj *)arg);
+
+  http_worker_set_cpu_affinity(ctx, worker);
   grn_ctx_recv_handler_set(ctx, h_output, &hc);
-  CRITICAL_SECTION_ENTER(q_critical_section);
   GRN_LOG(ctx, GRN_LOG_NOTICE, "thread start (%u/%u)",
-          n_floating_threads, n_running_threads);
-  while (n_running_threads <= max_n_floating_threads &&
-         grn_gctx.stat != GRN_CTX_QUIT) {
+          worker->id, n_running_threads);
+  while (GRN_TRUE) {
     grn_obj *msg;
+    msg = http_worker_take(ctx, worker);
+    if (!msg) {
+      if (!http_worker_wait(ctx, worker)) {
+        break;
+      }
+      continue;
+    }
     if (ctx->rc == GRN_CANCEL) {
       ctx->rc = GRN_SUCCESS;
     }
-    n_floating_threads++;
-    while (!(msg = (grn_obj *)grn_com_queue_deque(&grn_gctx, &ctx_new))) {
-      COND_WAIT(q_cond, q_critical_section);
-      if (grn_gctx.stat == GRN_CTX_QUIT) {
-        n_floating_threads--;
-        goto exit;
-      }
-      if (n_running_threads > max_n_floating_threads) {
-        n_floating_threads--;
-        goto exit;
-      }
-    }
-    n_floating_threads--;
-    CRITICAL_SECTION_LEAVE(q_critical_section);
     hc.msg = (grn_msg *)msg;
-    hc.in_body = GRN_FALSE;
-    hc.is_chunked = GRN_FALSE;
+    if (is_http_keep_alive_enabled) {
+      hc.com = hc.msg->u.peer;
+      hc.fd = hc.com->fd;
+    } else {
+      hc.com = NULL;
+      hc.fd = hc.msg->u.fd;
+    }
     do_htreq(ctx, &hc);
-    CRITICAL_SECTION_ENTER(q_critical_section);
   }
-exit :
-  n_running_threads--;
-  GRN_LOG(ctx, GRN_LOG_NOTICE, "thread end (%u/%u)",
-          n_floating_threads, n_running_threads);
-  if (grn_gctx.stat == GRN_CTX_QUIT && running_event_loop) {
-    break_accept_event_loop(ctx);
+  return GRN_THREAD_FUNC_RETURN_VALUE;
+}
+
+static http_worker *
+http_worker_open(grn_ctx *ctx, uint32_t id, grn_obj *db)
+{
+  http_worker *worker;
+
+  worker = GRN_MALLOC(sizeof(http_worker));
+  if (!worker) {
+    return NULL;
+  }
+  worker->id = id;
+  grn_ctx_init(&(worker->ctx), 0);
+  grn_ctx_use(&(worker->ctx), db);
+  worker->db = db;
+  GRN_COM_QUEUE_INIT(&(worker->queue));
+  CRITICAL_SECTION_INIT(worker->critical_section);
+  COND_INIT(worker->cond);
+  worker->is_running = GRN_FALSE;
+  worker->is_waiting = GRN_FALSE;
+  return worker;
+}
+
+static void
+http_worker_close(grn_ctx *ctx, http_worker *worker)
+{
+  grn_obj *msg;
+
+  while ((msg = (grn_obj *)grn_com_queue_deque(ctx, &(worker->queue)))) {
+    grn_msg_close(ctx, msg);
+  }
+  CRITICAL_SECTION_FIN(worker->queue.cs);
+  COND_FIN(worker->cond);
+  CRITICAL_SECTION_FIN(worker->critical_section);
+  grn_ctx_fin(&(worker->ctx));
+  GRN_FREE(worker);
+}
+
+/* This must be called by the event loop thread. */
+static http_worker *
+http_workers_spawn(grn_ctx *ctx, grn_obj *db)
+{
+  http_worker *worker = NULL;
+  uint32_t i;
+
+  CRITICAL_SECTION_ENTER(q_critical_section);
+  if (n_running_threads < max_n_floating_threads) {
+    for (i = 0; i < MAX_N_HTTP_WORKERS; i++) {
+      http_worker *candidate;
+      if (i == n_http_workers) {
+        candidate = http_worker_open(ctx, i, db);
+        if (!candidate) {
+          break;
+        }
+        http_workers[i] = candidate;
+        n_http_workers++;
+      } else {
+        candidate = http_workers[i];
+      }
+      CRITICAL_SECTION_ENTER(candidate->critical_section);
+      if (!candidate->is_running) {
+        candidate->is_running = GRN_TRUE;
+        worker = candidate;
+      }
+      CRITICAL_SECTION_LEAVE(candidate->critical_section);
+      if (worker) {
+        break;
+      }
+    }
+    if (worker) {
+      grn_thread thread;
+      n_running_threads++;
+      if (THREAD_CREATE(thread, http_worker_run, worker)) {
+        n_running_threads--;
+        CRITICAL_SECTION_ENTER(worker->critical_section);
+        worker->is_running = GRN_FALSE;
+        CRITICAL_SECTION_LEAVE(worker->critical_section);
+        worker = NULL;
+        SERR("pthread_create");
+      }
+    }
   }
-  grn_ctx_fin(ctx);
   CRITICAL_SECTION_LEAVE(q_critical_section);
-  return GRN_THREAD_FUNC_RETURN_VALUE;
+
+  return worker;
+}
+
+static void
+http_workers_start(grn_ctx *ctx, grn_obj *db)
+{
+  use_http_workers = GRN_TRUE;
+  while (n_running_threads < max_n_floating_threads) {
+    if (!http_workers_spawn(ctx, db)) {
+      break;
+    }
+  }
+}
+
+static void
+http_workers_wake_up(void)
+{
+  uint32_t i;
+
+  for (i = 0; i < n_http_workers; i++) {
+    http_worker *worker = http_workers[i];
+    if (!worker) {
+      continue;
+    }
+    CRITICAL_SECTION_ENTER(worker->critical_section);
+    if (worker->is_waiting) {
+      worker->is_waiting = GRN_FALSE;
+      COND_SIGNAL(worker->cond);
+    }
+    CRITICAL_SECTION_LEAVE(worker->critical_section);
+  }
+}
+
+static void
+http_workers_wake_up_one(void)
+{
+  uint32_t i;
+
+  for (i = 0; i < n_http_workers; i++) {
+    http_worker *worker = http_workers[i];
+    grn_bool woke_up = GRN_FALSE;
+    if (!worker) {
+      continue;
+    }
+    CRITICAL_SECTION_ENTER(worker->critical_section);
+    if (worker->is_waiting) {
+      worker->is_waiting = GRN_FALSE;
+      COND_SIGNAL(worker->cond);
+      woke_up = GRN_TRUE;
+    }
+    CRITICAL_SECTION_LEAVE(worker->critical_section);
+    if (woke_up) {
+      break;
+    }
+  }
+}
+
+static void
+http_workers_fin(grn_ctx *ctx)
+{
+  uint32_t i;
+
+  for (i = 0; i < n_http_workers; i++) {
+    http_worker_close(ctx, http_workers[i]);
+    http_workers[i] = NULL;
+  }
+  n_http_workers = 0;
+}
+
+/* This must be called by the event loop thread. */
+static grn_bool
+http_workers_dispatch(grn_ctx *ctx, grn_obj *msg, grn_obj *db)
+{
+  uint32_t i;
+  uint32_t n_workers = n_http_workers;
+
+  for (i = 0; i < n_workers; i++) {
+    http_worker *worker =
+      http_workers[(next_http_worker_id + i) % n_workers];
+    if (http_worker_push(ctx, worker, msg, GRN_TRUE)) {
+      next_http_worker_id += i + 1;
+      return GRN_TRUE;
+    }
+  }
+
+  if (n_running_threads < max_n_floating_threads) {
+    http_worker *worker = http_workers_spawn(ctx, db);
+    if (worker && http_worker_push(ctx, worker, msg, GRN_FALSE)) {
+      return GRN_TRUE;
+    }
+    n_workers = n_http_workers;
+  }
+
+  /* All workers are busy. A worker that finishes first steals this. */
+  for (i = 0; i < n_workers; i++) {
+    http_worker *worker = http_workers[next_http_worker_id++ % n_workers];
+    if (http_worker_push(ctx, worker, msg, GRN_FALSE)) {
+      /* A worker may have started waiting after the above check. */
+      http_workers_wake_up_one();
+      return GRN_TRUE;
+    }
+  }
+
+  return GRN_FALSE;
 }
 
 static void
@@ -2486,24 +3243,34 @@ h_handler(grn_ctx *ctx, grn_obj *msg)
   if (ctx->rc) {
     grn_com_close(ctx, com);
     grn_msg_close(ctx, msg);
+  } else if (is_http_keep_alive_enabled && GRN_BULK_VSIZE(msg) == 0) {
+    /* The client closed the connection or a worker shut it down. */
+    grn_com_close(ctx, com);
+    grn_msg_close(ctx, msg);
   } else {
+    grn_obj *db = com->ev->opaque;
     grn_sock fd = com->fd;
-    void *arg = com->ev->opaque;
-    /* if not keep alive connection */
-    grn_com_event_del(ctx, com->ev, fd);
-    ((grn_msg *)msg)->u.fd = fd;
-    CRITICAL_SECTION_ENTER(q_critical_section);
-    grn_com_queue_enque(ctx, &ctx_new, (grn_com_queue_entry *)msg);
-    if (n_floating_threads == 0 && n_running_threads < max_n_floating_threads) {
-      grn_thread thread;
-      n_running_threads++;
-      if (THREAD_CREATE(thread, h_worker, arg)) {
-        n_running_threads--;
-        SERR("pthread_create");
+    if (is_http_keep_alive_enabled) {
+      /* The worker polls the connection again after it sends the
+         response. */
+      com->last_active_time_msec = 0;
+      grn_com_event_set_events(ctx, com, 0);
+    } else {
+      /* if not keep alive connection */
+      grn_com_event_del(ctx, com->ev, fd);
+      ((grn_msg *)msg)->u.fd = fd;
+    }
+    if (!http_workers_dispatch(ctx, msg, db)) {
+      GRN_LOG(ctx, GRN_LOG_ERROR,
+              "[http] no worker to process a request: %" GRN_FMT_SOCKET,
+              fd);
+      grn_msg_close(ctx, msg);
+      if (is_http_keep_alive_enabled) {
+        grn_com_close(ctx, com);
+      } else {
+        grn_sock_close(fd);
       }
     }
-    COND_SIGNAL(q_cond);
-    CRITICAL_SECTION_LEAVE(q_critical_section);
   }
 }
 
@@ -2516,6 +3283,7 @@ h_server(char *path)
   GRN_COM_QUEUE_INIT(&ctx_new);
   GRN_COM_QUEUE_INIT(&ctx_old);
   check_rlimit_nofile(ctx);
+  is_http_keep_alive_enabled = (http_keep_alive_timeout > 0);
   GRN_TEXT_INIT(&http_response_server_line, 0);
   grn_text_printf(ctx,
                   &http_response_server_line,
@@ -2715,6 +3483,7 @@ enum {
 #define FLAG_MODE_SERVER     (1 << 7)
 #define FLAG_NEW_DB     (1 << 8)
 #define FLAG_USE_WINDOWS_EVENT_LOG (1 << 9)
+#define FLAG_HTTP_WORKER_CPU_AFFINITY (1 << 10)
 
 static uint32_t
 get_core_number(void)
@@ -3182,6 +3951,19 @@ show_usage(FILE *output)
           "                                (default: none; disabled)\n"
           "      --listen-backlog <backlog>: specify the backlog for listen(2)\n"
           "                                (default: %d)\n"
+          "      --http-keep-alive-timeout <timeout>:\n"
+          "                                specify the timeout in seconds to close\n"
+          "                                idle keep-alive connections (http only)\n"
+          "                                0 disables keep-alive\n"
+          "                                (default: %f)\n"
+          "      --http-max-keep-alive-requests <n>:\n"
+          "                                specify max number of requests\n"
+          "                                per keep-alive connection (http only)\n"
+          "                                0 means unlimited\n"
+          "                                (default: %d)\n"
+          "      --http-worker-cpu-affinity:\n"
+          "                                pin each HTTP worker thread to a CPU\n"
+          "                                (Linux only)\n"
           "\n"
           "Memcached options:\n"
           "      --memcached-column <column>:\n"
@@ -3256,6 +4038,8 @@ show_usage(FILE *output)
           default_document_root, default_cache_limit, default_max_n_threads,
           default_default_request_timeout,
           listen_backlog,
+          DEFAULT_HTTP_KEEP_ALIVE_TIMEOUT,
+          DEFAULT_HTTP_MAX_KEEP_ALIVE_REQUESTS,
           grn_log_level_to_string(default_log_level),
           "time|message", /* TODO: Generate from GRN_LOG_DEFAULT */
           default_log_path, default_query_log_path,
@@ -3290,6 +4074,8 @@ main(int argc, char **argv)
   const char *cache_base_path = NULL;
   const char *listen_backlog_arg = NULL;
   const char *log_flags_arg = NULL;
+  const char *http_keep_alive_timeout_arg = NULL;
+  const char *http_max_keep_alive_requests_arg = NULL;
   int exit_code = EXIT_SUCCESS;
   int i;
   int flags = 0;
@@ -3334,6 +4120,10 @@ main(int argc, char **argv)
     {'\0', "cache-base-path", NULL, 0, GETOPT_OP_NONE},
     {'\0', "listen-backlog", NULL, 0, GETOPT_OP_NONE},
     {'\0', "log-flags", NULL, 0, GETOPT_OP_NONE},
+    {'\0', "http-keep-alive-timeout", NULL, 0, GETOPT_OP_NONE},
+    {'\0', "http-max-keep-alive-requests", NULL, 0, GETOPT_OP_NONE},
+    {'\0', "http-worker-cpu-affinity", NULL,
+     FLAG_HTTP_WORKER_CPU_AFFINITY, GETOPT_OP_ON},
     {'\0', NULL, NULL, 0, 0}
   };
   opts[0].arg = &port_arg;
@@ -3362,6 +4152,8 @@ main(int argc, char **argv)
   opts[31].arg = &cache_base_path;
   opts[32].arg = &listen_backlog_arg;
   opts[33].arg = &log_flags_arg;
+  opts[34].arg = &http_keep_alive_timeout_arg;
+  opts[35].arg = &http_max_keep_alive_requests_arg;
 
   reset_ready_notify_pipe();
 
@@ -3516,6 +4308,10 @@ main(int argc, char **argv)
     do_server = g_server;
   }
 
+  if (flags & FLAG_HTTP_WORKER_CPU_AFFINITY) {
+    use_http_worker_cpu_affinity = GRN_TRUE;
+  }
+
 #ifdef WIN32
   if (flags & FLAG_USE_WINDOWS_EVENT_LOG) {
     use_windows_event_log = GRN_TRUE;
@@ -3737,6 +4533,35 @@ main(int argc, char **argv)
     listen_backlog = value;
   }
 
+  if (http_keep_alive_timeout_arg) {
+    const char * const end =
+      http_keep_alive_timeout_arg + strlen(http_keep_alive_timeout_arg);
+    char *rest = NULL;
+    double value;
+    value = strtod(http_keep_alive_timeout_arg, &rest);
+    if (end != rest || value < 0) {
+      fprintf(stderr, "invalid HTTP keep-alive timeout: <%s>\n",
+              http_keep_alive_timeout_arg);
+      return EXIT_FAILURE;
+    }
+    http_keep_alive_timeout = value;
+  }
+
+  if (http_max_keep_alive_requests_arg) {
+    const char * const end =
+      http_max_keep_alive_requests_arg +
+      strlen(http_max_keep_alive_requests_arg);
+    const char *rest = NULL;
+    int value;
+    value = grn_atoi(http_max_keep_alive_requests_arg, end, &rest);
+    if (rest != end || value < 0) {
+      fprintf(stderr, "invalid HTTP max keep-alive requests: <%s>\n",
+              http_max_keep_alive_requests_arg);
+      return EXIT_FAILURE;
+    }
+    http_max_keep_alive_requests = value;
+  }
+
   grn_gctx.errbuf[0] = '\0';
   if (grn_init()) {
     fprintf(stderr, "failed to initialize Groonga: %s\n", grn_gctx.errbuf);
@@ -3769,6 +4594,7 @@ main(int argc, char **argv)
 
   CRITICAL_SECTION_INIT(q_critical_section);
   COND_INIT(q_cond);
+  CRITICAL_SECTION_INIT(http_connections_critical_section);
 
   if (input_path) {
     input_reader = grn_file_reader_open(&grn_gctx, input_path);
@@ -3833,6 +4659,7 @@ main(int argc, char **argv)
     exit_code = do_alone(argc - i, argv + i);
   }
 
+  CRITICAL_SECTION_FIN(http_connections_critical_section);
   COND_FIN(q_cond);
   CRITICAL_SECTION_FIN(q_critical_section);
 
@@ -1,8 +1,11 @@
 require "fileutils"
 require "json"
+require "net/http"
 require "shellwords"
+require "socket"
 require "tempfile"
 require "time"
+require "zlib"
 
 require "test-unit"
 
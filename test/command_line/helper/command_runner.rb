@@ -79,9 +79,46 @@ module CommandRunner
     command_line << "-n" unless @database_path.exist?
     command_line << @database_path.to_s
     command_line.concat(groonga_command_line)
+    if options and options[:env]
+      command_line.unshift(options[:env])
+    end
     run_command(*command_line, &block)
   end
 
+  def groonga_http_server(options={})
+    port = find_available_port
+    command_line = [
+      groonga_path,
+      "--log-path", @log_path.to_s,
+      "--query-log-path", @query_log_path.to_s,
+      "--protocol", "http",
+      "--bind-address", "127.0.0.1",
+      "--port", port.to_s,
+    ]
+    more_command_line = options[:command_line]
+    command_line.concat(more_command_line) if more_command_line
+    command_line << "-s"
+    command_line << "-n" unless @database_path.exist?
+    command_line << @database_path.to_s
+    env = options[:env] || {}
+    spawn_options = {
+      :out => @output_log_path.to_s,
+      :err => @error_output_log_path.to_s,
+    }
+    pid = spawn(env, *command_line, spawn_options)
+    begin
+      wait_http_server(port)
+      yield(port)
+    ensure
+      begin
+        Net::HTTP.get(URI("http://127.0.0.1:#{port}/d/shutdown"))
+      rescue SystemCallError, IOError
+        Process.kill(:KILL, pid)
+      end
+      Process.waitpid(pid)
+    end
+  end
+
   def groonga_select(*select_arguments)
     result = groonga("select", *select_arguments)
     select_result = JSON.parse(result.output)
@@ -145,6 +182,29 @@ module CommandRunner
   end
 
   private
+  def find_available_port
+    server = TCPServer.new("127.0.0.1", 0)
+    begin
+      server.addr[1]
+    ensure
+      server.close
+    end
+  end
+
+  def wait_http_server(port)
+    timeout = 10
+    start = Time.now
+    loop do
+      begin
+        TCPSocket.new("127.0.0.1", port).close
+        return
+      rescue SystemCallError
+        raise if Time.now - start > timeout
+        sleep(0.1)
+      end
+    end
+  end
+
   def run_command_interactive(*command_line)
     IO.pipe do |input_read, input_write|
       IO.pipe do |output_read, output_write|
@@ -0,0 +1,72 @@
+# Copyright(C) 2019 Kouhei Sutou <kou@clear-code.com>
+#
+# This library is free software; you can redistribute it and/or
+# modify it under the terms of the GNU Lesser General Public
+# License version 2.1 as published by the Free Software Foundation.
+#
+# This library is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+# Lesser General Public License for more details.
+#
+# You should have received a copy of the GNU Lesser General Public
+# License along with this library; if not, write to the Free Software
+# Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+class TestGroongaCacheCompression < GroongaTestCase
+  def setup
+    groonga("table_create", "Memos", "TABLE_NO_KEY")
+    groonga("column_create", "Memos", "content", "COLUMN_SCALAR", "Text")
+    values = 20.times.collect do |i|
+      {"content" => "Groonga is a fast full text search engine. (#{i})"}
+    end
+    groonga do |process|
+      process.run_command(<<-COMMAND)
+load --table Memos
+#{values.to_json}
+      COMMAND
+    end
+    # Cache entries that are stored in the same second as the last
+    # modification are expired.
+    sleep(1)
+  end
+
+  def features
+    @features ||= begin
+      version = run_command(groonga_path, "--version").output
+      version[/\[(.+?)\]/, 1].split(",")
+    end
+  end
+
+  def select_and_cache_size(env={})
+    groonga(env: env) do |process|
+      responses = 2.times.collect do
+        JSON.parse(process.run_command("select Memos --limit -1"))[1]
+      end
+      status = JSON.parse(process.run_command("status"))[1]
+      return responses, status["cache"]
+    end
+  end
+
+  data("zlib" => "zlib",
+       "lz4"  => "lz4",
+       "zstd" => "zstd")
+  test("compressed") do |compression|
+    unless features.include?(compression)
+      omit("#{compression} isn't available")
+    end
+    raw_responses, raw_cache = select_and_cache_size
+    responses, cache = select_and_cache_size("GRN_CACHE_COMPRESSION" =>
+                                               compression)
+    assert_equal([
+                   raw_responses,
+                   1,
+                   true,
+                 ],
+                 [
+                   responses,
+                   cache["n_entries"],
+                   cache["size"] < raw_cache["size"],
+                 ])
+  end
+end
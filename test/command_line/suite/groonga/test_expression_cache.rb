@@ -0,0 +1,52 @@
+# Copyright(C) 2019 Kouhei Sutou <kou@clear-code.com>
+#
+# This library is free software; you can redistribute it and/or
+# modify it under the terms of the GNU Lesser General Public
+# License version 2.1 as published by the Free Software Foundation.
+#
+# This library is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+# Lesser General Public License for more details.
+#
+# You should have received a copy of the GNU Lesser General Public
+# License along with this library; if not, write to the Free Software
+# Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+class TestGroongaExpressionCache < GroongaTestCase
+  def setup
+    groonga("table_create", "Items", "TABLE_NO_KEY")
+    groonga("column_create", "Items", "price", "COLUMN_SCALAR", "UInt32")
+    groonga("column_create", "Items", "other", "COLUMN_SCALAR", "UInt32")
+    groonga do |process|
+      process.run_command(<<-COMMAND)
+load --table Items
+[
+{"price": 1, "other": 10},
+{"price": 2, "other": 20},
+{"price": 3, "other": 30}
+]
+      COMMAND
+    end
+  end
+
+  test("rename by another process") do
+    select = [
+      "select Items",
+      "--filter 'price > 1'",
+      "--output_columns price,other",
+      "--cache no",
+    ].join(" ")
+    groonga do |external_process|
+      assert_equal([[2], [["price", "UInt32"], ["other", "UInt32"]],
+                    [2, 20], [3, 30]],
+                   JSON.parse(external_process.run_command(select))[1][0])
+      groonga("column_rename", "Items", "price", "tmp")
+      groonga("column_rename", "Items", "other", "price")
+      groonga("column_rename", "Items", "tmp", "other")
+      assert_equal([[3], [["price", "UInt32"], ["other", "UInt32"]],
+                    [10, 1], [20, 2], [30, 3]],
+                   JSON.parse(external_process.run_command(select))[1][0])
+    end
+  end
+end
@@ -0,0 +1,314 @@
+# Copyright(C) 2019 Kouhei Sutou <kou@clear-code.com>
+#
+# This library is free software; you can redistribute it and/or
+# modify it under the terms of the GNU Lesser General Public
+# License version 2.1 as published by the Free Software Foundation.
+#
+# This library is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+# Lesser General Public License for more details.
+#
+# You should have received a copy of the GNU Lesser General Public
+# License along with this library; if not, write to the Free Software
+# Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+class TestGroongaHTTP < GroongaTestCase
+  sub_test_case("cache: Content-Encoding") do
+    def setup
+      groonga("table_create", "Memos", "TABLE_NO_KEY")
+      groonga("column_create", "Memos", "content", "COLUMN_SCALAR", "Text")
+      groonga do |process|
+        process.run_command(<<-COMMAND)
+load --table Memos
+[
+{"content": "Groonga is a fast and accurate full text search engine based on inverted index."},
+{"content": "Mroonga is a storage engine for MySQL. It provides fast fulltext search feature."},
+{"content": "PGroonga is an extension for PostgreSQL. It uses Groonga as index."},
+{"content": "Rroonga is the Ruby bindings of Groonga."}
+]
+        COMMAND
+      end
+      # Cache entries that are stored in the same second as the last
+      # modification are expired.
+      sleep(1)
+    end
+
+    def get(port, accept_encoding=nil)
+      http = Net::HTTP.new("127.0.0.1", port)
+      request = Net::HTTP::Get.new("/d/select?table=Memos")
+      request["Accept-Encoding"] = accept_encoding if accept_encoding
+      http.request(request)
+    end
+
+    def groonga_http_server(&block)
+      super(env: {"GRN_CACHE_COMPRESSION" => "zlib"}, &block)
+    end
+
+    def decode_body(body)
+      JSON.parse(body)[1]
+    end
+
+    def n_cache_hits
+      File.readlines(@query_log_path).grep(/\|:\d+ cache\(\d+\)$/).size
+    end
+
+    test("gzip") do
+      groonga_http_server do |port|
+        expected = get(port)
+        response = get(port, "gzip")
+        assert_equal([
+                       "gzip",
+                       decode_body(expected.body),
+                     ],
+                     [
+                       response["Content-Encoding"],
+                       decode_body(Zlib.gunzip(response.body)),
+                     ])
+      end
+      assert_equal(1, n_cache_hits)
+    end
+
+    test("deflate") do
+      groonga_http_server do |port|
+        expected = get(port)
+        response = get(port, "deflate")
+        assert_equal([
+                       "deflate",
+                       decode_body(expected.body),
+                     ],
+                     [
+                       response["Content-Encoding"],
+                       decode_body(Zlib::Inflate.inflate(response.body)),
+                     ])
+      end
+      assert_equal(1, n_cache_hits)
+    end
+
+    test("identity") do
+      groonga_http_server do |port|
+        expected = get(port)
+        response = get(port, "identity")
+        assert_equal([
+                       nil,
+                       decode_body(expected.body),
+                     ],
+                     [
+                       response["Content-Encoding"],
+                       decode_body(response.body),
+                     ])
+      end
+      assert_equal(1, n_cache_hits)
+    end
+  end
+
+  sub_test_case("keep-alive") do
+    def open_connection(port)
+      TCPSocket.open("127.0.0.1", port) do |socket|
+        yield(socket)
+      end
+    end
+
+    def build_request(path, headers={})
+      request = "GET #{path} HTTP/1.1\r\n"
+      request << "Host: 127.0.0.1\r\n"
+      headers.each do |name, value|
+        request << "#{name}: #{value}\r\n"
+      end
+      request << "\r\n"
+      request
+    end
+
+    def read_response(socket)
+      status_line = socket.gets
+      headers = {}
+      while (line = socket.gets) != "\r\n"
+        name, value = line.chomp.split(/: */, 2)
+        headers[name] = value
+      end
+      body = socket.read(Integer(headers["Content-Length"]))
+      [status_line.chomp, headers["Connection"], JSON.parse(body)[1]]
+    end
+
+    def closed?(socket)
+      return false unless IO.select([socket], nil, nil, 5)
+      socket.read_nonblock(1, exception: false).nil?
+    rescue Errno::ECONNRESET
+      true
+    end
+
+    def groonga_http_server(*options, keep_alive_timeout: "15", &block)
+      command_line = ["--max-threads", "2"]
+      if keep_alive_timeout
+        command_line.concat(["--http-keep-alive-timeout", keep_alive_timeout])
+      end
+      command_line.concat(options)
+      super(command_line: command_line, &block)
+    end
+
+    test("reuse") do
+      groonga_http_server do |port|
+        open_connection(port) do |socket|
+          socket.write(build_request("/d/cache_limit"))
+          first_response = read_response(socket)
+          socket.write(build_request("/d/thread_limit"))
+          second_response = read_response(socket)
+          assert_equal([
+                         ["HTTP/1.1 200 OK", "keep-alive", 100],
+                         ["HTTP/1.1 200 OK", "keep-alive", 2],
+                       ],
+                       [
+                         first_response,
+                         second_response,
+                       ])
+        end
+      end
+    end
+
+    test("pipelining") do
+      groonga_http_server do |port|
+        open_connection(port) do |socket|
+          socket.write(build_request("/d/cache_limit") +
+                       build_request("/d/thread_limit"))
+          assert_equal([
+                         ["HTTP/1.1 200 OK", "keep-alive", 100],
+                         ["HTTP/1.1 200 OK", "keep-alive", 2],
+                       ],
+                       [
+                         read_response(socket),
+                         read_response(socket),
+                       ])
+        end
+      end
+    end
+
+    test("pipelining: partial header") do
+      groonga_http_server do |port|
+        open_connection(port) do |socket|
+          socket.write(build_request("/d/cache_limit") +
+                       "GET /d/thread_limit HTTP/1.1\r\n")
+          assert_equal([
+                         ["HTTP/1.1 200 OK", "close", 100],
+                         true,
+                       ],
+                       [
+                         read_response(socket),
+                         closed?(socket),
+                       ])
+        end
+      end
+    end
+
+    test("Connection: close") do
+      groonga_http_server do |port|
+        open_connection(port) do |socket|
+          socket.write(build_request("/d/cache_limit",
+                                     "Connection" => "close"))
+          assert_equal([
+                         ["HTTP/1.1 200 OK", "close", 100],
+                         true,
+                       ],
+                       [
+                         read_response(socket),
+                         closed?(socket),
+                       ])
+        end
+      end
+    end
+
+    test("--http-max-keep-alive-requests") do
+      groonga_http_server("--http-max-keep-alive-requests", "2") do |port|
+        open_connection(port) do |socket|
+          socket.write(build_request("/d/cache_limit"))
+          first_response = read_response(socket)
+          socket.write(build_request("/d/thread_limit"))
+          second_response = read_response(socket)
+          assert_equal([
+                         ["HTTP/1.1 200 OK", "keep-alive", 100],
+                         ["HTTP/1.1 200 OK", "close", 2],
+                         true,
+                       ],
+                       [
+                         first_response,
+                         second_response,
+                         closed?(socket),
+                       ])
+        end
+      end
+    end
+
+    test("--http-keep-alive-timeout") do
+      groonga_http_server(keep_alive_timeout: "1") do |port|
+        open_connection(port) do |socket|
+          socket.write(build_request("/d/cache_limit"))
+          assert_equal([
+                         ["HTTP/1.1 200 OK", "keep-alive", 100],
+                         true,
+                       ],
+                       [
+                         read_response(socket),
+                         closed?(socket),
+                       ])
+        end
+      end
+    end
+
+    test("default") do
+      groonga_http_server(keep_alive_timeout: nil) do |port|
+        open_connection(port) do |socket|
+          socket.write(build_request("/d/cache_limit"))
+          assert_equal([
+                         ["HTTP/1.1 200 OK", "close", 100],
+                         true,
+                       ],
+                       [
+                         read_response(socket),
+                         closed?(socket),
+                       ])
+        end
+      end
+    end
+
+    test("--http-keep-alive-timeout 0") do
+      groonga_http_server(keep_alive_timeout: "0") do |port|
+        open_connection(port) do |socket|
+          socket.write(build_request("/d/cache_limit"))
+          assert_equal([
+                         ["HTTP/1.1 200 OK", "close", 100],
+                         true,
+                       ],
+                       [
+                         read_response(socket),
+                         closed?(socket),
+                       ])
+        end
+      end
+    end
+  end
+
+  sub_test_case("worker pool") do
+    def get(port, path)
+      JSON.parse(Net::HTTP.get(URI("http://127.0.0.1:#{port}#{path}")))
+    end
+
+    def thread_end_logs
+      File.readlines(@log_path).grep(/\|n\| thread end /).collect do |line|
+        line[/\(\d+\/(\d+)\)$/, 1]
+      end
+    end
+
+    test("thread_limit: reduce") do
+      groonga_http_server(command_line: ["--max-threads", "4"]) do |port|
+        assert_equal(4, get(port, "/d/thread_limit?max=2")[1])
+        assert_equal(["3", "2"], thread_end_logs)
+        threads = 8.times.collect do
+          Thread.new do
+            get(port, "/d/status")[0][0]
+          end
+        end
+        assert_equal([0] * 8, threads.collect(&:value))
+        assert_equal(["3", "2"], thread_end_logs)
+      end
+    end
+  end
+end
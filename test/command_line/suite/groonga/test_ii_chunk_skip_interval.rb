@@ -0,0 +1,153 @@
+# Copyright(C) 2019 Kouhei Sutou <kou@clear-code.com>
+#
+# This library is free software; you can redistribute it and/or
+# modify it under the terms of the GNU Lesser General Public
+# License version 2.1 as published by the Free Software Foundation.
+#
+# This library is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+# Lesser General Public License for more details.
+#
+# You should have received a copy of the GNU Lesser General Public
+# License along with this library; if not, write to the Free Software
+# Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+class TestGroongaIIChunkSkipInterval < GroongaTestCase
+  SPLIT_ENV = {"GRN_II_CHUNK_SKIP_INTERVAL" => "16"}
+  NO_SPLIT_ENV = {"GRN_II_CHUNK_SKIP_INTERVAL" => "0"}
+
+  def create_database(path, env=NO_SPLIT_ENV)
+    @database_path = path
+    groonga("table_create", "Memos", "TABLE_NO_KEY")
+    groonga("column_create", "Memos", "content", "COLUMN_SCALAR", "ShortText")
+    load_memos({}, 1..50000)
+    groonga("table_create", "Terms", "TABLE_PAT_KEY", "ShortText",
+            "--default_tokenizer", "TokenDelimit")
+    # The index is built statically. It's the layout without sub-chunks
+    # with NO_SPLIT_ENV.
+    groonga("column_create", "Terms", "memos_content",
+            "COLUMN_INDEX|WITH_POSITION", "Memos", "content",
+            env: env)
+  end
+
+  def load_memos(env, ids)
+    values = ids.collect do |i|
+      {"content" => "common #{(i % 10000).zero? ? "rare" : "x"}"}
+    end
+    groonga(env: env) do |process|
+      process.run_command(<<-COMMAND)
+load --table Memos
+#{values.to_json}
+      COMMAND
+    end
+  end
+
+  def inspect_index(env)
+    groonga(env: env) do |process|
+      inspected =
+        JSON.parse(process.run_command("object_inspect Terms.memos_content"))[1]
+      select = <<-COMMAND.gsub(/\n/, " ")
+select Memos
+  --match_columns content
+  --query '"common rare"'
+  --sort_keys _id
+  --output_columns _id
+      COMMAND
+      records = JSON.parse(process.run_command(select))[1][0][2..-1]
+      diff = JSON.parse(process.run_command("index_column_diff Terms memos_content"))[1]
+      return {
+        "total_chunk_size" =>
+          inspected["value"]["statistics"]["total_chunk_size"],
+        "records" => records,
+        "diff" => diff,
+      }
+    end
+  end
+
+  def count_skipped_chunks
+    log_size = File.size(@log_path)
+    groonga(command_line: ["--log-level", "debug"]) do |process|
+      process.run_command(<<-COMMAND.gsub(/\n/, " "))
+select Memos
+  --match_columns content
+  --query '"common rare"'
+  --output_columns _id
+      COMMAND
+    end
+    File.open(@log_path) do |log|
+      log.seek(log_size)
+      log.each_line.inject(0) do |n_skipped_chunks, line|
+        case line
+        when /\[ii\]\[cursor\]\[min\] skip: .* chunk\((\d+)->(\d+)\)/
+          n_skipped_chunks + ($2.to_i - $1.to_i)
+        else
+          n_skipped_chunks
+        end
+      end
+    end
+  end
+
+  test("reopen") do
+    create_database(@tmp_dir + "old.db")
+    old = inspect_index({})
+    reopened = inspect_index(SPLIT_ENV)
+    assert_equal([
+                   old,
+                   [[10000], [20000], [30000], [40000], [50000]],
+                   [],
+                 ],
+                 [
+                   reopened,
+                   old["records"],
+                   old["diff"],
+                 ])
+  end
+
+  test("split") do
+    create_database(@tmp_dir + "plain.db")
+    load_memos(NO_SPLIT_ENV, 50001..100000)
+    plain = inspect_index(NO_SPLIT_ENV)
+
+    create_database(@tmp_dir + "split.db")
+    load_memos(SPLIT_ENV, 50001..100000)
+    split = inspect_index(SPLIT_ENV)
+    reopened = inspect_index(NO_SPLIT_ENV)
+
+    assert_equal([
+                   plain["records"],
+                   [],
+                   true,
+                   split,
+                 ],
+                 [
+                   split["records"],
+                   split["diff"],
+                   split["total_chunk_size"] > plain["total_chunk_size"],
+                   reopened,
+                 ])
+  end
+
+  test("static build") do
+    create_database(@tmp_dir + "plain.db")
+    plain = inspect_index({})
+    plain_n_skipped_chunks = count_skipped_chunks
+
+    create_database(@tmp_dir + "split.db", SPLIT_ENV)
+    split = inspect_index({})
+    split_n_skipped_chunks = count_skipped_chunks
+
+    assert_equal([
+                   plain["records"],
+                   [],
+                   true,
+                   true,
+                 ],
+                 [
+                   split["records"],
+                   split["diff"],
+                   split["total_chunk_size"] > plain["total_chunk_size"],
+                   split_n_skipped_chunks > plain_n_skipped_chunks,
+                 ])
+  end
+end
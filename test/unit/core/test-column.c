@@ -26,6 +26,7 @@
 void test_fix_size_set_value_set(void);
 void test_fix_size_set_value_increment(void);
 void test_create_on_temporary_table(void);
+void test_fix_size_get_values_batch(void);
 
 static grn_logger_info *logger;
 static grn_ctx *context;
@@ -188,3 +189,78 @@ test_create_on_temporary_table(void)
                           found_column_id);
   }
 }
+
+void
+test_fix_size_get_values_batch(void)
+{
+  const gchar column_name[] = "count64";
+  grn_obj *column;
+  /* A segment of an Int64 column has 2^19 values. */
+  const grn_id segment_boundary = 1 << 19;
+  const grn_id set_ids[] = {
+    1,
+    2,
+    3,
+    5,
+    segment_boundary - 2,
+    segment_boundary - 1,
+    segment_boundary,
+    segment_boundary + 1,
+  };
+  const grn_id ids[] = {
+    GRN_ID_NIL,
+    1,
+    2,
+    3,
+    5,
+    4,
+    segment_boundary - 2,
+    segment_boundary - 1,
+    segment_boundary,
+    segment_boundary + 1,
+    2,
+  };
+  const gint64 expected_values[] = {
+    0,
+    10,
+    20,
+    30,
+    50,
+    0,
+    (segment_boundary - 2) * 10,
+    (segment_boundary - 1) * 10,
+    segment_boundary * 10,
+    (segment_boundary + 1) * 10,
+    20,
+  };
+  grn_obj value;
+  grn_obj values;
+  size_t i;
+
+  column = grn_column_create(context,
+                             bookmarks,
+                             column_name,
+                             strlen(column_name),
+                             NULL,
+                             GRN_OBJ_COLUMN_SCALAR,
+                             get_object("Int64"));
+  grn_test_assert_context(context);
+
+  GRN_INT64_INIT(&value, 0);
+  for (i = 0; i < sizeof(set_ids) / sizeof(grn_id); i++) {
+    GRN_INT64_SET(context, &value, set_ids[i] * 10);
+    grn_test_assert(grn_obj_set_value(context, column, set_ids[i],
+                                      &value, GRN_OBJ_SET));
+  }
+  GRN_OBJ_FIN(context, &value);
+
+  GRN_VOID_INIT(&values);
+  grn_test_assert(grn_column_get_values_batch(context,
+                                              column,
+                                              ids,
+                                              sizeof(ids) / sizeof(grn_id),
+                                              &values));
+  cut_assert_equal_memory(expected_values, sizeof(expected_values),
+                          GRN_BULK_HEAD(&values), GRN_BULK_VSIZE(&values));
+  GRN_OBJ_FIN(context, &values);
+}
@@ -0,0 +1 @@
+GRN_VERSION=9.0.7